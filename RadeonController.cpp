@@ -246,6 +246,7 @@ bool RadeonController::start( IOService * provider )
 	options.enableOSXI2C = FALSE;
 	
 	options.lowPowerMode = FALSE;
+	options.enableMemoryAndVoltageScaling = FALSE;
 	if (dict) {
 		prop = OSDynamicCast(OSBoolean, dict->getObject("enableHWCursor"));
 		if (prop) options.HWCursorSupport = prop->getValue();
@@ -256,6 +257,8 @@ bool RadeonController::start( IOService * provider )
 		if (prop) options.enableGammaTable = prop->getValue();
 		prop = OSDynamicCast(OSBoolean, dict->getObject("lowPowerMode"));
 		if (prop) options.lowPowerMode = prop->getValue();
+		prop = OSDynamicCast(OSBoolean, dict->getObject("enableMemoryAndVoltageScaling"));
+		if (prop) options.enableMemoryAndVoltageScaling = prop->getValue();
 	}
 	options.verbosity = 1;
 #ifdef DEBUG
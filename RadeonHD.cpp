@@ -16,6 +16,7 @@
 #include "RadeonHD.h"
 #include "rhd/rhd.h"
 #include "rhd/rhd_crtc.h"
+#include "rhd/rhd_i2c.h"
 #include "rhd/rhd_pm.h"
 #include "OS_Version.h"
 
@@ -359,6 +360,26 @@ IOReturn NDRVHD::doControl( UInt32 code, void * params )
 				ret = kIOReturnSuccess;
 		}
 			break;
+		case cscPrivateControlCall:
+			if (RHDReady && options->enableOSXI2C)
+		{
+			/* DDC/CI VCP batch, see struct rhdDDCCIBatch; the caller's block is
+			 * copied in before it is checked, so it can't change underneath */
+			VDPrivateSelectorDataRec *info = &((VDPrivateSelectorRec *) params)->data[0];
+			struct rhdDDCCIBatch batch;
+			if (!info->privateParameters || (info->privateParametersSize != sizeof(struct rhdDDCCIBatch))) break;
+			bcopy(info->privateParameters, &batch, sizeof(struct rhdDDCCIBatch));
+			if (!RHDDDCCIBatchValid(&batch)) {
+				ret = kIOReturnBadArgument;
+				break;
+			}
+			ret = RadeonHDDoDDCCIBatch(&batch, nubIndex) ? kIOReturnSuccess : kIOReturnIOError;
+			if (info->privateResults && (info->privateResultsSize == sizeof(struct rhdDDCCIBatch)))
+				bcopy(&batch, info->privateResults, sizeof(struct rhdDDCCIBatch));
+			else
+				bcopy(&batch, info->privateParameters, sizeof(struct rhdDDCCIBatch));
+		}
+			break;
 		case cscGrayPage:
 			if (RHDReady)
 		{
@@ -428,6 +449,8 @@ IOReturn NDRVHD::doControl( UInt32 code, void * params )
 				pScrn->bitsPerPixel = fBitsPerPixel;
 				pScrn->depth = pScrn->bitsPerPixel;
 				pScrn->bitsPerComponent = fBitsPerComponent;
+				/* the other head may already have taken the new depth */
+				RadeonHDSetMode(pScrn, fDepth);
 				break;
 			}
 			
@@ -793,7 +816,7 @@ IOReturn NDRVHD::doStatus( UInt32 code, void * params )
 			info->csMinBus = 0;
 			info->csMaxBus = 0;
 			info->csSupportedTypes = kVideoNoTransactionTypeMask | kVideoSimpleI2CTypeMask | kVideoDDCciReplyTypeMask | kVideoCombinedI2CTypeMask;
-			info->csSupportedCommFlags = kVideoUsageAddrSubAddrMask;
+			info->csSupportedCommFlags = kVideoUsageAddrSubAddrMask | kVideoReplyMicroSecDelayMask;
 			ret = kIOReturnSuccess;
 		}
 			break;
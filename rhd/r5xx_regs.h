@@ -71,6 +71,8 @@
 
 #define R5XX_CP_RB_BASE                   0x0700
 #define R5XX_CP_RB_CNTL                   0x0704
+#       define R5XX_RB_BUFSZ_MASK         (0x3f << 0)  /* log2 of size in qwords */
+#       define R5XX_RB_BLKSZ_SHIFT        8            /* log2 of rptr update in qwords */
 #	define R5XX_BUF_SWAP_32BIT	  (2 << 16)
 #	define R5XX_RB_NO_UPDATE	  (1 << 27)
 #       define R5XX_RB_RPTR_WR_ENA        (1 << 31)
@@ -84,6 +86,9 @@
 
 #define R5XX_CP_RB_RPTR_WR                0x071C
 
+#define R5XX_SCRATCH_UMSK                 0x0770
+#define R5XX_SCRATCH_ADDR                 0x0774
+
 #define R5XX_CP_IB_BASE                   0x0738
 #define R5XX_CP_IB_BUFSZ                  0x073c
 
@@ -257,6 +262,8 @@
 #define R5XX_DP_SRC_BKGD_CLR              0x15dc
 #define R5XX_DP_SRC_FRGD_CLR              0x15d8
 
+#define R5XX_SCRATCH_REG0                 0x15e0
+
 #define R5XX_DST_LINE_START               0x1600
 #define R5XX_DST_LINE_END                 0x1604
 #define R5XX_DST_LINE_PATCOUNT            0x1608
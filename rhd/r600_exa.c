@@ -35,10 +35,15 @@
 #include "rhd.h"
 #include "rhd_cs.h"
 #include "r6xx_accel.h"
+#include "rhd_atlas.h"
 #include "r600_shader.h"
 #include "r600_reg.h"
 #include "r600_state.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /* #define SHOW_VERTEXES */
 
 #       define RADEON_ROP3_ZERO             0x00000000
@@ -77,11 +82,621 @@ uint32_t RADEON_ROP[16] = {
     RADEON_ROP3_ONE,  /* GXset          */
 };
 
+/*
+ * Batching.
+ *
+ * Rectangles are not drawn at Done time but collected in the indirect buffer
+ * for as long as following Prepares would emit the very same state; only the
+ * first Prepare of a batch emits anything. The command stream grows from the
+ * start of the buffer, the vertices follow it, and the closing draw is put
+ * in front again once the buffer is handed off: on a state change, on sync,
+ * before the server sleeps, or when the buffer runs full.
+ */
+
+/* room for the draw and syncs that close a batch */
+#define R600_BATCH_TAIL 512
+
 static void
-R600DoneSolid(PixmapPtr pPix);
+R600BatchDraw(ScrnInfoPtr pScrn)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    draw_config_t   draw_conf;
+    vtx_resource_t  vtx_res;
+
+    CLEAR (draw_conf);
+    CLEAR (vtx_res);
+
+    if (accel_state->vb_index == 0) {
+	R600IBDiscard(pScrn, accel_state->ib);
+	return;
+    }
+
+    accel_state->vb_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
+	(accel_state->ib->idx * accel_state->ib->total) + accel_state->vb_start;
+    accel_state->vb_size = accel_state->vb_index * accel_state->vtx_size;
+
+    /* flush vertex cache */
+    if ((rhdPtr->ChipSet == RHD_RV610) ||
+	(rhdPtr->ChipSet == RHD_RV620) ||
+	(rhdPtr->ChipSet == RHD_M72) ||
+	(rhdPtr->ChipSet == RHD_M74) ||
+	(rhdPtr->ChipSet == RHD_M82) ||
+	(rhdPtr->ChipSet == RHD_RS780) ||
+	(rhdPtr->ChipSet == RHD_RS880) ||
+	(rhdPtr->ChipSet == RHD_RV710))
+	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
+			    accel_state->vb_size, accel_state->vb_mc_addr);
+    else
+	cp_set_surface_sync(pScrn, accel_state->ib, VC_ACTION_ENA_bit,
+			    accel_state->vb_size, accel_state->vb_mc_addr);
+
+    /* Vertex buffer setup */
+    vtx_res.id              = SQ_VTX_RESOURCE_vs;
+    vtx_res.vtx_size_dw     = accel_state->vtx_size / 4;
+    vtx_res.vtx_num_entries = accel_state->vb_size / 4;
+    vtx_res.mem_req_size    = 1;
+    vtx_res.vb_addr         = accel_state->vb_mc_addr;
+    set_vtx_resource        (pScrn, accel_state->ib, &vtx_res);
+
+    /* Draw */
+    draw_conf.prim_type          = DI_PT_RECTLIST;
+    draw_conf.vgt_draw_initiator = DI_SRC_SEL_AUTO_INDEX;
+    draw_conf.num_instances      = 1;
+    draw_conf.num_indices        = vtx_res.vtx_num_entries / vtx_res.vtx_size_dw;
+    draw_conf.index_type         = DI_INDEX_SIZE_16_BIT;
+
+    draw_auto(pScrn, accel_state->ib, &draw_conf);
+
+    wait_3d_idle_clean(pScrn, accel_state->ib);
+
+    /* sync dst surface; accel_state->dst_* may belong to the next batch already */
+    cp_set_surface_sync(pScrn, accel_state->ib, (CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit),
+			accel_state->batch_key.dst_size, accel_state->batch_key.dst_mc_addr);
+
+    emit_fence(pScrn, accel_state->ib);
+
+    R600CPFlushIndirect(pScrn, accel_state->ib);
+}
 
 static void
-R600DoneComposite(PixmapPtr pDst);
+R600BatchFlush(ScrnInfoPtr pScrn)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    if (accel_state->batch_key.op == R6XX_BATCH_NONE)
+	return;
+
+    R600BatchDraw(pScrn);
+    accel_state->batch_key.op = R6XX_BATCH_NONE;
+}
+
+/*
+ * Returns TRUE when the rectangles of this operation can go into the pending
+ * batch. Otherwise the pending batch is drawn, and a fresh buffer is set up
+ * for the caller to emit its state into.
+ */
+static Bool
+R600BatchContinue(ScrnInfoPtr pScrn, struct r6xx_batch_key *key)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    if (accel_state->XHas3DEngineState &&
+	(accel_state->batch_key.op != R6XX_BATCH_NONE) &&
+	!memcmp(&accel_state->batch_key, key, sizeof(struct r6xx_batch_key))) {
+	accel_state->batch_continued++;
+	return TRUE;
+    }
+
+    R600BatchFlush(pScrn);
+
+    accel_state->batch_key = *key;
+    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    accel_state->vb_index = 0;
+
+    return FALSE;
+}
+
+/* called once the state is in, vertices go after it */
+static void
+R600BatchStart(ScrnInfoPtr pScrn, int vtx_size)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    accel_state->vtx_size = vtx_size;
+    accel_state->vb_start = (accel_state->ib->used + R600_BATCH_TAIL + 255) & ~255;
+}
+
+/*
+ * Hands off what the pending batch has collected so far without ending it:
+ * the state stays with the engine, the next buffer just draws.
+ */
+static void
+R600BatchBreak(ScrnInfoPtr pScrn)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    if (accel_state->batch_key.op == R6XX_BATCH_NONE)
+	return;
+
+    if (accel_state->vb_index)
+	R600BatchDraw(pScrn);
+    else if (accel_state->ib->used)
+	R600CPFlushIndirect(pScrn, accel_state->ib);
+    else
+	return;
+
+    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    accel_state->vb_index = 0;
+    accel_state->vb_start = R600_BATCH_TAIL;
+}
+
+/* room for one more rectangle, three vertices */
+static float *
+R600BatchVertices(ScrnInfoPtr pScrn)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    float *vb;
+
+    if ((accel_state->vb_start + (accel_state->vb_index + 3) * accel_state->vtx_size) >
+	accel_state->ib->total)
+	R600BatchBreak(pScrn);
+
+    vb = (pointer)((char*)accel_state->ib->address +
+		   accel_state->vb_start +
+		   accel_state->vb_index * accel_state->vtx_size);
+
+    accel_state->vb_index += 3;
+    accel_state->batch_rects++;
+
+    return vb;
+}
+
+/* hand off whatever is batched up */
+void
+R6xxEXAFlush(ScrnInfoPtr pScrn)
+{
+    if (!RHDPTR(pScrn)->TwoDPrivate)
+	return;
+
+    R600BatchFlush(pScrn);
+}
+
+/*
+ * Engine selection.
+ *
+ * Large fills and copies of dword aligned rows do not need the 3D engine:
+ * the CP moves them itself with CP_DMA, a packet per row, or a few for the
+ * whole rectangle when its rows are contiguous. Fills are copied from a
+ * pattern at the end of the indirect buffer. Everything below the thresholds
+ * stays in the 3D batch, where a rectangle costs three vertices instead of a
+ * buffer and a wait of its own.
+ */
+
+/* rectangles of at least this many bytes go to CP DMA, 0 turns it off */
+#define R600_DMA_FILL_MIN	(128 * 1024)
+#define R600_DMA_COPY_MIN	(64 * 1024)
+/* narrower rows cost more in packets than the 3D setup they save */
+#define R600_DMA_ROW_MIN	256
+
+/* fill pattern kept at the end of each buffer */
+#define R600_DMA_PATTERN_MAX	(16 * 1024)
+/* one CP_DMA packet, and room for the waits and fence closing a buffer */
+#define R600_DMA_PACKET_SIZE	(6 * 4)
+#define R600_DMA_TAIL		256
+
+static Bool
+R600DmaPlanemask(Pixel pm, int bpp)
+{
+    uint32_t mask = (bpp == 32) ? 0xffffffff : ((1 << bpp) - 1);
+
+    return (pm & mask) == mask;
+}
+
+/* returns FALSE when the raster op needs the 3D engine */
+static Bool
+R600DmaFillValue(int alu, Pixel pm, Pixel fg, int bpp, uint32_t *fill)
+{
+    uint32_t mask = (bpp == 32) ? 0xffffffff : ((1 << bpp) - 1);
+
+    if (!R600DmaPlanemask(pm, bpp))
+	return FALSE;
+
+    switch (alu) {
+    case GXclear:
+	fg = 0;
+	break;
+    case GXset:
+	fg = 0xffffffff;
+	break;
+    case GXcopy:
+	break;
+    default:
+	return FALSE;
+    }
+
+    fg &= mask;
+    if (bpp == 8)
+	*fill = fg * 0x01010101;
+    else if (bpp == 16)
+	*fill = fg | (fg << 16);
+    else
+	*fill = fg;
+
+    return TRUE;
+}
+
+static Bool
+R600DmaUsable(struct r6xx_accel_state *accel_state, uint32_t x_bytes,
+	      uint32_t w_bytes, int h, uint32_t min)
+{
+    if (!accel_state->dma_ok || !min)
+	return FALSE;
+
+    if ((x_bytes | w_bytes) & 3)
+	return FALSE;
+
+    if (w_bytes < accel_state->dma_row_min)
+	return FALSE;
+
+    return (w_bytes * h) >= min;
+}
+
+static drmBufPtr
+R600DmaBuffer(ScrnInfoPtr pScrn, uint32_t pattern_bytes, uint32_t *limit)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    drmBufPtr ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    uint32_t *pattern;
+    uint32_t i;
+
+    *limit = ib->total;
+
+    if (pattern_bytes) {
+	*limit = (ib->total - pattern_bytes) & ~255;
+	pattern = (uint32_t *)((char *)ib->address + *limit);
+	for (i = 0; i < (pattern_bytes >> 2); i++)
+	    pattern[i] = accel_state->dma_fill;
+    }
+
+    return ib;
+}
+
+static void
+R600DmaEnd(ScrnInfoPtr pScrn, drmBufPtr ib, uint64_t dst_mc_addr, uint32_t dst_size)
+{
+    /* the 3D engine must not see the destination before the copy landed */
+    EREG(ib, WAIT_UNTIL,                          WAIT_CP_DMA_IDLE_bit);
+    cp_set_surface_sync(pScrn, ib, TC_ACTION_ENA_bit,
+			dst_size + (dst_mc_addr & 0xff), dst_mc_addr);
+
+    emit_fence(pScrn, ib);
+
+    R600CPFlushIndirect(pScrn, ib);
+}
+
+/*
+ * Moves rows of bytes with CP_DMA, or fills them with accel_state->dma_fill.
+ * Rows of an overlapping copy are done one at a time, bottom up when the
+ * destination lies below the source.
+ */
+static void
+R600DmaRows(ScrnInfoPtr pScrn,
+	    uint64_t dst_mc_addr, uint32_t dst_pitch,
+	    uint64_t src_mc_addr, uint32_t src_pitch,
+	    uint32_t bytes, int rows, Bool fill, Bool overlap, Bool bottom_up)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    uint32_t dst_size = (rows - 1) * dst_pitch + bytes;
+    uint32_t pattern_bytes = 0, limit = 0;
+    uint64_t pattern_mc_addr = 0;
+    drmBufPtr ib = NULL;
+    int i;
+
+    accel_state->dma_rects++;
+    accel_state->dma_bytes += bytes * rows;
+
+    /* whatever was batched before has to land first */
+    R600BatchBreak(pScrn);
+
+    /* contiguous rows are a single span */
+    if (!overlap && (dst_pitch == bytes) && (fill || (src_pitch == bytes))) {
+	bytes *= rows;
+	rows = 1;
+    }
+
+    if (fill)
+	pattern_bytes = (bytes < R600_DMA_PATTERN_MAX) ? bytes : R600_DMA_PATTERN_MAX;
+
+    for (i = 0; i < rows; i++) {
+	int row = bottom_up ? (rows - 1 - i) : i;
+	uint64_t dst = dst_mc_addr + row * dst_pitch;
+	uint64_t src = src_mc_addr + row * src_pitch;
+	uint32_t done, size;
+
+	for (done = 0; done < bytes; done += size) {
+	    if (!ib || ((ib->used + R600_DMA_PACKET_SIZE + R600_DMA_TAIL) > limit)) {
+		if (ib)
+		    R600DmaEnd(pScrn, ib, dst_mc_addr, dst_size);
+		ib = R600DmaBuffer(pScrn, pattern_bytes, &limit);
+		pattern_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
+		    (ib->idx * ib->total) + limit;
+	    }
+
+	    size = bytes - done;
+	    if (fill) {
+		if (size > pattern_bytes)
+		    size = pattern_bytes;
+		cp_dma(pScrn, ib, dst + done, pattern_mc_addr, size, FALSE);
+	    } else {
+		if (size > CP_DMA_BYTE_COUNT_max)
+		    size = CP_DMA_BYTE_COUNT_max;
+		cp_dma(pScrn, ib, dst + done, src + done, size, overlap);
+	    }
+	}
+    }
+
+    if (ib)
+	R600DmaEnd(pScrn, ib, dst_mc_addr, dst_size);
+}
+
+/*
+ * Glyph atlases.
+ *
+ * Text comes in as a composite per glyph, the glyph being the mask, or the
+ * source when EXA first adds a run up into a mask of its own. Every glyph
+ * is a pixmap of its own and so breaks the batch. Small untransformed A8
+ * and ARGB pictures are copied once into an atlas texture with CP DMA, and
+ * sampled from there at an offset; a run of glyphs then shares its texture
+ * state and goes out as one draw.
+ *
+ * Atlas entries are keyed on the pixmap serial number and dropped whenever
+ * the pixmap is drawn to or mapped for writing.
+ */
+#define R600_GLYPH_ATLAS_SIZE	512
+/* largest glyph, also the height of an atlas band */
+#define R600_GLYPH_MAX		64
+
+static void
+R600GlyphInvalidate(struct r6xx_accel_state *accel_state, PixmapPtr pPix)
+{
+    int i;
+
+    if ((pPix->drawable.width > R600_GLYPH_MAX) ||
+	(pPix->drawable.height > R600_GLYPH_MAX))
+	return;
+
+    for (i = 0; i < R6XX_GLYPH_ATLASES; i++)
+	if (accel_state->glyph_atlas[i].atlas)
+	    RHDAtlasRemove(accel_state->glyph_atlas[i].atlas,
+			   pPix->drawable.serialNumber);
+}
+
+/* the atlas a picture can be sampled from, NULL if none */
+static struct r6xx_glyph_atlas *
+R600GlyphAtlas(struct r6xx_accel_state *accel_state, PicturePtr pPict)
+{
+    int i;
+
+    if (pPict->transform || pPict->repeat ||
+	(pPict->pDrawable->type != DRAWABLE_PIXMAP) ||
+	(pPict->pDrawable->width > R600_GLYPH_MAX) ||
+	(pPict->pDrawable->height > R600_GLYPH_MAX))
+	return NULL;
+
+    for (i = 0; i < R6XX_GLYPH_ATLASES; i++)
+	if (accel_state->glyph_atlas[i].atlas &&
+	    (accel_state->glyph_atlas[i].format == pPict->format))
+	    return &accel_state->glyph_atlas[i];
+
+    return NULL;
+}
+
+/* finds the pixmap in the atlas, copying it there first if needed */
+static Bool
+R600GlyphCache(ScrnInfoPtr pScrn, struct r6xx_glyph_atlas *glyphs,
+	       PixmapPtr pPix, struct rhdAtlasRect *rect)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    int w = pPix->drawable.width;
+    int h = pPix->drawable.height;
+    uint64_t src_mc_addr, dst_mc_addr;
+
+    if (RHDAtlasLookup(glyphs->atlas, pPix->drawable.serialNumber, rect))
+	return TRUE;
+
+    if (!RHDAtlasInsert(glyphs->atlas, pPix->drawable.serialNumber, w, h, rect))
+	return FALSE;
+
+    src_mc_addr = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+    dst_mc_addr = glyphs->mc_addr + rect->Y * glyphs->pitch + rect->X * glyphs->cpp;
+
+    /* atlas slots are dword aligned, rows are rounded up into their padding;
+     * this also breaks the batch, so anything sampling an evicted band is
+     * drawn before it gets overwritten */
+    R600DmaRows(pScrn, dst_mc_addr, glyphs->pitch,
+		src_mc_addr, exaGetPixmapPitch(pPix),
+		(w * glyphs->cpp + 3) & ~3, h, FALSE, FALSE, FALSE);
+
+    accel_state->glyph_uploads++;
+
+    return TRUE;
+}
+
+static void
+R600AllocGlyphAtlases(ScrnInfoPtr pScrn, ScreenPtr pScreen)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    static const uint32_t formats[R6XX_GLYPH_ATLASES] = { PICT_a8, PICT_a8r8g8b8 };
+    int i;
+
+    for (i = 0; i < R6XX_GLYPH_ATLASES; i++) {
+	struct r6xx_glyph_atlas *glyphs = &accel_state->glyph_atlas[i];
+
+	glyphs->format = formats[i];
+	glyphs->cpp = PICT_FORMAT_BPP(formats[i]) / 8;
+	glyphs->pitch = R600_GLYPH_ATLAS_SIZE * glyphs->cpp;
+
+	glyphs->area = exaOffscreenAlloc(pScreen, glyphs->pitch * R600_GLYPH_ATLAS_SIZE,
+					 256, TRUE, NULL, NULL);
+	if (!glyphs->area)
+	    continue;
+
+	glyphs->mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + glyphs->area->offset;
+	glyphs->atlas = RHDAtlasCreate(R600_GLYPH_ATLAS_SIZE, R600_GLYPH_ATLAS_SIZE,
+				       R600_GLYPH_MAX, 4 / glyphs->cpp);
+	if (!glyphs->atlas) {
+	    exaOffscreenFree(pScreen, glyphs->area);
+	    glyphs->area = NULL;
+	}
+    }
+}
+
+/*
+ * Tiled pixmaps.
+ *
+ * EXA places pixmaps itself and knows them only as linear. A large pixmap
+ * that gets uploaded as a whole is switched to ARRAY_1D_TILED_THIN1 right
+ * there, as the upload defines all of its contents; the 3D engine then
+ * renders to and samples from it tiled. The CPU is handed a linear copy in
+ * PrepareAccess that FinishAccess writes back. CP DMA moves bytes, not
+ * pixels, so it stays away from tiled pixmaps.
+ *
+ * A slot only counts while pixmap, serial number and address still match;
+ * it is dropped when its pixmap is destroyed or any pixmap overlapping it
+ * comes by. The front buffer stays linear, scanout is set up that way and
+ * the window server draws into it directly.
+ */
+/* smaller pixmaps do not gain enough to make up for the CPU copies */
+#define R600_TILED_MIN		(256 * 1024)
+
+static void
+R600TiledDrop(struct r6xx_tiled_surface *tiled)
+{
+    if (tiled->shadow)
+	xfree(tiled->shadow);
+    tiled->shadow = NULL;
+    tiled->access = 0;
+    tiled->pPix = NULL;
+}
+
+/* the slot of a tiled pixmap, NULL if the pixmap is linear */
+static struct r6xx_tiled_surface *
+R600TiledSurface(ScrnInfoPtr pScrn, PixmapPtr pPix)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    struct r6xx_tiled_surface *found = NULL;
+    uint64_t mc_addr = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+    uint32_t size = exaGetPixmapPitch(pPix) * pPix->drawable.height;
+    int i;
+
+    for (i = 0; i < R6XX_TILED_SURFACES; i++) {
+	struct r6xx_tiled_surface *tiled = &accel_state->tiled[i];
+
+	if (!tiled->pPix ||
+	    (tiled->mc_addr >= (mc_addr + size)) ||
+	    ((tiled->mc_addr + tiled->layout.Size) <= mc_addr))
+	    continue;
+
+	/* left behind by a pixmap that moved or went away */
+	if ((tiled->pPix != pPix) ||
+	    (tiled->serial != pPix->drawable.serialNumber) ||
+	    (tiled->mc_addr != mc_addr) ||
+	    (tiled->layout.Size != size)) {
+	    R600TiledDrop(tiled);
+	    continue;
+	}
+
+	found = tiled;
+    }
+
+    return found;
+}
+
+uint32_t
+R600PixmapArrayMode(ScrnInfoPtr pScrn, PixmapPtr pPix)
+{
+    if (R600TiledSurface(pScrn, pPix))
+	return ARRAY_1D_TILED_THIN1;
+
+    return ARRAY_LINEAR_GENERAL;
+}
+
+/* for an upload covering all of the pixmap, before anything is written */
+static struct r6xx_tiled_surface *
+R600TiledAdd(ScrnInfoPtr pScrn, PixmapPtr pPix)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    struct r6xx_tiled_surface *tiled;
+    struct rhdSurfaceLayout layout;
+    uint64_t mc_addr = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+    int cpp = pPix->drawable.bitsPerPixel / 8;
+    int i;
+
+    tiled = R600TiledSurface(pScrn, pPix);
+    if (tiled)
+	return tiled;
+
+    if (!accel_state->tiled_min ||
+	((exaGetPixmapPitch(pPix) * pPix->drawable.height) < accel_state->tiled_min))
+	return NULL;
+
+    if (exaGetPixmapOffset(pPix) < (rhdPtr->FbOffscreenStart - rhdPtr->FbScanoutStart))
+	return NULL;
+
+    if (!RHDSurfaceLayout(&accel_state->tiling, RHD_ARRAY_1D_TILED_THIN1, cpp,
+			  exaGetPixmapPitch(pPix) / cpp, pPix->drawable.height,
+			  &layout))
+	return NULL;
+
+    /* the tiles have to fit what EXA allocated, partial tile rows do not */
+    if (((layout.Pitch * cpp) != exaGetPixmapPitch(pPix)) ||
+	(layout.Height != pPix->drawable.height) ||
+	(mc_addr & (layout.BaseAlign - 1)))
+	return NULL;
+
+    for (i = 0; i < R6XX_TILED_SURFACES; i++) {
+	tiled = &accel_state->tiled[i];
+	if (tiled->pPix)
+	    continue;
+
+	tiled->pPix = pPix;
+	tiled->serial = pPix->drawable.serialNumber;
+	tiled->mc_addr = mc_addr;
+	tiled->layout = layout;
+	tiled->shadow = NULL;
+	tiled->access = 0;
+	tiled->dirty = FALSE;
+
+	return tiled;
+    }
+
+    return NULL;
+}
+
+static Bool
+R600DestroyPixmap(PixmapPtr pPix)
+{
+    ScreenPtr pScreen = pPix->drawable.pScreen;
+    struct r6xx_accel_state *accel_state = RHDPTR(xf86Screens[pScreen->myNum])->TwoDPrivate;
+    Bool ret;
+    int i;
+
+    if (pPix->refcnt == 1)
+	for (i = 0; i < R6XX_TILED_SURFACES; i++)
+	    if (accel_state->tiled[i].pPix == pPix)
+		R600TiledDrop(&accel_state->tiled[i]);
+
+    pScreen->DestroyPixmap = accel_state->DestroyPixmap;
+    ret = (*pScreen->DestroyPixmap) (pPix);
+    pScreen->DestroyPixmap = R600DestroyPixmap;
+
+    return ret;
+}
 
 static Bool
 R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
@@ -91,6 +706,7 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
     cb_config_t     cb_conf;
     shader_config_t vs_conf, ps_conf;
+    struct r6xx_batch_key key;
     int pmask = 0;
     uint32_t a, r, g, b;
     float ps_alu_consts[4];
@@ -110,9 +726,14 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
     if (pPix->drawable.bitsPerPixel == 24)
 	return FALSE;
 
+    R600GlyphInvalidate(accel_state, pPix);
+
+    accel_state->dst_array_mode = R600PixmapArrayMode(pScrn, pPix);
+
     CLEAR (cb_conf);
     CLEAR (vs_conf);
     CLEAR (ps_conf);
+    CLEAR (key);
 
     /* return FALSE; */
 
@@ -121,7 +742,25 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
 	   pPix->drawable.bitsPerPixel, exaGetPixmapPitch(pPix));
 #endif
 
-    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    accel_state->dma_ok = (accel_state->dst_array_mode == ARRAY_LINEAR_GENERAL) &&
+	R600DmaFillValue(alu, pm, fg, pPix->drawable.bitsPerPixel, &accel_state->dma_fill);
+    accel_state->dma_dst_mc_addr = accel_state->dst_mc_addr;
+    accel_state->dma_dst_pitch = exaGetPixmapPitch(pPix);
+    accel_state->dma_cpp = pPix->drawable.bitsPerPixel / 8;
+
+    key.op          = R6XX_BATCH_SOLID;
+    key.dst_mc_addr = accel_state->dst_mc_addr;
+    key.dst_pitch   = accel_state->dst_pitch;
+    key.dst_height  = pPix->drawable.height;
+    key.dst_format  = pPix->drawable.bitsPerPixel;
+    key.dst_size    = accel_state->dst_size;
+    key.dst_array_mode = accel_state->dst_array_mode;
+    key.alu         = alu;
+    key.planemask   = pm;
+    key.fg          = fg;
+
+    if (R600BatchContinue(pScrn, &key))
+	return TRUE;
 
     /* Init */
     start_3d(pScrn, accel_state->ib);
@@ -131,8 +770,8 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
     set_default_state(pScrn, accel_state->ib);
 
     /* Scissor / viewport */
-    EREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
-    EREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
+    CREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
+    CREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
 
     accel_state->vs_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
 	accel_state->solid_vs_offset;
@@ -173,15 +812,16 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
 	pmask |= 1; /* R */
     if (pm & 0xff000000)
 	pmask |= 8; /* A */
-    EREG(accel_state->ib, CB_SHADER_MASK,                      (pmask << OUTPUT0_ENABLE_shift));
-    EREG(accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
-    EREG(accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[alu]);
+    CREG(accel_state->ib, CB_SHADER_MASK,                      (pmask << OUTPUT0_ENABLE_shift));
+    CREG(accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
+    CREG(accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[alu]);
 
 
     cb_conf.id = 0;
     cb_conf.w = accel_state->dst_pitch;
     cb_conf.h = pPix->drawable.height;
     cb_conf.base = accel_state->dst_mc_addr;
+    cb_conf.array_mode = accel_state->dst_array_mode;
 
     if (pPix->drawable.bitsPerPixel == 8) {
 	cb_conf.format = COLOR_8;
@@ -197,28 +837,28 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
     cb_conf.blend_clamp = 1;
     set_render_target(pScrn, accel_state->ib, &cb_conf);
 
-    EREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
+    CREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_FRONT_PTYPE_shift)	|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_BACK_PTYPE_shift)));
-    EREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
+    CREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
 								DUAL_EXPORT_ENABLE_bit)); /* Only useful if no depth export */
 
     /* Interpolator setup */
     /* one unused export from VS (VS_EXPORT_COUNT is zero based, count minus one) */
-    EREG(accel_state->ib, SPI_VS_OUT_CONFIG, (0 << VS_EXPORT_COUNT_shift));
-    EREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_CONFIG, (0 << VS_EXPORT_COUNT_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
 
     /* Enabling flat shading needs both FLAT_SHADE_bit in SPI_PS_INPUT_CNTL_x
      * *and* FLAT_SHADE_ENA_bit in SPI_INTERP_CONTROL_0 */
     /* no VS exports as PS input (NUM_INTERP is not zero based, no minus one) */
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 (0 << NUM_INTERP_shift));
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 (0 << NUM_INTERP_shift));
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
     /* color semantic id 0 -> GPR[0] */
-    EREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
+    CREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
 								(0x03 << DEFAULT_VAL_shift)	|
 								FLAT_SHADE_bit		|
 								SEL_CENTROID_bit));
-    EREG(accel_state->ib, SPI_INTERP_CONTROL_0,                FLAT_SHADE_ENA_bit | 0);
+    CREG(accel_state->ib, SPI_INTERP_CONTROL_0,                FLAT_SHADE_ENA_bit | 0);
 
     /* PS alu constants */
     if (pPix->drawable.bitsPerPixel == 16) {
@@ -247,7 +887,7 @@ R600PrepareSolid(PixmapPtr pPix, int alu, Pixel pm, Pixel fg)
     }
     set_alu_consts(pScrn, accel_state->ib, 0, sizeof(ps_alu_consts) / SQ_ALU_CONSTANT_offset, ps_alu_consts);
 
-    accel_state->vb_index = 0;
+    R600BatchStart(pScrn, 8);
 
 #ifdef SHOW_VERTEXES
     LOG("PM: 0x%08x\n", pm);
@@ -261,19 +901,20 @@ static void
 R600Solid(PixmapPtr pPix, int x1, int y1, int x2, int y2)
 {
     ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    int cpp = accel_state->dma_cpp;
     float *vb;
 
-    if (((accel_state->vb_index + 3) * 8) > (accel_state->ib->total / 2)) {
-	R600DoneSolid(pPix);
-	accel_state->vb_index = 0;
-	accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    if (R600DmaUsable(accel_state, x1 * cpp, (x2 - x1) * cpp, y2 - y1,
+		      accel_state->dma_fill_min)) {
+	R600DmaRows(pScrn,
+		    accel_state->dma_dst_mc_addr + y1 * accel_state->dma_dst_pitch + x1 * cpp,
+		    accel_state->dma_dst_pitch, 0, 0,
+		    (x2 - x1) * cpp, y2 - y1, TRUE, FALSE, FALSE);
+	return;
     }
 
-    vb = (pointer)((char*)accel_state->ib->address +
-		   (accel_state->ib->total / 2) +
-		   accel_state->vb_index * 8);
+    vb = R600BatchVertices(pScrn);
 
     vb[0] = (float)x1;
     vb[1] = (float)y1;
@@ -282,78 +923,22 @@ R600Solid(PixmapPtr pPix, int x1, int y1, int x2, int y2)
     vb[3] = (float)y2;
 
     vb[4] = (float)x2;
-    vb[5] = (float)y2;
-
-    accel_state->vb_index += 3;
-
-}
-
-static void
-R600DoneSolid(PixmapPtr pPix)
-{
-    ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    draw_config_t   draw_conf;
-    vtx_resource_t  vtx_res;
-
-    CLEAR (draw_conf);
-    CLEAR (vtx_res);
-
-    if (accel_state->vb_index == 0) {
-	R600IBDiscard(pScrn, accel_state->ib);
-	return;
-    }
-
-    accel_state->vb_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
-	(accel_state->ib->idx * accel_state->ib->total) + (accel_state->ib->total / 2);
-    accel_state->vb_size = accel_state->vb_index * 8;
-
-    /* flush vertex cache */
-    if ((rhdPtr->ChipSet == RHD_RV610) ||
-	(rhdPtr->ChipSet == RHD_RV620) ||
-	(rhdPtr->ChipSet == RHD_M72) ||
-	(rhdPtr->ChipSet == RHD_M74) ||
-	(rhdPtr->ChipSet == RHD_M82) ||
-	(rhdPtr->ChipSet == RHD_RS780) ||
-	(rhdPtr->ChipSet == RHD_RS880) ||
-	(rhdPtr->ChipSet == RHD_RV710))
-	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-    else
-	cp_set_surface_sync(pScrn, accel_state->ib, VC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-
-    /* Vertex buffer setup */
-    vtx_res.id              = SQ_VTX_RESOURCE_vs;
-    vtx_res.vtx_size_dw     = 8 / 4;
-    vtx_res.vtx_num_entries = accel_state->vb_size / 4;
-    vtx_res.mem_req_size    = 1;
-    vtx_res.vb_addr         = accel_state->vb_mc_addr;
-    set_vtx_resource        (pScrn, accel_state->ib, &vtx_res);
-
-    /* Draw */
-    draw_conf.prim_type          = DI_PT_RECTLIST;
-    draw_conf.vgt_draw_initiator = DI_SRC_SEL_AUTO_INDEX;
-    draw_conf.num_instances      = 1;
-    draw_conf.num_indices        = vtx_res.vtx_num_entries / vtx_res.vtx_size_dw;
-    draw_conf.index_type         = DI_INDEX_SIZE_16_BIT;
-
-    draw_auto(pScrn, accel_state->ib, &draw_conf);
-
-    wait_3d_idle_clean(pScrn, accel_state->ib);
+    vb[5] = (float)y2;
 
-    /* sync dst surface */
-    cp_set_surface_sync(pScrn, accel_state->ib, (CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit),
-			accel_state->dst_size, accel_state->dst_mc_addr);
+}
 
-    R600CPFlushIndirect(pScrn, accel_state->ib);
+static void
+R600DoneSolid(PixmapPtr pPix)
+{
+    /* the rectangles stay batched, see R600BatchContinue() */
 }
 
 static void
 R600DoPrepareCopy(ScrnInfoPtr pScrn,
 		  int src_pitch, int src_width, int src_height, uint32_t src_offset, int src_bpp,
+		  uint32_t src_array_mode,
 		  int dst_pitch, int dst_height, uint32_t dst_offset, int dst_bpp,
+		  uint32_t dst_array_mode,
 		  int rop, Pixel planemask)
 {
     RHDPtr rhdPtr = RHDPTR(pScrn);
@@ -363,14 +948,33 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
     tex_resource_t  tex_res;
     tex_sampler_t   tex_samp;
     shader_config_t vs_conf, ps_conf;
+    struct r6xx_batch_key key;
 
     CLEAR (cb_conf);
     CLEAR (tex_res);
     CLEAR (tex_samp);
     CLEAR (vs_conf);
     CLEAR (ps_conf);
-
-    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    CLEAR (key);
+
+    key.op             = R6XX_BATCH_COPY;
+    key.dst_mc_addr    = dst_offset;
+    key.dst_pitch      = dst_pitch;
+    key.dst_height     = dst_height;
+    key.dst_format     = dst_bpp;
+    key.dst_size       = dst_pitch * dst_height * (dst_bpp/8);
+    key.src_mc_addr[0] = src_offset;
+    key.src_pitch[0]   = src_pitch;
+    key.src_width[0]   = src_width;
+    key.src_height[0]  = src_height;
+    key.src_format[0]  = src_bpp;
+    key.src_array_mode[0] = src_array_mode;
+    key.dst_array_mode = dst_array_mode;
+    key.alu            = rop;
+    key.planemask      = planemask;
+
+    if (R600BatchContinue(pScrn, &key))
+	return;
 
     /* Init */
     start_3d(pScrn, accel_state->ib);
@@ -380,8 +984,8 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
     set_default_state(pScrn, accel_state->ib);
 
     /* Scissor / viewport */
-    EREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
-    EREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
+    CREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
+    CREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
 
     accel_state->vs_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
 	accel_state->copy_vs_offset;
@@ -433,6 +1037,7 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
     tex_res.dim                 = SQ_TEX_DIM_2D;
     tex_res.base                = accel_state->src_mc_addr[0];
     tex_res.mip_base            = accel_state->src_mc_addr[0];
+    tex_res.tile_mode           = src_array_mode;
     if (src_bpp == 8) {
 	tex_res.format              = FMT_8;
 	tex_res.dst_sel_x           = SQ_SEL_1; /* R */
@@ -479,9 +1084,9 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
 	pmask |= 1; /* R */
     if (planemask & 0xff000000)
 	pmask |= 8; /* A */
-    EREG  (accel_state->ib, CB_SHADER_MASK,                      (pmask << OUTPUT0_ENABLE_shift));
-    EREG  (accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
-    EREG  (accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[rop]);
+    CREG  (accel_state->ib, CB_SHADER_MASK,                      (pmask << OUTPUT0_ENABLE_shift));
+    CREG  (accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
+    CREG  (accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[rop]);
 
     accel_state->dst_size = dst_pitch * dst_height * (dst_bpp/8);
     accel_state->dst_mc_addr = dst_offset;
@@ -493,6 +1098,7 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
     cb_conf.w = accel_state->dst_pitch;
     cb_conf.h = dst_height;
     cb_conf.base = accel_state->dst_mc_addr;
+    cb_conf.array_mode = dst_array_mode;
     if (dst_bpp == 8) {
 	cb_conf.format = COLOR_8;
 	cb_conf.comp_swap = 3; /* A */
@@ -507,90 +1113,30 @@ R600DoPrepareCopy(ScrnInfoPtr pScrn,
     cb_conf.blend_clamp = 1;
     set_render_target(pScrn, accel_state->ib, &cb_conf);
 
-    EREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
+    CREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_FRONT_PTYPE_shift)	|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_BACK_PTYPE_shift)));
-    EREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
+    CREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
 								DUAL_EXPORT_ENABLE_bit)); /* Only useful if no depth export */
 
     /* Interpolator setup */
     /* export tex coord from VS */
-    EREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
-    EREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
 
     /* Enabling flat shading needs both FLAT_SHADE_bit in SPI_PS_INPUT_CNTL_x
      * *and* FLAT_SHADE_ENA_bit in SPI_INTERP_CONTROL_0 */
     /* input tex coord from VS */
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 ((1 << NUM_INTERP_shift)));
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 ((1 << NUM_INTERP_shift)));
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
     /* color semantic id 0 -> GPR[0] */
-    EREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
+    CREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
 								(0x01 << DEFAULT_VAL_shift)	|
 								SEL_CENTROID_bit));
-    EREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
-
-    accel_state->vb_index = 0;
-
-}
-
-static void
-R600DoCopy(ScrnInfoPtr pScrn)
-{
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    draw_config_t   draw_conf;
-    vtx_resource_t  vtx_res;
-
-    CLEAR (draw_conf);
-    CLEAR (vtx_res);
-
-    if (accel_state->vb_index == 0) {
-	R600IBDiscard(pScrn, accel_state->ib);
-	return;
-    }
-
-    accel_state->vb_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
-	(accel_state->ib->idx * accel_state->ib->total) + (accel_state->ib->total / 2);
-    accel_state->vb_size = accel_state->vb_index * 16;
-
-    /* flush vertex cache */
-    if ((rhdPtr->ChipSet == RHD_RV610) ||
-	(rhdPtr->ChipSet == RHD_RV620) ||
-	(rhdPtr->ChipSet == RHD_M72) ||
-	(rhdPtr->ChipSet == RHD_M74) ||
-	(rhdPtr->ChipSet == RHD_M82) ||
-	(rhdPtr->ChipSet == RHD_RS780) ||
-	(rhdPtr->ChipSet == RHD_RS880) ||
-	(rhdPtr->ChipSet == RHD_RV710))
-	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-    else
-	cp_set_surface_sync(pScrn, accel_state->ib, VC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-
-    /* Vertex buffer setup */
-    vtx_res.id              = SQ_VTX_RESOURCE_vs;
-    vtx_res.vtx_size_dw     = 16 / 4;
-    vtx_res.vtx_num_entries = accel_state->vb_size / 4;
-    vtx_res.mem_req_size    = 1;
-    vtx_res.vb_addr         = accel_state->vb_mc_addr;
-    set_vtx_resource        (pScrn, accel_state->ib, &vtx_res);
-
-    draw_conf.prim_type          = DI_PT_RECTLIST;
-    draw_conf.vgt_draw_initiator = DI_SRC_SEL_AUTO_INDEX;
-    draw_conf.num_instances      = 1;
-    draw_conf.num_indices        = vtx_res.vtx_num_entries / vtx_res.vtx_size_dw;
-    draw_conf.index_type         = DI_INDEX_SIZE_16_BIT;
-
-    draw_auto(pScrn, accel_state->ib, &draw_conf);
-
-    wait_3d_idle_clean(pScrn, accel_state->ib);
+    CREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
 
-    /* sync dst surface */
-    cp_set_surface_sync(pScrn, accel_state->ib, (CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit),
-			accel_state->dst_size, accel_state->dst_mc_addr);
+    R600BatchStart(pScrn, 16);
 
-    R600CPFlushIndirect(pScrn, accel_state->ib);
 }
 
 static void
@@ -599,19 +1145,9 @@ R600AppendCopyVertex(ScrnInfoPtr pScrn,
 		     int dstX, int dstY,
 		     int w, int h)
 {
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
     float *vb;
 
-    if (((accel_state->vb_index + 3) * 16) > (accel_state->ib->total / 2)) {
-	R600DoCopy(pScrn);
-	accel_state->vb_index = 0;
-	accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
-    }
-
-    vb = (pointer)((char*)accel_state->ib->address +
-		   (accel_state->ib->total / 2) +
-		   accel_state->vb_index * 16);
+    vb = R600BatchVertices(pScrn);
 
     vb[0] = (float)dstX;
     vb[1] = (float)dstY;
@@ -627,8 +1163,6 @@ R600AppendCopyVertex(ScrnInfoPtr pScrn,
     vb[9] = (float)(dstY + h);
     vb[10] = (float)(srcX + w);
     vb[11] = (float)(srcY + h);
-
-    accel_state->vb_index += 3;
 }
 
 static Bool
@@ -670,6 +1204,11 @@ R600PrepareCopy(PixmapPtr pSrc,   PixmapPtr pDst,
     if (pDst->drawable.bitsPerPixel == 24)
 	return FALSE;
 
+    R600GlyphInvalidate(accel_state, pDst);
+
+    accel_state->src_array_mode[0] = R600PixmapArrayMode(pScrn, pSrc);
+    accel_state->dst_array_mode = R600PixmapArrayMode(pScrn, pDst);
+
     /* return FALSE; */
 
 #ifdef SHOW_VERTEXES
@@ -682,10 +1221,24 @@ R600PrepareCopy(PixmapPtr pSrc,   PixmapPtr pDst,
     accel_state->rop = rop;
     accel_state->planemask = planemask;
 
+    accel_state->dma_ok = (rop == GXcopy) &&
+	(accel_state->src_array_mode[0] == ARRAY_LINEAR_GENERAL) &&
+	(accel_state->dst_array_mode == ARRAY_LINEAR_GENERAL) &&
+	(pSrc->drawable.bitsPerPixel == pDst->drawable.bitsPerPixel) &&
+	R600DmaPlanemask(planemask, pDst->drawable.bitsPerPixel);
+    accel_state->dma_dst_mc_addr = accel_state->dst_mc_addr;
+    accel_state->dma_dst_pitch = exaGetPixmapPitch(pDst);
+    accel_state->dma_src_mc_addr = accel_state->src_mc_addr[0];
+    accel_state->dma_src_pitch = exaGetPixmapPitch(pSrc);
+    accel_state->dma_cpp = pDst->drawable.bitsPerPixel / 8;
+
     if (exaGetPixmapOffset(pSrc) == exaGetPixmapOffset(pDst)) {
 	unsigned long size = pDst->drawable.height * accel_state->dst_pitch * pDst->drawable.bitsPerPixel/8;
 	accel_state->same_surface = TRUE;
 
+	/* copied piecewise with a flush after each piece, see R600Copy() */
+	R600BatchFlush(pScrn);
+
 	if (accel_state->copy_area) {
 	    exaOffscreenFree(pDst->drawable.pScreen, accel_state->copy_area);
 	    accel_state->copy_area = NULL;
@@ -698,8 +1251,10 @@ R600PrepareCopy(PixmapPtr pSrc,   PixmapPtr pDst,
 	R600DoPrepareCopy(pScrn,
 			  accel_state->src_pitch[0], pSrc->drawable.width, pSrc->drawable.height,
 			  accel_state->src_mc_addr[0], pSrc->drawable.bitsPerPixel,
+			  accel_state->src_array_mode[0],
 			  accel_state->dst_pitch, pDst->drawable.height,
 			  accel_state->dst_mc_addr, pDst->drawable.bitsPerPixel,
+			  accel_state->dst_array_mode,
 			  rop, planemask);
 
     }
@@ -746,42 +1301,42 @@ R600OverlapCopy(PixmapPtr pDst,
             if ((w / hchunk) <= (h / vchunk)) { /* reduce to horizontal */
                 if (srcY > dstY ) { /* diagonal up */
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
                     R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, w, vchunk);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
 
                     srcY = srcY + vchunk;
                     dstY = dstY + vchunk;
                 } else { /* diagonal down */
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
                     R600AppendCopyVertex(pScrn, srcX, srcY + h - vchunk, dstX, dstY + h - vchunk, w, vchunk);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
                 }
                 h = h - vchunk;
                 vchunk = 0;
             } else { /* reduce to vertical */
                 if (srcX > dstX ) { /* diagonal left */
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
                     R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, hchunk, h);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
 
                     srcX = srcX + hchunk;
                     dstX = dstX + hchunk;
                 } else { /* diagonal right */
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
                     R600AppendCopyVertex(pScrn, srcX + w - hchunk, srcY, dstX + w - hchunk, dstY, hchunk, h);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
                 }
                 w = w - hchunk;
                 hchunk = 0;
@@ -793,22 +1348,22 @@ R600OverlapCopy(PixmapPtr pDst,
 		/* copy right to left */
 		for (i = w; i > 0; i -= hchunk) {
 		    R600DoPrepareCopy(pScrn,
-				      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-				      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+				      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+				      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
 				      accel_state->rop, accel_state->planemask);
 		    R600AppendCopyVertex(pScrn, srcX + i - hchunk, srcY, dstX + i - hchunk, dstY, hchunk, h);
-		    R600DoCopy(pScrn);
+		    R600BatchFlush(pScrn);
 		}
 	    } else { /* left */
 		/* copy left to right */
 		for (i = 0; i < w; i += hchunk) {
 		    R600DoPrepareCopy(pScrn,
-				      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-				      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+				      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+				      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
 				      accel_state->rop, accel_state->planemask);
 
 		    R600AppendCopyVertex(pScrn, srcX + i, srcY, dstX + i, dstY, hchunk, h);
-		    R600DoCopy(pScrn);
+		    R600BatchFlush(pScrn);
 		}
 	    }
 	} else { /* up/down */
@@ -816,37 +1371,70 @@ R600OverlapCopy(PixmapPtr pDst,
 		/* copy top to bottom */
                 for (i = 0; i < h; i += vchunk) {
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
 
                     if (vchunk > h - i) vchunk = h - i;
                     R600AppendCopyVertex(pScrn, srcX, srcY + i, dstX, dstY + i, w, vchunk);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
                 }
 	    } else { /* down */
 		/* copy bottom to top */
                 for (i = h; i > 0; i -= vchunk) {
                     R600DoPrepareCopy(pScrn,
-                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+                                      dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+                                      dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
                                       accel_state->rop, accel_state->planemask);
 
                     if (vchunk > i) vchunk = i;
                     R600AppendCopyVertex(pScrn, srcX, srcY + i - vchunk, dstX, dstY + i - vchunk, w, vchunk);
-                    R600DoCopy(pScrn);
+                    R600BatchFlush(pScrn);
                 }
             }
 	}
     } else {
 	R600DoPrepareCopy(pScrn,
-			  dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
-			  dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel,
+			  dst_pitch, pDst->drawable.width, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
+			  dst_pitch, pDst->drawable.height, dst_offset, pDst->drawable.bitsPerPixel, accel_state->dst_array_mode,
 			  accel_state->rop, accel_state->planemask);
 
 	R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, w, h);
-	R600DoCopy(pScrn);
+	R600BatchFlush(pScrn);
+    }
+}
+
+/* returns FALSE when the copy is left to the 3D engine */
+static Bool
+R600DmaCopy(ScrnInfoPtr pScrn,
+	    int srcX, int srcY,
+	    int dstX, int dstY,
+	    int w, int h)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    int cpp = accel_state->dma_cpp;
+    Bool overlap = FALSE;
+
+    if (!R600DmaUsable(accel_state, (srcX * cpp) | (dstX * cpp), w * cpp, h,
+		       accel_state->dma_copy_min))
+	return FALSE;
+
+    if (accel_state->same_surface &&
+	is_overlap(srcX, srcX + w, srcY, srcY + h, dstX, dstX + w, dstY, dstY + h)) {
+	/* rows that overlap themselves, see R600OverlapCopy() */
+	if (srcY == dstY)
+	    return FALSE;
+	overlap = TRUE;
     }
+
+    R600DmaRows(pScrn,
+		accel_state->dma_dst_mc_addr + dstY * accel_state->dma_dst_pitch + dstX * cpp,
+		accel_state->dma_dst_pitch,
+		accel_state->dma_src_mc_addr + srcY * accel_state->dma_src_pitch + srcX * cpp,
+		accel_state->dma_src_pitch,
+		w * cpp, h, FALSE, overlap, overlap && (dstY > srcY));
+
+    return TRUE;
 }
 
 static void
@@ -862,6 +1450,9 @@ R600Copy(PixmapPtr pDst,
     if (accel_state->same_surface && (srcX == dstX) && (srcY == dstY))
 	return;
 
+    if (R600DmaCopy(pScrn, srcX, srcY, dstX, dstY, w, h))
+	return;
+
     if (accel_state->same_surface && is_overlap(srcX, srcX + w, srcY, srcY + h, dstX, dstX + w, dstY, dstY + h)) {
 	if (accel_state->copy_area) {
 	    uint32_t pitch = exaGetPixmapPitch(pDst) / (pDst->drawable.bitsPerPixel / 8);
@@ -872,16 +1463,20 @@ R600Copy(PixmapPtr pDst,
 
 	    R600DoPrepareCopy(pScrn,
 			      pitch, pDst->drawable.width, pDst->drawable.height, orig_offset, pDst->drawable.bitsPerPixel,
+			      accel_state->dst_array_mode,
 			      pitch,                       pDst->drawable.height, tmp_offset, pDst->drawable.bitsPerPixel,
+			      ARRAY_LINEAR_GENERAL,
 			      accel_state->rop, accel_state->planemask);
 	    R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, w, h);
-	    R600DoCopy(pScrn);
+	    R600BatchFlush(pScrn);
 	    R600DoPrepareCopy(pScrn,
 			      pitch, pDst->drawable.width, pDst->drawable.height, tmp_offset, pDst->drawable.bitsPerPixel,
+			      ARRAY_LINEAR_GENERAL,
 			      pitch,                       pDst->drawable.height, orig_offset, pDst->drawable.bitsPerPixel,
+			      accel_state->dst_array_mode,
 			      accel_state->rop, accel_state->planemask);
 	    R600AppendCopyVertex(pScrn, dstX, dstY, dstX, dstY, w, h);
-	    R600DoCopy(pScrn);
+	    R600BatchFlush(pScrn);
 	} else
 	    R600OverlapCopy(pDst, srcX, srcY, dstX, dstY, w, h);
     } else if (accel_state->same_surface) {
@@ -890,10 +1485,12 @@ R600Copy(PixmapPtr pDst,
 
 	R600DoPrepareCopy(pScrn,
 			  pitch, pDst->drawable.width, pDst->drawable.height, offset, pDst->drawable.bitsPerPixel,
+			  accel_state->dst_array_mode,
 			  pitch,                       pDst->drawable.height, offset, pDst->drawable.bitsPerPixel,
+			  accel_state->dst_array_mode,
 			  accel_state->rop, accel_state->planemask);
 	R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, w, h);
-	R600DoCopy(pScrn);
+	R600BatchFlush(pScrn);
     } else {
 	R600AppendCopyVertex(pScrn, srcX, srcY, dstX, dstY, w, h);
     }
@@ -907,9 +1504,7 @@ R600DoneCopy(PixmapPtr pDst)
     RHDPtr rhdPtr = RHDPTR(pScrn);
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
 
-    if (!accel_state->same_surface)
-	R600DoCopy(pScrn);
-
+    /* other surfaces stay batched, same surface copies have been flushed */
     if (accel_state->copy_area) {
 	exaOffscreenFree(pDst->drawable.pScreen, accel_state->copy_area);
 	accel_state->copy_area = NULL;
@@ -994,7 +1589,7 @@ static struct formatinfo R600TexFormats[] = {
     {PICT_a8,		FMT_8},
 };
 
-static uint32_t R600GetBlendCntl(int op, PicturePtr pMask, uint32_t dst_format)
+static uint32_t R600GetBlendCntl(int op, Bool component_alpha, uint32_t dst_format)
 {
     uint32_t sblend, dblend;
 
@@ -1015,7 +1610,7 @@ static uint32_t R600GetBlendCntl(int op, PicturePtr pMask, uint32_t dst_format)
      * the source blend factor is 0, and the source blend value is the mask
      * channels multiplied by the source picture's alpha.
      */
-    if (pMask && pMask->componentAlpha && R600BlendOp[op].src_alpha) {
+    if (component_alpha && R600BlendOp[op].src_alpha) {
 	if (dblend == (BLEND_SRC_ALPHA << COLOR_DESTBLEND_shift)) {
 	    dblend = (BLEND_SRC_COLOR << COLOR_DESTBLEND_shift);
 	} else if (dblend == (BLEND_ONE_MINUS_SRC_ALPHA << COLOR_DESTBLEND_shift)) {
@@ -1026,9 +1621,9 @@ static uint32_t R600GetBlendCntl(int op, PicturePtr pMask, uint32_t dst_format)
     return sblend | dblend;
 }
 
-static Bool R600GetDestFormat(PicturePtr pDstPicture, uint32_t *dst_format)
+static Bool R600GetDestFormat(uint32_t format, uint32_t *dst_format)
 {
-    switch (pDstPicture->format) {
+    switch (format) {
     case PICT_a8r8g8b8:
     case PICT_x8r8g8b8:
 	*dst_format = COLOR_8_8_8_8;
@@ -1045,19 +1640,15 @@ static Bool R600GetDestFormat(PicturePtr pDstPicture, uint32_t *dst_format)
 	break;
     default:
 	RADEON_FALLBACK(("Unsupported dest format 0x%x\n",
-	       (int)pDstPicture->format));
+	       (int)format));
     }
     return TRUE;
 }
 
-static Bool R600CheckCompositeTexture(PicturePtr pPict,
-				      PicturePtr pDstPict,
-				      int op,
-				      int unit)
+static Bool R600CheckCompositeTexture(PicturePtr pPict, int unit)
 {
     int w = pPict->pDrawable->width;
     int h = pPict->pDrawable->height;
-    unsigned int i;
     int max_tex_w, max_tex_h;
 
     max_tex_w = 8192;
@@ -1066,89 +1657,34 @@ static Bool R600CheckCompositeTexture(PicturePtr pPict,
     if ((w > max_tex_w) || (h > max_tex_h))
 	RADEON_FALLBACK(("Picture w/h too large (%dx%d)\n", w, h));
 
-    for (i = 0; i < sizeof(R600TexFormats) / sizeof(R600TexFormats[0]); i++) {
-	if (R600TexFormats[i].fmt == pPict->format)
-	    break;
-    }
-    if (i == sizeof(R600TexFormats) / sizeof(R600TexFormats[0]))
-	RADEON_FALLBACK(("Unsupported picture format 0x%x\n",
-			 (int)pPict->format));
-
     if (pPict->filter != PictFilterNearest &&
 	pPict->filter != PictFilterBilinear)
 	RADEON_FALLBACK(("Unsupported filter 0x%x\n", pPict->filter));
 
-    /* for REPEAT_NONE, Render semantics are that sampling outside the source
-     * picture results in alpha=0 pixels. We can implement this with a border color
-     * *if* our source texture has an alpha channel, otherwise we need to fall
-     * back. If we're not transformed then we hope that upper layers have clipped
-     * rendering to the bounds of the source drawable, in which case it doesn't
-     * matter. I have not, however, verified that the X server always does such
-     * clipping.
-     */
-    /* FIXME R6xx */
-    if (pPict->transform != 0 && !pPict->repeat && PICT_FORMAT_A(pPict->format) == 0) {
-	if (!(((op == PictOpSrc) || (op == PictOpClear)) && (PICT_FORMAT_A(pDstPict->format) == 0)))
-	    RADEON_FALLBACK(("REPEAT_NONE unsupported for transformed xRGB source\n"));
-    }
-
     return TRUE;
 }
 
-static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
-					int unit)
+static Bool R600GetTexFormat(uint32_t format, uint32_t *card_fmt)
 {
-    ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    int w = pPict->pDrawable->width;
-    int h = pPict->pDrawable->height;
     unsigned int i;
-    tex_resource_t  tex_res;
-    tex_sampler_t   tex_samp;
-    int pix_r, pix_g, pix_b, pix_a;
-
-    CLEAR (tex_res);
-    CLEAR (tex_samp);
-
-    accel_state->src_pitch[unit] = exaGetPixmapPitch(pPix) / (pPix->drawable.bitsPerPixel / 8);
-    accel_state->src_size[unit] = exaGetPixmapPitch(pPix) * h;
-    accel_state->src_mc_addr[unit] = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
-
-    if (accel_state->src_pitch[1] & 7)
-	RADEON_FALLBACK(("Bad pitch %d 0x%x\n", (int)accel_state->src_pitch[unit], unit));
-
-    if (accel_state->src_mc_addr[1] & 0xff)
-	RADEON_FALLBACK(("Bad offset %d 0x%x\n", (int)accel_state->src_mc_addr[unit], unit));
 
     for (i = 0; i < sizeof(R600TexFormats) / sizeof(R600TexFormats[0]); i++) {
-	if (R600TexFormats[i].fmt == pPict->format)
-	    break;
+	if (R600TexFormats[i].fmt == format) {
+	    *card_fmt = R600TexFormats[i].card_fmt;
+	    return TRUE;
+	}
     }
 
-    accel_state->texW[unit] = w;
-    accel_state->texH[unit] = h;
-
-    /* LOG("Tex %d setup %dx%d\n", unit, w, h); */
-
-    /* flush texture cache */
-    cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
-			accel_state->src_size[unit], accel_state->src_mc_addr[unit]);
+    RADEON_FALLBACK(("Unsupported picture format 0x%x\n", (int)format));
+}
 
-    /* Texture */
-    tex_res.id                  = unit;
-    tex_res.w                   = w;
-    tex_res.h                   = h;
-    tex_res.pitch               = accel_state->src_pitch[unit];
-    tex_res.depth               = 0;
-    tex_res.dim                 = SQ_TEX_DIM_2D;
-    tex_res.base                = accel_state->src_mc_addr[unit];
-    tex_res.mip_base            = accel_state->src_mc_addr[unit];
-    tex_res.format              = R600TexFormats[i].card_fmt;
-    tex_res.request_size        = 1;
+static Bool R600GetTexSwizzle(uint32_t format, int unit, Bool has_mask,
+			      Bool component_alpha, Bool src_alpha, int *sel)
+{
+    int pix_r, pix_g, pix_b, pix_a;
 
     /* component swizzles */
-    switch (pPict->format) {
+    switch (format) {
     case PICT_a1r5g5b5:
     case PICT_a8r8g8b8:
 	pix_r = SQ_SEL_Z; /* R */
@@ -1183,23 +1719,23 @@ static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
 	pix_a = SQ_SEL_X; /* A */
 	break;
     default:
-	RADEON_FALLBACK(("Bad format 0x%x\n", pPict->format));
+	RADEON_FALLBACK(("Bad format 0x%x\n", (int)format));
     }
 
     if (unit == 0) {
-	if (!accel_state->has_mask) {
-	    if (PICT_FORMAT_RGB(pPict->format) == 0) {
+	if (!has_mask) {
+	    if (PICT_FORMAT_RGB(format) == 0) {
 		pix_r = SQ_SEL_0;
 		pix_g = SQ_SEL_0;
 		pix_b = SQ_SEL_0;
 	    }
 
-	    if (PICT_FORMAT_A(pPict->format) == 0)
+	    if (PICT_FORMAT_A(format) == 0)
 		pix_a = SQ_SEL_1;
 	} else {
-	    if (accel_state->component_alpha) {
-		if (accel_state->src_alpha) {
-		    if (PICT_FORMAT_A(pPict->format) == 0) {
+	    if (component_alpha) {
+		if (src_alpha) {
+		    if (PICT_FORMAT_A(format) == 0) {
 			pix_r = SQ_SEL_1;
 			pix_g = SQ_SEL_1;
 			pix_b = SQ_SEL_1;
@@ -1210,26 +1746,26 @@ static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
 			pix_b = pix_a;
 		    }
 		} else {
-		    if (PICT_FORMAT_A(pPict->format) == 0)
+		    if (PICT_FORMAT_A(format) == 0)
 			pix_a = SQ_SEL_1;
 		}
 	    } else {
-		if (PICT_FORMAT_RGB(pPict->format) == 0) {
+		if (PICT_FORMAT_RGB(format) == 0) {
 		    pix_r = SQ_SEL_0;
 		    pix_g = SQ_SEL_0;
 		    pix_b = SQ_SEL_0;
 		}
 
-		if (PICT_FORMAT_A(pPict->format) == 0)
+		if (PICT_FORMAT_A(format) == 0)
 		    pix_a = SQ_SEL_1;
 	    }
 	}
     } else {
-	if (accel_state->component_alpha) {
-	    if (PICT_FORMAT_A(pPict->format) == 0)
+	if (component_alpha) {
+	    if (PICT_FORMAT_A(format) == 0)
 		pix_a = SQ_SEL_1;
 	} else {
-	    if (PICT_FORMAT_A(pPict->format) == 0) {
+	    if (PICT_FORMAT_A(format) == 0) {
 		pix_r = SQ_SEL_1;
 		pix_g = SQ_SEL_1;
 		pix_b = SQ_SEL_1;
@@ -1242,10 +1778,311 @@ static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
 	}
     }
 
-    tex_res.dst_sel_x           = pix_r; /* R */
-    tex_res.dst_sel_y           = pix_g; /* G */
-    tex_res.dst_sel_z           = pix_b; /* B */
-    tex_res.dst_sel_w           = pix_a; /* A */
+    sel[0] = pix_r;
+    sel[1] = pix_g;
+    sel[2] = pix_b;
+    sel[3] = pix_a;
+
+    return TRUE;
+}
+
+/* for REPEAT_NONE, Render semantics are that sampling outside the source
+ * picture results in alpha=0 pixels. We can implement this with a border color
+ * *if* our source texture has an alpha channel, otherwise we need to fall
+ * back. If we're not transformed then we hope that upper layers have clipped
+ * rendering to the bounds of the source drawable, in which case it doesn't
+ * matter. I have not, however, verified that the X server always does such
+ * clipping.
+ */
+/* FIXME R6xx */
+static Bool R600CheckClampedTexture(int op, uint32_t format, uint32_t dst_format)
+{
+    if (PICT_FORMAT_A(format) == 0) {
+	if (!(((op == PictOpSrc) || (op == PictOpClear)) && (PICT_FORMAT_A(dst_format) == 0)))
+	    RADEON_FALLBACK(("REPEAT_NONE unsupported for transformed xRGB source\n"));
+    }
+
+    return TRUE;
+}
+
+/*
+ * Works out everything about a composite that depends on the op and the
+ * picture formats only: whether it can be done at all, the blend control,
+ * the render target format and the texture formats and swizzles.
+ */
+static Bool R600CompClassFill(struct r6xx_comp_class *comp)
+{
+    int op = comp->op;
+    Bool has_mask = comp->mask_format != 0;
+    Bool component_alpha = (comp->flags & R6XX_COMP_CLASS_CA) != 0;
+    Bool src_alpha;
+
+    /* Check for unsupported compositing operations. */
+    if (op < 0 || op >= (int) (sizeof(R600BlendOp) / sizeof(R600BlendOp[0])))
+	RADEON_FALLBACK(("Unsupported Composite op 0x%x\n", op));
+
+    src_alpha = component_alpha && R600BlendOp[op].src_alpha;
+
+    if (component_alpha) {
+	/* Check if it's component alpha that relies on a source alpha and
+	 * on the source value.  We can only get one of those into the
+	 * single source value that we get to blend with.
+	 */
+	if (R600BlendOp[op].src_alpha &&
+	    (R600BlendOp[op].blend_cntl & COLOR_SRCBLEND_mask) !=
+	    (BLEND_ZERO << COLOR_SRCBLEND_shift)) {
+	    RADEON_FALLBACK(("Component alpha not supported with source "
+			     "alpha and source value blending.\n"));
+	}
+    }
+
+    if (has_mask) {
+	if (!R600GetTexFormat(comp->mask_format, &comp->tex_format[1]))
+	    return FALSE;
+	if ((comp->flags & R6XX_COMP_CLASS_MASK_CLAMPED) &&
+	    !R600CheckClampedTexture(op, comp->mask_format, comp->dst_format))
+	    return FALSE;
+	if (!R600GetTexSwizzle(comp->mask_format, 1, has_mask,
+			       component_alpha, src_alpha, comp->tex_sel[1]))
+	    return FALSE;
+    }
+
+    if (!R600GetTexFormat(comp->src_format, &comp->tex_format[0]))
+	return FALSE;
+    if ((comp->flags & R6XX_COMP_CLASS_SRC_CLAMPED) &&
+	!R600CheckClampedTexture(op, comp->src_format, comp->dst_format))
+	return FALSE;
+    if (!R600GetTexSwizzle(comp->src_format, 0, has_mask,
+			   component_alpha, src_alpha, comp->tex_sel[0]))
+	return FALSE;
+
+    if (!R600GetDestFormat(comp->dst_format, &comp->cb_format))
+	return FALSE;
+
+    switch (comp->dst_format) {
+    case PICT_a8r8g8b8:
+    case PICT_x8r8g8b8:
+    case PICT_a1r5g5b5:
+    case PICT_x1r5g5b5:
+    default:
+	comp->cb_comp_swap = 1; /* ARGB */
+	break;
+    case PICT_r5g6b5:
+	comp->cb_comp_swap = 2; /* RGB */
+	break;
+    case PICT_a8:
+	comp->cb_comp_swap = 3; /* A */
+	break;
+    }
+
+    comp->blend_cntl = R600GetBlendCntl(op, component_alpha, comp->dst_format);
+
+    return TRUE;
+}
+
+/*
+ * Check and Prepare both classify every composite, and the same few format
+ * combinations make up nearly all of them. Classes are kept in a small
+ * direct mapped cache; a collision just redoes the work.
+ */
+static struct r6xx_comp_class *
+R600ClassifyComposite(struct r6xx_accel_state *accel_state, int op,
+		      PicturePtr pSrcPicture, PicturePtr pMaskPicture,
+		      PicturePtr pDstPicture)
+{
+    struct r6xx_comp_class *comp;
+    uint32_t mask_format = 0, flags = 0, hash;
+
+    if (pSrcPicture->transform && !pSrcPicture->repeat)
+	flags |= R6XX_COMP_CLASS_SRC_CLAMPED;
+    if (pMaskPicture) {
+	mask_format = pMaskPicture->format;
+	if (pMaskPicture->componentAlpha)
+	    flags |= R6XX_COMP_CLASS_CA;
+	if (pMaskPicture->transform && !pMaskPicture->repeat)
+	    flags |= R6XX_COMP_CLASS_MASK_CLAMPED;
+    }
+
+    hash = pSrcPicture->format * 31 + mask_format;
+    hash = hash * 31 + pDstPicture->format;
+    hash = hash * 31 + ((uint32_t)op << 3) + flags;
+    hash ^= hash >> 16;
+    hash ^= hash >> 8;
+    comp = &accel_state->comp_class[hash % R6XX_COMP_CLASS_NUM];
+
+    if (comp->valid && comp->op == op && comp->flags == flags &&
+	comp->src_format == pSrcPicture->format &&
+	comp->mask_format == mask_format &&
+	comp->dst_format == pDstPicture->format) {
+	accel_state->comp_class_hits++;
+	return comp;
+    }
+
+    accel_state->comp_class_misses++;
+
+    CLEAR (*comp);
+    comp->valid       = TRUE;
+    comp->op          = op;
+    comp->src_format  = pSrcPicture->format;
+    comp->mask_format = mask_format;
+    comp->dst_format  = pDstPicture->format;
+    comp->flags       = flags;
+    comp->supported   = R600CompClassFill(comp);
+
+    return comp;
+}
+
+/*
+ * Most transforms are identities or plain translations; those only need an
+ * offset per vertex instead of a full matrix multiply per corner.
+ */
+static void
+R600CompTransform(struct r6xx_accel_state *accel_state, int unit,
+		  PictTransform *transform)
+{
+    accel_state->is_transform[unit] = transform != 0;
+    accel_state->transform[unit] = transform;
+
+    if (!transform) {
+	accel_state->xform[unit] = R6XX_XFORM_NONE;
+	return;
+    }
+
+    if (transform->matrix[0][0] == xFixed1 && transform->matrix[0][1] == 0 &&
+	transform->matrix[1][0] == 0 && transform->matrix[1][1] == xFixed1 &&
+	transform->matrix[2][0] == 0 && transform->matrix[2][1] == 0 &&
+	transform->matrix[2][2] == xFixed1) {
+	accel_state->xform_tx[unit] = xFixedToFloat(transform->matrix[0][2]);
+	accel_state->xform_ty[unit] = xFixedToFloat(transform->matrix[1][2]);
+	if (transform->matrix[0][2] || transform->matrix[1][2])
+	    accel_state->xform[unit] = R6XX_XFORM_TRANSLATE;
+	else
+	    accel_state->xform[unit] = R6XX_XFORM_NONE;
+    } else
+	accel_state->xform[unit] = R6XX_XFORM_GENERAL;
+}
+
+/* for pictures sampled from a glyph atlas */
+static void
+R600CompOffset(struct r6xx_accel_state *accel_state, int unit,
+	       struct rhdAtlasRect *rect)
+{
+    accel_state->xform[unit] = R6XX_XFORM_TRANSLATE;
+    accel_state->xform_tx[unit] = rect->X;
+    accel_state->xform_ty[unit] = rect->Y;
+}
+
+/* normalized texture coordinates of the top left, bottom left and bottom
+ * right corners, the ones a RECTLIST takes
+ */
+static void
+R600CompTexCoords(struct r6xx_accel_state *accel_state, int unit,
+		  int x, int y, int w, int h, float *tc)
+{
+    float rcp_w = accel_state->tex_rcp_w[unit];
+    float rcp_h = accel_state->tex_rcp_h[unit];
+
+    if (accel_state->xform[unit] != R6XX_XFORM_GENERAL) {
+	float x0 = x, y0 = y;
+
+	if (accel_state->xform[unit] == R6XX_XFORM_TRANSLATE) {
+	    x0 += accel_state->xform_tx[unit];
+	    y0 += accel_state->xform_ty[unit];
+	}
+
+	tc[0] = x0 * rcp_w;
+	tc[1] = y0 * rcp_h;
+	tc[2] = tc[0];
+	tc[3] = (y0 + h) * rcp_h;
+	tc[4] = (x0 + w) * rcp_w;
+	tc[5] = tc[3];
+    } else {
+	xPointFixed topLeft, bottomLeft, bottomRight;
+
+	topLeft.x     = IntToxFixed(x);
+	topLeft.y     = IntToxFixed(y);
+	bottomLeft.x  = IntToxFixed(x);
+	bottomLeft.y  = IntToxFixed(y + h);
+	bottomRight.x = IntToxFixed(x + w);
+	bottomRight.y = IntToxFixed(y + h);
+
+	/* XXX do transform in vertex shader */
+	transformPoint(accel_state->transform[unit], &topLeft);
+	transformPoint(accel_state->transform[unit], &bottomLeft);
+	transformPoint(accel_state->transform[unit], &bottomRight);
+
+	tc[0] = xFixedToFloat(topLeft.x) * rcp_w;
+	tc[1] = xFixedToFloat(topLeft.y) * rcp_h;
+	tc[2] = xFixedToFloat(bottomLeft.x) * rcp_w;
+	tc[3] = xFixedToFloat(bottomLeft.y) * rcp_h;
+	tc[4] = xFixedToFloat(bottomRight.x) * rcp_w;
+	tc[5] = xFixedToFloat(bottomRight.y) * rcp_h;
+    }
+}
+
+static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
+			     struct r6xx_comp_class *comp,
+			     struct r6xx_glyph_atlas *glyphs, int unit)
+{
+    ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    int w = pPict->pDrawable->width;
+    int h = pPict->pDrawable->height;
+    tex_resource_t  tex_res;
+    tex_sampler_t   tex_samp;
+
+    CLEAR (tex_res);
+    CLEAR (tex_samp);
+
+    if (glyphs) {
+	w = R600_GLYPH_ATLAS_SIZE;
+	h = R600_GLYPH_ATLAS_SIZE;
+	accel_state->src_pitch[unit] = glyphs->pitch / glyphs->cpp;
+	accel_state->src_size[unit] = glyphs->pitch * h;
+	accel_state->src_mc_addr[unit] = glyphs->mc_addr;
+	accel_state->src_array_mode[unit] = ARRAY_LINEAR_GENERAL;
+    } else {
+	accel_state->src_pitch[unit] = exaGetPixmapPitch(pPix) / (pPix->drawable.bitsPerPixel / 8);
+	accel_state->src_size[unit] = exaGetPixmapPitch(pPix) * h;
+	accel_state->src_mc_addr[unit] = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+	accel_state->src_array_mode[unit] = R600PixmapArrayMode(pScrn, pPix);
+    }
+
+    if (accel_state->src_pitch[1] & 7)
+	RADEON_FALLBACK(("Bad pitch %d 0x%x\n", (int)accel_state->src_pitch[unit], unit));
+
+    if (accel_state->src_mc_addr[1] & 0xff)
+	RADEON_FALLBACK(("Bad offset %d 0x%x\n", (int)accel_state->src_mc_addr[unit], unit));
+
+    accel_state->texW[unit] = w;
+    accel_state->texH[unit] = h;
+    accel_state->tex_rcp_w[unit] = 1.0f / w;
+    accel_state->tex_rcp_h[unit] = 1.0f / h;
+
+    /* LOG("Tex %d setup %dx%d\n", unit, w, h); */
+
+    /* flush texture cache */
+    cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
+			accel_state->src_size[unit], accel_state->src_mc_addr[unit]);
+
+    /* Texture */
+    tex_res.id                  = unit;
+    tex_res.w                   = w;
+    tex_res.h                   = h;
+    tex_res.pitch               = accel_state->src_pitch[unit];
+    tex_res.depth               = 0;
+    tex_res.dim                 = SQ_TEX_DIM_2D;
+    tex_res.base                = accel_state->src_mc_addr[unit];
+    tex_res.mip_base            = accel_state->src_mc_addr[unit];
+    tex_res.tile_mode           = accel_state->src_array_mode[unit];
+    tex_res.format              = comp->tex_format[unit];
+    tex_res.request_size        = 1;
+
+    tex_res.dst_sel_x           = comp->tex_sel[unit][0]; /* R */
+    tex_res.dst_sel_y           = comp->tex_sel[unit][1]; /* G */
+    tex_res.dst_sel_z           = comp->tex_sel[unit][2]; /* B */
+    tex_res.dst_sel_w           = comp->tex_sel[unit][3]; /* A */
 
     tex_res.base_level          = 0;
     tex_res.last_level          = 0;
@@ -1299,11 +2136,7 @@ static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
     tex_samp.mip_filter         = 0;			/* no mipmap */
     set_tex_sampler             (pScrn, accel_state->ib, &tex_samp);
 
-    if (pPict->transform != 0) {
-	accel_state->is_transform[unit] = TRUE;
-	accel_state->transform[unit] = pPict->transform;
-    } else
-	accel_state->is_transform[unit] = FALSE;
+    R600CompTransform(accel_state, unit, pPict->transform);
 
     return TRUE;
 }
@@ -1311,16 +2144,15 @@ static Bool R600TextureSetup(PicturePtr pPict, PixmapPtr pPix,
 static Bool R600CheckComposite(int op, PicturePtr pSrcPicture, PicturePtr pMaskPicture,
 			       PicturePtr pDstPicture)
 {
-    uint32_t tmp1;
-/*    ScreenPtr pScreen = pDstPicture->pDrawable->pScreen; */
+    ScreenPtr pScreen = pDstPicture->pDrawable->pScreen;
     PixmapPtr pSrcPixmap, pDstPixmap;
-/*    ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum]; */
-/*    RHDPtr rhdPtr = RHDPTR(pScrn); */
+    ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
+    RHDPtr rhdPtr = RHDPTR(pScrn);
     int max_tex_w, max_tex_h, max_dst_w, max_dst_h;
 
-    /* Check for unsupported compositing operations. */
-    if (op >= (int) (sizeof(R600BlendOp) / sizeof(R600BlendOp[0])))
-	RADEON_FALLBACK(("Unsupported Composite op 0x%x\n", op));
+    if (!R600ClassifyComposite(rhdPtr->TwoDPrivate, op, pSrcPicture,
+			       pMaskPicture, pDstPicture)->supported)
+	return FALSE;
 
     pSrcPixmap = RADEONGetDrawablePixmap(pSrcPicture->pDrawable);
 
@@ -1355,31 +2187,83 @@ static Bool R600CheckComposite(int op, PicturePtr pSrcPicture, PicturePtr pMaskP
 			     pMaskPixmap->drawable.height));
 	}
 
-	if (pMaskPicture->componentAlpha) {
-	    /* Check if it's component alpha that relies on a source alpha and
-	     * on the source value.  We can only get one of those into the
-	     * single source value that we get to blend with.
-	     */
-	    if (R600BlendOp[op].src_alpha &&
-		(R600BlendOp[op].blend_cntl & COLOR_SRCBLEND_mask) !=
-		(BLEND_ZERO << COLOR_SRCBLEND_shift)) {
-		RADEON_FALLBACK(("Component alpha not supported with source "
-				 "alpha and source value blending.\n"));
-	    }
-	}
-
-	if (!R600CheckCompositeTexture(pMaskPicture, pDstPicture, op, 1))
+	if (!R600CheckCompositeTexture(pMaskPicture, 1))
 	    return FALSE;
     }
 
-    if (!R600CheckCompositeTexture(pSrcPicture, pDstPicture, op, 0))
+    if (!R600CheckCompositeTexture(pSrcPicture, 0))
 	return FALSE;
 
-    if (!R600GetDestFormat(pDstPicture, &tmp1))
+    return TRUE;
+
+}
+
+static void R600BatchPictureKey(struct r6xx_batch_key *key, int unit,
+				PicturePtr pPict, PixmapPtr pPix,
+				struct r6xx_glyph_atlas *glyphs)
+{
+    ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+
+    if (glyphs) {
+	key->src_mc_addr[unit] = glyphs->mc_addr;
+	key->src_pitch[unit] = glyphs->pitch;
+	key->src_width[unit] = R600_GLYPH_ATLAS_SIZE;
+	key->src_height[unit] = R600_GLYPH_ATLAS_SIZE;
+	key->src_array_mode[unit] = ARRAY_LINEAR_GENERAL;
+    } else {
+	key->src_mc_addr[unit] = exaGetPixmapOffset(pPix) + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+	key->src_pitch[unit] = exaGetPixmapPitch(pPix);
+	key->src_width[unit] = pPict->pDrawable->width;
+	key->src_height[unit] = pPict->pDrawable->height;
+	key->src_array_mode[unit] = R600PixmapArrayMode(pScrn, pPix);
+    }
+    key->src_format[unit] = pPict->format;
+    key->src_flags[unit] = (pPict->repeat ? (1 << 0) : 0) |
+	(pPict->repeatType << 1) | (pPict->filter << 4) |
+	(pPict->componentAlpha ? (1 << 8) : 0);
+}
+
+/* every shader gets a slot of its own */
+#define R600_SHADER_SLOT 512
+/* solid, copy and xv vs/ps, then the composite variants */
+#define R600_SHADER_SLOTS (6 + 2 * R6XX_COMP_VARIANTS)
+
+static uint32_t
+R600ShaderSlot(struct r6xx_accel_state *accel_state)
+{
+    uint32_t offset = accel_state->shaders_used;
+
+    accel_state->shaders_used += R600_SHADER_SLOT;
+
+    return offset;
+}
+
+/*
+ * Composite shaders only get generated once a variant is first used.
+ */
+static Bool
+R600CompShaders(ScrnInfoPtr pScrn, int variant)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    uint32_t *shader;
+
+    if (accel_state->comp_vs_offset[variant])
+	return TRUE;
+
+    if ((accel_state->shaders_used + 2 * R600_SHADER_SLOT) > accel_state->shaders->size)
 	return FALSE;
 
-    return TRUE;
+    shader = (pointer)((char *)rhdPtr->FbBase + rhdPtr->FbScanoutStart + accel_state->shaders->offset);
+
+    accel_state->comp_vs_offset[variant] = R600ShaderSlot(accel_state);
+    R600_comp_vs_variant(rhdPtr->ChipSet, variant, shader + accel_state->comp_vs_offset[variant] / 4);
+
+    accel_state->comp_ps_offset[variant] = R600ShaderSlot(accel_state);
+    R600_comp_ps_variant(rhdPtr->ChipSet, variant, shader + accel_state->comp_ps_offset[variant] / 4);
 
+    return TRUE;
 }
 
 static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
@@ -1389,12 +2273,21 @@ static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
     ScrnInfoPtr pScrn = xf86Screens[pSrc->drawable.pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    uint32_t blendcntl, dst_format;
+    uint32_t dst_format;
     cb_config_t cb_conf;
     shader_config_t vs_conf, ps_conf;
+    struct r6xx_batch_key key;
+    struct r6xx_comp_class *comp;
+    struct r6xx_glyph_atlas *glyphs[2] = { NULL, NULL };
+    struct rhdAtlasRect rect[2];
+    int variant;
 
     /* return FALSE; */
 
+    comp = R600ClassifyComposite(accel_state, op, pSrcPicture, pMaskPicture, pDstPicture);
+    if (!comp->supported)
+	return FALSE;
+
     if (pMask) {
 	accel_state->has_mask = TRUE;
 	if (pMaskPicture->componentAlpha) {
@@ -1423,14 +2316,52 @@ static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
     if (accel_state->dst_mc_addr & 0xff)
 	RADEON_FALLBACK(("Bad destination offset 0x%x\n", (int)accel_state->dst_mc_addr));
 
-    if (!R600GetDestFormat(pDstPicture, &dst_format))
-	return FALSE;
+    dst_format = comp->cb_format;
+
+    R600GlyphInvalidate(accel_state, pDst);
+
+    accel_state->dst_array_mode = R600PixmapArrayMode(pScrn, pDst);
+
+    glyphs[0] = R600GlyphAtlas(accel_state, pSrcPicture);
+    if (glyphs[0] && !R600GlyphCache(pScrn, glyphs[0], pSrc, &rect[0]))
+	glyphs[0] = NULL;
+    if (pMask) {
+	glyphs[1] = R600GlyphAtlas(accel_state, pMaskPicture);
+	if (glyphs[1] && !R600GlyphCache(pScrn, glyphs[1], pMask, &rect[1]))
+	    glyphs[1] = NULL;
+	/* caching the mask may have evicted the source */
+	if (glyphs[0] && (glyphs[0] == glyphs[1]) &&
+	    !RHDAtlasLookup(glyphs[0]->atlas, pSrc->drawable.serialNumber, &rect[0]))
+	    glyphs[0] = NULL;
+    }
 
     CLEAR (cb_conf);
     CLEAR (vs_conf);
     CLEAR (ps_conf);
-
-    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
+    CLEAR (key);
+
+    key.op          = R6XX_BATCH_COMPOSITE;
+    key.dst_mc_addr = accel_state->dst_mc_addr;
+    key.dst_pitch   = accel_state->dst_pitch;
+    key.dst_height  = pDst->drawable.height;
+    key.dst_format  = dst_format;
+    key.dst_size    = accel_state->dst_size;
+    key.dst_array_mode = accel_state->dst_array_mode;
+    key.alu         = op;
+    R600BatchPictureKey(&key, 0, pSrcPicture, pSrc, glyphs[0]);
+    if (pMask)
+	R600BatchPictureKey(&key, 1, pMaskPicture, pMask, glyphs[1]);
+
+    if (R600BatchContinue(pScrn, &key)) {
+	/* transforms and atlas offsets only go into the vertices */
+	R600CompTransform(accel_state, 0, pSrcPicture->transform);
+	R600CompTransform(accel_state, 1, pMask ? pMaskPicture->transform : NULL);
+	if (glyphs[0])
+	    R600CompOffset(accel_state, 0, &rect[0]);
+	if (glyphs[1])
+	    R600CompOffset(accel_state, 1, &rect[1]);
+	return TRUE;
+    }
 
     /* Init */
     start_3d(pScrn, accel_state->ib);
@@ -1440,34 +2371,40 @@ static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
     set_default_state(pScrn, accel_state->ib);
 
     /* Scissor / viewport */
-    EREG  (accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
-    EREG  (accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
+    CREG  (accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
+    CREG  (accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
 
-    if (!R600TextureSetup(pSrcPicture, pSrc, 0)) {
+    if (!R600TextureSetup(pSrcPicture, pSrc, comp, glyphs[0], 0)) {
 	R600IBDiscard(pScrn, accel_state->ib);
+	accel_state->batch_key.op = R6XX_BATCH_NONE;
 	return FALSE;
     }
 
     if (pMask != NULL) {
-	if (!R600TextureSetup(pMaskPicture, pMask, 1)) {
+	if (!R600TextureSetup(pMaskPicture, pMask, comp, glyphs[1], 1)) {
 	    R600IBDiscard(pScrn, accel_state->ib);
+	    accel_state->batch_key.op = R6XX_BATCH_NONE;
 	    return FALSE;
 	}
     } else
-	accel_state->is_transform[1] = FALSE;
+	R600CompTransform(accel_state, 1, NULL);
 
-    if (pMask) {
-	set_bool_consts(pScrn, accel_state->ib, SQ_BOOL_CONST_vs, (1 << 0));
-	accel_state->ps_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
-	    accel_state->comp_mask_ps_offset;
-    } else {
-	set_bool_consts(pScrn, accel_state->ib, SQ_BOOL_CONST_vs, (0 << 0));
-	accel_state->ps_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
-	    accel_state->comp_ps_offset;
+    if (glyphs[0])
+	R600CompOffset(accel_state, 0, &rect[0]);
+    if (glyphs[1])
+	R600CompOffset(accel_state, 1, &rect[1]);
+
+    variant = pMask ? R600_COMP_MASK : 0;
+    if (!R600CompShaders(pScrn, variant)) {
+	R600IBDiscard(pScrn, accel_state->ib);
+	accel_state->batch_key.op = R6XX_BATCH_NONE;
+	RADEON_FALLBACK(("No room for composite shader variant %d\n", variant));
     }
 
     accel_state->vs_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
-	accel_state->comp_vs_offset;
+	accel_state->comp_vs_offset[variant];
+    accel_state->ps_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
+	accel_state->comp_ps_offset[variant];
 
     accel_state->vs_size = 512;
     accel_state->ps_size = 512;
@@ -1480,7 +2417,7 @@ static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
 
     vs_conf.shader_addr         = accel_state->vs_mc_addr;
     vs_conf.num_gprs            = 3;
-    vs_conf.stack_size          = 1;
+    vs_conf.stack_size          = 0;
     vs_setup                    (pScrn, accel_state->ib, &vs_conf);
 
     /* flush SQ cache */
@@ -1495,82 +2432,66 @@ static Bool R600PrepareComposite(int op, PicturePtr pSrcPicture,
     ps_conf.export_mode         = 2;
     ps_setup                    (pScrn, accel_state->ib, &ps_conf);
 
-    EREG  (accel_state->ib, CB_SHADER_MASK,                      (0xf << OUTPUT0_ENABLE_shift));
-    EREG  (accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
-
-    blendcntl = R600GetBlendCntl(op, pMaskPicture, pDstPicture->format);
+    CREG  (accel_state->ib, CB_SHADER_MASK,                      (0xf << OUTPUT0_ENABLE_shift));
+    CREG  (accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
 
     if (rhdPtr->ChipSet == RHD_R600) {
 	/* no per-MRT blend on R600 */
-	EREG  (accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[3] | (1 << TARGET_BLEND_ENABLE_shift));
-	EREG  (accel_state->ib, CB_BLEND_CONTROL,                    blendcntl);
+	CREG  (accel_state->ib, CB_COLOR_CONTROL,                    RADEON_ROP[3] | (1 << TARGET_BLEND_ENABLE_shift));
+	CREG  (accel_state->ib, CB_BLEND_CONTROL,                    comp->blend_cntl);
     } else {
-	EREG  (accel_state->ib, CB_COLOR_CONTROL,                    (RADEON_ROP[3] |
+	CREG  (accel_state->ib, CB_COLOR_CONTROL,                    (RADEON_ROP[3] |
 								      (1 << TARGET_BLEND_ENABLE_shift) |
 								      PER_MRT_BLEND_bit));
-	EREG  (accel_state->ib, CB_BLEND0_CONTROL,                   blendcntl);
+	CREG  (accel_state->ib, CB_BLEND0_CONTROL,                   comp->blend_cntl);
     }
 
     cb_conf.id = 0;
     cb_conf.w = accel_state->dst_pitch;
     cb_conf.h = pDst->drawable.height;
     cb_conf.base = accel_state->dst_mc_addr;
+    cb_conf.array_mode = accel_state->dst_array_mode;
     cb_conf.format = dst_format;
-
-    switch (pDstPicture->format) {
-    case PICT_a8r8g8b8:
-    case PICT_x8r8g8b8:
-    case PICT_a1r5g5b5:
-    case PICT_x1r5g5b5:
-    default:
-	cb_conf.comp_swap = 1; /* ARGB */
-	break;
-    case PICT_r5g6b5:
-	cb_conf.comp_swap = 2; /* RGB */
-	break;
-    case PICT_a8:
-	cb_conf.comp_swap = 3; /* A */
-	break;
-    }
+    cb_conf.comp_swap = comp->cb_comp_swap;
     cb_conf.source_format = 1;
     cb_conf.blend_clamp = 1;
     set_render_target(pScrn, accel_state->ib, &cb_conf);
 
-    EREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
+    CREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_FRONT_PTYPE_shift)	|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_BACK_PTYPE_shift)));
-    EREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
+    CREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
 								DUAL_EXPORT_ENABLE_bit)); /* Only useful if no depth export */
 
     /* Interpolator setup */
     if (pMask) {
 	/* export 2 tex coords from VS */
-	EREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((2 - 1) << VS_EXPORT_COUNT_shift));
+	CREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((2 - 1) << VS_EXPORT_COUNT_shift));
 	/* src = semantic id 0; mask = semantic id 1 */
-	EREG(accel_state->ib, SPI_VS_OUT_ID_0, ((0 << SEMANTIC_0_shift) |
+	CREG(accel_state->ib, SPI_VS_OUT_ID_0, ((0 << SEMANTIC_0_shift) |
 						(1 << SEMANTIC_1_shift)));
 	/* input 2 tex coords from VS */
-	EREG(accel_state->ib, SPI_PS_IN_CONTROL_0, (2 << NUM_INTERP_shift));
+	CREG(accel_state->ib, SPI_PS_IN_CONTROL_0, (2 << NUM_INTERP_shift));
     } else {
 	/* export 1 tex coords from VS */
-	EREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
+	CREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
 	/* src = semantic id 0 */
-	EREG(accel_state->ib, SPI_VS_OUT_ID_0,   (0 << SEMANTIC_0_shift));
+	CREG(accel_state->ib, SPI_VS_OUT_ID_0,   (0 << SEMANTIC_0_shift));
 	/* input 1 tex coords from VS */
-	EREG(accel_state->ib, SPI_PS_IN_CONTROL_0, (1 << NUM_INTERP_shift));
+	CREG(accel_state->ib, SPI_PS_IN_CONTROL_0, (1 << NUM_INTERP_shift));
     }
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
     /* SPI_PS_INPUT_CNTL_0 maps to GPR[0] - load with semantic id 0 */
-    EREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
+    CREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
 								(0x01 << DEFAULT_VAL_shift)	|
 								SEL_CENTROID_bit));
     /* SPI_PS_INPUT_CNTL_1 maps to GPR[1] - load with semantic id 1 */
-    EREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (1 <<2),       ((1    << SEMANTIC_shift)	|
+    CREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (1 <<2),       ((1    << SEMANTIC_shift)	|
 								(0x01 << DEFAULT_VAL_shift)	|
 								SEL_CENTROID_bit));
-    EREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
+    CREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
 
-    accel_state->vb_index = 0;
+    R600BatchStart(pScrn, pMask ? 24 : 16);
 
     return TRUE;
 }
@@ -1585,186 +2506,139 @@ static void R600Composite(PixmapPtr pDst,
     RHDPtr rhdPtr = RHDPTR(pScrn);
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
     float *vb;
-    xPointFixed srcTopLeft, srcTopRight, srcBottomLeft, srcBottomRight;
+    float src[6];
 
     /* LOG("R600Composite (%d,%d) (%d,%d) (%d,%d) (%d,%d)\n",
        srcX, srcY, maskX, maskY,dstX, dstY, w, h); */
 
-    srcTopLeft.x     = IntToxFixed(srcX);
-    srcTopLeft.y     = IntToxFixed(srcY);
-    srcTopRight.x    = IntToxFixed(srcX + w);
-    srcTopRight.y    = IntToxFixed(srcY);
-    srcBottomLeft.x  = IntToxFixed(srcX);
-    srcBottomLeft.y  = IntToxFixed(srcY + h);
-    srcBottomRight.x = IntToxFixed(srcX + w);
-    srcBottomRight.y = IntToxFixed(srcY + h);
+    vb = R600BatchVertices(pScrn);
 
-    /* XXX do transform in vertex shader */
-    if (accel_state->is_transform[0]) {
-	transformPoint(accel_state->transform[0], &srcTopLeft);
-	transformPoint(accel_state->transform[0], &srcTopRight);
-	transformPoint(accel_state->transform[0], &srcBottomLeft);
-	transformPoint(accel_state->transform[0], &srcBottomRight);
-    }
+    R600CompTexCoords(accel_state, 0, srcX, srcY, w, h, src);
 
     if (accel_state->has_mask) {
-	xPointFixed maskTopLeft, maskTopRight, maskBottomLeft, maskBottomRight;
-
-	if (((accel_state->vb_index + 3) * 24) > (accel_state->ib->total / 2)) {
-	    R600DoneComposite(pDst);
-	    accel_state->vb_index = 0;
-	    accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
-	}
+	float mask[6];
 
-	vb = (pointer)((char*)accel_state->ib->address +
-		       (accel_state->ib->total / 2) +
-		       accel_state->vb_index * 24);
-
-	maskTopLeft.x     = IntToxFixed(maskX);
-	maskTopLeft.y     = IntToxFixed(maskY);
-	maskTopRight.x    = IntToxFixed(maskX + w);
-	maskTopRight.y    = IntToxFixed(maskY);
-	maskBottomLeft.x  = IntToxFixed(maskX);
-	maskBottomLeft.y  = IntToxFixed(maskY + h);
-	maskBottomRight.x = IntToxFixed(maskX + w);
-	maskBottomRight.y = IntToxFixed(maskY + h);
-
-	if (accel_state->is_transform[1]) {
-	    transformPoint(accel_state->transform[1], &maskTopLeft);
-	    transformPoint(accel_state->transform[1], &maskTopRight);
-	    transformPoint(accel_state->transform[1], &maskBottomLeft);
-	    transformPoint(accel_state->transform[1], &maskBottomRight);
-	}
+	R600CompTexCoords(accel_state, 1, maskX, maskY, w, h, mask);
 
 	vb[0] = (float)dstX;
 	vb[1] = (float)dstY;
-	vb[2] = xFixedToFloat(srcTopLeft.x) / accel_state->texW[0];
-	vb[3] = xFixedToFloat(srcTopLeft.y) / accel_state->texH[0];
-	vb[4] = xFixedToFloat(maskTopLeft.x) / accel_state->texW[1];
-	vb[5] = xFixedToFloat(maskTopLeft.y) / accel_state->texH[1];
+	vb[2] = src[0];
+	vb[3] = src[1];
+	vb[4] = mask[0];
+	vb[5] = mask[1];
 
 	vb[6] = (float)dstX;
 	vb[7] = (float)(dstY + h);
-	vb[8] = xFixedToFloat(srcBottomLeft.x) / accel_state->texW[0];
-	vb[9] = xFixedToFloat(srcBottomLeft.y) / accel_state->texH[0];
-	vb[10] = xFixedToFloat(maskBottomLeft.x) / accel_state->texW[1];
-	vb[11] = xFixedToFloat(maskBottomLeft.y) / accel_state->texH[1];
+	vb[8] = src[2];
+	vb[9] = src[3];
+	vb[10] = mask[2];
+	vb[11] = mask[3];
 
 	vb[12] = (float)(dstX + w);
 	vb[13] = (float)(dstY + h);
-	vb[14] = xFixedToFloat(srcBottomRight.x) / accel_state->texW[0];
-	vb[15] = xFixedToFloat(srcBottomRight.y) / accel_state->texH[0];
-	vb[16] = xFixedToFloat(maskBottomRight.x) / accel_state->texW[1];
-	vb[17] = xFixedToFloat(maskBottomRight.y) / accel_state->texH[1];
+	vb[14] = src[4];
+	vb[15] = src[5];
+	vb[16] = mask[4];
+	vb[17] = mask[5];
 
     } else {
-	vb = (pointer)((char*)accel_state->ib->address +
-		       (accel_state->ib->total / 2) +
-		       accel_state->vb_index * 16);
-
 	vb[0] = (float)dstX;
 	vb[1] = (float)dstY;
-	vb[2] = xFixedToFloat(srcTopLeft.x) / accel_state->texW[0];
-	vb[3] = xFixedToFloat(srcTopLeft.y) / accel_state->texH[0];
+	vb[2] = src[0];
+	vb[3] = src[1];
 
 	vb[4] = (float)dstX;
 	vb[5] = (float)(dstY + h);
-	vb[6] = xFixedToFloat(srcBottomLeft.x) / accel_state->texW[0];
-	vb[7] = xFixedToFloat(srcBottomLeft.y) / accel_state->texH[0];
+	vb[6] = src[2];
+	vb[7] = src[3];
 
 	vb[8] = (float)(dstX + w);
 	vb[9] = (float)(dstY + h);
-	vb[10] = xFixedToFloat(srcBottomRight.x) / accel_state->texW[0];
-	vb[11] = xFixedToFloat(srcBottomRight.y) / accel_state->texH[0];
+	vb[10] = src[4];
+	vb[11] = src[5];
     }
 
-    accel_state->vb_index += 3;
-
 }
 
 static void R600DoneComposite(PixmapPtr pDst)
 {
-    ScrnInfoPtr pScrn = xf86Screens[pDst->drawable.pScreen->myNum];
-    RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    draw_config_t   draw_conf;
-    vtx_resource_t  vtx_res;
-
-    CLEAR (draw_conf);
-    CLEAR (vtx_res);
-
-    if (accel_state->vb_index == 0) {
-	R600IBDiscard(pScrn, accel_state->ib);
-	return;
-    }
+    /* the rectangles stay batched, see R600BatchContinue() */
+}
 
-    accel_state->vb_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
-	(accel_state->ib->idx * accel_state->ib->total) + (accel_state->ib->total / 2);
+/*
+ * Uploads and downloads are staged through a small ring of DMA buffers, so
+ * that the CPU copies one chunk while the engine blits another. Each slot
+ * is reused only after the fence of its previous blit has passed.
+ */
+#define R600_STAGING_SLOTS 3
 
+/* uploads up to this size go straight to the framebuffer when idle */
+#define R600_UPLOAD_DIRECT_MAX 4096
 
-    /* Vertex buffer setup */
-    if (accel_state->has_mask) {
-	accel_state->vb_size = accel_state->vb_index * 24;
-	vtx_res.id              = SQ_VTX_RESOURCE_vs;
-	vtx_res.vtx_size_dw     = 24 / 4;
-	vtx_res.vtx_num_entries = accel_state->vb_size / 4;
-	vtx_res.mem_req_size    = 1;
-	vtx_res.vb_addr         = accel_state->vb_mc_addr;
-    } else {
-	accel_state->vb_size = accel_state->vb_index * 16;
-	vtx_res.id              = SQ_VTX_RESOURCE_vs;
-	vtx_res.vtx_size_dw     = 16 / 4;
-	vtx_res.vtx_num_entries = accel_state->vb_size / 4;
-	vtx_res.mem_req_size    = 1;
-	vtx_res.vb_addr         = accel_state->vb_mc_addr;
+/* copy a row into staging memory, streaming it past the caches */
+static void
+R600StagingCopy(char *dst, const char *src, int size)
+{
+#ifdef __SSE2__
+    if (!((unsigned long) dst & 15) && (size >= 64)) {
+	while (size >= 64) {
+	    __m128i a = _mm_loadu_si128((const __m128i *) src);
+	    __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+	    __m128i c = _mm_loadu_si128((const __m128i *) (src + 32));
+	    __m128i d = _mm_loadu_si128((const __m128i *) (src + 48));
+
+	    _mm_stream_si128((__m128i *) dst, a);
+	    _mm_stream_si128((__m128i *) (dst + 16), b);
+	    _mm_stream_si128((__m128i *) (dst + 32), c);
+	    _mm_stream_si128((__m128i *) (dst + 48), d);
+	    src += 64;
+	    dst += 64;
+	    size -= 64;
+	}
+	_mm_sfence();
     }
-    /* flush vertex cache */
-    if ((rhdPtr->ChipSet == RHD_RV610) ||
-	(rhdPtr->ChipSet == RHD_RV620) ||
-	(rhdPtr->ChipSet == RHD_M72) ||
-	(rhdPtr->ChipSet == RHD_M74) ||
-	(rhdPtr->ChipSet == RHD_M82) ||
-	(rhdPtr->ChipSet == RHD_RS780) ||
-	(rhdPtr->ChipSet == RHD_RS880) ||
-	(rhdPtr->ChipSet == RHD_RV710))
-	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-    else
-	cp_set_surface_sync(pScrn, accel_state->ib, VC_ACTION_ENA_bit,
-			    accel_state->vb_size, accel_state->vb_mc_addr);
-
-    set_vtx_resource        (pScrn, accel_state->ib, &vtx_res);
-
-    draw_conf.prim_type          = DI_PT_RECTLIST;
-    draw_conf.vgt_draw_initiator = DI_SRC_SEL_AUTO_INDEX;
-    draw_conf.num_instances      = 1;
-    draw_conf.num_indices        = vtx_res.vtx_num_entries / vtx_res.vtx_size_dw;
-    draw_conf.index_type         = DI_INDEX_SIZE_16_BIT;
+#endif
+    memcpy(dst, src, size);
+}
 
-    draw_auto(pScrn, accel_state->ib, &draw_conf);
+/* adds staging buffers up to R600_STAGING_SLOTS, but no more than chunks */
+static int
+R600StagingAlloc(ScrnInfoPtr pScrn, drmBufPtr *scratch, int slots, int chunks)
+{
+    while ((slots < R600_STAGING_SLOTS) && (slots < chunks)) {
+	scratch[slots] = RHDDRMCPBuffer(pScrn->scrnIndex);
+	if (!scratch[slots])
+	    break;
+	slots++;
+    }
 
-    wait_3d_idle_clean(pScrn, accel_state->ib);
+    return slots;
+}
 
-    cp_set_surface_sync(pScrn, accel_state->ib, (CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit),
-			accel_state->dst_size, accel_state->dst_mc_addr);
+static void
+R600StagingFree(ScrnInfoPtr pScrn, drmBufPtr *scratch, int slots)
+{
+    int i;
 
-    R600CPFlushIndirect(pScrn, accel_state->ib);
+    for (i = 0; i < slots; i++)
+	R600IBDiscard(pScrn, scratch[i]);
 }
 
-Bool
-R600CopyToVRAM(ScrnInfoPtr pScrn,
-	       char *src, int src_pitch,
-	       uint32_t dst_pitch, uint32_t dst_mc_addr, uint32_t dst_height, int bpp,
-	       int x, int y, int w, int h)
+static Bool
+R600CopyToSurface(ScrnInfoPtr pScrn,
+		  char *src, int src_pitch,
+		  uint32_t dst_pitch, uint32_t dst_mc_addr, uint32_t dst_height, int bpp,
+		  uint32_t dst_array_mode,
+		  int x, int y, int w, int h)
 {
-    struct RhdCS *CS = RHDPTR(pScrn)->CS;
-    uint32_t scratch_mc_addr;
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    drmBufPtr scratch[R600_STAGING_SLOTS];
+    uint32_t fence[R600_STAGING_SLOTS];
     int wpass = w * (bpp/8);
     int scratch_pitch_bytes = (wpass + 255) & ~255;
     uint32_t scratch_pitch = scratch_pitch_bytes / (bpp / 8);
-    int scratch_offset = 0, hpass, temph;
+    int slots, chunk, hchunk, hpass, temph;
     char *dst;
-    drmBufPtr scratch;
 
     if (dst_pitch & 7)
 	return FALSE;
@@ -1772,69 +2646,133 @@ R600CopyToVRAM(ScrnInfoPtr pScrn,
     if (dst_mc_addr & 0xff)
 	return FALSE;
 
-    scratch = RHDDRMCPBuffer(pScrn->scrnIndex);
-    if (scratch == NULL)
+    slots = R600StagingAlloc(pScrn, scratch, 0, 1);
+    if (!slots)
 	return FALSE;
 
-    scratch_mc_addr = RHDDRIGetIntGARTLocation(pScrn) + (scratch->idx * scratch->total);
-    temph = hpass = min(h, scratch->total/2 / scratch_pitch_bytes);
-    dst = (char *)scratch->address;
-
-    /* memcopy from sys to scratch */
-    while (temph--) {
-	memcpy (dst, src, wpass);
-	src += src_pitch;
-	dst += scratch_pitch_bytes;
-    }
-
-    while (h) {
-	uint32_t offset = scratch_mc_addr + scratch_offset;
-	int oldhpass = hpass;
-	h -= oldhpass;
-	temph = hpass = min(h, scratch->total/2 / scratch_pitch_bytes);
-
-	if (hpass) {
-	    scratch_offset = scratch->total/2 - scratch_offset;
-	    dst = (char *)scratch->address + scratch_offset;
-	    /* wait for the engine to be idle */
-	    RHDCSIdle(CS);
-	    /* memcopy from sys to scratch */
-	    while (temph--) {
-		memcpy (dst, src, wpass);
-		src += src_pitch;
-		dst += scratch_pitch_bytes;
-	    }
+    hchunk = scratch[0]->total / scratch_pitch_bytes;
+    if (!hchunk) {
+	R600StagingFree(pScrn, scratch, slots);
+	return FALSE;
+    }
+
+    slots = R600StagingAlloc(pScrn, scratch, slots, (h + hchunk - 1) / hchunk);
+
+    for (chunk = 0; h; chunk++) {
+	int slot = chunk % slots;
+	uint32_t scratch_mc_addr = RHDDRIGetIntGARTLocation(pScrn) +
+	    (scratch[slot]->idx * scratch[slot]->total);
+
+	temph = hpass = min(h, hchunk);
+
+	/* the blit out of this slot has to be done before refilling it */
+	if (chunk >= slots)
+	    fence_wait(pScrn, fence[slot]);
+
+	/* memcopy from sys to scratch */
+	dst = (char *)scratch[slot]->address;
+	while (temph--) {
+	    R600StagingCopy(dst, src, wpass);
+	    src += src_pitch;
+	    dst += scratch_pitch_bytes;
 	}
+
 	/* blit from scratch to vram */
 	R600DoPrepareCopy(pScrn,
-			  scratch_pitch, w, oldhpass, offset, bpp,
-			  dst_pitch, dst_height, dst_mc_addr, bpp,
+			  scratch_pitch, w, hpass, scratch_mc_addr, bpp, ARRAY_LINEAR_GENERAL,
+			  dst_pitch, dst_height, dst_mc_addr, bpp, dst_array_mode,
 			  3, 0xffffffff);
-	R600AppendCopyVertex(pScrn, 0, 0, x, y, w, oldhpass);
-	R600DoCopy(pScrn);
-	y += oldhpass;
+	R600AppendCopyVertex(pScrn, 0, 0, x, y, w, hpass);
+	R600BatchFlush(pScrn);
+	fence[slot] = accel_state->fence_last;
+
+	y += hpass;
+	h -= hpass;
     }
 
-    R600IBDiscard(pScrn, scratch);
+    R600StagingFree(pScrn, scratch, slots);
 
     return TRUE;
 }
 
+Bool
+R600CopyToVRAM(ScrnInfoPtr pScrn,
+	       char *src, int src_pitch,
+	       uint32_t dst_pitch, uint32_t dst_mc_addr, uint32_t dst_height, int bpp,
+	       int x, int y, int w, int h)
+{
+    return R600CopyToSurface(pScrn, src, src_pitch,
+			     dst_pitch, dst_mc_addr, dst_height, bpp, ARRAY_LINEAR_GENERAL,
+			     x, y, w, h);
+}
+
 static Bool
 R600UploadToScreen(PixmapPtr pDst, int x, int y, int w, int h,
 		   char *src, int src_pitch)
 {
     ScrnInfoPtr pScrn = xf86Screens[pDst->drawable.pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
     uint32_t dst_pitch = exaGetPixmapPitch(pDst) / (pDst->drawable.bitsPerPixel / 8);
     uint32_t dst_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + exaGetPixmapOffset(pDst);
     uint32_t dst_height = pDst->drawable.height;
     int bpp = pDst->drawable.bitsPerPixel;
+    struct r6xx_tiled_surface *tiled;
+
+    R600GlyphInvalidate(accel_state, pDst);
+
+    if (!x && !y && (w == pDst->drawable.width) && (h == pDst->drawable.height))
+	tiled = R600TiledAdd(pScrn, pDst);
+    else
+	tiled = R600TiledSurface(pScrn, pDst);
+    if (tiled)
+	accel_state->tiled_uploads++;
+
+    /* small, and nothing in flight that could touch it: setting up a blit
+     * costs more than writing through the aperture */
+    if (((w * h * (bpp / 8)) <= R600_UPLOAD_DIRECT_MAX) &&
+	(accel_state->batch_key.op == R6XX_BATCH_NONE) &&
+	fence_passed(pScrn, accel_state->fence_last)) {
+	char *base = (char *)rhdPtr->FbBase + rhdPtr->FbScanoutStart + exaGetPixmapOffset(pDst);
+	char *dst = base + y * exaGetPixmapPitch(pDst) + x * (bpp / 8);
+
+	if (tiled)
+	    return RHDSurfaceRetile(&tiled->layout, base, x, y, w, h, src, src_pitch);
+
+	while (h--) {
+	    memcpy(dst, src, w * (bpp / 8));
+	    src += src_pitch;
+	    dst += exaGetPixmapPitch(pDst);
+	}
+
+	return TRUE;
+    }
+
+    return R600CopyToSurface(pScrn,
+			     src, src_pitch,
+			     dst_pitch, dst_mc_addr, dst_height, bpp,
+			     tiled ? ARRAY_1D_TILED_THIN1 : ARRAY_LINEAR_GENERAL,
+			     x, y, w, h);
+}
+
+/* blit rows y to y + h of the source into a staging buffer */
+static uint32_t
+R600QueueDownload(ScrnInfoPtr pScrn, drmBufPtr scratch, uint32_t scratch_pitch,
+		  uint32_t src_pitch, uint32_t src_width, uint32_t src_height,
+		  uint32_t src_mc_addr, int bpp, uint32_t src_array_mode,
+		  int x, int y, int w, int h)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    uint32_t scratch_mc_addr = RHDDRIGetIntGARTLocation(pScrn) + (scratch->idx * scratch->total);
+
+    R600DoPrepareCopy(pScrn,
+		      src_pitch, src_width, src_height, src_mc_addr, bpp, src_array_mode,
+		      scratch_pitch, h, scratch_mc_addr, bpp, ARRAY_LINEAR_GENERAL,
+		      3, 0xffffffff);
+    R600AppendCopyVertex(pScrn, x, y, 0, 0, w, h);
+    R600BatchFlush(pScrn);
 
-    return R600CopyToVRAM(pScrn,
-			  src, src_pitch,
-			  dst_pitch, dst_mc_addr, dst_height, bpp,
-			  x, y, w, h);
+    return accel_state->fence_last;
 }
 
 static Bool
@@ -1843,74 +2781,102 @@ R600DownloadFromScreen(PixmapPtr pSrc, int x, int y, int w, int h,
 {
     ScrnInfoPtr pScrn = xf86Screens[pSrc->drawable.pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
-    struct RhdCS *CS = rhdPtr->CS;
     uint32_t src_pitch = exaGetPixmapPitch(pSrc) / (pSrc->drawable.bitsPerPixel / 8);
     uint32_t src_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + exaGetPixmapOffset(pSrc);
     uint32_t src_width = pSrc->drawable.width;
     uint32_t src_height = pSrc->drawable.height;
+    uint32_t src_array_mode = R600PixmapArrayMode(pScrn, pSrc);
     int bpp = pSrc->drawable.bitsPerPixel;
-    uint32_t scratch_mc_addr;
-    int scratch_pitch_bytes = (dst_pitch + 255) & ~255;
-    int scratch_offset = 0, hpass;
-    uint32_t scratch_pitch = scratch_pitch_bytes / (bpp / 8);
     int wpass = w * (bpp/8);
-    drmBufPtr scratch;
+    int scratch_pitch_bytes = (wpass + 255) & ~255;
+    uint32_t scratch_pitch = scratch_pitch_bytes / (bpp / 8);
+    drmBufPtr scratch[R600_STAGING_SLOTS];
+    uint32_t fence[R600_STAGING_SLOTS];
+    int slots, chunks, chunk, hchunk, hpass;
 
     if (src_pitch & 7)
 	return FALSE;
 
-    scratch = RHDDRMCPBuffer(pScrn->scrnIndex);
-    if (scratch == NULL)
+    slots = R600StagingAlloc(pScrn, scratch, 0, 1);
+    if (!slots)
+	return FALSE;
+
+    hchunk = scratch[0]->total / scratch_pitch_bytes;
+    if (!hchunk) {
+	R600StagingFree(pScrn, scratch, slots);
 	return FALSE;
+    }
 
-    scratch_mc_addr = RHDDRIGetIntGARTLocation(pScrn) + (scratch->idx * scratch->total);
-    hpass = min(h, scratch->total/2 / scratch_pitch_bytes);
+    chunks = (h + hchunk - 1) / hchunk;
+    slots = R600StagingAlloc(pScrn, scratch, slots, chunks);
 
-    /* blit from vram to scratch */
-    R600DoPrepareCopy(pScrn,
-		      src_pitch, src_width, src_height, src_mc_addr, bpp,
-		      scratch_pitch, hpass, scratch_mc_addr, bpp,
-		      3, 0xffffffff);
-    R600AppendCopyVertex(pScrn, x, y, 0, 0, w, hpass);
-    R600DoCopy(pScrn);
-
-    while (h) {
-	char *src = (char *)scratch->address + scratch_offset;
-	int oldhpass = hpass;
-	h -= oldhpass;
-	y += oldhpass;
-	hpass = min(h, scratch->total/2 / scratch_pitch_bytes);
-
-	if (hpass) {
-	    scratch_offset = scratch->total/2 - scratch_offset;
-	    /* blit from vram to scratch */
-	    R600DoPrepareCopy(pScrn,
-			      src_pitch, src_width, src_height, src_mc_addr, bpp,
-			      scratch_pitch, hpass, scratch_mc_addr + scratch_offset, bpp,
-			      3, 0xffffffff);
-	    R600AppendCopyVertex(pScrn, x, y, 0, 0, w, hpass);
-	    R600DoCopy(pScrn);
-	}
+    /* get the engine going on as many chunks as there are slots */
+    for (chunk = 0; chunk < slots; chunk++)
+	fence[chunk] = R600QueueDownload(pScrn, scratch[chunk], scratch_pitch,
+					 src_pitch, src_width, src_height, src_mc_addr, bpp, src_array_mode,
+					 x, y + chunk * hchunk, w,
+					 min(h - chunk * hchunk, hchunk));
+
+    for (chunk = 0; chunk < chunks; chunk++) {
+	int slot = chunk % slots;
+	char *src = (char *)scratch[slot]->address;
+
+	hpass = min(h - chunk * hchunk, hchunk);
+
+	fence_wait(pScrn, fence[slot]);
 
-	/* wait for the engine to be idle */
-	RHDCSIdle(CS);
 	/* memcopy from scratch to sys */
-	while (oldhpass--) {
+	while (hpass--) {
 	    memcpy (dst, src, wpass);
 	    dst += dst_pitch;
 	    src += scratch_pitch_bytes;
 	}
+
+	/* and refill the slot with the next chunk it is due for */
+	if ((chunk + slots) < chunks)
+	    fence[slot] = R600QueueDownload(pScrn, scratch[slot], scratch_pitch,
+					    src_pitch, src_width, src_height, src_mc_addr, bpp, src_array_mode,
+					    x, y + (chunk + slots) * hchunk, w,
+					    min(h - (chunk + slots) * hchunk, hchunk));
     }
 
-    R600IBDiscard(pScrn, scratch);
+    R600StagingFree(pScrn, scratch, slots);
 
     return TRUE;
 
 }
 
+/* nothing batched may be left behind while the server sleeps */
+static void
+R600BlockHandler(int i, pointer blockData, pointer pTimeout, pointer pReadmask)
+{
+    ScreenPtr pScreen = screenInfo.screens[i];
+    ScrnInfoPtr pScrn = xf86Screens[i];
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    R600BatchFlush(pScrn);
+
+    pScreen->BlockHandler = accel_state->BlockHandler;
+    (*pScreen->BlockHandler) (i, blockData, pTimeout, pReadmask);
+    pScreen->BlockHandler = R600BlockHandler;
+}
+
 void
 R6xxEXACloseScreen(ScreenPtr pScreen)
 {
+    ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    if (accel_state && accel_state->BlockHandler) {
+	R600BatchFlush(pScrn);
+	pScreen->BlockHandler = accel_state->BlockHandler;
+	accel_state->BlockHandler = NULL;
+    }
+    if (accel_state && accel_state->DestroyPixmap) {
+	pScreen->DestroyPixmap = accel_state->DestroyPixmap;
+	accel_state->DestroyPixmap = NULL;
+    }
+
     exaDriverFini(pScreen);
 }
 
@@ -1918,6 +2884,7 @@ void
 R6xxEXADestroy(ScrnInfoPtr pScrn)
 {
     RHDPtr rhdPtr = RHDPTR(pScrn);
+    int i;
 
     if (rhdPtr->EXAInfo) {
 	xfree(rhdPtr->EXAInfo);
@@ -1925,6 +2892,49 @@ R6xxEXADestroy(ScrnInfoPtr pScrn)
     }
 
     if (rhdPtr->TwoDPrivate) {
+	struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+
+	if (accel_state->ib_count)
+	    LOG("R6xx EXA: %u of %u context register writes suppressed, "
+		"%u dwords in %u indirect buffers.\n",
+		(unsigned int) accel_state->context_reg_skipped,
+		(unsigned int) accel_state->context_reg_writes,
+		(unsigned int) accel_state->ib_dwords,
+		(unsigned int) accel_state->ib_count);
+	if (accel_state->batch_rects)
+	    LOG("R6xx EXA: %u rectangles, %u operations batched up, "
+		"%u indirect buffers per 10000 rectangles.\n",
+		(unsigned int) accel_state->batch_rects,
+		(unsigned int) accel_state->batch_continued,
+		(unsigned int) (((CARD64) accel_state->ib_count * 10000) / accel_state->batch_rects));
+	if (accel_state->dma_rects)
+	    LOG("R6xx EXA: %u rectangles, %u bytes moved by CP DMA.\n",
+		(unsigned int) accel_state->dma_rects,
+		(unsigned int) accel_state->dma_bytes);
+	if (accel_state->comp_class_misses)
+	    LOG("R6xx EXA: %u of %u composite classifications cached.\n",
+		(unsigned int) accel_state->comp_class_hits,
+		(unsigned int) (accel_state->comp_class_hits +
+				accel_state->comp_class_misses));
+	for (i = 0; i < R6XX_GLYPH_ATLASES; i++) {
+	    struct rhdAtlasStats Stats;
+
+	    if (!accel_state->glyph_atlas[i].atlas)
+		continue;
+	    RHDAtlasStats(accel_state->glyph_atlas[i].atlas, &Stats);
+	    if (Stats.Lookups)
+		LOG("R6xx EXA: glyph atlas %d: %u of %u lookups hit, "
+		    "%u bands evicted.\n", i, (unsigned int) Stats.Hits,
+		    (unsigned int) Stats.Lookups, (unsigned int) Stats.Evictions);
+	    RHDAtlasDestroy(accel_state->glyph_atlas[i].atlas);
+	}
+	if (accel_state->tiled_uploads)
+	    LOG("R6xx EXA: %u uploads to tiled pixmaps, %u CPU accesses "
+		"detiled.\n", (unsigned int) accel_state->tiled_uploads,
+		(unsigned int) accel_state->tiled_accesses);
+	for (i = 0; i < R6XX_TILED_SURFACES; i++)
+	    R600TiledDrop(&accel_state->tiled[i]);
+
 	xfree(rhdPtr->TwoDPrivate);
 	rhdPtr->TwoDPrivate = NULL;
     }
@@ -1962,6 +2972,8 @@ R600EXASync(ScreenPtr pScreen, int marker)
     ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
     struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
 
+    R600BatchFlush(pScrn);
+
     if (accel_state->exaMarkerSynced != marker) {
 	struct RhdCS *CS = RHDPTR(pScrn)->CS;
 
@@ -1976,8 +2988,7 @@ R600AllocShaders(ScrnInfoPtr pScrn, ScreenPtr pScreen)
 {
     RHDPtr rhdPtr = RHDPTR(pScrn);
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
-    /* 512 bytes per shader for now */
-    int size = 512 * 9;
+    int size = R600_SHADER_SLOT * R600_SHADER_SLOTS;
 
     accel_state->shaders = NULL;
 
@@ -1996,45 +3007,42 @@ R600LoadShaders(ScrnInfoPtr pScrn)
     struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
     enum RHD_CHIPSETS ChipSet = rhdPtr->ChipSet;
     uint32_t *shader;
+    int i;
 
     shader = (pointer)((char *)rhdPtr->FbBase + rhdPtr->FbScanoutStart + accel_state->shaders->offset);
 
+    accel_state->shaders_used = 0;
+
     /*  solid vs --------------------------------------- */
-    accel_state->solid_vs_offset = 0;
+    accel_state->solid_vs_offset = R600ShaderSlot(accel_state);
     R600_solid_vs(ChipSet, shader + accel_state->solid_vs_offset / 4);
 
     /*  solid ps --------------------------------------- */
-    accel_state->solid_ps_offset = 512;
+    accel_state->solid_ps_offset = R600ShaderSlot(accel_state);
     R600_solid_ps(ChipSet, shader + accel_state->solid_ps_offset / 4);
 
     /*  copy vs --------------------------------------- */
-    accel_state->copy_vs_offset = 1024;
+    accel_state->copy_vs_offset = R600ShaderSlot(accel_state);
     R600_copy_vs(ChipSet, shader + accel_state->copy_vs_offset / 4);
 
     /*  copy ps --------------------------------------- */
-    accel_state->copy_ps_offset = 1536;
+    accel_state->copy_ps_offset = R600ShaderSlot(accel_state);
     R600_copy_ps(ChipSet, shader + accel_state->copy_ps_offset / 4);
 
-    /*  comp vs --------------------------------------- */
-    accel_state->comp_vs_offset = 2048;
-    R600_comp_vs(ChipSet, shader + accel_state->comp_vs_offset / 4);
-
-    /*  comp ps --------------------------------------- */
-    accel_state->comp_ps_offset = 2560;
-    R600_comp_ps(ChipSet, shader + accel_state->comp_ps_offset / 4);
-
-    /*  comp mask ps --------------------------------------- */
-    accel_state->comp_mask_ps_offset = 3072;
-    R600_comp_mask_ps(ChipSet, shader + accel_state->comp_mask_ps_offset / 4);
-
     /*  xv vs --------------------------------------- */
-    accel_state->xv_vs_offset = 3584;
+    accel_state->xv_vs_offset = R600ShaderSlot(accel_state);
     R600_xv_vs(ChipSet, shader + accel_state->xv_vs_offset / 4);
 
     /*  xv ps --------------------------------------- */
-    accel_state->xv_ps_offset = 4096;
+    accel_state->xv_ps_offset = R600ShaderSlot(accel_state);
     R600_xv_ps(ChipSet, shader + accel_state->xv_ps_offset / 4);
 
+    /* composite variants are generated by R600CompShaders() */
+    for (i = 0; i < R6XX_COMP_VARIANTS; i++) {
+	accel_state->comp_vs_offset[i] = 0;
+	accel_state->comp_ps_offset[i] = 0;
+    }
+
     return TRUE;
 }
 
@@ -2043,10 +3051,39 @@ R600PrepareAccess(PixmapPtr pPix, int index)
 {
     ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_accel_state *accel_state = rhdPtr->TwoDPrivate;
+    struct r6xx_tiled_surface *tiled;
+
+    if ((index != EXA_PREPARE_SRC) && (index != EXA_PREPARE_MASK))
+	R600GlyphInvalidate(accel_state, pPix);
 
     /* flush HDP read/write caches */
     RHDRegWrite(rhdPtr, HDP_MEM_COHERENCY_FLUSH_CNTL, 0x1);
 
+    tiled = R600TiledSurface(pScrn, pPix);
+    if (!tiled)
+	return TRUE;
+
+    /* the engine is idle here, EXA waited for it */
+    if (!tiled->shadow) {
+	tiled->shadow = xalloc(tiled->layout.Size);
+	if (!tiled->shadow)
+	    return FALSE;
+
+	RHDSurfaceDetile(&tiled->layout,
+			 (char *)rhdPtr->FbBase + rhdPtr->FbScanoutStart + exaGetPixmapOffset(pPix),
+			 0, 0, pPix->drawable.width, pPix->drawable.height,
+			 tiled->shadow, exaGetPixmapPitch(pPix));
+	tiled->dirty = FALSE;
+	accel_state->tiled_accesses++;
+    }
+
+    if ((index != EXA_PREPARE_SRC) && (index != EXA_PREPARE_MASK))
+	tiled->dirty = TRUE;
+    tiled->access++;
+
+    pPix->devPrivate.ptr = tiled->shadow;
+
     return TRUE;
 }
 
@@ -2055,6 +3092,21 @@ R600FinishAccess(PixmapPtr pPix, int index)
 {
     ScrnInfoPtr pScrn = xf86Screens[pPix->drawable.pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct r6xx_tiled_surface *tiled;
+
+    tiled = R600TiledSurface(pScrn, pPix);
+    if (tiled && tiled->shadow && !--tiled->access) {
+	char *base = (char *)rhdPtr->FbBase + rhdPtr->FbScanoutStart + exaGetPixmapOffset(pPix);
+
+	if (tiled->dirty)
+	    RHDSurfaceRetile(&tiled->layout, base,
+			     0, 0, pPix->drawable.width, pPix->drawable.height,
+			     tiled->shadow, exaGetPixmapPitch(pPix));
+
+	xfree(tiled->shadow);
+	tiled->shadow = NULL;
+	pPix->devPrivate.ptr = base;
+    }
 
     /* flush HDP read/write caches */
     RHDRegWrite(rhdPtr, HDP_MEM_COHERENCY_FLUSH_CNTL, 0x1);
@@ -2131,6 +3183,12 @@ R6xxEXAInit(ScrnInfoPtr pScrn, ScreenPtr pScreen)
 
     accel_state->XHas3DEngineState = FALSE;
     accel_state->copy_area = NULL;
+    accel_state->fence_last = RHDRegRead(pScrn, R6XX_FENCE_REG);
+    accel_state->dma_fill_min = R600_DMA_FILL_MIN;
+    accel_state->dma_copy_min = R600_DMA_COPY_MIN;
+    accel_state->dma_row_min = R600_DMA_ROW_MIN;
+    RHDTilingConfigR6xx(RHDRegRead(pScrn, GB_TILING_CONFIG), &accel_state->tiling);
+    accel_state->tiled_min = R600_TILED_MIN;
 
     rhdPtr->TwoDPrivate = accel_state;
 
@@ -2146,6 +3204,14 @@ R6xxEXAInit(ScrnInfoPtr pScrn, ScreenPtr pScreen)
 	return FALSE;
     }
 
+    /* text just goes unbatched without them */
+    R600AllocGlyphAtlases(pScrn, pScreen);
+
+    accel_state->BlockHandler = pScreen->BlockHandler;
+    pScreen->BlockHandler = R600BlockHandler;
+    accel_state->DestroyPixmap = pScreen->DestroyPixmap;
+    pScreen->DestroyPixmap = R600DestroyPixmap;
+
     exaMarkSync(pScreen);
 
     return TRUE;
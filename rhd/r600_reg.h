@@ -87,6 +87,12 @@ enum {
 	WAIT_MEM    = (1<<4)
 };
 
+/* packet3 IT_CP_DMA bits */
+enum {
+	CP_DMA_CP_SYNC         = (1 << 31),	/* src hi dword, wait for completion */
+	CP_DMA_BYTE_COUNT_max  = (1 << 21) - 8
+};
+
 /* Packet3 commands */
 enum {
     IT_NOP                               = 0x10,
@@ -112,6 +118,7 @@ enum {
     IT_MEM_WRITE                         = 0x3D,
     IT_INDIRECT_BUFFER                   = 0x32,
     IT_CP_INTERRUPT                      = 0x40,
+    IT_CP_DMA                            = 0x41,
     IT_SURFACE_SYNC                      = 0x43,
     IT_ME_INITIALIZE                     = 0x44,
     IT_COND_WRITE                        = 0x45,
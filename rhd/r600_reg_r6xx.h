@@ -373,6 +373,14 @@ enum {
 	DB_EXTRA_DEBUG_mask                               = 0x0f << 28,
 	DB_EXTRA_DEBUG_shift                              = 28,
 
+    GB_TILING_CONFIG                                      = 0x98f0,
+	PIPE_TILING_mask                                  = 0x07 << 1,
+	PIPE_TILING_shift                                 = 1,
+	BANK_TILING_mask                                  = 0x03 << 4,
+	BANK_TILING_shift                                 = 4,
+	GROUP_SIZE_mask                                   = 0x03 << 6,
+	GROUP_SIZE_shift                                  = 6,
+
     CP_RB_BASE                                            = 0xc100,
     CP_RB_CNTL                                            = 0xc104,
         RB_BUFSZ_mask                                     = 0x3f << 0,
@@ -1244,441 +1244,37 @@ int R600_xv_ps(enum RHD_CHIPSETS ChipSet, CARD32* shader)
     return i;
 }
 
-/* comp mask ps --------------------------------------- */
-int R600_comp_mask_ps(enum RHD_CHIPSETS ChipSet, CARD32* shader)
-{
-    int i=0;
-
-    /* 0 */
-    shader[i++] = CF_DWORD0(ADDR(8));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-			    CF_CONST(0),
-			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(2),
-			    CALL_COUNT(0),
-			    END_OF_PROGRAM(0),
-			    VALID_PIXEL_MODE(0),
-			    CF_INST(SQ_CF_INST_TEX),
-			    WHOLE_QUAD_MODE(0),
-			    BARRIER(1));
-
-    /* 1 */
-    shader[i++] = CF_ALU_DWORD0(ADDR(3),
-				KCACHE_BANK0(0),
-				KCACHE_BANK1(0),
-				KCACHE_MODE0(SQ_CF_KCACHE_NOP));
-    shader[i++] = CF_ALU_DWORD1(KCACHE_MODE1(SQ_CF_KCACHE_NOP),
-				KCACHE_ADDR0(0),
-				KCACHE_ADDR1(0),
-				I_COUNT(4),
-				USES_WATERFALL(0),
-				CF_INST(SQ_CF_INST_ALU),
-				WHOLE_QUAD_MODE(0),
-				BARRIER(1));
-
-    /* 2 */
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(CF_PIXEL_MRT0),
-					  TYPE(SQ_EXPORT_PIXEL),
-					  RW_GPR(2),
-					  RW_REL(ABSOLUTE),
-					  INDEX_GPR(0),
-					  ELEM_SIZE(1));
-
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
-					       SRC_SEL_Y(SQ_SEL_Y),
-					       SRC_SEL_Z(SQ_SEL_Z),
-					       SRC_SEL_W(SQ_SEL_W),
-					       R6xx_ELEM_LOOP(0),
-					       BURST_COUNT(1),
-					       END_OF_PROGRAM(1),
-					       VALID_PIXEL_MODE(0),
-					       CF_INST(SQ_CF_INST_EXPORT_DONE),
-					       WHOLE_QUAD_MODE(0),
-					       BARRIER(1));
-
-    /* 3 - alu 0 */
-    /* MUL gpr[2].x gpr[1].x gpr[0].x */
-    shader[i++] = ALU_DWORD0(SRC0_SEL(1),
-			     SRC0_REL(ABSOLUTE),
-			     SRC0_ELEM(ELEM_X),
-			     SRC0_NEG(0),
-			     SRC1_SEL(0),
-			     SRC1_REL(ABSOLUTE),
-			     SRC1_ELEM(ELEM_X),
-			     SRC1_NEG(0),
-			     INDEX_MODE(SQ_INDEX_LOOP),
-			     PRED_SEL(SQ_PRED_SEL_OFF),
-			     LAST(0));
-    shader[i++] = ALU_DWORD1_OP2(ChipSet,
-				 SRC0_ABS(0),
-				 SRC1_ABS(0),
-				 UPDATE_EXECUTE_MASK(0),
-				 UPDATE_PRED(0),
-				 WRITE_MASK(1),
-				 FOG_MERGE(0),
-				 OMOD(SQ_ALU_OMOD_OFF),
-				 ALU_INST(SQ_OP2_INST_MUL),
-				 BANK_SWIZZLE(SQ_ALU_VEC_012),
-				 DST_GPR(2),
-				 DST_REL(ABSOLUTE),
-				 DST_ELEM(ELEM_X),
-				 CLAMP(1));
-    /* 4 - alu 1 */
-    /* MUL gpr[2].y gpr[1].y gpr[0].y */
-    shader[i++] = ALU_DWORD0(SRC0_SEL(1),
-			     SRC0_REL(ABSOLUTE),
-			     SRC0_ELEM(ELEM_Y),
-			     SRC0_NEG(0),
-			     SRC1_SEL(0),
-			     SRC1_REL(ABSOLUTE),
-			     SRC1_ELEM(ELEM_Y),
-			     SRC1_NEG(0),
-			     INDEX_MODE(SQ_INDEX_LOOP),
-			     PRED_SEL(SQ_PRED_SEL_OFF),
-			     LAST(0));
-    shader[i++] = ALU_DWORD1_OP2(ChipSet,
-				 SRC0_ABS(0),
-				 SRC1_ABS(0),
-				 UPDATE_EXECUTE_MASK(0),
-				 UPDATE_PRED(0),
-				 WRITE_MASK(1),
-				 FOG_MERGE(0),
-				 OMOD(SQ_ALU_OMOD_OFF),
-				 ALU_INST(SQ_OP2_INST_MUL),
-				 BANK_SWIZZLE(SQ_ALU_VEC_012),
-				 DST_GPR(2),
-				 DST_REL(ABSOLUTE),
-				 DST_ELEM(ELEM_Y),
-				 CLAMP(1));
-    /* 5 - alu 2 */
-    /* MUL gpr[2].z gpr[1].z gpr[0].z */
-    shader[i++] = ALU_DWORD0(SRC0_SEL(1),
-			     SRC0_REL(ABSOLUTE),
-			     SRC0_ELEM(ELEM_Z),
-			     SRC0_NEG(0),
-			     SRC1_SEL(0),
-			     SRC1_REL(ABSOLUTE),
-			     SRC1_ELEM(ELEM_Z),
-			     SRC1_NEG(0),
-			     INDEX_MODE(SQ_INDEX_LOOP),
-			     PRED_SEL(SQ_PRED_SEL_OFF),
-			     LAST(0));
-    shader[i++] = ALU_DWORD1_OP2(ChipSet,
-				 SRC0_ABS(0),
-				 SRC1_ABS(0),
-				 UPDATE_EXECUTE_MASK(0),
-				 UPDATE_PRED(0),
-				 WRITE_MASK(1),
-				 FOG_MERGE(0),
-				 OMOD(SQ_ALU_OMOD_OFF),
-				 ALU_INST(SQ_OP2_INST_MUL),
-				 BANK_SWIZZLE(SQ_ALU_VEC_012),
-				 DST_GPR(2),
-				 DST_REL(ABSOLUTE),
-				 DST_ELEM(ELEM_Z),
-				 CLAMP(1));
-    /* 6 - alu 3 */
-    /* MUL gpr[2].w gpr[1].w gpr[0].w */
-    shader[i++] = ALU_DWORD0(SRC0_SEL(1),
-			     SRC0_REL(ABSOLUTE),
-			     SRC0_ELEM(ELEM_W),
-			     SRC0_NEG(0),
-			     SRC1_SEL(0),
-			     SRC1_REL(ABSOLUTE),
-			     SRC1_ELEM(ELEM_W),
-			     SRC1_NEG(0),
-			     INDEX_MODE(SQ_INDEX_LOOP),
-			     PRED_SEL(SQ_PRED_SEL_OFF),
-			     LAST(1));
-    shader[i++] = ALU_DWORD1_OP2(ChipSet,
-				 SRC0_ABS(0),
-				 SRC1_ABS(0),
-				 UPDATE_EXECUTE_MASK(0),
-				 UPDATE_PRED(0),
-				 WRITE_MASK(1),
-				 FOG_MERGE(0),
-				 OMOD(SQ_ALU_OMOD_OFF),
-				 ALU_INST(SQ_OP2_INST_MUL),
-				 BANK_SWIZZLE(SQ_ALU_VEC_012),
-				 DST_GPR(2),
-				 DST_REL(ABSOLUTE),
-				 DST_ELEM(ELEM_W),
-				 CLAMP(1));
-    /* 7 */
-    shader[i++] = 0x00000000;
-    shader[i++] = 0x00000000;
-
-    /* 8/9 - src */
-    shader[i++] = TEX_DWORD0(TEX_INST(SQ_TEX_INST_SAMPLE),
-			     BC_FRAC_MODE(0),
-			     FETCH_WHOLE_QUAD(0),
-			     RESOURCE_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     R7xx_ALT_CONST(0));
-    shader[i++] = TEX_DWORD1(DST_GPR(0),
-			     DST_REL(ABSOLUTE),
-			     DST_SEL_X(SQ_SEL_X),
-			     DST_SEL_Y(SQ_SEL_Y),
-			     DST_SEL_Z(SQ_SEL_Z),
-			     DST_SEL_W(SQ_SEL_W),
-			     LOD_BIAS(0),
-			     COORD_TYPE_X(TEX_NORMALIZED),
-			     COORD_TYPE_Y(TEX_NORMALIZED),
-			     COORD_TYPE_Z(TEX_NORMALIZED),
-			     COORD_TYPE_W(TEX_NORMALIZED));
-    shader[i++] = TEX_DWORD2(OFFSET_X(0),
-			     OFFSET_Y(0),
-			     OFFSET_Z(0),
-			     SAMPLER_ID(0),
-			     SRC_SEL_X(SQ_SEL_X),
-			     SRC_SEL_Y(SQ_SEL_Y),
-			     SRC_SEL_Z(SQ_SEL_0),
-			     SRC_SEL_W(SQ_SEL_1));
-    shader[i++] = TEX_DWORD_PAD;
-    /* 10/11 - mask */
-    shader[i++] = TEX_DWORD0(TEX_INST(SQ_TEX_INST_SAMPLE),
-			     BC_FRAC_MODE(0),
-			     FETCH_WHOLE_QUAD(0),
-			     RESOURCE_ID(1),
-			     SRC_GPR(1),
-			     SRC_REL(ABSOLUTE),
-			     R7xx_ALT_CONST(0));
-    shader[i++] = TEX_DWORD1(DST_GPR(1),
-			     DST_REL(ABSOLUTE),
-			     DST_SEL_X(SQ_SEL_X),
-			     DST_SEL_Y(SQ_SEL_Y),
-			     DST_SEL_Z(SQ_SEL_Z),
-			     DST_SEL_W(SQ_SEL_W),
-			     LOD_BIAS(0),
-			     COORD_TYPE_X(TEX_NORMALIZED),
-			     COORD_TYPE_Y(TEX_NORMALIZED),
-			     COORD_TYPE_Z(TEX_NORMALIZED),
-			     COORD_TYPE_W(TEX_NORMALIZED));
-    shader[i++] = TEX_DWORD2(OFFSET_X(0),
-			     OFFSET_Y(0),
-			     OFFSET_Z(0),
-			     SAMPLER_ID(1),
-			     SRC_SEL_X(SQ_SEL_X),
-			     SRC_SEL_Y(SQ_SEL_Y),
-			     SRC_SEL_Z(SQ_SEL_0),
-			     SRC_SEL_W(SQ_SEL_1));
-    shader[i++] = TEX_DWORD_PAD;
-
-    return i;
-}
+/*
+ * Composite shaders are generated per variant, R600_COMP_* bits, instead of
+ * branching on a boolean constant for every vertex. Source format, component
+ * alpha and repeat mode are left out: the texture swizzles and samplers take
+ * care of them without costing any code.
+ */
 
 /* comp vs --------------------------------------- */
-int R600_comp_vs(enum RHD_CHIPSETS ChipSet, CARD32* shader)
+int R600_comp_vs_variant(enum RHD_CHIPSETS ChipSet, int variant, CARD32* shader)
 {
-    int i = 0;
+    /* texture coordinates: src, mask; destination position after them */
+    int coords = (variant & R600_COMP_MASK) ? 2 : 1;
+    int pos_gpr = coords;
+    int i = 0, k;
 
     /* 0 */
-    shader[i++] = CF_DWORD0(ADDR(3));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-                            CF_CONST(0),
-                            COND(SQ_CF_COND_BOOL),
-                            I_COUNT(0),
-                            CALL_COUNT(0),
-                            END_OF_PROGRAM(0),
-                            VALID_PIXEL_MODE(0),
-                            CF_INST(SQ_CF_INST_CALL),
-                            WHOLE_QUAD_MODE(0),
-                            BARRIER(0));
-    /* 1 */
-    shader[i++] = CF_DWORD0(ADDR(14));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-                            CF_CONST(0),
-                            COND(SQ_CF_COND_NOT_BOOL),
-                            I_COUNT(0),
-                            CALL_COUNT(0),
-                            END_OF_PROGRAM(0),
-                            VALID_PIXEL_MODE(0),
-                            CF_INST(SQ_CF_INST_CALL),
-                            WHOLE_QUAD_MODE(0),
-                            BARRIER(0));
-    /* 2 */
-    shader[i++] = CF_DWORD0(0);
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-                            CF_CONST(0),
-                            COND(SQ_CF_COND_ACTIVE),
-                            I_COUNT(0),
-                            CALL_COUNT(0),
-                            END_OF_PROGRAM(1),
-                            VALID_PIXEL_MODE(0),
-                            CF_INST(SQ_CF_INST_NOP),
-                            WHOLE_QUAD_MODE(0),
-                            BARRIER(1));
-    /* 3 - mask sub */
-    shader[i++] = CF_DWORD0(ADDR(8));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-			    CF_CONST(0),
-			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(3),
-			    CALL_COUNT(0),
-			    END_OF_PROGRAM(0),
-			    VALID_PIXEL_MODE(0),
-			    CF_INST(SQ_CF_INST_VTX),
-			    WHOLE_QUAD_MODE(0),
-			    BARRIER(1));
-    /* 4 - dst */
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(CF_POS0),
-					  TYPE(SQ_EXPORT_POS),
-					  RW_GPR(2),
-					  RW_REL(ABSOLUTE),
-					  INDEX_GPR(0),
-					  ELEM_SIZE(0));
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
-					       SRC_SEL_Y(SQ_SEL_Y),
-					       SRC_SEL_Z(SQ_SEL_Z),
-					       SRC_SEL_W(SQ_SEL_W),
-					       R6xx_ELEM_LOOP(0),
-					       BURST_COUNT(1),
-					       END_OF_PROGRAM(0),
-					       VALID_PIXEL_MODE(0),
-					       CF_INST(SQ_CF_INST_EXPORT_DONE),
-					       WHOLE_QUAD_MODE(0),
-					       BARRIER(1));
-    /* 5 - src */
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(0),
-					  TYPE(SQ_EXPORT_PARAM),
-					  RW_GPR(1),
-					  RW_REL(ABSOLUTE),
-					  INDEX_GPR(0),
-					  ELEM_SIZE(0));
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
-					       SRC_SEL_Y(SQ_SEL_Y),
-					       SRC_SEL_Z(SQ_SEL_Z),
-					       SRC_SEL_W(SQ_SEL_W),
-					       R6xx_ELEM_LOOP(0),
-					       BURST_COUNT(1),
-					       END_OF_PROGRAM(0),
-					       VALID_PIXEL_MODE(0),
-					       CF_INST(SQ_CF_INST_EXPORT),
-					       WHOLE_QUAD_MODE(0),
-					       BARRIER(0));
-    /* 6 - mask */
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(1),
-					  TYPE(SQ_EXPORT_PARAM),
-					  RW_GPR(0),
-					  RW_REL(ABSOLUTE),
-					  INDEX_GPR(0),
-					  ELEM_SIZE(0));
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
-					       SRC_SEL_Y(SQ_SEL_Y),
-					       SRC_SEL_Z(SQ_SEL_Z),
-					       SRC_SEL_W(SQ_SEL_W),
-					       R6xx_ELEM_LOOP(0),
-					       BURST_COUNT(1),
-					       END_OF_PROGRAM(0),
-					       VALID_PIXEL_MODE(0),
-					       CF_INST(SQ_CF_INST_EXPORT_DONE),
-					       WHOLE_QUAD_MODE(0),
-					       BARRIER(0));
-    /* 7 */
-    shader[i++] = CF_DWORD0(ADDR(0));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-			    CF_CONST(0),
-			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(0),
-			    CALL_COUNT(0),
-			    END_OF_PROGRAM(0),
-			    VALID_PIXEL_MODE(0),
-			    CF_INST(SQ_CF_INST_RETURN),
-			    WHOLE_QUAD_MODE(0),
-			    BARRIER(1));
-    /* 8/9 - dst */
-    shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
-			     FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
-			     FETCH_WHOLE_QUAD(0),
-			     BUFFER_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     SRC_SEL_X(SQ_SEL_X),
-			     MEGA_FETCH_COUNT(24));
-    shader[i++] = VTX_DWORD1_GPR(DST_GPR(2),
-				 DST_REL(0),
-				 DST_SEL_X(SQ_SEL_X),
-				 DST_SEL_Y(SQ_SEL_Y),
-				 DST_SEL_Z(SQ_SEL_0),
-				 DST_SEL_W(SQ_SEL_1),
-				 USE_CONST_FIELDS(0),
-				 DATA_FORMAT(FMT_32_32_FLOAT), /* xxx */
-				 NUM_FORMAT_ALL(SQ_NUM_FORMAT_NORM), /* xxx */
-				 FORMAT_COMP_ALL(SQ_FORMAT_COMP_SIGNED), /* xxx */
-				 SRF_MODE_ALL(SRF_MODE_ZERO_CLAMP_MINUS_ONE));
-    shader[i++] = VTX_DWORD2(OFFSET(0),
-			     ENDIAN_SWAP(ENDIAN_NONE),
-			     CONST_BUF_NO_STRIDE(0),
-			     MEGA_FETCH(1));
-    shader[i++] = VTX_DWORD_PAD;
-    /* 10/11 - src */
-    shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
-			     FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
-			     FETCH_WHOLE_QUAD(0),
-			     BUFFER_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     SRC_SEL_X(SQ_SEL_X),
-			     MEGA_FETCH_COUNT(8));
-    shader[i++] = VTX_DWORD1_GPR(DST_GPR(1),
-				 DST_REL(0),
-				 DST_SEL_X(SQ_SEL_X),
-				 DST_SEL_Y(SQ_SEL_Y),
-				 DST_SEL_Z(SQ_SEL_0),
-				 DST_SEL_W(SQ_SEL_1),
-				 USE_CONST_FIELDS(0),
-				 DATA_FORMAT(FMT_32_32_FLOAT), /* xxx */
-				 NUM_FORMAT_ALL(SQ_NUM_FORMAT_NORM), /* xxx */
-				 FORMAT_COMP_ALL(SQ_FORMAT_COMP_SIGNED), /* xxx */
-				 SRF_MODE_ALL(SRF_MODE_ZERO_CLAMP_MINUS_ONE));
-    shader[i++] = VTX_DWORD2(OFFSET(8),
-			     ENDIAN_SWAP(ENDIAN_NONE),
-			     CONST_BUF_NO_STRIDE(0),
-			     MEGA_FETCH(0));
-    shader[i++] = VTX_DWORD_PAD;
-    /* 12/13 - mask */
-    shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
-			     FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
-			     FETCH_WHOLE_QUAD(0),
-			     BUFFER_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     SRC_SEL_X(SQ_SEL_X),
-			     MEGA_FETCH_COUNT(8));
-    shader[i++] = VTX_DWORD1_GPR(DST_GPR(0),
-				 DST_REL(0),
-				 DST_SEL_X(SQ_SEL_X),
-				 DST_SEL_Y(SQ_SEL_Y),
-				 DST_SEL_Z(SQ_SEL_0),
-				 DST_SEL_W(SQ_SEL_1),
-				 USE_CONST_FIELDS(0),
-				 DATA_FORMAT(FMT_32_32_FLOAT), /* xxx */
-				 NUM_FORMAT_ALL(SQ_NUM_FORMAT_NORM), /* xxx */
-				 FORMAT_COMP_ALL(SQ_FORMAT_COMP_SIGNED), /* xxx */
-				 SRF_MODE_ALL(SRF_MODE_ZERO_CLAMP_MINUS_ONE));
-    shader[i++] = VTX_DWORD2(OFFSET(16),
-			     ENDIAN_SWAP(ENDIAN_NONE),
-			     CONST_BUF_NO_STRIDE(0),
-			     MEGA_FETCH(0));
-    shader[i++] = VTX_DWORD_PAD;
-
-    /* 14 - non-mask sub */
-    shader[i++] = CF_DWORD0(ADDR(18));
+    shader[i++] = CF_DWORD0(ADDR(4));
     shader[i++] = CF_DWORD1(POP_COUNT(0),
 			    CF_CONST(0),
 			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(2),
+			    I_COUNT(1 + coords),
 			    CALL_COUNT(0),
 			    END_OF_PROGRAM(0),
 			    VALID_PIXEL_MODE(0),
 			    CF_INST(SQ_CF_INST_VTX),
 			    WHOLE_QUAD_MODE(0),
 			    BARRIER(1));
-    /* 15 - dst */
+    /* 1 - dst */
     shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(CF_POS0),
 					  TYPE(SQ_EXPORT_POS),
-					  RW_GPR(1),
+					  RW_GPR(pos_gpr),
 					  RW_REL(ABSOLUTE),
 					  INDEX_GPR(0),
 					  ELEM_SIZE(0));
@@ -1693,37 +1289,32 @@ int R600_comp_vs(enum RHD_CHIPSETS ChipSet, CARD32* shader)
 					       CF_INST(SQ_CF_INST_EXPORT_DONE),
 					       WHOLE_QUAD_MODE(0),
 					       BARRIER(1));
-    /* 16 - src */
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(0),
-					  TYPE(SQ_EXPORT_PARAM),
-					  RW_GPR(0),
-					  RW_REL(ABSOLUTE),
-					  INDEX_GPR(0),
-					  ELEM_SIZE(0));
-    shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
-					       SRC_SEL_Y(SQ_SEL_Y),
-					       SRC_SEL_Z(SQ_SEL_Z),
-					       SRC_SEL_W(SQ_SEL_W),
-					       R6xx_ELEM_LOOP(0),
-					       BURST_COUNT(0),
-					       END_OF_PROGRAM(0),
-					       VALID_PIXEL_MODE(0),
-					       CF_INST(SQ_CF_INST_EXPORT_DONE),
-					       WHOLE_QUAD_MODE(0),
-					       BARRIER(0));
-    /* 17 */
-    shader[i++] = CF_DWORD0(ADDR(0));
-    shader[i++] = CF_DWORD1(POP_COUNT(0),
-			    CF_CONST(0),
-			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(0),
-			    CALL_COUNT(0),
-			    END_OF_PROGRAM(0),
-			    VALID_PIXEL_MODE(0),
-			    CF_INST(SQ_CF_INST_RETURN),
-			    WHOLE_QUAD_MODE(0),
-			    BARRIER(1));
-    /* 18/19 - dst */
+    /* 2, 3 - src, mask */
+    for (k = 0; k < coords; k++) {
+	shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(k),
+					      TYPE(SQ_EXPORT_PARAM),
+					      RW_GPR(k),
+					      RW_REL(ABSOLUTE),
+					      INDEX_GPR(0),
+					      ELEM_SIZE(0));
+	shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
+						   SRC_SEL_Y(SQ_SEL_Y),
+						   SRC_SEL_Z(SQ_SEL_Z),
+						   SRC_SEL_W(SQ_SEL_W),
+						   R6xx_ELEM_LOOP(0),
+						   BURST_COUNT(0),
+						   END_OF_PROGRAM(k == (coords - 1)),
+						   VALID_PIXEL_MODE(0),
+						   CF_INST((k == (coords - 1)) ?
+							   SQ_CF_INST_EXPORT_DONE : SQ_CF_INST_EXPORT),
+						   WHOLE_QUAD_MODE(0),
+						   BARRIER(0));
+    }
+    /* fetch clauses start on an even slot */
+    while (i < 8)
+	shader[i++] = 0x00000000;
+
+    /* 4/5 - dst */
     shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
 			     FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
 			     FETCH_WHOLE_QUAD(0),
@@ -1731,8 +1322,8 @@ int R600_comp_vs(enum RHD_CHIPSETS ChipSet, CARD32* shader)
 			     SRC_GPR(0),
 			     SRC_REL(ABSOLUTE),
 			     SRC_SEL_X(SQ_SEL_X),
-			     MEGA_FETCH_COUNT(16));
-    shader[i++] = VTX_DWORD1_GPR(DST_GPR(1),
+			     MEGA_FETCH_COUNT(8 + 8 * coords));
+    shader[i++] = VTX_DWORD1_GPR(DST_GPR(pos_gpr),
 				 DST_REL(0),
 				 DST_SEL_X(SQ_SEL_X),
 				 DST_SEL_Y(SQ_SEL_Y),
@@ -1748,60 +1339,85 @@ int R600_comp_vs(enum RHD_CHIPSETS ChipSet, CARD32* shader)
 			     CONST_BUF_NO_STRIDE(0),
 			     MEGA_FETCH(1));
     shader[i++] = VTX_DWORD_PAD;
-    /* 20/21 - src */
-    shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
-			     FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
-			     FETCH_WHOLE_QUAD(0),
-			     BUFFER_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     SRC_SEL_X(SQ_SEL_X),
-			     MEGA_FETCH_COUNT(8));
-    shader[i++] = VTX_DWORD1_GPR(DST_GPR(0),
-				 DST_REL(0),
-				 DST_SEL_X(SQ_SEL_X),
-				 DST_SEL_Y(SQ_SEL_Y),
-				 DST_SEL_Z(SQ_SEL_0),
-				 DST_SEL_W(SQ_SEL_1),
-				 USE_CONST_FIELDS(0),
-				 DATA_FORMAT(FMT_32_32_FLOAT), /* xxx */
-				 NUM_FORMAT_ALL(SQ_NUM_FORMAT_NORM), /* xxx */
-				 FORMAT_COMP_ALL(SQ_FORMAT_COMP_SIGNED), /* xxx */
-				 SRF_MODE_ALL(SRF_MODE_ZERO_CLAMP_MINUS_ONE));
-    shader[i++] = VTX_DWORD2(OFFSET(8),
-			     ENDIAN_SWAP(ENDIAN_NONE),
-			     CONST_BUF_NO_STRIDE(0),
-			     MEGA_FETCH(0));
-    shader[i++] = VTX_DWORD_PAD;
+    /* 6/7 - src, 8/9 - mask */
+    for (k = 0; k < coords; k++) {
+	shader[i++] = VTX_DWORD0(VTX_INST(SQ_VTX_INST_FETCH),
+				 FETCH_TYPE(SQ_VTX_FETCH_VERTEX_DATA),
+				 FETCH_WHOLE_QUAD(0),
+				 BUFFER_ID(0),
+				 SRC_GPR(0),
+				 SRC_REL(ABSOLUTE),
+				 SRC_SEL_X(SQ_SEL_X),
+				 MEGA_FETCH_COUNT(8));
+	shader[i++] = VTX_DWORD1_GPR(DST_GPR(k),
+				     DST_REL(0),
+				     DST_SEL_X(SQ_SEL_X),
+				     DST_SEL_Y(SQ_SEL_Y),
+				     DST_SEL_Z(SQ_SEL_0),
+				     DST_SEL_W(SQ_SEL_1),
+				     USE_CONST_FIELDS(0),
+				     DATA_FORMAT(FMT_32_32_FLOAT), /* xxx */
+				     NUM_FORMAT_ALL(SQ_NUM_FORMAT_NORM), /* xxx */
+				     FORMAT_COMP_ALL(SQ_FORMAT_COMP_SIGNED), /* xxx */
+				     SRF_MODE_ALL(SRF_MODE_ZERO_CLAMP_MINUS_ONE));
+	shader[i++] = VTX_DWORD2(OFFSET(8 + 8 * k),
+				 ENDIAN_SWAP(ENDIAN_NONE),
+				 CONST_BUF_NO_STRIDE(0),
+				 MEGA_FETCH(0));
+	shader[i++] = VTX_DWORD_PAD;
+    }
 
     return i;
 }
 
 /* comp ps --------------------------------------- */
-int R600_comp_ps(enum RHD_CHIPSETS ChipSet, CARD32* shader)
+int R600_comp_ps_variant(enum RHD_CHIPSETS ChipSet, int variant, CARD32* shader)
 {
-    int i=0;
+    Bool mask = (variant & R600_COMP_MASK) ? TRUE : FALSE;
+    /* src in gpr 0, mask in gpr 1, the product in gpr 2 */
+    int out_gpr = mask ? 2 : 0;
+    int alu_addr = mask ? 3 : 2;
+    int alu_count = mask ? 4 : 0;
+    int tex_count = mask ? 2 : 1;
+    int tex_addr = (alu_addr + alu_count + 1) & ~1;
+    int i = 0, k;
 
     /* 0 */
-    shader[i++] = CF_DWORD0(ADDR(2));
+    shader[i++] = CF_DWORD0(ADDR(tex_addr));
     shader[i++] = CF_DWORD1(POP_COUNT(0),
 			    CF_CONST(0),
 			    COND(SQ_CF_COND_ACTIVE),
-			    I_COUNT(1),
+			    I_COUNT(tex_count),
 			    CALL_COUNT(0),
 			    END_OF_PROGRAM(0),
 			    VALID_PIXEL_MODE(0),
 			    CF_INST(SQ_CF_INST_TEX),
 			    WHOLE_QUAD_MODE(0),
 			    BARRIER(1));
-    /* 1 */
+
+    if (mask) {
+	/* 1 */
+	shader[i++] = CF_ALU_DWORD0(ADDR(alu_addr),
+				    KCACHE_BANK0(0),
+				    KCACHE_BANK1(0),
+				    KCACHE_MODE0(SQ_CF_KCACHE_NOP));
+	shader[i++] = CF_ALU_DWORD1(KCACHE_MODE1(SQ_CF_KCACHE_NOP),
+				    KCACHE_ADDR0(0),
+				    KCACHE_ADDR1(0),
+				    I_COUNT(alu_count),
+				    USES_WATERFALL(0),
+				    CF_INST(SQ_CF_INST_ALU),
+				    WHOLE_QUAD_MODE(0),
+				    BARRIER(1));
+    }
+
+    /* 1 or 2 */
     shader[i++] = CF_ALLOC_IMP_EXP_DWORD0(ARRAY_BASE(CF_PIXEL_MRT0),
 					  TYPE(SQ_EXPORT_PIXEL),
-					  RW_GPR(0),
+					  RW_GPR(out_gpr),
 					  RW_REL(ABSOLUTE),
 					  INDEX_GPR(0),
 					  ELEM_SIZE(1));
-
     shader[i++] = CF_ALLOC_IMP_EXP_DWORD1_SWIZ(SRC_SEL_X(SQ_SEL_X),
 					       SRC_SEL_Y(SQ_SEL_Y),
 					       SRC_SEL_Z(SQ_SEL_Z),
@@ -1814,35 +1430,67 @@ int R600_comp_ps(enum RHD_CHIPSETS ChipSet, CARD32* shader)
 					       WHOLE_QUAD_MODE(0),
 					       BARRIER(1));
 
+    /* 3 - 6, alu: MUL gpr[2].c gpr[1].c gpr[0].c */
+    for (k = 0; k < alu_count; k++) {
+	shader[i++] = ALU_DWORD0(SRC0_SEL(1),
+				 SRC0_REL(ABSOLUTE),
+				 SRC0_ELEM(k),
+				 SRC0_NEG(0),
+				 SRC1_SEL(0),
+				 SRC1_REL(ABSOLUTE),
+				 SRC1_ELEM(k),
+				 SRC1_NEG(0),
+				 INDEX_MODE(SQ_INDEX_LOOP),
+				 PRED_SEL(SQ_PRED_SEL_OFF),
+				 LAST(k == (alu_count - 1)));
+	shader[i++] = ALU_DWORD1_OP2(ChipSet,
+				     SRC0_ABS(0),
+				     SRC1_ABS(0),
+				     UPDATE_EXECUTE_MASK(0),
+				     UPDATE_PRED(0),
+				     WRITE_MASK(1),
+				     FOG_MERGE(0),
+				     OMOD(SQ_ALU_OMOD_OFF),
+				     ALU_INST(SQ_OP2_INST_MUL),
+				     BANK_SWIZZLE(SQ_ALU_VEC_012),
+				     DST_GPR(out_gpr),
+				     DST_REL(ABSOLUTE),
+				     DST_ELEM(k),
+				     CLAMP(1));
+    }
+    while (i < (tex_addr * 2))
+	shader[i++] = 0x00000000;
 
-    /* 2/3 - src */
-    shader[i++] = TEX_DWORD0(TEX_INST(SQ_TEX_INST_SAMPLE),
-			     BC_FRAC_MODE(0),
-			     FETCH_WHOLE_QUAD(0),
-			     RESOURCE_ID(0),
-			     SRC_GPR(0),
-			     SRC_REL(ABSOLUTE),
-			     R7xx_ALT_CONST(0));
-    shader[i++] = TEX_DWORD1(DST_GPR(0),
-			     DST_REL(ABSOLUTE),
-			     DST_SEL_X(SQ_SEL_X),
-			     DST_SEL_Y(SQ_SEL_Y),
-			     DST_SEL_Z(SQ_SEL_Z),
-			     DST_SEL_W(SQ_SEL_W),
-			     LOD_BIAS(0),
-			     COORD_TYPE_X(TEX_NORMALIZED),
-			     COORD_TYPE_Y(TEX_NORMALIZED),
-			     COORD_TYPE_Z(TEX_NORMALIZED),
-			     COORD_TYPE_W(TEX_NORMALIZED));
-    shader[i++] = TEX_DWORD2(OFFSET_X(0),
-			     OFFSET_Y(0),
-			     OFFSET_Z(0),
-			     SAMPLER_ID(0),
-			     SRC_SEL_X(SQ_SEL_X),
-			     SRC_SEL_Y(SQ_SEL_Y),
-			     SRC_SEL_Z(SQ_SEL_0),
-			     SRC_SEL_W(SQ_SEL_1));
-    shader[i++] = TEX_DWORD_PAD;
+    /* src, mask */
+    for (k = 0; k < (mask ? 2 : 1); k++) {
+	shader[i++] = TEX_DWORD0(TEX_INST(SQ_TEX_INST_SAMPLE),
+				 BC_FRAC_MODE(0),
+				 FETCH_WHOLE_QUAD(0),
+				 RESOURCE_ID(k),
+				 SRC_GPR(k),
+				 SRC_REL(ABSOLUTE),
+				 R7xx_ALT_CONST(0));
+	shader[i++] = TEX_DWORD1(DST_GPR(k),
+				 DST_REL(ABSOLUTE),
+				 DST_SEL_X(SQ_SEL_X),
+				 DST_SEL_Y(SQ_SEL_Y),
+				 DST_SEL_Z(SQ_SEL_Z),
+				 DST_SEL_W(SQ_SEL_W),
+				 LOD_BIAS(0),
+				 COORD_TYPE_X(TEX_NORMALIZED),
+				 COORD_TYPE_Y(TEX_NORMALIZED),
+				 COORD_TYPE_Z(TEX_NORMALIZED),
+				 COORD_TYPE_W(TEX_NORMALIZED));
+	shader[i++] = TEX_DWORD2(OFFSET_X(0),
+				 OFFSET_Y(0),
+				 OFFSET_Z(0),
+				 SAMPLER_ID(k),
+				 SRC_SEL_X(SQ_SEL_X),
+				 SRC_SEL_Y(SQ_SEL_Y),
+				 SRC_SEL_Z(SQ_SEL_0),
+				 SRC_SEL_W(SQ_SEL_1));
+	shader[i++] = TEX_DWORD_PAD;
+    }
 
     return i;
 }
@@ -354,6 +354,8 @@ extern int R600_copy_ps(enum RHD_CHIPSETS ChipSet, CARD32* ps);
 extern int R600_xv_vs(enum RHD_CHIPSETS ChipSet, CARD32* shader);
 extern int R600_xv_ps(enum RHD_CHIPSETS ChipSet, CARD32* shader);
 
-extern int R600_comp_vs(enum RHD_CHIPSETS ChipSet, CARD32* vs);
-extern int R600_comp_mask_ps(enum RHD_CHIPSETS ChipSet, CARD32* ps);
-extern int R600_comp_ps(enum RHD_CHIPSETS ChipSet, CARD32* ps);
+/* composite shader variants */
+#define R600_COMP_MASK	(1 << 0)	/* multiply by a mask texture */
+
+extern int R600_comp_vs_variant(enum RHD_CHIPSETS ChipSet, int variant, CARD32* vs);
+extern int R600_comp_ps_variant(enum RHD_CHIPSETS ChipSet, int variant, CARD32* ps);
@@ -240,15 +240,34 @@ do {								        \
     E32((ib), (val));							\
 } while (0)
 
+/* write a single context register through the shadow, pScrn must be in scope */
+#define CREG(ib, reg, val)                                              \
+do {								        \
+    set_context_reg(pScrn, (ib), (reg), (val));				\
+} while (0)
+
+/* scratch register the command stream stamps fences into */
+#define R6XX_FENCE_REG SCRATCH_REG7
+
 void R600CPFlushIndirect(ScrnInfoPtr pScrn, drmBufPtr ib);
 void R600IBDiscard(ScrnInfoPtr pScrn, drmBufPtr ib);
 
 uint64_t
 upload (ScrnInfoPtr pScrn, void *shader, int size, int offset);
+Bool
+set_context_reg(ScrnInfoPtr pScrn, drmBufPtr ib, uint32_t reg, uint32_t val);
+void
+invalidate_context_regs(ScrnInfoPtr pScrn);
 void
 wait_3d_idle_clean(ScrnInfoPtr pScrn, drmBufPtr ib);
 void
 wait_3d_idle(ScrnInfoPtr pScrn, drmBufPtr ib);
+uint32_t
+emit_fence(ScrnInfoPtr pScrn, drmBufPtr ib);
+Bool
+fence_passed(ScrnInfoPtr pScrn, uint32_t fence);
+void
+fence_wait(ScrnInfoPtr pScrn, uint32_t fence);
 void
 wait_vline_range(ScrnInfoPtr pScrn, drmBufPtr ib, int crtc, int start, int stop);
 void
@@ -258,6 +277,8 @@ set_render_target(ScrnInfoPtr pScrn, drmBufPtr ib, cb_config_t *cb_conf);
 void
 cp_set_surface_sync(ScrnInfoPtr pScrn, drmBufPtr ib, uint32_t sync_type, uint32_t size, uint64_t mc_addr);
 void
+cp_dma(ScrnInfoPtr pScrn, drmBufPtr ib, uint64_t dst_mc_addr, uint64_t src_mc_addr, uint32_t size, Bool sync);
+void
 fs_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *fs_conf);
 void
 vs_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *vs_conf);
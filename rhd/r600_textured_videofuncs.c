@@ -109,6 +109,8 @@ R600DoneTexturedVideo(ScrnInfoPtr pScrn)
     cp_set_surface_sync(pScrn, accel_state->ib, (CB_ACTION_ENA_bit | CB0_DEST_BASE_ENA_bit),
 			accel_state->dst_size, accel_state->dst_mc_addr);
 
+    emit_fence(pScrn, accel_state->ib);
+
     R600CPFlushIndirect(pScrn, accel_state->ib);
 }
 
@@ -150,7 +152,26 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
         255.0/219.0, -16.0/219.0, 255.0/224.0, -128.0/224.0,
     };
 
+    /* P010 samples are read as 16bit UNORM, with the 10 bits on top:
+     *  - Y' is scaled from 64:940
+     *  - Cb/Cr are scaled from 64:960
+     * Same structure as above */
+    static float ps_alu_consts_rec709_p010[] = {
+	1.0,  0.0,      1.5748,   0,  /* r - c[0] */
+	1.0, -0.18732, -0.46812,  0,  /* g - c[1] */
+	1.0,  1.8556,   0.0,      0,  /* b - c[2] */
+	65535.0/(64.0*876.0), -64.0/876.0, 65535.0/(64.0*896.0), -512.0/896.0,
+    };
+
+    static float ps_alu_consts_rec601_p010[] = {
+        1.0,  0.0,      1.4020,   0,  /* r - c[0] */
+        1.0, -0.34414, -0.71414,  0,  /* g - c[1] */
+        1.0,  1.7720,   0.0,      0,  /* b - c[2] */
+	65535.0/(64.0*876.0), -64.0/876.0, 65535.0/(64.0*896.0), -512.0/896.0,
+    };
+
     float *ps_alu_consts;
+    int cpp;
 
     /* Pick Y'CbCr color space to use
      * For video with _encoded_ width of 928 or above, choose Rec. 709. This should cover
@@ -161,9 +182,15 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
      * */
     if ((pPriv->color_space == RHD_XV_COLOR_SPACE_REC709) ||
         (pPriv->color_space == RHD_XV_COLOR_SPACE_AUTODETECT && pPriv->src_w >= 928)) {
-        ps_alu_consts = ps_alu_consts_rec709;
+        if (pPriv->id == FOURCC_P010)
+            ps_alu_consts = ps_alu_consts_rec709_p010;
+        else
+            ps_alu_consts = ps_alu_consts_rec709;
     } else {
-        ps_alu_consts = ps_alu_consts_rec601;
+        if (pPriv->id == FOURCC_P010)
+            ps_alu_consts = ps_alu_consts_rec601_p010;
+        else
+            ps_alu_consts = ps_alu_consts_rec601;
     }
 
     CLEAR (cb_conf);
@@ -189,6 +216,9 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     dstyoff = 0;
 #endif
 
+    /* EXA rectangles still pending have to land first */
+    R6xxEXAFlush(pScrn);
+
     accel_state->ib = RHDDRMCPBuffer(pScrn->scrnIndex);
 
     /* Init */
@@ -199,8 +229,8 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     set_default_state(pScrn, accel_state->ib);
 
     /* Scissor / viewport */
-    EREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
-    EREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
+    CREG(accel_state->ib, PA_CL_VTE_CNTL,                      VTX_XY_FMT_bit);
+    CREG(accel_state->ib, PA_CL_CLIP_CNTL,                     CLIP_DISABLE_bit);
 
     accel_state->vs_mc_addr = rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart + accel_state->shaders->offset +
 	accel_state->xv_vs_offset;
@@ -213,6 +243,9 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     case FOURCC_I420:
 	set_bool_consts(pScrn, accel_state->ib, SQ_BOOL_CONST_ps, (1 << 0));
 	break;
+    case FOURCC_NV12:
+    case FOURCC_P010:
+	/* a Y and a UV texture, just like the packed formats */
     case FOURCC_UYVY:
     case FOURCC_YUY2:
     default:
@@ -360,6 +393,81 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
 	tex_samp.id                 = 2;
 	set_tex_sampler             (pScrn, accel_state->ib, &tex_samp);
 	break;
+    case FOURCC_NV12:
+    case FOURCC_P010:
+	cpp = (pPriv->id == FOURCC_P010) ? 2 : 1;
+
+	accel_state->src_mc_addr[0] = pPriv->BufferOffset + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart;
+	accel_state->src_size[0] = accel_state->src_pitch[0] * pPriv->h;
+
+	/* flush texture cache */
+	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit, accel_state->src_size[0],
+			    accel_state->src_mc_addr[0]);
+
+	/* Y texture */
+	tex_res.id                  = 0;
+	tex_res.w                   = pPriv->w;
+	tex_res.h                   = pPriv->h;
+	tex_res.pitch               = accel_state->src_pitch[0] / cpp;
+	tex_res.depth               = 0;
+	tex_res.dim                 = SQ_TEX_DIM_2D;
+	tex_res.base                = accel_state->src_mc_addr[0];
+	tex_res.mip_base            = accel_state->src_mc_addr[0];
+
+	tex_res.format              = (cpp == 2) ? FMT_16 : FMT_8;
+	tex_res.dst_sel_x           = SQ_SEL_X; /* Y */
+	tex_res.dst_sel_y           = SQ_SEL_1;
+	tex_res.dst_sel_z           = SQ_SEL_1;
+	tex_res.dst_sel_w           = SQ_SEL_1;
+
+	tex_res.request_size        = 1;
+	tex_res.base_level          = 0;
+	tex_res.last_level          = 0;
+	tex_res.perf_modulation     = 0;
+	tex_res.interlaced          = 0;
+	set_tex_resource            (pScrn, accel_state->ib, &tex_res);
+
+	/* Y sampler */
+	tex_samp.id                 = 0;
+	tex_samp.clamp_x            = SQ_TEX_CLAMP_LAST_TEXEL;
+	tex_samp.clamp_y            = SQ_TEX_CLAMP_LAST_TEXEL;
+	tex_samp.clamp_z            = SQ_TEX_WRAP;
+
+	/* UV texture */
+	uv_offset = accel_state->src_pitch[0] * pPriv->h;
+	uv_offset = (uv_offset + 255) & ~255;
+
+	cp_set_surface_sync(pScrn, accel_state->ib, TC_ACTION_ENA_bit,
+			    accel_state->src_size[0] / 2,
+			    accel_state->src_mc_addr[0] + uv_offset);
+
+	tex_res.id                  = 1;
+	tex_res.format              = (cpp == 2) ? FMT_16_16 : FMT_8_8;
+	tex_res.w                   = pPriv->w >> 1;
+	tex_res.h                   = pPriv->h >> 1;
+	tex_res.pitch               = accel_state->src_pitch[0] / (2 * cpp);
+	tex_res.dst_sel_x           = SQ_SEL_X; /* U */
+	tex_res.dst_sel_y           = SQ_SEL_Y; /* V */
+	tex_res.dst_sel_z           = SQ_SEL_1;
+	tex_res.dst_sel_w           = SQ_SEL_1;
+	tex_res.interlaced          = 0;
+	/* XXX tex bases need to be 256B aligned */
+	tex_res.base                = accel_state->src_mc_addr[0] + uv_offset;
+	tex_res.mip_base            = accel_state->src_mc_addr[0] + uv_offset;
+	set_tex_resource            (pScrn, accel_state->ib, &tex_res);
+
+	/* xxx: switch to bicubic */
+	tex_samp.xy_mag_filter      = SQ_TEX_XY_FILTER_BILINEAR;
+	tex_samp.xy_min_filter      = SQ_TEX_XY_FILTER_BILINEAR;
+
+	tex_samp.z_filter           = SQ_TEX_Z_FILTER_NONE;
+	tex_samp.mip_filter         = 0;			/* no mipmap */
+	set_tex_sampler             (pScrn, accel_state->ib, &tex_samp);
+
+	/* UV sampler */
+	tex_samp.id                 = 1;
+	set_tex_sampler             (pScrn, accel_state->ib, &tex_samp);
+	break;
     case FOURCC_UYVY:
     case FOURCC_YUY2:
     default:
@@ -439,9 +547,9 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     }
 
     /* Render setup */
-    EREG(accel_state->ib, CB_SHADER_MASK,                      (0x0f << OUTPUT0_ENABLE_shift));
-    EREG(accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
-    EREG(accel_state->ib, CB_COLOR_CONTROL,                    (0xcc << ROP3_shift)); /* copy */
+    CREG(accel_state->ib, CB_SHADER_MASK,                      (0x0f << OUTPUT0_ENABLE_shift));
+    CREG(accel_state->ib, R7xx_CB_SHADER_CONTROL,              (RT0_ENABLE_bit));
+    CREG(accel_state->ib, CB_COLOR_CONTROL,                    (0xcc << ROP3_shift)); /* copy */
 
     cb_conf.id = 0;
 
@@ -450,6 +558,7 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     cb_conf.w = accel_state->dst_pitch;
     cb_conf.h = pPixmap->drawable.height;
     cb_conf.base = accel_state->dst_mc_addr;
+    cb_conf.array_mode = R600PixmapArrayMode(pScrn, pPixmap);
 
     switch (pPixmap->drawable.bitsPerPixel) {
     case 16:
@@ -473,25 +582,25 @@ R600DisplayTexturedVideo(ScrnInfoPtr pScrn, struct RHDPortPriv *pPriv)
     cb_conf.blend_clamp = 1;
     set_render_target(pScrn, accel_state->ib, &cb_conf);
 
-    EREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
+    CREG(accel_state->ib, PA_SU_SC_MODE_CNTL,                  (FACE_bit			|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_FRONT_PTYPE_shift)	|
 								(POLYMODE_PTYPE__TRIANGLES << POLYMODE_BACK_PTYPE_shift)));
-    EREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
+    CREG(accel_state->ib, DB_SHADER_CONTROL,                   ((1 << Z_ORDER_shift)		| /* EARLY_Z_THEN_LATE_Z */
 								DUAL_EXPORT_ENABLE_bit)); /* Only useful if no depth export */
 
     /* Interpolator setup */
     /* export tex coords from VS */
-    EREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
-    EREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_CONFIG, ((1 - 1) << VS_EXPORT_COUNT_shift));
+    CREG(accel_state->ib, SPI_VS_OUT_ID_0, (0 << SEMANTIC_0_shift));
 
     /* Enabling flat shading needs both FLAT_SHADE_bit in SPI_PS_INPUT_CNTL_x
      * *and* FLAT_SHADE_ENA_bit in SPI_INTERP_CONTROL_0 */
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 ((1 << NUM_INTERP_shift)));
-    EREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
-    EREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_0,                 ((1 << NUM_INTERP_shift)));
+    CREG(accel_state->ib, SPI_PS_IN_CONTROL_1,                 0);
+    CREG(accel_state->ib, SPI_PS_INPUT_CNTL_0 + (0 <<2),       ((0    << SEMANTIC_shift)	|
 								(0x03 << DEFAULT_VAL_shift)	|
 								SEL_CENTROID_bit));
-    EREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
+    CREG(accel_state->ib, SPI_INTERP_CONTROL_0,                0);
 
     if (exaGetPixmapOffset(pPixmap) == 0)
 	wait_vline_range(
@@ -68,9 +68,20 @@ void R600CPFlushIndirect(ScrnInfoPtr pScrn, drmBufPtr ib)
     int                start  = 0;
     drm_radeon_indirect_t  indirect;
     int drmFD = RHDDRMFDGet(pScrn->scrnIndex);
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
 
     if (!buffer) return;
 
+    if (accel_state) {
+	/* nothing may be appended to a packet that has been handed off */
+	accel_state->context_run_ib = NULL;
+	if (buffer->used) {
+	    accel_state->default_state_queued = FALSE;
+	    accel_state->ib_count++;
+	    accel_state->ib_dwords += buffer->used >> 2;
+	}
+    }
+
     while (buffer->used & 0x3c){
         E32(buffer, CP_PACKET2()); /* fill up to multiple of 16 dwords */
     }
@@ -87,12 +98,86 @@ void R600CPFlushIndirect(ScrnInfoPtr pScrn, drmBufPtr ib)
 
 void R600IBDiscard(ScrnInfoPtr pScrn, drmBufPtr ib)
 {
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
     if (!ib) return;
 
+    /* none of this reaches the hardware, so neither does the state in it */
+    if (accel_state && ib->used) {
+	if (accel_state->default_state_queued)
+	    accel_state->XHas3DEngineState = FALSE;
+	invalidate_context_regs(pScrn);
+    }
+
     ib->used = 0;
     R600CPFlushIndirect(pScrn, ib);
 }
 
+/*
+ * Context registers go through a shadow of what was last put in the command
+ * stream: unchanged values are dropped, and a register following the one
+ * written last extends that SET_CONTEXT_REG packet instead of starting a
+ * new one. Everything else is handed straight to EREG.
+ * Returns whether anything was emitted.
+ */
+Bool
+set_context_reg(ScrnInfoPtr pScrn, drmBufPtr ib, uint32_t reg, uint32_t val)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+    uint32_t *ib_head = (pointer)(char*)ib->address;
+    uint32_t header, num;
+    int index;
+
+    if ((reg < SET_CONTEXT_REG_offset) || (reg >= SET_CONTEXT_REG_end)) {
+	EREG(ib, reg, val);
+	return TRUE;
+    }
+
+    index = (reg - SET_CONTEXT_REG_offset) >> 2;
+    accel_state->context_reg_writes++;
+
+    if ((accel_state->context_reg_valid[index >> 5] & (1 << (index & 31))) &&
+	(accel_state->context_reg[index] == val)) {
+	accel_state->context_reg_skipped++;
+	return FALSE;
+    }
+
+    accel_state->context_reg[index] = val;
+    accel_state->context_reg_valid[index >> 5] |= 1 << (index & 31);
+
+    /* still the last packet in this ib? */
+    if ((accel_state->context_run_ib == ib) && (accel_state->context_run_next == reg)) {
+	header = ib_head[accel_state->context_run_header];
+	num = ((header >> 16) & 0x3fff) + 1;
+
+	if (ib->used == ((accel_state->context_run_header + 1 + num) << 2)) {
+	    ib_head[accel_state->context_run_header] = header + (1 << 16);
+	    E32(ib, val);
+	    accel_state->context_run_next += 4;
+	    return TRUE;
+	}
+    }
+
+    accel_state->context_run_ib = ib;
+    accel_state->context_run_header = ib->used >> 2;
+    accel_state->context_run_next = reg + 4;
+    EREG(ib, reg, val);
+
+    return TRUE;
+}
+
+/*
+ * For when the hardware no longer holds what the shadow says it does.
+ */
+void
+invalidate_context_regs(ScrnInfoPtr pScrn)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    memset(accel_state->context_reg_valid, 0, sizeof(accel_state->context_reg_valid));
+    accel_state->context_run_ib = NULL;
+}
+
 void
 wait_3d_idle_clean(ScrnInfoPtr pScrn, drmBufPtr ib)
 {
@@ -304,6 +389,7 @@ set_render_target(ScrnInfoPtr pScrn, drmBufPtr ib, cb_config_t *cb_conf)
 {
     uint32_t cb_color_info;
     int pitch, slice, h;
+    Bool base_changed;
     RHDPtr rhdPtr = RHDPTR(pScrn);
 
     cb_color_info = ((cb_conf->endian      << ENDIAN_shift)				|
@@ -335,24 +421,26 @@ set_render_target(ScrnInfoPtr pScrn, drmBufPtr ib, cb_config_t *cb_conf)
     h = (cb_conf->h + 7) & ~7;
     slice = ((cb_conf->w * h) / 64) - 1;
 
-    EREG(ib, (CB_COLOR0_BASE + (4 * cb_conf->id)), (cb_conf->base >> 8));
+    base_changed = set_context_reg(pScrn, ib, (CB_COLOR0_BASE + (4 * cb_conf->id)),
+				   (cb_conf->base >> 8));
 
     /* rv6xx workaround */
-    if ((rhdPtr->ChipSet > RHD_R600) &&
+    if (base_changed &&
+	(rhdPtr->ChipSet > RHD_R600) &&
 	(rhdPtr->ChipSet < RHD_RV770)) {
 	PACK3(ib, IT_SURFACE_BASE_UPDATE, 1);
 	E32(ib, (2 << cb_conf->id));
     }
 
     /* pitch only for ARRAY_LINEAR_GENERAL, other tiling modes require addrlib */
-    EREG(ib, (CB_COLOR0_SIZE + (4 * cb_conf->id)), ((pitch << PITCH_TILE_MAX_shift)	|
+    CREG(ib, (CB_COLOR0_SIZE + (4 * cb_conf->id)), ((pitch << PITCH_TILE_MAX_shift)	|
 						    (slice << SLICE_TILE_MAX_shift)));
-    EREG(ib, (CB_COLOR0_VIEW + (4 * cb_conf->id)), ((0    << SLICE_START_shift)		|
+    CREG(ib, (CB_COLOR0_VIEW + (4 * cb_conf->id)), ((0    << SLICE_START_shift)		|
 						    (0    << SLICE_MAX_shift)));
-    EREG(ib, (CB_COLOR0_INFO + (4 * cb_conf->id)), cb_color_info);
-    EREG(ib, (CB_COLOR0_TILE + (4 * cb_conf->id)), (0     >> 8));	/* CMASK per-tile data base/256 */
-    EREG(ib, (CB_COLOR0_FRAG + (4 * cb_conf->id)), (0     >> 8));	/* FMASK per-tile data base/256 */
-    EREG(ib, (CB_COLOR0_MASK + (4 * cb_conf->id)), ((0    << CMASK_BLOCK_MAX_shift)	|
+    CREG(ib, (CB_COLOR0_INFO + (4 * cb_conf->id)), cb_color_info);
+    CREG(ib, (CB_COLOR0_TILE + (4 * cb_conf->id)), (0     >> 8));	/* CMASK per-tile data base/256 */
+    CREG(ib, (CB_COLOR0_FRAG + (4 * cb_conf->id)), (0     >> 8));	/* FMASK per-tile data base/256 */
+    CREG(ib, (CB_COLOR0_MASK + (4 * cb_conf->id)), ((0    << CMASK_BLOCK_MAX_shift)	|
 						    (0    << FMASK_TILE_MAX_shift)));
 }
 
@@ -372,6 +460,22 @@ cp_set_surface_sync(ScrnInfoPtr pScrn, drmBufPtr ib, uint32_t sync_type, uint32_
     E32(ib, 10); /* poll interval */
 }
 
+/*
+ * memory to memory copy done by the CP itself, no 3D state involved.
+ * size has to be dword aligned and at most CP_DMA_BYTE_COUNT_max; with sync
+ * the CP does not fetch the next packet before the copy has landed.
+ */
+void
+cp_dma(ScrnInfoPtr pScrn, drmBufPtr ib, uint64_t dst_mc_addr, uint64_t src_mc_addr, uint32_t size, Bool sync)
+{
+    PACK3(ib, IT_CP_DMA, 5);
+    E32(ib, (src_mc_addr & 0xffffffff));
+    E32(ib, ((src_mc_addr >> 32) & 0xff) | (sync ? CP_DMA_CP_SYNC : 0));
+    E32(ib, (dst_mc_addr & 0xffffffff));
+    E32(ib, ((dst_mc_addr >> 32) & 0xff));
+    E32(ib, size);
+}
+
 void
 fs_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *fs_conf)
 {
@@ -383,9 +487,9 @@ fs_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *fs_conf)
     if (fs_conf->dx10_clamp)
 	sq_pgm_resources |= SQ_PGM_RESOURCES_FS__DX10_CLAMP_bit;
 
-    EREG(ib, SQ_PGM_START_FS, fs_conf->shader_addr >> 8);
-    EREG(ib, SQ_PGM_RESOURCES_FS, sq_pgm_resources);
-    EREG(ib, SQ_PGM_CF_OFFSET_FS, 0);
+    CREG(ib, SQ_PGM_START_FS, fs_conf->shader_addr >> 8);
+    CREG(ib, SQ_PGM_RESOURCES_FS, sq_pgm_resources);
+    CREG(ib, SQ_PGM_CF_OFFSET_FS, 0);
 }
 
 void
@@ -403,9 +507,9 @@ vs_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *vs_conf)
     if (vs_conf->uncached_first_inst)
 	sq_pgm_resources |= UNCACHED_FIRST_INST_bit;
 
-    EREG(ib, SQ_PGM_START_VS, vs_conf->shader_addr >> 8);
-    EREG(ib, SQ_PGM_RESOURCES_VS, sq_pgm_resources);
-    EREG(ib, SQ_PGM_CF_OFFSET_VS, 0);
+    CREG(ib, SQ_PGM_START_VS, vs_conf->shader_addr >> 8);
+    CREG(ib, SQ_PGM_RESOURCES_VS, sq_pgm_resources);
+    CREG(ib, SQ_PGM_CF_OFFSET_VS, 0);
 }
 
 void
@@ -425,10 +529,10 @@ ps_setup(ScrnInfoPtr pScrn, drmBufPtr ib, shader_config_t *ps_conf)
     if (ps_conf->clamp_consts)
 	sq_pgm_resources |= CLAMP_CONSTS_bit;
 
-    EREG(ib, SQ_PGM_START_PS, ps_conf->shader_addr >> 8);
-    EREG(ib, SQ_PGM_RESOURCES_PS, sq_pgm_resources);
-    EREG(ib, SQ_PGM_EXPORTS_PS, ps_conf->export_mode);
-    EREG(ib, SQ_PGM_CF_OFFSET_PS, 0);
+    CREG(ib, SQ_PGM_START_PS, ps_conf->shader_addr >> 8);
+    CREG(ib, SQ_PGM_RESOURCES_PS, sq_pgm_resources);
+    CREG(ib, SQ_PGM_EXPORTS_PS, ps_conf->export_mode);
+    CREG(ib, SQ_PGM_CF_OFFSET_PS, 0);
 }
 
 void
@@ -595,20 +699,20 @@ void
 set_screen_scissor(ScrnInfoPtr pScrn, drmBufPtr ib, int x1, int y1, int x2, int y2)
 {
 
-    EREG(ib, PA_SC_SCREEN_SCISSOR_TL,              ((x1 << PA_SC_SCREEN_SCISSOR_TL__TL_X_shift) |
+    CREG(ib, PA_SC_SCREEN_SCISSOR_TL,              ((x1 << PA_SC_SCREEN_SCISSOR_TL__TL_X_shift) |
 						    (y1 << PA_SC_SCREEN_SCISSOR_TL__TL_Y_shift)));
-    EREG(ib, PA_SC_SCREEN_SCISSOR_BR,              ((x2 << PA_SC_SCREEN_SCISSOR_BR__BR_X_shift) |
+    CREG(ib, PA_SC_SCREEN_SCISSOR_BR,              ((x2 << PA_SC_SCREEN_SCISSOR_BR__BR_X_shift) |
 						    (y2 << PA_SC_SCREEN_SCISSOR_BR__BR_Y_shift)));
 }
 
 void
 set_vport_scissor(ScrnInfoPtr pScrn, drmBufPtr ib, int id, int x1, int y1, int x2, int y2)
 {
-    EREG(ib, PA_SC_VPORT_SCISSOR_0_TL +
+    CREG(ib, PA_SC_VPORT_SCISSOR_0_TL +
 	 id * PA_SC_VPORT_SCISSOR_0_TL_offset, ((x1 << PA_SC_VPORT_SCISSOR_0_TL__TL_X_shift) |
 						(y1 << PA_SC_VPORT_SCISSOR_0_TL__TL_Y_shift) |
 						WINDOW_OFFSET_DISABLE_bit));
-    EREG(ib, PA_SC_VPORT_SCISSOR_0_BR +
+    CREG(ib, PA_SC_VPORT_SCISSOR_0_BR +
 	 id * PA_SC_VPORT_SCISSOR_0_BR_offset, ((x2 << PA_SC_VPORT_SCISSOR_0_BR__BR_X_shift) |
 						(y2 << PA_SC_VPORT_SCISSOR_0_BR__BR_Y_shift)));
 }
@@ -616,30 +720,30 @@ set_vport_scissor(ScrnInfoPtr pScrn, drmBufPtr ib, int id, int x1, int y1, int x
 void
 set_generic_scissor(ScrnInfoPtr pScrn, drmBufPtr ib, int x1, int y1, int x2, int y2)
 {
-    EREG(ib, PA_SC_GENERIC_SCISSOR_TL,            ((x1 << PA_SC_GENERIC_SCISSOR_TL__TL_X_shift) |
+    CREG(ib, PA_SC_GENERIC_SCISSOR_TL,            ((x1 << PA_SC_GENERIC_SCISSOR_TL__TL_X_shift) |
 						   (y1 << PA_SC_GENERIC_SCISSOR_TL__TL_Y_shift) |
 						   WINDOW_OFFSET_DISABLE_bit));
-    EREG(ib, PA_SC_GENERIC_SCISSOR_BR,            ((x2 << PA_SC_GENERIC_SCISSOR_BR__BR_X_shift) |
+    CREG(ib, PA_SC_GENERIC_SCISSOR_BR,            ((x2 << PA_SC_GENERIC_SCISSOR_BR__BR_X_shift) |
 						   (y2 << PA_SC_GENERIC_SCISSOR_TL__TL_Y_shift)));
 }
 
 void
 set_window_scissor(ScrnInfoPtr pScrn, drmBufPtr ib, int x1, int y1, int x2, int y2)
 {
-    EREG(ib, PA_SC_WINDOW_SCISSOR_TL,             ((x1 << PA_SC_WINDOW_SCISSOR_TL__TL_X_shift) |
+    CREG(ib, PA_SC_WINDOW_SCISSOR_TL,             ((x1 << PA_SC_WINDOW_SCISSOR_TL__TL_X_shift) |
 						   (y1 << PA_SC_WINDOW_SCISSOR_TL__TL_Y_shift) |
 						   WINDOW_OFFSET_DISABLE_bit));
-    EREG(ib, PA_SC_WINDOW_SCISSOR_BR,             ((x2 << PA_SC_WINDOW_SCISSOR_BR__BR_X_shift) |
+    CREG(ib, PA_SC_WINDOW_SCISSOR_BR,             ((x2 << PA_SC_WINDOW_SCISSOR_BR__BR_X_shift) |
 						   (y2 << PA_SC_WINDOW_SCISSOR_BR__BR_Y_shift)));
 }
 
 void
 set_clip_rect(ScrnInfoPtr pScrn, drmBufPtr ib, int id, int x1, int y1, int x2, int y2)
 {
-    EREG(ib, PA_SC_CLIPRECT_0_TL +
+    CREG(ib, PA_SC_CLIPRECT_0_TL +
 	 id * PA_SC_CLIPRECT_0_TL_offset,     ((x1 << PA_SC_CLIPRECT_0_TL__TL_X_shift) |
 					       (y1 << PA_SC_CLIPRECT_0_TL__TL_Y_shift)));
-    EREG(ib, PA_SC_CLIPRECT_0_BR +
+    CREG(ib, PA_SC_CLIPRECT_0_BR +
 	 id * PA_SC_CLIPRECT_0_BR_offset,     ((x2 << PA_SC_CLIPRECT_0_BR__BR_X_shift) |
 					       (y2 << PA_SC_CLIPRECT_0_BR__BR_Y_shift)));
 }
@@ -668,6 +772,10 @@ set_default_state(ScrnInfoPtr pScrn, drmBufPtr ib)
 #endif
 
     accel_state->XHas3DEngineState = TRUE;
+    accel_state->default_state_queued = TRUE;
+
+    /* the defaults below bypass the shadow */
+    invalidate_context_regs(pScrn);
 
     wait_3d_idle(pScrn, ib);
 
@@ -1200,3 +1308,41 @@ R6xxIdle(ScrnInfoPtr pScrn)
     if (!R6xxIdleLocal(pScrn->scrnIndex))
 	R6xxEngineReset(pScrn);
 }
+
+/*
+ * Fences. The stream writes an increasing count to a scratch register; once
+ * the register has caught up with a fence, everything queued before it has
+ * been carried out. This only holds for work the stream waited for (e.g.
+ * wait_3d_idle_clean()) before the fence.
+ */
+uint32_t
+emit_fence(ScrnInfoPtr pScrn, drmBufPtr ib)
+{
+    struct r6xx_accel_state *accel_state = RHDPTR(pScrn)->TwoDPrivate;
+
+    accel_state->fence_last++;
+    EREG(ib, R6XX_FENCE_REG, accel_state->fence_last);
+
+    return accel_state->fence_last;
+}
+
+Bool
+fence_passed(ScrnInfoPtr pScrn, uint32_t fence)
+{
+    /* wraps around */
+    return ((int32_t) (RHDRegRead(pScrn, R6XX_FENCE_REG) - fence)) >= 0;
+}
+
+void
+fence_wait(ScrnInfoPtr pScrn, uint32_t fence)
+{
+    int i;
+
+    for (i = 0; i < R6XX_LOOP_COUNT; i++)
+	if (fence_passed(pScrn, fence))
+	    return;
+
+    LOG("%s: Timeout on fence %u, at %u.\n", __func__, (unsigned int) fence,
+	(unsigned int) RHDRegRead(pScrn, R6XX_FENCE_REG));
+    R6xxIdle(pScrn);
+}
@@ -3,15 +3,20 @@
 
 #include "xf86drm.h"
 
+#include "rhd_tiling.h"
+
 /* seriously ?! @#$%% */
 # define uint32_t CARD32
 # define uint64_t CARD64
 
 /* r600_exa.c */
 Bool R6xxEXAInit(ScrnInfoPtr pScrn, ScreenPtr pScreen);
+uint32_t R600PixmapArrayMode(ScrnInfoPtr pScrn, PixmapPtr pPix);
 void R6xxEXACloseScreen(ScreenPtr pScreen);
 void R6xxEXADestroy(ScrnInfoPtr pScrn);
 
+void R6xxEXAFlush(ScrnInfoPtr pScrn);
+
 void R6xxCacheFlush(struct RhdCS *CS);
 void R6xxEngineWaitIdleFull(struct RhdCS *CS);
 
@@ -28,8 +33,119 @@ R6xxIdle(ScrnInfoPtr pScrn);
 Bool
 R600LoadShaders(ScrnInfoPtr pScrn);
 
+enum r6xx_batch_op {
+    R6XX_BATCH_NONE = 0,
+    R6XX_BATCH_SOLID,
+    R6XX_BATCH_COPY,
+    R6XX_BATCH_COMPOSITE
+};
+
+/* everything a Prepare turns into state; memset before filling in */
+struct r6xx_batch_key {
+    enum r6xx_batch_op op;
+    uint64_t          dst_mc_addr;
+    uint32_t          dst_pitch;
+    uint32_t          dst_height;
+    uint32_t          dst_format;
+    uint32_t          dst_size;
+    uint64_t          src_mc_addr[2];
+    uint32_t          src_pitch[2];
+    uint32_t          src_width[2];
+    uint32_t          src_height[2];
+    uint32_t          src_format[2];
+    uint32_t          src_flags[2]; /* repeat, filter, component alpha */
+    uint32_t          src_array_mode[2];
+    uint32_t          dst_array_mode;
+    uint32_t          alu;          /* rop or render op */
+    uint32_t          planemask;
+    uint32_t          fg;
+};
+
+/* one for each combination of the R600_COMP_ bits in r600_shader.h */
+#define R6XX_COMP_VARIANTS 2
+
+/* how a picture transform maps destination onto texture coordinates */
+enum r6xx_comp_xform {
+    R6XX_XFORM_NONE = 0,
+    R6XX_XFORM_TRANSLATE,
+    R6XX_XFORM_GENERAL
+};
+
+#define R6XX_COMP_CLASS_CA		(1 << 0) /* component alpha mask */
+#define R6XX_COMP_CLASS_SRC_CLAMPED	(1 << 1) /* transformed and REPEAT_NONE */
+#define R6XX_COMP_CLASS_MASK_CLAMPED	(1 << 2)
+
+/* composite state that only depends on the op and the formats involved */
+struct r6xx_comp_class {
+    /* key */
+    Bool              valid;
+    int               op;
+    uint32_t          src_format;
+    uint32_t          mask_format; /* 0 without a mask */
+    uint32_t          dst_format;
+    uint32_t          flags;       /* R6XX_COMP_CLASS_ bits */
+    /* verdict and the state derived from it */
+    Bool              supported;
+    uint32_t          blend_cntl;
+    uint32_t          cb_format;
+    int               cb_comp_swap;
+    uint32_t          tex_format[2];
+    int               tex_sel[2][4];  /* r, g, b, a */
+};
+
+/* direct mapped, see R600ClassifyComposite() */
+#define R6XX_COMP_CLASS_NUM 64
+
+struct rhdAtlas;
+
+/* A8 and a8r8g8b8, see R600GlyphAtlas() */
+#define R6XX_GLYPH_ATLASES 2
+
+struct r6xx_glyph_atlas {
+    struct rhdAtlas   *atlas;
+    ExaOffscreenArea  *area;
+    uint32_t          format;      /* PICT_ */
+    int               cpp;
+    uint32_t          pitch;       /* bytes */
+    uint64_t          mc_addr;
+};
+
+/* pixmaps kept ARRAY_1D_TILED_THIN1, see R600TiledSurface() */
+#define R6XX_TILED_SURFACES 32
+
+struct r6xx_tiled_surface {
+    PixmapPtr         pPix;        /* NULL when the slot is free */
+    unsigned long     serial;
+    uint64_t          mc_addr;
+    struct rhdSurfaceLayout layout;
+    /* linear copy handed out by PrepareAccess */
+    char              *shadow;
+    int               access;      /* PrepareAccess nesting */
+    Bool              dirty;       /* shadow mapped for writing */
+};
+
+/* SET_CONTEXT_REG space, 0x28000 - 0x29000 */
+#define R6XX_CONTEXT_REG_NUM 1024
+
 struct r6xx_accel_state {
     Bool XHas3DEngineState;
+    Bool default_state_queued; /* not yet flushed to the hardware */
+
+    /* context registers as last written through set_context_reg() */
+    uint32_t          context_reg[R6XX_CONTEXT_REG_NUM];
+    uint32_t          context_reg_valid[R6XX_CONTEXT_REG_NUM / 32];
+    /* SET_CONTEXT_REG packet that new registers can be appended to */
+    drmBufPtr         context_run_ib;
+    uint32_t          context_run_header; /* dword index */
+    uint32_t          context_run_next;
+
+    /* statistics */
+    uint32_t          context_reg_writes;
+    uint32_t          context_reg_skipped;
+    uint32_t          ib_count;
+    uint32_t          ib_dwords;
+    uint32_t          batch_rects;
+    uint32_t          batch_continued;
 
     int               exaSyncMarker;
     int               exaMarkerSynced;
@@ -37,15 +153,54 @@ struct r6xx_accel_state {
     drmBufPtr         ib;
     int               vb_index;
 
+    /* operations collected in ib, see R600BatchContinue() */
+    struct r6xx_batch_key batch_key;
+    uint32_t          vb_start;    /* byte offset of the vertices in ib */
+    int               vtx_size;    /* bytes per vertex */
+    ScreenBlockHandlerProcPtr BlockHandler;
+    DestroyPixmapProcPtr DestroyPixmap;
+
+    /* last value handed to emit_fence() */
+    uint32_t          fence_last;
+
+    /* CP DMA fast path, see R600DmaRows(); thresholds in bytes */
+    Bool              dma_ok;      /* the pending operation qualifies */
+    uint32_t          dma_fill;    /* fill value repeated over a dword */
+    uint64_t          dma_dst_mc_addr;
+    uint32_t          dma_dst_pitch;
+    uint64_t          dma_src_mc_addr;
+    uint32_t          dma_src_pitch;
+    int               dma_cpp;
+    uint32_t          dma_fill_min;
+    uint32_t          dma_copy_min;
+    uint32_t          dma_row_min;
+    uint32_t          dma_rects;
+    uint32_t          dma_bytes;
+
+    /* composite classification cache */
+    struct r6xx_comp_class comp_class[R6XX_COMP_CLASS_NUM];
+    uint32_t          comp_class_hits;
+    uint32_t          comp_class_misses;
+
+    struct r6xx_glyph_atlas glyph_atlas[R6XX_GLYPH_ATLASES];
+    uint32_t          glyph_uploads;
+
+    struct rhdTilingConfig tiling;
+    struct r6xx_tiled_surface tiled[R6XX_TILED_SURFACES];
+    uint32_t          tiled_min;   /* bytes, 0 turns tiling off */
+    uint32_t          tiled_uploads;
+    uint32_t          tiled_accesses;
+
     /* shader storage */
     ExaOffscreenArea  *shaders;
     uint32_t          solid_vs_offset;
     uint32_t          solid_ps_offset;
     uint32_t          copy_vs_offset;
     uint32_t          copy_ps_offset;
-    uint32_t          comp_vs_offset;
-    uint32_t          comp_ps_offset;
-    uint32_t          comp_mask_ps_offset;
+    /* per variant, built on first use; 0 if not yet */
+    uint32_t          comp_vs_offset[R6XX_COMP_VARIANTS];
+    uint32_t          comp_ps_offset[R6XX_COMP_VARIANTS];
+    uint32_t          shaders_used;
     uint32_t          xv_vs_offset;
     uint32_t          xv_ps_offset;
 
@@ -56,11 +211,13 @@ struct r6xx_accel_state {
     uint32_t          src_width[2];
     uint32_t          src_height[2];
     uint32_t          src_bpp[2];
+    uint32_t          src_array_mode[2];
     uint32_t          dst_size;
     uint64_t          dst_mc_addr;
     uint32_t          dst_pitch;
     uint32_t          dst_height;
     uint32_t          dst_bpp;
+    uint32_t          dst_array_mode;
     uint32_t          vs_size;
     uint64_t          vs_mc_addr;
     uint32_t          ps_size;
@@ -80,8 +237,13 @@ struct r6xx_accel_state {
     /*comp */
     unsigned short texW[2];
     unsigned short texH[2];
+    float tex_rcp_w[2];
+    float tex_rcp_h[2];
     Bool is_transform[2];
     struct pixman_transform *transform[2];
+    enum r6xx_comp_xform xform[2];
+    float xform_tx[2];      /* offset for R6XX_XFORM_TRANSLATE */
+    float xform_ty[2];
     Bool has_mask;
     Bool component_alpha;
     Bool src_alpha;
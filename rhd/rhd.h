@@ -199,6 +199,8 @@ typedef struct RHDRec {
 #define RHD_FB_ALIGNMENT 0x1000
     /* Use this macro to always chew up 4096byte aligned pieces. */
 #define RHD_FB_CHUNK(x)     ALIGN((x), RHD_FB_ALIGNMENT)
+    struct rhdFbHeap   *FbHeap;
+    /* largest range not held by fixed allocations, kept in sync by RHDAllocFb */
     unsigned int        FbFreeStart;
     unsigned int        FbFreeSize;
 
@@ -228,6 +230,8 @@ typedef struct RHDRec {
     struct rhdMC       *MC;  /* Memory Controller */
     struct rhdVGA      *VGA; /* VGA compatibility HW */
     struct rhdCrtc     *Crtc[2];
+    struct rhdVBlank   *VBlank;
+    struct rhdFlip     *Flip[2]; /* NULL unless flipping */
     struct rhdPLL      *PLLs[2]; /* Pixelclock PLLs */
     //struct rhdAudio    *Audio;
 
@@ -255,6 +259,8 @@ typedef struct RHDRec {
 
     struct rhdPm       *Pm;
 
+    struct rhdModeCache *ModeCache; /* mode validation verdicts */
+
     struct rhdOutput *DigEncoderOutput[2];
 # define RHD_CHECKDEBUGFLAG(rhdPtr, FLAG) (rhdPtr->DebugFlags & (1 << FLAG))
 #ifndef NO_ASSERT
@@ -300,7 +306,6 @@ struct rhdPowerState {
 /* rhd_driver.c */
 /* Some handy functions that makes life so much more readable */
 extern Bool isDisplayEnabled(RHDPtr rhdPtr, UInt8 index);
-extern void WaitForVBL(RHDPtr rhdPtr, UInt8 index, Bool disable);
 extern unsigned int RHDReadPCIBios(RHDPtr rhdPtr, unsigned char **prt);
 extern void RHDPrepareMode(RHDPtr rhdPtr);
 extern Bool RHDUseAtom(RHDPtr rhdPtr, enum RHD_CHIPSETS *BlackList, enum atomSubSystem subsys);
@@ -330,6 +335,10 @@ extern CARD32 _RHDReadPLL(int scrnIndex, CARD16 offset);
 extern void _RHDWritePLL(int scrnIndex, CARD16 offset, CARD32 data);
 #define RHDWritePLL(ptr, off, value) _RHDWritePLL((ptr)->scrnIndex,(off),(value))
 extern unsigned int RHDAllocFb(RHDPtr rhdPtr, unsigned int size, const char *name);
+extern unsigned int RHDAllocFbPlaced(RHDPtr rhdPtr, unsigned int size, unsigned int align,
+				     int placement, unsigned int flags, int usage,
+				     const char *name);
+extern void RHDFreeFb(RHDPtr rhdPtr, unsigned int offset);
 
 /* rhd_id.c */
 Bool RHDIsIGP(enum RHD_CHIPSETS chipset);
@@ -0,0 +1,445 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The atlas is cut into horizontal bands. Each band is packed bottom-left
+ * against its own skyline: the list of segments giving, for every column,
+ * the lowest row that is still free. A skyline cannot give back single
+ * rectangles, so space is reclaimed a band at a time: once nothing fits
+ * anymore, the band that was used least recently is emptied.
+ *
+ * Entries are found through a hash of their key, and also hang off their
+ * band, so that a band can be emptied without walking the whole table.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_atlas.h"
+
+struct rhdAtlasEntry {
+    struct rhdAtlasEntry *HashNext;
+    struct rhdAtlasEntry *BandNext;
+
+    CARD32 Key;
+    struct rhdAtlasRect Rect;
+    int Band;
+};
+
+/* Y is relative to the top of the band */
+struct rhdAtlasSegment {
+    CARD16 X;
+    CARD16 Y;
+    CARD16 Width;
+};
+
+struct rhdAtlasBand {
+    struct rhdAtlasSegment *Skyline;
+    int NumSegments;
+
+    struct rhdAtlasEntry *Entries;
+    CARD32 LastUse;
+};
+
+struct rhdAtlas {
+    int Width;
+    int Height;
+    int BandHeight;
+    int Alignment;	/* of X and Width, in texels */
+
+    int NumBands;
+    struct rhdAtlasBand *Bands;
+    struct rhdAtlasSegment *Segments;
+    int MaxSegments;	/* per band */
+
+    struct rhdAtlasEntry *Hash[RHD_ATLAS_HASH_SIZE];
+    struct rhdAtlasEntry *Pool;
+    int PoolSize;
+    struct rhdAtlasEntry *Free;
+
+    CARD32 Clock;
+    struct rhdAtlasStats Stats;
+};
+
+#define RHD_ATLAS_HASH(Key)	(((Key) * 2654435761U) >> 24)
+
+/*
+ *
+ */
+static void
+rhdAtlasBandClear(struct rhdAtlas *Atlas, int Band)
+{
+    struct rhdAtlasBand *B = &Atlas->Bands[Band];
+
+    B->Skyline[0].X = 0;
+    B->Skyline[0].Y = 0;
+    B->Skyline[0].Width = Atlas->Width;
+    B->NumSegments = 1;
+    B->Entries = NULL;
+    B->LastUse = 0;
+}
+
+/*
+ *
+ */
+static void
+rhdAtlasHashUnlink(struct rhdAtlas *Atlas, struct rhdAtlasEntry *Entry)
+{
+    struct rhdAtlasEntry **Link = &Atlas->Hash[RHD_ATLAS_HASH(Entry->Key)];
+
+    for (; *Link; Link = &(*Link)->HashNext)
+	if (*Link == Entry) {
+	    *Link = Entry->HashNext;
+	    return;
+	}
+}
+
+/*
+ * Drops every entry in the band and starts its skyline over.
+ */
+static void
+rhdAtlasBandEvict(struct rhdAtlas *Atlas, int Band)
+{
+    struct rhdAtlasEntry *Entry, *Next;
+
+    for (Entry = Atlas->Bands[Band].Entries; Entry; Entry = Next) {
+	Next = Entry->BandNext;
+
+	rhdAtlasHashUnlink(Atlas, Entry);
+	Entry->HashNext = Atlas->Free;
+	Atlas->Free = Entry;
+	Atlas->Stats.Entries--;
+    }
+
+    rhdAtlasBandClear(Atlas, Band);
+}
+
+/*
+ * Least recently used band that has anything to give back.
+ */
+static int
+rhdAtlasBandLRU(struct rhdAtlas *Atlas)
+{
+    int i, Band = -1;
+
+    for (i = 0; i < Atlas->NumBands; i++) {
+	if (!Atlas->Bands[i].Entries)
+	    continue;
+	if ((Band < 0) || (Atlas->Bands[i].LastUse < Atlas->Bands[Band].LastUse))
+	    Band = i;
+    }
+
+    return (Band < 0) ? 0 : Band;
+}
+
+/*
+ * Lowest spot in the band for a Width x Height rectangle. Returns the
+ * skyline segment it starts at, or -1 if it does not fit.
+ */
+static int
+rhdAtlasBandFit(struct rhdAtlas *Atlas, int Band, int Width, int Height,
+		int *Y)
+{
+    struct rhdAtlasBand *B = &Atlas->Bands[Band];
+    int i, j, Best = -1, BestY = 0;
+
+    for (i = 0; i < B->NumSegments; i++) {
+	int X = B->Skyline[i].X, Top = 0, Left = Width;
+
+	if ((X + Width) > Atlas->Width)
+	    break;
+
+	/* the rectangle rests on the highest segment it spans */
+	for (j = i; Left > 0; j++) {
+	    if (B->Skyline[j].Y > Top)
+		Top = B->Skyline[j].Y;
+	    Left -= B->Skyline[j].Width;
+	}
+
+	if ((Top + Height) > Atlas->BandHeight)
+	    continue;
+
+	if ((Best < 0) || (Top < BestY)) {
+	    Best = i;
+	    BestY = Top;
+	}
+    }
+
+    *Y = BestY;
+    return Best;
+}
+
+/*
+ * Raises the skyline over a rectangle placed at segment Index.
+ */
+static void
+rhdAtlasBandPlace(struct rhdAtlas *Atlas, int Band, int Index, int Width,
+		  int Bottom)
+{
+    struct rhdAtlasBand *B = &Atlas->Bands[Band];
+    struct rhdAtlasSegment *S = B->Skyline;
+    int X = S[Index].X, End = X + Width, i;
+
+    /* make room for the new segment */
+    for (i = B->NumSegments; i > Index; i--)
+	S[i] = S[i - 1];
+    B->NumSegments++;
+
+    S[Index].X = X;
+    S[Index].Y = Bottom;
+    S[Index].Width = Width;
+
+    /* drop or shorten what it covers */
+    i = Index + 1;
+    while (i < B->NumSegments && S[i].X < End) {
+	if ((S[i].X + S[i].Width) <= End) {
+	    int j;
+
+	    for (j = i; j < (B->NumSegments - 1); j++)
+		S[j] = S[j + 1];
+	    B->NumSegments--;
+	} else {
+	    S[i].Width -= End - S[i].X;
+	    S[i].X = End;
+	    break;
+	}
+    }
+
+    /* merge neighbours of the same height */
+    for (i = 0; i < (B->NumSegments - 1); ) {
+	if (S[i].Y == S[i + 1].Y) {
+	    int j;
+
+	    S[i].Width += S[i + 1].Width;
+	    for (j = i + 1; j < (B->NumSegments - 1); j++)
+		S[j] = S[j + 1];
+	    B->NumSegments--;
+	} else
+	    i++;
+    }
+}
+
+/*
+ *
+ */
+struct rhdAtlas *
+RHDAtlasCreate(int Width, int Height, int BandHeight, int Alignment)
+{
+    struct rhdAtlas *Atlas;
+    int i;
+
+    if ((Width <= 0) || (BandHeight <= 0) || (Height < BandHeight) ||
+	(Alignment <= 0) || (Width % Alignment))
+	return NULL;
+
+    Atlas = IONew(struct rhdAtlas, 1);
+    if (!Atlas)
+	return NULL;
+    bzero(Atlas, sizeof(struct rhdAtlas));
+
+    Atlas->Width = Width;
+    Atlas->Height = Height;
+    Atlas->BandHeight = BandHeight;
+    Atlas->Alignment = Alignment;
+    Atlas->NumBands = Height / BandHeight;
+    /* every placement adds at most one segment */
+    Atlas->MaxSegments = Width / Alignment + 1;
+    /* plenty for glyphs; running out just evicts early */
+    Atlas->PoolSize = (Width / Alignment) * Atlas->NumBands;
+
+    Atlas->Bands = IONew(struct rhdAtlasBand, Atlas->NumBands);
+    Atlas->Segments = IONew(struct rhdAtlasSegment,
+			    Atlas->NumBands * Atlas->MaxSegments);
+    Atlas->Pool = IONew(struct rhdAtlasEntry, Atlas->PoolSize);
+    if (!Atlas->Bands || !Atlas->Segments || !Atlas->Pool) {
+	RHDAtlasDestroy(Atlas);
+	return NULL;
+    }
+
+    for (i = 0; i < Atlas->NumBands; i++)
+	Atlas->Bands[i].Skyline = &Atlas->Segments[i * Atlas->MaxSegments];
+
+    RHDAtlasReset(Atlas);
+
+    return Atlas;
+}
+
+/*
+ *
+ */
+void
+RHDAtlasDestroy(struct rhdAtlas *Atlas)
+{
+    if (!Atlas)
+	return;
+
+    if (Atlas->Bands)
+	IODelete(Atlas->Bands, struct rhdAtlasBand, Atlas->NumBands);
+    if (Atlas->Segments)
+	IODelete(Atlas->Segments, struct rhdAtlasSegment,
+		 Atlas->NumBands * Atlas->MaxSegments);
+    if (Atlas->Pool)
+	IODelete(Atlas->Pool, struct rhdAtlasEntry, Atlas->PoolSize);
+    IODelete(Atlas, struct rhdAtlas, 1);
+}
+
+/*
+ * Forget everything, statistics included.
+ */
+void
+RHDAtlasReset(struct rhdAtlas *Atlas)
+{
+    int i;
+
+    bzero(Atlas->Hash, sizeof(Atlas->Hash));
+    bzero(&Atlas->Stats, sizeof(Atlas->Stats));
+    Atlas->Clock = 0;
+
+    Atlas->Free = NULL;
+    for (i = Atlas->PoolSize - 1; i >= 0; i--) {
+	Atlas->Pool[i].HashNext = Atlas->Free;
+	Atlas->Free = &Atlas->Pool[i];
+    }
+
+    for (i = 0; i < Atlas->NumBands; i++)
+	rhdAtlasBandClear(Atlas, i);
+}
+
+/*
+ * Also marks the entry as used.
+ */
+Bool
+RHDAtlasLookup(struct rhdAtlas *Atlas, CARD32 Key, struct rhdAtlasRect *Rect)
+{
+    struct rhdAtlasEntry *Entry;
+
+    Atlas->Stats.Lookups++;
+
+    for (Entry = Atlas->Hash[RHD_ATLAS_HASH(Key)]; Entry; Entry = Entry->HashNext)
+	if (Entry->Key == Key) {
+	    Atlas->Bands[Entry->Band].LastUse = ++Atlas->Clock;
+	    Atlas->Stats.Hits++;
+	    *Rect = Entry->Rect;
+	    return TRUE;
+	}
+
+    return FALSE;
+}
+
+/*
+ * Finds room for Key, evicting the least recently used band if needed.
+ * Only fails for rectangles that can never fit.
+ */
+Bool
+RHDAtlasInsert(struct rhdAtlas *Atlas, CARD32 Key, int Width, int Height,
+	       struct rhdAtlasRect *Rect)
+{
+    struct rhdAtlasEntry *Entry;
+    int Aligned, Band, Best = -1, BestIndex = -1, BestY = 0, i;
+
+    Aligned = (Width + Atlas->Alignment - 1) / Atlas->Alignment * Atlas->Alignment;
+    if ((Width <= 0) || (Height <= 0) ||
+	(Aligned > Atlas->Width) || (Height > Atlas->BandHeight))
+	return FALSE;
+
+    RHDAtlasRemove(Atlas, Key);
+
+    if (Atlas->Free) {
+	for (Band = 0; Band < Atlas->NumBands; Band++) {
+	    int Y, Index = rhdAtlasBandFit(Atlas, Band, Aligned, Height, &Y);
+
+	    if ((Index >= 0) && ((Best < 0) || (Y < BestY))) {
+		Best = Band;
+		BestIndex = Index;
+		BestY = Y;
+	    }
+	}
+    }
+
+    if (Best < 0) {
+	Best = rhdAtlasBandLRU(Atlas);
+	if (Atlas->Bands[Best].Entries)
+	    Atlas->Stats.Evictions++;
+	rhdAtlasBandEvict(Atlas, Best);
+	BestIndex = 0;
+	BestY = 0;
+    }
+
+    Entry = Atlas->Free;
+    Atlas->Free = Entry->HashNext;
+
+    Entry->Key = Key;
+    Entry->Band = Best;
+    Entry->Rect.X = Atlas->Bands[Best].Skyline[BestIndex].X;
+    Entry->Rect.Y = Best * Atlas->BandHeight + BestY;
+    Entry->Rect.Width = Width;
+    Entry->Rect.Height = Height;
+
+    rhdAtlasBandPlace(Atlas, Best, BestIndex, Aligned, BestY + Height);
+
+    i = RHD_ATLAS_HASH(Key);
+    Entry->HashNext = Atlas->Hash[i];
+    Atlas->Hash[i] = Entry;
+    Entry->BandNext = Atlas->Bands[Best].Entries;
+    Atlas->Bands[Best].Entries = Entry;
+    Atlas->Bands[Best].LastUse = ++Atlas->Clock;
+
+    Atlas->Stats.Inserts++;
+    Atlas->Stats.Entries++;
+
+    *Rect = Entry->Rect;
+    return TRUE;
+}
+
+/*
+ * The key is gone, its space only comes back with its band.
+ */
+void
+RHDAtlasRemove(struct rhdAtlas *Atlas, CARD32 Key)
+{
+    struct rhdAtlasEntry *Entry, **Link;
+
+    for (Entry = Atlas->Hash[RHD_ATLAS_HASH(Key)]; Entry; Entry = Entry->HashNext)
+	if (Entry->Key == Key)
+	    break;
+    if (!Entry)
+	return;
+
+    rhdAtlasHashUnlink(Atlas, Entry);
+
+    for (Link = &Atlas->Bands[Entry->Band].Entries; *Link; Link = &(*Link)->BandNext)
+	if (*Link == Entry) {
+	    *Link = Entry->BandNext;
+	    break;
+	}
+
+    Entry->HashNext = Atlas->Free;
+    Atlas->Free = Entry;
+    Atlas->Stats.Entries--;
+}
+
+/*
+ *
+ */
+void
+RHDAtlasStats(struct rhdAtlas *Atlas, struct rhdAtlasStats *Stats)
+{
+    *Stats = Atlas->Stats;
+}
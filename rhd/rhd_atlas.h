@@ -0,0 +1,63 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_ATLAS_H
+# define _RHD_ATLAS_H
+
+/*
+ * Glyph atlas.
+ *
+ * Packs small rectangles, keyed by a 32 bit id, into one texture. Only the
+ * layout is kept here; filling in the texels is left to the caller, so this
+ * can be driven without any hardware.
+ */
+
+/* power of two */
+#define RHD_ATLAS_HASH_SIZE	256
+
+struct rhdAtlasRect {
+    CARD16 X;
+    CARD16 Y;
+    CARD16 Width;
+    CARD16 Height;
+};
+
+struct rhdAtlasStats {
+    CARD32 Lookups;
+    CARD32 Hits;
+    CARD32 Inserts;
+    CARD32 Evictions;	/* bands emptied to make room */
+    CARD32 Entries;	/* currently cached */
+};
+
+struct rhdAtlas;
+
+struct rhdAtlas *RHDAtlasCreate(int Width, int Height, int BandHeight,
+				int Alignment);
+void RHDAtlasDestroy(struct rhdAtlas *Atlas);
+Bool RHDAtlasLookup(struct rhdAtlas *Atlas, CARD32 Key,
+		    struct rhdAtlasRect *Rect);
+Bool RHDAtlasInsert(struct rhdAtlas *Atlas, CARD32 Key, int Width, int Height,
+		    struct rhdAtlasRect *Rect);
+void RHDAtlasRemove(struct rhdAtlas *Atlas, CARD32 Key);
+void RHDAtlasReset(struct rhdAtlas *Atlas);
+void RHDAtlasStats(struct rhdAtlas *Atlas, struct rhdAtlasStats *Stats);
+
+#endif /* _RHD_ATLAS_H */
@@ -713,6 +713,7 @@ rhdAtomAllocateFbScratch(atomBiosHandlePtr handle,
 				__func__, (unsigned int)(fb_base), start);
 		} else {
 			size -= fb_size;
+			data->fb.size = size;
 			handle->fbBase = fb_base;
 			return ATOM_SUCCESS;
 		}
@@ -284,6 +284,7 @@ rhdAtomCrtcPower(struct rhdCrtc *Crtc, int Power)
 	default:
 	    rhdAtomEnableCrtc(rhdPtr->atomBIOS, AtomCrtc, atomCrtcDisable);
 	    rhdAtomEnableCrtcMemReq(rhdPtr->atomBIOS, AtomCrtc, atomCrtcDisable);
+	    RHDMCDisplayOff(rhdPtr, Crtc->Id);
 	    break;
     }
     data.Address = NULL;
@@ -34,23 +34,25 @@
 #include "rhd_regs.h"
 
 #define AUDIO_TIMER_INTERVALL 100 /* 1/10 sekund should be enough */
+/* with nothing playing, the interval doubles up to this */
+#define AUDIO_TIMER_INTERVALL_IDLE 800
 
 /*
  * current number of channels
  */
 static int
-AudioChannels(struct rhdAudio* Audio)
+AudioChannels(CARD32 value)
 {
-    return (RHDRegRead(Audio, AUDIO_RATE_BPS_CHANNEL) & 0x7) + 1;
+    return (value & 0x7) + 1;
 }
 
 /*
  * current bits per sample
  */
 static int
-AudioBitsPerSample(struct rhdAudio* Audio)
+AudioBitsPerSample(CARD32 value)
 {
-    CARD32 value = (RHDRegRead(Audio, AUDIO_RATE_BPS_CHANNEL) & 0xF0) >> 4;
+    value = (value & 0xF0) >> 4;
     switch(value)
     {
 	case 0x0: return  8;
@@ -70,9 +72,8 @@ AudioBitsPerSample(struct rhdAudio* Audio)
  * current sampling rate in HZ
  */
 static int
-AudioRate(struct rhdAudio* Audio)
+AudioRate(CARD32 value)
 {
-    CARD32 value = RHDRegRead(Audio, AUDIO_RATE_BPS_CHANNEL);
     CARD32 result;
 
     if(value & 0x4000)
@@ -99,43 +100,62 @@ AudioPlaying(struct rhdAudio* Audio)
  * iec 60958 status bits
  */
 static CARD8
-AudioStatusBits(struct rhdAudio* Audio)
+AudioStatusBits(CARD32 value)
 {
-    return RHDRegRead(Audio, AUDIO_STATUS_BITS) & 0xff;
+    return value & 0xff;
 }
 
 /*
  * iec 60958 category code
  */
 static CARD8
-AudioCategoryCode(struct rhdAudio* Audio)
+AudioCategoryCode(CARD32 value)
 {
-    return (RHDRegRead(Audio, AUDIO_STATUS_BITS) >> 8) & 0xff;
+    return (value >> 8) & 0xff;
 }
 
 /*
- * update all registered hdmi interfaces with current audio parameters
+ * Format and status only matter while playing, and are picked up again when
+ * playing starts, so once the first tick has them, a stopped engine only has
+ * its playing bit read. Each register is read once per tick, and the hdmi
+ * interfaces are only touched when a decoded value changed. With nothing
+ * playing and nothing changing, the ticks get further apart.
  */
 static CARD32
 AudioUpdateHdmi(OsTimerPtr timer, CARD32 time, pointer ptr)
 {
     struct rhdAudio *Audio = (struct rhdAudio*)ptr;
     Bool playing = AudioPlaying(Audio);
-    int channels = AudioChannels(Audio);
-    int rate = AudioRate(Audio);
-    int bps = AudioBitsPerSample(Audio);
-    CARD8 status_bits = AudioStatusBits(Audio);
-    CARD8 category_code = AudioCategoryCode(Audio);
+    int channels = Audio->SavedChannels;
+    int rate = Audio->SavedRate;
+    int bps = Audio->SavedBitsPerSample;
+    CARD8 status_bits = Audio->SavedStatusBits;
+    CARD8 category_code = Audio->SavedCategoryCode;
 
     struct rhdHdmi* hdmi;
 
-    if(playing != Audio->SavedPlaying ||
+    Audio->Wakeups++;
+
+    if(playing || !Audio->Saved) {
+	CARD32 format = RHDRegRead(Audio, AUDIO_RATE_BPS_CHANNEL);
+	CARD32 status = RHDRegRead(Audio, AUDIO_STATUS_BITS);
+
+	channels = AudioChannels(format);
+	rate = AudioRate(format);
+	bps = AudioBitsPerSample(format);
+	status_bits = AudioStatusBits(status);
+	category_code = AudioCategoryCode(status);
+    }
+
+    if(!Audio->Saved ||
+	playing != Audio->SavedPlaying ||
 	channels != Audio->SavedChannels ||
 	rate != Audio->SavedRate ||
 	bps != Audio->SavedBitsPerSample ||
 	status_bits != Audio->SavedStatusBits ||
 	category_code != Audio->SavedCategoryCode) {
 
+	Audio->Saved = TRUE;
 	Audio->SavedPlaying = playing;
 	Audio->SavedChannels = channels;
 	Audio->SavedRate = rate;
@@ -148,9 +168,13 @@ AudioUpdateHdmi(OsTimerPtr timer, CARD32 time, pointer ptr)
 		hdmi, playing, channels,
 		rate, bps, status_bits,
 		category_code);
-    }
 
-    return AUDIO_TIMER_INTERVALL;
+	Audio->Updates++;
+	Audio->Interval = AUDIO_TIMER_INTERVALL;
+    } else if(!playing && Audio->Interval < AUDIO_TIMER_INTERVALL_IDLE)
+	Audio->Interval *= 2;
+
+    return Audio->Interval;
 }
 
 /*
@@ -192,11 +216,14 @@ RHDAudioSetEnable(RHDPtr rhdPtr, Bool Enable)
 	 * but since drm doesn't support this interrupt, we check
 	 * every AUDIO_TIMER_INTERVALL ms if something has changed
 	 */
+	Audio->Saved = FALSE;
+	Audio->SavedPlaying = FALSE;
 	Audio->SavedChannels = -1;
 	Audio->SavedRate = -1;
 	Audio->SavedBitsPerSample = -1;
         Audio->SavedStatusBits = 0;
         Audio->SavedCategoryCode = 0;
+	Audio->Interval = AUDIO_TIMER_INTERVALL;
 	Audio->Timer = TimerSet(NULL, 0, AUDIO_TIMER_INTERVALL, AudioUpdateHdmi, Audio);
 
 	/* 48kHz and 16/20 bits per sample are always supported */
@@ -303,6 +330,13 @@ RHDAudioRegisterHdmi(RHDPtr rhdPtr, struct rhdHdmi* rhdHdmi)
 
     rhdHdmi->Next = Audio->Registered;
     Audio->Registered = rhdHdmi;
+
+    /* the others are only updated on changes, so catch up with them */
+    if(Audio->Timer && Audio->Saved)
+	RHDHdmiUpdateAudioSettings(
+	    rhdHdmi, Audio->SavedPlaying, Audio->SavedChannels,
+	    Audio->SavedRate, Audio->SavedBitsPerSample,
+	    Audio->SavedStatusBits, Audio->SavedCategoryCode);
 }
 
 
@@ -397,5 +431,9 @@ RHDAudioDestroy(RHDPtr rhdPtr)
     if(rhdPtr->Audio->Timer)
 	TimerFree(rhdPtr->Audio->Timer);
 
+    LOG("Audio: %u wakeups, %u hdmi updates.\n",
+	(unsigned int) rhdPtr->Audio->Wakeups,
+	(unsigned int) rhdPtr->Audio->Updates);
+
     IODelete(rhdPtr->Audio, struct rhdAudio, 1);
 }
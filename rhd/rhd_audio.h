@@ -33,7 +33,9 @@ struct rhdAudio {
 
 	struct rhdHdmi* Registered;
 	OsTimerPtr 	Timer;
+	CARD32		Interval;	/* ms until the next tick */
 
+	Bool	Saved;		/* the Saved* values below are valid */
 	Bool	SavedPlaying;
 	int	SavedChannels;
 	int	SavedRate;
@@ -41,6 +43,10 @@ struct rhdAudio {
 	CARD8	SavedStatusBits;
 	CARD8	SavedCategoryCode;
 
+	/* statistics */
+	CARD32	Wakeups;
+	CARD32	Updates;	/* ticks that found something changed */
+
 	Bool Stored;
 
 	CARD32 StoreEnabled;
@@ -1086,10 +1086,12 @@ D1Power(struct rhdCrtc *Crtc, int Power)
 			return TRUE;
 		case RHD_POWER_RESET:
 			RHDRegMask(Crtc, D1CRTC_CONTROL, 0x01000000, 0x01000000); /* disable read requests */
+			RHDMCDisplayOff(RHDPTRI(Crtc), Crtc->Id);
 			return D1CRTCDisable(Crtc);
 		case RHD_POWER_SHUTDOWN:
 		default:
 			RHDRegMask(Crtc, D1CRTC_CONTROL, 0x01000000, 0x01000000); /* disable read requests */
+			RHDMCDisplayOff(RHDPTRI(Crtc), Crtc->Id);
 			ret = D1CRTCDisable(Crtc);
 			RHDRegMask(Crtc, D1GRPH_ENABLE, 0, 0x00000001);
 			return ret;
@@ -1114,10 +1116,12 @@ D2Power(struct rhdCrtc *Crtc, int Power)
 	return TRUE;
     case RHD_POWER_RESET:
 	RHDRegMask(Crtc, D2CRTC_CONTROL, 0x01000000, 0x01000000); /* disable read requests */
+	RHDMCDisplayOff(RHDPTRI(Crtc), Crtc->Id);
 	return D2CRTCDisable(Crtc);
     case RHD_POWER_SHUTDOWN:
     default:
 	RHDRegMask(Crtc, D2CRTC_CONTROL, 0x01000000, 0x01000000); /* disable read requests */
+	RHDMCDisplayOff(RHDPTRI(Crtc), Crtc->Id);
 	ret = D2CRTCDisable(Crtc);
 	RHDRegMask(Crtc, D2GRPH_ENABLE, 0, 0x00000001);
 	return ret;
@@ -1525,3 +1529,65 @@ RHDCrtcRestore(struct rhdCrtc *Crtc)
     if (Crtc->ModeRestore)
 	Crtc->ModeRestore(Crtc);
 }
+
+/*
+ * Where a scanning out CRTC is in its frame. The line counter starts at
+ * sync, as the blank does in DxModeSet.
+ */
+Bool
+RHDCrtcScanPosition(struct rhdCrtc *Crtc, struct rhdCrtcScan *Scan)
+{
+    DisplayModePtr Mode = Crtc->CurrentMode;
+    CARD32 BlankStartEnd;
+    CARD16 RegOff;
+
+    if (!Crtc->Active || !Mode || !Mode->Clock || !Mode->CrtcHTotal)
+	return FALSE;
+
+    if (Crtc->Id == RHD_CRTC_1)
+	RegOff = D1_REG_OFFSET;
+    else
+	RegOff = D2_REG_OFFSET;
+
+    if (!(RHDRegRead(Crtc, RegOff + D1CRTC_CONTROL) & 0x01))
+	return FALSE;
+
+    Scan->Total = (RHDRegRead(Crtc, RegOff + D1CRTC_V_TOTAL) & 0x1FFF) + 1;
+    BlankStartEnd = RHDRegRead(Crtc, RegOff + D1CRTC_V_BLANK_START_END);
+    Scan->BlankStart = BlankStartEnd & 0x1FFF;
+    Scan->BlankEnd = (BlankStartEnd >> 16) & 0x1FFF;
+    Scan->Line = RHDRegRead(Crtc, RegOff + D1CRTC_STATUS_POSITION) & 0x1FFF;
+    Scan->LineTime = (Mode->CrtcHTotal * 1000000ULL) / Mode->Clock;
+
+    return TRUE;
+}
+
+/*
+ * Vertical blank timing of a scanning out CRTC, in usecs: how much is Left
+ * of the current blank, 0 outside of it, and the Length of the blank and
+ * of the whole Frame.
+ */
+Bool
+RHDCrtcBlankTime(struct rhdCrtc *Crtc, CARD32 *Left, CARD32 *Length,
+		 CARD32 *Frame)
+{
+    struct rhdCrtcScan Scan;
+    CARD32 Lines;
+
+    if (!RHDCrtcScanPosition(Crtc, &Scan))
+	return FALSE;
+
+    if (Scan.Line >= Scan.BlankStart)
+	Lines = Scan.Total - Scan.Line + Scan.BlankEnd;
+    else if (Scan.Line < Scan.BlankEnd)
+	Lines = Scan.BlankEnd - Scan.Line;
+    else
+	Lines = 0;
+
+    *Left = (Lines * Scan.LineTime) / 1000;
+    *Length = ((Scan.Total - Scan.BlankStart + Scan.BlankEnd) * Scan.LineTime)
+	/ 1000;
+    *Frame = (Scan.Total * Scan.LineTime) / 1000;
+
+    return TRUE;
+}
@@ -54,6 +54,7 @@ struct rhdCrtc {
 
 	void *FBPhyAddress;
     int Offset; /* Current offset */
+    unsigned int FbSize; /* size of the scanout buffer we own at Offset, 0 if none */
     int bpp;
     int Pitch;
     int Width;
@@ -113,11 +114,23 @@ struct rhdCrtc {
     void (*Blank) (struct rhdCrtc *Crtc, Bool Blank);
 };
 
+/* all in lines, but LineTime, which is in nsecs */
+struct rhdCrtcScan {
+    CARD32 Line;
+    CARD32 Total;
+    CARD32 BlankStart;
+    CARD32 BlankEnd;
+    CARD32 LineTime;
+};
+
 Bool RHDCrtcsInit(RHDPtr rhdPtr);
 void RHDAtomCrtcsInit(RHDPtr rhdPtr);
 void RHDCrtcsDestroy(RHDPtr rhdPtr);
 void RHDCrtcSave(struct rhdCrtc *Crtc);
 void RHDCrtcRestore(struct rhdCrtc *Crtc);
+Bool RHDCrtcScanPosition(struct rhdCrtc *Crtc, struct rhdCrtcScan *Scan);
+Bool RHDCrtcBlankTime(struct rhdCrtc *Crtc, CARD32 *Left, CARD32 *Length,
+		      CARD32 *Frame);
 
 /*
  * Calculate overscan values for scaler.
@@ -37,6 +37,26 @@
 #define BUILD_CS_MMIO 1
 #endif
 
+/* execute everything in software instead of on the card */
+#if 0
+#define BUILD_CS_EMUL 1
+#endif
+
+/* R5xx only, and only where the CP microcode is already running */
+#if 1
+#define BUILD_CS_CP 1
+#endif
+
+#ifdef BUILD_CS_EMUL
+#include "rhd_pm4.h"
+#endif
+
+#ifdef BUILD_CS_CP
+#include <unistd.h> /* usleep */
+#include "compiler.h" /* write_mem_barrier */
+#include "rhd_fbmem.h"
+#endif
+
 #define CS_LOOP_COUNT 10000000
 
 #ifdef BUILD_CS_MMIO
@@ -172,6 +192,478 @@ CSMMIOInit(struct RhdCS *CS)
 
 #endif /* BUILD_CS_MMIO */
 
+#ifdef BUILD_CS_EMUL
+/*
+ *
+ * Software PM4 backend.
+ *
+ */
+static void
+CSEmulFlush(struct RhdCS *CS)
+{
+    struct RhdPM4Emu *Emu = CS->Private;
+
+    if (CS->Flushed == CS->Wptr)
+	return;
+
+    if (RHDPM4EmuExecute(Emu, CS->Buffer + CS->Flushed, CS->Wptr - CS->Flushed) < 0)
+	LOG("%s: Bad command stream.\n", __func__);
+
+    CS->Flushed = CS->Wptr;
+#ifdef RHD_CS_DEBUG
+    CS->Grabbed = 0;
+#endif
+}
+
+/*
+ *
+ */
+static void
+CSEmulGrab(struct RhdCS *CS, CARD32 Count)
+{
+    if ((CS->Size - CS->Wptr) >= Count)
+	return;
+
+    CSEmulFlush(CS);
+    CS->Wptr = 0;
+    CS->Flushed = 0;
+}
+
+/*
+ *
+ */
+static Bool
+CSEmulIdle(struct RhdCS *CS)
+{
+    CSEmulFlush(CS);
+    return TRUE;
+}
+
+/*
+ * Everything is executed when flushed, so all fences have passed already.
+ */
+static CARD32
+CSEmulFenceEmit(struct RhdCS *CS)
+{
+    CSEmulFlush(CS);
+    return 0;
+}
+
+/*
+ *
+ */
+static Bool
+CSEmulFenceWait(struct RhdCS *CS, CARD32 Fence, int Timeout)
+{
+    return TRUE;
+}
+
+/*
+ *
+ */
+static void
+CSEmulDestroy(struct RhdCS *CS)
+{
+    struct RhdPM4Emu *Emu = CS->Private;
+
+    RHDPM4EmuStatsPrint(Emu);
+    RHDPM4EmuDestroy(Emu);
+    CS->Private = NULL;
+
+    if (CS->Buffer)
+	xfree(CS->Buffer);
+
+    CS->Destroy = NULL;
+}
+
+/*
+ *
+ */
+static Bool
+CSEmulInit(struct RhdCS *CS)
+{
+    RHDPtr rhdPtr = RHDPTRI(CS);
+    struct RhdPM4Emu *Emu;
+
+    Emu = RHDPM4EmuCreate((rhdPtr->ChipSet >= RHD_R600) ? RHD_PM4_R6XX : RHD_PM4_R5XX);
+    if (!Emu)
+	return FALSE;
+
+    if (!RHDPM4EmuMap(Emu, rhdPtr->FbIntAddress, rhdPtr->FbMapSize, rhdPtr->FbBase)) {
+	RHDPM4EmuDestroy(Emu);
+	return FALSE;
+    }
+
+    LOG("Using software PM4 Command Submission for acceleration.\n");
+
+    CS->Type = RHD_CS_EMUL;
+    CS->Private = Emu;
+
+    CS->Size = (64 << 10) / 4;
+    CS->Buffer = xnfcalloc(1, 4 * CS->Size);
+
+    CS->Grab = CSEmulGrab;
+    CS->Flush = CSEmulFlush;
+    CS->AdvanceFlush = FALSE;
+    CS->Idle = CSEmulIdle;
+    CS->FenceEmit = CSEmulFenceEmit;
+    CS->FenceWait = CSEmulFenceWait;
+    CS->Start = NULL;
+    CS->Reset = NULL;
+    CS->Stop = CSEmulFlush;
+    CS->Destroy = CSEmulDestroy;
+
+    return TRUE;
+}
+
+#endif /* BUILD_CS_EMUL */
+
+#ifdef BUILD_CS_CP
+/*
+ *
+ * Direct CP: a ring in the framebuffer, fed by moving the write pointer.
+ *
+ * The CP writes its read pointer and the fence scratch register back into a
+ * page next to the ring, so checking for room or for a fence never has to
+ * go near the register FIFO. Waits sleep instead of spinning.
+ *
+ */
+#define CS_CP_RING_SIZE   (64 << 10) /* bytes, power of two */
+#define CS_CP_WB_SIZE     4096
+#define CS_CP_WB_RPTR     0          /* dword offsets into the writeback page */
+#define CS_CP_WB_SCRATCH  8          /* SCRATCH_REG0, the fence */
+#define CS_CP_RPTR_BLOCK  9          /* rptr writeback every 2^9 qwords */
+
+#define CS_CP_SLEEP       50         /* usecs between polls */
+#define CS_CP_TIMEOUT     2000000    /* usecs */
+#define CS_CP_PROBE       10000      /* usecs */
+
+struct RhdCSCP {
+    CARD32 Offset; /* of ring + writeback page in the framebuffer */
+    CARD32 IntAddress;
+    volatile CARD32 *WriteBack;
+
+    CARD32 Fence; /* last one emitted */
+
+    /* statistics */
+    CARD32 Dwords;
+    CARD32 Waits;
+    CARD32 Slept; /* usecs */
+};
+
+/*
+ *
+ */
+static void
+CSCPRingStart(struct RhdCS *CS)
+{
+    struct RhdCSCP *CP = CS->Private;
+    CARD32 Cntl = (CS_CP_RPTR_BLOCK << R5XX_RB_BLKSZ_SHIFT);
+    CARD32 Size = CS_CP_RING_SIZE / 8;
+
+    /* log2 of the ring size in qwords */
+    while (Size > 1) {
+	Cntl++;
+	Size >>= 1;
+    }
+
+    CP->WriteBack[CS_CP_WB_RPTR] = 0;
+    CP->WriteBack[CS_CP_WB_SCRATCH] = CP->Fence;
+
+    RHDRegWrite(CS, R5XX_CP_CSQ_CNTL, R5XX_CSQ_PRIDIS_INDDIS);
+
+    RHDRegWrite(CS, R5XX_CP_RB_BASE, CP->IntAddress);
+    RHDRegWrite(CS, R5XX_CP_RB_CNTL, Cntl | R5XX_RB_RPTR_WR_ENA);
+    RHDRegWrite(CS, R5XX_CP_RB_RPTR_WR, 0);
+    RHDRegWrite(CS, R5XX_CP_RB_WPTR, 0);
+    RHDRegWrite(CS, R5XX_CP_RB_CNTL, Cntl);
+    RHDRegWrite(CS, R5XX_CP_RB_WPTR_DELAY, 0);
+
+    RHDRegWrite(CS, R5XX_CP_RB_RPTR_ADDR, CP->IntAddress + CS_CP_RING_SIZE +
+		CS_CP_WB_RPTR * 4);
+    RHDRegWrite(CS, R5XX_SCRATCH_ADDR, CP->IntAddress + CS_CP_RING_SIZE +
+		CS_CP_WB_SCRATCH * 4);
+    RHDRegWrite(CS, R5XX_SCRATCH_REG0, CP->Fence);
+    RHDRegWrite(CS, R5XX_SCRATCH_UMSK, 1 << 0);
+
+    RHDRegWrite(CS, R5XX_CP_CSQ_CNTL, R5XX_CSQ_PRIBM_INDDIS);
+
+    CS->Flushed = 0;
+    CS->Wptr = 0;
+}
+
+/*
+ *
+ */
+static void
+CSCPRingStop(struct RhdCS *CS)
+{
+    RHDRegWrite(CS, R5XX_SCRATCH_UMSK, 0);
+    RHDRegWrite(CS, R5XX_CP_CSQ_CNTL, R5XX_CSQ_PRIDIS_INDDIS);
+}
+
+/*
+ *
+ */
+static void
+CSCPFlush(struct RhdCS *CS)
+{
+    struct RhdCSCP *CP = CS->Private;
+
+    /* the CP fetches qwords; Grab keeps one dword spare for this */
+    if (CS->Wptr & 1)
+	CS->Buffer[CS->Wptr++] = CP_PACKET2();
+
+    CP->Dwords += CS->Wptr - CS->Flushed;
+
+    write_mem_barrier();
+    RHDRegWrite(CS, R5XX_CP_RB_WPTR, CS->Wptr & (CS->Size - 1));
+
+    CS->Flushed = CS->Wptr;
+#ifdef RHD_CS_DEBUG
+    CS->Grabbed = 0;
+#endif
+}
+
+/*
+ * Free dwords in the ring, one is always kept so that full is not empty.
+ */
+static CARD32
+CSCPRoom(struct RhdCS *CS, Bool Exact)
+{
+    struct RhdCSCP *CP = CS->Private;
+    CARD32 Rptr;
+
+    if (Exact) /* the writeback lags by up to a block */
+	Rptr = RHDRegRead(CS, R5XX_CP_RB_RPTR);
+    else
+	Rptr = CP->WriteBack[CS_CP_WB_RPTR];
+
+    return (Rptr - CS->Wptr - 1) & (CS->Size - 1);
+}
+
+/*
+ *
+ */
+static Bool
+CSCPWaitRoom(struct RhdCS *CS, CARD32 Count)
+{
+    struct RhdCSCP *CP = CS->Private;
+    int i;
+
+    if (CSCPRoom(CS, FALSE) >= Count)
+	return TRUE;
+
+    /* nothing of what we wait for may still sit in front of the wptr */
+    if (CS->Flushed != CS->Wptr)
+	CSCPFlush(CS);
+
+    CP->Waits++;
+    for (i = 0; i < CS_CP_TIMEOUT; i += CS_CP_SLEEP) {
+	if (CSCPRoom(CS, TRUE) >= Count)
+	    return TRUE;
+	usleep(CS_CP_SLEEP);
+	CP->Slept += CS_CP_SLEEP;
+    }
+
+    LOG("%s: Timeout waiting for %d dwords (RPTR 0x%04X, WPTR 0x%04X).\n",
+	__func__, (unsigned int) Count, (unsigned int) RHDRegRead(CS, R5XX_CP_RB_RPTR),
+	(unsigned int) CS->Wptr);
+    return FALSE;
+}
+
+/*
+ * Hands out Count contiguous dwords, plus one for qword alignment.
+ */
+static void
+CSCPGrab(struct RhdCS *CS, CARD32 Count)
+{
+    Count++;
+
+    if ((CS->Size - CS->Wptr) < Count) {
+	/* pad to the end, the CP wraps on its own */
+	CSCPWaitRoom(CS, CS->Size - CS->Wptr);
+	while (CS->Wptr < CS->Size)
+	    CS->Buffer[CS->Wptr++] = CP_PACKET2();
+	CSCPFlush(CS);
+
+	CS->Wptr = 0;
+	CS->Flushed = 0;
+    }
+
+    CSCPWaitRoom(CS, Count);
+}
+
+/*
+ * Fences are numbered, and only land once the engines are idle.
+ */
+static CARD32
+CSCPFenceEmit(struct RhdCS *CS)
+{
+    struct RhdCSCP *CP = CS->Private;
+
+    CP->Fence++;
+
+    CSCPGrab(CS, 4);
+    RHDCSRegWrite(CS, R5XX_WAIT_UNTIL,
+		  R5XX_WAIT_HOST_IDLECLEAN | R5XX_WAIT_3D_IDLECLEAN |
+		  R5XX_WAIT_2D_IDLECLEAN | R5XX_WAIT_DMA_GUI_IDLE);
+    RHDCSRegWrite(CS, R5XX_SCRATCH_REG0, CP->Fence);
+    CSCPFlush(CS);
+
+    return CP->Fence;
+}
+
+/*
+ *
+ */
+static Bool
+CSCPFenceWait(struct RhdCS *CS, CARD32 Fence, int Timeout)
+{
+    struct RhdCSCP *CP = CS->Private;
+    int i;
+
+    for (i = 0; ; i += CS_CP_SLEEP) {
+	/* wraps around */
+	if (((INT32) (CP->WriteBack[CS_CP_WB_SCRATCH] - Fence)) >= 0)
+	    return TRUE;
+	if (i >= Timeout)
+	    return FALSE;
+	usleep(CS_CP_SLEEP);
+	CP->Slept += CS_CP_SLEEP;
+    }
+}
+
+/*
+ *
+ */
+static Bool
+CSCPIdle(struct RhdCS *CS)
+{
+    struct RhdCSCP *CP = CS->Private;
+    CARD32 Fence = CSCPFenceEmit(CS);
+
+    CP->Waits++;
+    if (CSCPFenceWait(CS, Fence, CS_CP_TIMEOUT))
+	return TRUE;
+
+    LOG("%s: Timeout on fence %u (at %u).\n", __func__, (unsigned int) Fence,
+	(unsigned int) CP->WriteBack[CS_CP_WB_SCRATCH]);
+    return FALSE;
+}
+
+/*
+ *
+ */
+static void
+CSCPStart(struct RhdCS *CS)
+{
+    CSCPRingStart(CS);
+}
+
+/*
+ *
+ */
+static void
+CSCPReset(struct RhdCS *CS)
+{
+    CSCPRingStop(CS);
+    CSCPRingStart(CS);
+}
+
+/*
+ *
+ */
+static void
+CSCPStop(struct RhdCS *CS)
+{
+    CSCPIdle(CS);
+    CSCPRingStop(CS);
+}
+
+/*
+ *
+ */
+static void
+CSCPDestroy(struct RhdCS *CS)
+{
+    struct RhdCSCP *CP = CS->Private;
+
+    if (CP->Dwords)
+	LOG("Direct CP: %u kB of commands, %u waits, %u usecs asleep "
+	    "(%u usecs per MB).\n",
+	    (unsigned int) (CP->Dwords >> 8), (unsigned int) CP->Waits,
+	    (unsigned int) CP->Slept,
+	    (unsigned int) (((unsigned long long) CP->Slept << 18) / CP->Dwords));
+
+    RHDFreeFb(RHDPTRI(CS), CP->Offset);
+
+    xfree(CP);
+    CS->Private = NULL;
+    CS->Buffer = NULL;
+    CS->Destroy = NULL;
+}
+
+/*
+ *
+ */
+static Bool
+CSCPInit(struct RhdCS *CS)
+{
+    RHDPtr rhdPtr = RHDPTRI(CS);
+    struct RhdCSCP *CP;
+    CARD32 Offset;
+
+    Offset = RHDAllocFbPlaced(rhdPtr, CS_CP_RING_SIZE + CS_CP_WB_SIZE, 4096,
+			      RHD_FB_PLACE_HIGH, 0,
+			      RHD_FB_USAGE_OTHER, "CP Ring");
+    if (Offset == (CARD32) -1)
+	return FALSE;
+
+    CP = xnfcalloc(1, sizeof(struct RhdCSCP));
+    CP->Offset = Offset;
+    CP->IntAddress = rhdPtr->FbIntAddress + Offset;
+    CP->WriteBack = (CARD32 *) ((CARD8 *) rhdPtr->FbBase + Offset + CS_CP_RING_SIZE);
+
+    CS->Private = CP;
+    CS->Buffer = (CARD32 *) ((CARD8 *) rhdPtr->FbBase + Offset);
+    CS->Size = CS_CP_RING_SIZE / 4;
+
+    /* we do not load microcode; see whether somebody did */
+    CSCPRingStart(CS);
+    if (!CSCPFenceWait(CS, CSCPFenceEmit(CS), CS_CP_PROBE)) {
+	LOG("%s: CP does not respond, no microcode?\n", __func__);
+	CSCPRingStop(CS);
+	RHDFreeFb(rhdPtr, Offset);
+	xfree(CP);
+	CS->Private = NULL;
+	CS->Buffer = NULL;
+	return FALSE;
+    }
+    CSCPRingStop(CS);
+    CP->Dwords = 0;
+    CP->Slept = 0;
+
+    LOG("Using direct CP Command Submission for acceleration.\n");
+
+    CS->Type = RHD_CS_CP;
+
+    CS->Grab = CSCPGrab;
+    CS->Flush = CSCPFlush;
+    CS->AdvanceFlush = FALSE;
+    CS->Idle = CSCPIdle;
+    CS->FenceEmit = CSCPFenceEmit;
+    CS->FenceWait = CSCPFenceWait;
+    CS->Start = CSCPStart;
+    CS->Reset = CSCPReset;
+    CS->Stop = CSCPStop;
+    CS->Destroy = CSCPDestroy;
+
+    return TRUE;
+}
+
+#endif /* BUILD_CS_CP */
+
 #ifdef USE_DRI
 
 /*
@@ -524,6 +1016,33 @@ RHDCSIdle(struct RhdCS *CS)
     return TRUE;
 }
 
+/*
+ * Backends without fences only flush here, and waiting idles the engines.
+ */
+CARD32
+RHDCSFenceEmit(struct RhdCS *CS)
+{
+    if (CS->FenceEmit)
+	return CS->FenceEmit(CS);
+
+    RHDCSFlush(CS);
+    return 0;
+}
+
+/*
+ *
+ */
+Bool
+RHDCSFenceWait(struct RhdCS *CS, CARD32 Fence, int Timeout)
+{
+    if (CS->FenceWait)
+	return CS->FenceWait(CS, Fence, Timeout);
+
+    if (!Timeout)
+	return FALSE;
+    return RHDCSIdle(CS);
+}
+
 /*
  *
  */
@@ -614,6 +1133,11 @@ RHDCSInit(ScrnInfoPtr pScrn)
 
     rhdPtr->CS = CS;
 
+#ifdef BUILD_CS_EMUL
+    if (CSEmulInit(CS))
+	return;
+#endif
+
 #ifdef USE_DRI
     if (CSDRMCPInit(CS))
 	return;
@@ -626,7 +1150,10 @@ RHDCSInit(ScrnInfoPtr pScrn)
 	return;
     }
 
-    /* hook in direct CP backend here */
+#ifdef BUILD_CS_CP
+    if (CSCPInit(CS))
+	return;
+#endif
 
     CSMMIOInit(CS);
 }
@@ -39,7 +39,8 @@ enum RhdCSType {
     RHD_CS_NONE = 0,
     RHD_CS_MMIO,
     RHD_CS_CP, /* CP but without the GART (Direct CP) */
-    RHD_CS_CPDMA /* CP with kernel support (DRM or indirect CP) */
+    RHD_CS_CPDMA, /* CP with kernel support (DRM or indirect CP) */
+    RHD_CS_EMUL /* software PM4 command processor */
 };
 
 struct RhdCS {
@@ -76,6 +77,10 @@ struct RhdCS {
     Bool AdvanceFlush; /* flush the buffer all the time? */
     Bool (*Idle) (struct RhdCS *CS);
 
+    /* optional, numbered fences; Timeout in usecs, 0 only polls */
+    CARD32 (*FenceEmit) (struct RhdCS *CS);
+    Bool (*FenceWait) (struct RhdCS *CS, CARD32 Fence, int Timeout);
+
     void (*Start) (struct RhdCS *CS);
     void (*Reset) (struct RhdCS *CS);
     void (*Stop) (struct RhdCS *CS);
@@ -109,6 +114,8 @@ struct _drmBuf *RHDDRMCPBuffer(int scrnIndex);
  */
 void RHDCSFlush(struct RhdCS *CS);
 Bool RHDCSIdle(struct RhdCS *CS);
+CARD32 RHDCSFenceEmit(struct RhdCS *CS);
+Bool RHDCSFenceWait(struct RhdCS *CS, CARD32 Fence, int Timeout);
 void RHDCSStart(struct RhdCS *CS);
 void RHDCSReset(struct RhdCS *CS);
 void RHDCSStop(struct RhdCS *CS);
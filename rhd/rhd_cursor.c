@@ -48,6 +48,7 @@
 #include "rhd_cursor.h"
 #include "rhd_crtc.h"
 #include "rhd_regs.h"
+#include "rhd_fbmem.h"
 
 #ifndef BITMAP_SCANLINE_PAD
 #define BITMAP_SCANLINE_PAD  32
@@ -463,7 +464,9 @@ void
 RHDCursorsInit(RHDPtr rhdPtr)
 {
     int size = RHD_FB_CHUNK(MAX_CURSOR_WIDTH * MAX_CURSOR_HEIGHT * 4);
-	int Base = RHDAllocFb(rhdPtr, size, "Cursor Image");
+	/* keep it out of the way of scanout, the hardware points here for good */
+	int Base = RHDAllocFbPlaced(rhdPtr, size, 0, RHD_FB_PLACE_HIGH, 0,
+								RHD_FB_USAGE_CURSOR, "Cursor Image");
     int i;
 
     RHDFUNC(rhdPtr);
@@ -491,6 +494,11 @@ RHDCursorsDestroy(RHDPtr rhdPtr)
     int i;
     RHDFUNC(rhdPtr);
 
+    /* both cursors share the one image buffer */
+    if (rhdPtr->Crtc[0] && rhdPtr->Crtc[0]->Cursor
+	&& (rhdPtr->Crtc[0]->Cursor->Base != -1))
+	RHDFreeFb(rhdPtr, rhdPtr->Crtc[0]->Cursor->Base);
+
     for (i = 0; i < 2; i++) {
 	if (!rhdPtr->Crtc[i] || !rhdPtr->Crtc[i]->Cursor)
 	    continue;
@@ -429,6 +429,10 @@ static void RHDLeaveServer(ScreenPtr pScreen)
     ScrnInfoPtr pScrn = xf86Screens[pScreen->myNum];
     RHDPtr rhdPtr = RHDPTR(pScrn);
 
+    /* batched up R6xx rectangles are not in the CS yet */
+    if (rhdPtr->ChipSet >= RHD_R600)
+	R6xxEXAFlush(pScrn);
+
     /* The CP is always running, but if we've generated any CP commands
      * we must flush them to the kernel module now. */
     if (CS->Clean == RHD_CS_CLEAN_DONE) {
@@ -64,12 +64,15 @@
 #include "rhd_mc.h"
 #include "rhd_monitor.h"
 #include "rhd_crtc.h"
+#include "rhd_vblank.h"
+#include "rhd_flip.h"
 #include "rhd_modes.h"
 #include "rhd_lut.h"
 #include "rhd_i2c.h"
 #include "rhd_card.h"
 //#include "rhd_audio.h"
 #include "rhd_pm.h"
+#include "rhd_fbmem.h"
 
 /* Mandatory functions */
 static Bool     RHDPreInit(ScrnInfoPtr pScrn);
@@ -94,7 +97,7 @@ static void     rhdModeLayoutPrint(RHDPtr rhdPtr);
 static void     rhdModeDPISet(ScrnInfoPtr pScrn);
 static Bool     rhdAllIdle(RHDPtr rhdPtr);
 static void     rhdModeInit(ScrnInfoPtr pScrn);
-static void	rhdSetMode(ScrnInfoPtr pScrn);
+static Bool	rhdSetMode(ScrnInfoPtr pScrn);
 static Bool     rhdMapFB(RHDPtr rhdPtr);
 static void     rhdUnmapFB(RHDPtr rhdPtr);
 static CARD32   rhdGetVideoRamSize(RHDPtr rhdPtr);
@@ -140,7 +143,13 @@ RHDFreeRec(ScrnInfoPtr pScrn)
     RHDOutputsDestroy(rhdPtr);
     RHDConnectorsDestroy(rhdPtr);
     RHDCursorsDestroy(rhdPtr);
+    RHDFlipDestroy(rhdPtr, 0);
+    RHDFlipDestroy(rhdPtr, 1);
+    RHDVBlankDestroy(rhdPtr);
     RHDCrtcsDestroy(rhdPtr);
+    RHDFbHeapDestroy(rhdPtr->FbHeap);
+    rhdPtr->FbHeap = NULL;
+    RHDModeCacheDestroy(rhdPtr);
     RHDI2CFunc(pScrn->scrnIndex, rhdPtr->I2C, RHD_I2C_TEARDOWN, NULL);
 #ifdef ATOM_BIOS
     RHDAtomBiosFunc(pScrn->scrnIndex, rhdPtr->atomBIOS,
@@ -306,6 +315,7 @@ RHDPreInit(ScrnInfoPtr pScrn)
 	
     rhdPtr->FbFreeStart = 0;
     rhdPtr->FbFreeSize = pScrn->videoRam * 1024;
+    rhdPtr->FbHeap = RHDFbHeapCreate(0, pScrn->videoRam * 1024);
 	
 #ifdef ATOM_BIOS
     if (rhdPtr->atomBIOS) { 	/* for testing functions */
@@ -318,6 +328,11 @@ RHDPreInit(ScrnInfoPtr pScrn)
 							&atomBiosArg) == ATOM_SUCCESS) {
 			rhdPtr->FbFreeStart = atomBiosArg.fb.start;
 			rhdPtr->FbFreeSize = atomBiosArg.fb.size;
+			/* whatever got cut off the end is firmware scratch */
+			if ((atomBiosArg.fb.start + atomBiosArg.fb.size) < (unsigned int)pScrn->videoRam * 1024)
+				RHDFbHeapReserve(rhdPtr->FbHeap, atomBiosArg.fb.start + atomBiosArg.fb.size,
+								 pScrn->videoRam * 1024 - (atomBiosArg.fb.start + atomBiosArg.fb.size),
+								 RHD_FB_USAGE_SCRATCH, "AtomBIOS Scratch");
 		}
 		
 		RHDAtomBiosFunc(pScrn->scrnIndex, rhdPtr->atomBIOS, ATOM_GET_DEFAULT_ENGINE_CLOCK,
@@ -355,6 +370,7 @@ RHDPreInit(ScrnInfoPtr pScrn)
 #else
 	goto error1;
 #endif
+    RHDVBlankInit(rhdPtr);
     if (!RHDPLLsInit(rhdPtr))
 #ifdef ATOM_BIOS
 		RHDAtomPLLsInit(rhdPtr);
@@ -669,9 +685,7 @@ RHDSwitchMode(ScrnInfoPtr pScrn)
     /* now set up the MC - has to be done before DRI init */
     RHDMCSetupFBLocation(rhdPtr, rhdPtr->FbIntAddress, rhdPtr->FbIntSize);
 	
-	rhdSetMode(pScrn);
-	
-    return TRUE;
+    return rhdSetMode(pScrn);
 }
 
 /*
@@ -1192,8 +1206,9 @@ rhdModeLayoutSelect(ScrnInfoPtr pScrn)
     RHDFUNC(rhdPtr);
 
     /* housekeeping */
+	/* the real scanout buffers get allocated at mode set time */
 	rhdPtr->Crtc[0]->Offset = rhdPtr->FbFreeStart;
-	rhdPtr->Crtc[1]->Offset = rhdPtr->FbMapSize / 2;
+	rhdPtr->Crtc[1]->Offset = rhdPtr->FbFreeStart;
 	
 	for (i = 0;i < 2;i++) {
 		rhdPtr->Crtc[i]->PLL = rhdPtr->PLLs[i];
@@ -1493,12 +1508,88 @@ static void setupMirrorViewPort(ScrnInfoPtr pScrn, UInt32 *width, UInt32 *height
 		&& Crtc1 && Crtc1->Active && Crtc1->CurrentMode) {
 		*width = min(Crtc0->CurrentMode->CrtcHDisplay, Crtc1->CurrentMode->CrtcHDisplay);
 		*height = min(Crtc0->CurrentMode->CrtcVDisplay, Crtc1->CurrentMode->CrtcVDisplay);
-		Crtc1->Offset = Crtc0->Offset;
-	} else if (Crtc1->Active) {
-		Crtc1->Offset = rhdPtr->FbMapSize/2;
 	}
-	if (Crtc1->Active)
-		Crtc1->FBPhyAddress = (char *) ((unsigned long)rhdPtr->FbPhysBase + Crtc1->Offset);
+}
+
+static void
+rhdScanoutRelease(RHDPtr rhdPtr, struct rhdCrtc *Crtc)
+{
+	if (!Crtc->FbSize)
+		return;
+	RHDFbHeapFree(rhdPtr->FbHeap, Crtc->Offset);
+	Crtc->FbSize = 0;
+}
+
+/*
+ * Replace the scanout buffer of a head. The old buffer is given up first,
+ * so that the new one may take its place, and claimed back when nothing
+ * fits: the head keeps scanning out of it until it gets reprogrammed, and
+ * on failure it simply stays.
+ */
+static Bool
+rhdScanoutAlloc(RHDPtr rhdPtr, struct rhdCrtc *Crtc, CARD32 Size, CARD32 *Offset)
+{
+	CARD32 OldSize = Crtc->FbSize;
+	
+	if (OldSize)
+		RHDFbHeapFree(rhdPtr->FbHeap, Crtc->Offset);
+	if (RHDFbHeapAlloc(rhdPtr->FbHeap, Size, 0, RHD_FB_PLACE_LOW, 0,
+					   RHD_FB_USAGE_SCANOUT, Crtc->Name, Offset))
+		return TRUE;
+	if (OldSize)
+		RHDFbHeapReserve(rhdPtr->FbHeap, Crtc->Offset, OldSize,
+						 RHD_FB_USAGE_SCANOUT, Crtc->Name);
+	RHDFbHeapPrint(rhdPtr->FbHeap);
+	return FALSE;
+}
+
+/*
+ * Does the other head scan out of this head's buffer, as a mirror?
+ */
+static Bool
+rhdScanoutShared(RHDPtr rhdPtr, struct rhdCrtc *Crtc)
+{
+	struct rhdCrtc *Other = rhdPtr->Crtc[(Crtc == rhdPtr->Crtc[0]) ? 1 : 0];
+	
+	return Crtc->FbSize && Other && Other->Active && !Other->FbSize
+		&& (Other->Offset == Crtc->Offset);
+}
+
+/*
+ * Give a head a scanout buffer of at least Size bytes. An existing buffer
+ * is resized in place when possible so that the address the OS has for it
+ * stays put; a mirrored second head shares the buffer of the first.
+ * A shared buffer is never moved, as the OS framebuffer of the mirror
+ * would keep drawing at the old address. On failure the head keeps its
+ * old buffer.
+ */
+static Bool
+rhdScanoutSetup(RHDPtr rhdPtr, struct rhdCrtc *Crtc, CARD32 Size)
+{
+	struct rhdCrtc *Crtc0 = rhdPtr->Crtc[0];
+	CARD32 Offset;
+	
+	if (!rhdPtr->FbHeap)
+		return TRUE;
+	
+	if (rhdPtr->mirrored && (Crtc != Crtc0) && Crtc0->Active && Crtc0->FbSize) {
+		rhdScanoutRelease(rhdPtr, Crtc);
+		Crtc->Offset = Crtc0->Offset;
+	} else if (Crtc->FbSize && RHDFbHeapResize(rhdPtr->FbHeap, Crtc->Offset, Size)) {
+		Crtc->FbSize = RHD_FB_CHUNK(Size);
+	} else if (rhdScanoutShared(rhdPtr, Crtc)) {
+		LOG("%s: %s is mirrored, its buffer cannot grow in place\n", __func__,
+			Crtc->Name);
+		return FALSE;
+	} else {
+		if (!rhdScanoutAlloc(rhdPtr, Crtc, Size, &Offset))
+			return FALSE;
+		Crtc->Offset = Offset;
+		Crtc->FbSize = RHD_FB_CHUNK(Size);
+	}
+	
+	Crtc->FBPhyAddress = (char *) ((unsigned long)rhdPtr->FbPhysBase + Crtc->Offset);
+	return TRUE;
 }
 
 #ifndef __IOMACOSVIDEO__
@@ -1512,14 +1603,16 @@ enum {
 };
 #endif
 /*
- *
+ * FALSE when a head could not get a scanout buffer; that head is left as
+ * it was, the other one is set up all the same.
  */
-static void
+static Bool
 rhdSetMode(ScrnInfoPtr pScrn)
 {
     RHDPtr rhdPtr = RHDPTR(pScrn);
 	DisplayModePtr mode;
 	DisplayModeRec copy;
+	Bool ret = TRUE;
     int i;
 
     RHDFUNC(rhdPtr);
@@ -1527,6 +1620,7 @@ rhdSetMode(ScrnInfoPtr pScrn)
     /* Set up D1/D2 and appendages */
     for (i = 0; i < 2; i++) {
 		struct rhdCrtc *Crtc = rhdPtr->Crtc[i];
+		RHDFlipDestroy(rhdPtr, i);
 		if (Crtc->Active && Crtc->CurrentMode) {
 			bcopy(Crtc->CurrentMode, &copy, sizeof(DisplayModeRec));
 			mode = &copy;	//so that we can modify the mode safely
@@ -1541,6 +1635,12 @@ rhdSetMode(ScrnInfoPtr pScrn)
 			mode->CrtcVDisplay = newHeight;
 			newBitsPerPixel = pScrn->depth;
 			newRowBytes = getPitch(newWidth, newBitsPerPixel / 8);
+			if (!rhdScanoutSetup(rhdPtr, Crtc, newRowBytes * newHeight)) {
+				LOG("Crtc %d: no room for a %dx%d scanout buffer\n", Crtc->Id,
+					(int)newWidth, (int)newHeight);
+				ret = FALSE;
+				continue;
+			}
 			
 			Crtc->FBSet(Crtc, newRowBytes * 8 / newBitsPerPixel, newWidth, newHeight,
 						pScrn->depth, Crtc->Offset);
@@ -1566,6 +1666,9 @@ rhdSetMode(ScrnInfoPtr pScrn)
     }
 	
 	/* shut down that what we don't use */
+	for (i = 0; i < 2; i++)
+		if (!rhdPtr->Crtc[i]->Active)
+			rhdScanoutRelease(rhdPtr, rhdPtr->Crtc[i]);
 	RHDPLLsShutdownInactive(rhdPtr);
 	RHDOutputsShutdownInactive(rhdPtr);
 	
@@ -1580,6 +1683,8 @@ rhdSetMode(ScrnInfoPtr pScrn)
 		rhdPtr->Crtc[1]->Power(rhdPtr->Crtc[1], RHD_POWER_SHUTDOWN);
 	
 	RHDOutputsPower(rhdPtr, RHD_POWER_ON);
+	
+	return ret;
 }
 
 /*
@@ -2019,23 +2124,52 @@ rhdGetCardType(RHDPtr rhdPtr)
     return RHD_CARD_NONE;
 }
 
-/* Allocate a chunk of the framebuffer. -1 on fail. So far no free()! */
-unsigned int RHDAllocFb(RHDPtr rhdPtr, unsigned int size, const char *name)
+/*
+ * FbFreeStart/FbFreeSize describe the largest range that is free right
+ * now; mode validation works against this.
+ */
+static void
+rhdFbUpdateFree(RHDPtr rhdPtr)
+{
+    CARD32 Start, Size;
+
+    if (RHDFbHeapLargestFree(rhdPtr->FbHeap, &Start, &Size)) {
+	rhdPtr->FbFreeStart = Start;
+	rhdPtr->FbFreeSize = Size;
+    } else {
+	rhdPtr->FbFreeStart = 0;
+	rhdPtr->FbFreeSize = 0;
+    }
+}
+
+/* Allocate a chunk of the framebuffer. -1 on fail. */
+unsigned int RHDAllocFbPlaced(RHDPtr rhdPtr, unsigned int size, unsigned int align,
+			      int placement, unsigned int flags, int usage,
+			      const char *name)
 {
-    unsigned int chunk;
-    size = RHD_FB_CHUNK(size);
-    if (rhdPtr->FbFreeSize < size) {
-	LOG("FB: Failed allocating %s (%d KB)\n", name, size/1024);
+    CARD32 chunk;
+
+    if (!RHDFbHeapAlloc(rhdPtr->FbHeap, size, align, (enum rhdFbPlacement) placement,
+			flags, (enum rhdFbUsage) usage, name, &chunk)) {
+	LOG("FB: Failed allocating %s (%d KB)\n", name, RHD_FB_CHUNK(size)/1024);
 	return -1;
     }
-    chunk = rhdPtr->FbFreeStart;
-    rhdPtr->FbFreeStart += size;
-    rhdPtr->FbFreeSize  -= size;
-    LOG("FB: Allocated %s at offset 0x%08X (size = 0x%08X)\n",
-	       name, chunk, size);
+    rhdFbUpdateFree(rhdPtr);
     return chunk;
 }
 
+unsigned int RHDAllocFb(RHDPtr rhdPtr, unsigned int size, const char *name)
+{
+    return RHDAllocFbPlaced(rhdPtr, size, 0, RHD_FB_PLACE_BEST_FIT,
+			    0, RHD_FB_USAGE_OTHER, name);
+}
+
+void RHDFreeFb(RHDPtr rhdPtr, unsigned int offset)
+{
+    if (RHDFbHeapFree(rhdPtr->FbHeap, offset))
+	rhdFbUpdateFree(rhdPtr);
+}
+
 //reverse engineered code
 Bool isDisplayEnabled(RHDPtr rhdPtr, UInt8 index) {
 	if (index == 0) return (RHDRegRead(rhdPtr, D1CRTC_CONTROL) & 1);
@@ -2043,27 +2177,6 @@ Bool isDisplayEnabled(RHDPtr rhdPtr, UInt8 index) {
 	return TRUE;
 }
 
-void WaitForVBL(RHDPtr rhdPtr, UInt8 index, Bool noWait) {
-	UInt32 crtcStatusReg;
-	uint64_t deadline, now;
-	
-	if (index > 2) return;
-	if (!isDisplayEnabled(rhdPtr, index)) return;
-	crtcStatusReg = (index)?D2CRTC_STATUS:D1CRTC_STATUS;
-	if (!noWait) {
-		clock_interval_to_deadline(80, 1000000, &deadline);	//80ms
-		while(RHDRegRead(rhdPtr, crtcStatusReg) & 1) {
-			clock_get_uptime(&now);
-			if (now > deadline) break;
-		}
-	}
-	clock_interval_to_deadline(80, 1000000, &deadline);
-	while(!(RHDRegRead(rhdPtr, crtcStatusReg) & 1)) {
-		clock_get_uptime(&now);
-		if (now > deadline) break;
-	}
-}
-
 //Interface added by Dong
 
 Bool RadeonHDPreInit(ScrnInfoPtr pScrn) {
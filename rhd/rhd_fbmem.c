@@ -0,0 +1,487 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The heap is an address ordered list of blocks covering the whole range,
+ * used and free alike. Adjacent free blocks are always merged, so every
+ * free block is bounded by used blocks or the ends of the heap.
+ *
+ * Blocks never move once allocated: the hardware, AtomBIOS and the OS
+ * framebuffer all hold on to their offsets. Fragmentation is kept down by
+ * placement alone, scanout low, long lived small things high.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_fbmem.h"
+
+struct rhdFbBlock {
+    struct rhdFbBlock *Next;
+
+    CARD32 Offset;
+    CARD32 Size;
+    CARD32 Alignment;
+
+    Bool Used;
+    CARD32 Flags;
+    enum rhdFbUsage Usage;
+    const char *Name;
+};
+
+struct rhdFbHeap {
+    CARD32 Start;
+    CARD32 Size;
+
+    struct rhdFbBlock *Blocks;
+};
+
+static const char *rhdFbUsageNames[] = {
+    "other", "scanout", "cursor", "shadow", "scratch"
+};
+
+/*
+ *
+ */
+static struct rhdFbBlock *
+rhdFbBlockNew(CARD32 Offset, CARD32 Size)
+{
+    struct rhdFbBlock *Block = IONew(struct rhdFbBlock, 1);
+
+    if (!Block)
+	return NULL;
+    bzero(Block, sizeof(struct rhdFbBlock));
+    Block->Offset = Offset;
+    Block->Size = Size;
+    Block->Alignment = RHD_FB_ALIGNMENT;
+    return Block;
+}
+
+/*
+ * Split Block at Offset, returns the upper half.
+ */
+static struct rhdFbBlock *
+rhdFbBlockSplit(struct rhdFbBlock *Block, CARD32 Offset)
+{
+    struct rhdFbBlock *Upper =
+	rhdFbBlockNew(Offset, Block->Offset + Block->Size - Offset);
+
+    if (!Upper)
+	return NULL;
+    Upper->Next = Block->Next;
+    Block->Size = Offset - Block->Offset;
+    Block->Next = Upper;
+    return Upper;
+}
+
+/*
+ *
+ */
+static void
+rhdFbHeapMerge(struct rhdFbHeap *Heap)
+{
+    struct rhdFbBlock *Block = Heap->Blocks;
+
+    while (Block && Block->Next) {
+	struct rhdFbBlock *Next = Block->Next;
+
+	if (!Block->Used && !Next->Used) {
+	    Block->Size += Next->Size;
+	    Block->Next = Next->Next;
+	    IODelete(Next, struct rhdFbBlock, 1);
+	} else
+	    Block = Next;
+    }
+}
+
+/*
+ *
+ */
+static struct rhdFbBlock *
+rhdFbHeapFind(struct rhdFbHeap *Heap, CARD32 Offset)
+{
+    struct rhdFbBlock *Block;
+
+    for (Block = Heap->Blocks; Block; Block = Block->Next)
+	if (Block->Used && (Block->Offset == Offset))
+	    return Block;
+    return NULL;
+}
+
+/*
+ * Where in a free block would this fit? FALSE if it doesn't.
+ */
+static Bool
+rhdFbBlockFit(struct rhdFbBlock *Block, CARD32 Size, CARD32 Alignment,
+	      Bool High, CARD32 *Base)
+{
+    CARD32 Start;
+
+    if (Block->Used || (Block->Size < Size))
+	return FALSE;
+
+    if (High) {
+	Start = (Block->Offset + Block->Size - Size) & ~(Alignment - 1);
+	if (Start < Block->Offset)
+	    return FALSE;
+    } else {
+	Start = ALIGN(Block->Offset, Alignment);
+	if ((Start < Block->Offset)
+	    || ((Start - Block->Offset) > (Block->Size - Size)))
+	    return FALSE;
+    }
+
+    *Base = Start;
+    return TRUE;
+}
+
+/*
+ * Turn [Base, Base + Size) inside the free Block into a used block.
+ */
+static struct rhdFbBlock *
+rhdFbBlockCarve(struct rhdFbHeap *Heap, struct rhdFbBlock *Block,
+		CARD32 Base, CARD32 Size)
+{
+    if (Base > Block->Offset) {
+	Block = rhdFbBlockSplit(Block, Base);
+	if (!Block)
+	    return NULL;
+    }
+
+    if (Block->Size > Size) {
+	if (!rhdFbBlockSplit(Block, Base + Size)) {
+	    rhdFbHeapMerge(Heap);
+	    return NULL;
+	}
+    }
+
+    Block->Used = TRUE;
+    return Block;
+}
+
+/*
+ *
+ */
+struct rhdFbHeap *
+RHDFbHeapCreate(CARD32 Start, CARD32 Size)
+{
+    struct rhdFbHeap *Heap;
+
+    if (!Size)
+	return NULL;
+
+    Heap = IONew(struct rhdFbHeap, 1);
+    if (!Heap)
+	return NULL;
+    bzero(Heap, sizeof(struct rhdFbHeap));
+
+    Heap->Start = Start;
+    Heap->Size = Size;
+    Heap->Blocks = rhdFbBlockNew(Start, Size);
+    if (!Heap->Blocks) {
+	IODelete(Heap, struct rhdFbHeap, 1);
+	return NULL;
+    }
+
+    return Heap;
+}
+
+/*
+ *
+ */
+void
+RHDFbHeapDestroy(struct rhdFbHeap *Heap)
+{
+    struct rhdFbBlock *Block, *Next;
+
+    if (!Heap)
+	return;
+
+    for (Block = Heap->Blocks; Block; Block = Next) {
+	Next = Block->Next;
+	IODelete(Block, struct rhdFbBlock, 1);
+    }
+    IODelete(Heap, struct rhdFbHeap, 1);
+}
+
+/*
+ * Alignment has to be a power of two, 0 picks RHD_FB_ALIGNMENT.
+ */
+Bool
+RHDFbHeapAlloc(struct rhdFbHeap *Heap, CARD32 Size, CARD32 Alignment,
+	       enum rhdFbPlacement Placement, CARD32 Flags,
+	       enum rhdFbUsage Usage, const char *Name, CARD32 *Offset)
+{
+    struct rhdFbBlock *Block, *Best = NULL;
+    CARD32 Base, BestBase = 0;
+
+    if (!Heap || !Size)
+	return FALSE;
+
+    if (Alignment < RHD_FB_ALIGNMENT)
+	Alignment = RHD_FB_ALIGNMENT;
+    if ((Flags & RHD_FB_FLAG_TILED) && (Alignment < RHD_FB_TILE_ALIGNMENT))
+	Alignment = RHD_FB_TILE_ALIGNMENT;
+    Size = RHD_FB_CHUNK(Size);
+
+    for (Block = Heap->Blocks; Block; Block = Block->Next) {
+	if (!rhdFbBlockFit(Block, Size, Alignment,
+			   Placement == RHD_FB_PLACE_HIGH, &Base))
+	    continue;
+
+	if (Placement == RHD_FB_PLACE_LOW) {
+	    Best = Block;
+	    BestBase = Base;
+	    break;
+	}
+	/* the list is address ordered, so HIGH keeps the last match */
+	if ((Placement == RHD_FB_PLACE_HIGH) || !Best
+	    || (Block->Size < Best->Size)) {
+	    Best = Block;
+	    BestBase = Base;
+	}
+    }
+
+    if (!Best) {
+	LOG("FB: No room for %s (%u kB)\n", Name, (unsigned int)(Size / 1024));
+	return FALSE;
+    }
+
+    Block = rhdFbBlockCarve(Heap, Best, BestBase, Size);
+    if (!Block)
+	return FALSE;
+
+    Block->Alignment = Alignment;
+    Block->Flags = Flags;
+    Block->Usage = Usage;
+    Block->Name = Name;
+
+    LOG("FB: Allocated %s at offset 0x%08X (size = 0x%08X)\n",
+	Name, (unsigned int)Block->Offset, (unsigned int)Block->Size);
+
+    *Offset = Block->Offset;
+    return TRUE;
+}
+
+/*
+ * Claim a fixed range, for things whose location is dictated to us.
+ */
+Bool
+RHDFbHeapReserve(struct rhdFbHeap *Heap, CARD32 Offset, CARD32 Size,
+		 enum rhdFbUsage Usage, const char *Name)
+{
+    struct rhdFbBlock *Block;
+
+    if (!Heap || !Size)
+	return FALSE;
+
+    for (Block = Heap->Blocks; Block; Block = Block->Next) {
+	if (Block->Used || (Offset < Block->Offset)
+	    || ((Offset - Block->Offset) >= Block->Size)
+	    || (Size > (Block->Size - (Offset - Block->Offset))))
+	    continue;
+
+	Block = rhdFbBlockCarve(Heap, Block, Offset, Size);
+	if (!Block)
+	    return FALSE;
+
+	Block->Alignment = 1;
+	Block->Flags = 0;
+	Block->Usage = Usage;
+	Block->Name = Name;
+
+	LOG("FB: Reserved %s at offset 0x%08X (size = 0x%08X)\n",
+	    Name, (unsigned int)Offset, (unsigned int)Size);
+	return TRUE;
+    }
+
+    LOG("FB: Unable to reserve %s at 0x%08X (size = 0x%08X)\n",
+	Name, (unsigned int)Offset, (unsigned int)Size);
+    return FALSE;
+}
+
+/*
+ *
+ */
+Bool
+RHDFbHeapFree(struct rhdFbHeap *Heap, CARD32 Offset)
+{
+    struct rhdFbBlock *Block;
+
+    if (!Heap)
+	return FALSE;
+
+    Block = rhdFbHeapFind(Heap, Offset);
+    if (!Block) {
+	LOG("FB: Freeing unknown block at 0x%08X\n", (unsigned int)Offset);
+	return FALSE;
+    }
+
+    LOG("FB: Freed %s at offset 0x%08X (size = 0x%08X)\n",
+	Block->Name, (unsigned int)Block->Offset, (unsigned int)Block->Size);
+
+    Block->Used = FALSE;
+    Block->Flags = 0;
+    Block->Usage = RHD_FB_USAGE_OTHER;
+    Block->Name = NULL;
+    Block->Alignment = RHD_FB_ALIGNMENT;
+    rhdFbHeapMerge(Heap);
+
+    return TRUE;
+}
+
+/*
+ * Shrink or grow a block in place. Growing only works if the block
+ * directly above is free and large enough.
+ */
+Bool
+RHDFbHeapResize(struct rhdFbHeap *Heap, CARD32 Offset, CARD32 Size)
+{
+    struct rhdFbBlock *Block, *Next;
+
+    if (!Heap || !Size)
+	return FALSE;
+
+    Block = rhdFbHeapFind(Heap, Offset);
+    if (!Block)
+	return FALSE;
+
+    Size = RHD_FB_CHUNK(Size);
+    if (Size == Block->Size)
+	return TRUE;
+
+    if (Size < Block->Size) {
+	Next = rhdFbBlockSplit(Block, Block->Offset + Size);
+	if (!Next)
+	    return FALSE;
+	rhdFbHeapMerge(Heap);
+	return TRUE;
+    }
+
+    Next = Block->Next;
+    if (!Next || Next->Used || ((Size - Block->Size) > Next->Size))
+	return FALSE;
+
+    Next->Offset += Size - Block->Size;
+    Next->Size -= Size - Block->Size;
+    Block->Size = Size;
+    if (!Next->Size) {
+	Block->Next = Next->Next;
+	IODelete(Next, struct rhdFbBlock, 1);
+    }
+
+    return TRUE;
+}
+
+/*
+ * Largest free range.
+ */
+Bool
+RHDFbHeapLargestFree(struct rhdFbHeap *Heap, CARD32 *Start, CARD32 *Size)
+{
+    struct rhdFbBlock *Block;
+    CARD32 RunStart = 0, RunSize = 0;
+    Bool Found = FALSE;
+
+    if (!Heap)
+	return FALSE;
+
+    *Start = 0;
+    *Size = 0;
+
+    for (Block = Heap->Blocks; Block; Block = Block->Next) {
+	if (Block->Used) {
+	    RunSize = 0;
+	    continue;
+	}
+
+	if (!RunSize)
+	    RunStart = Block->Offset;
+	RunSize += Block->Size;
+
+	if (RunSize > *Size) {
+	    *Start = RunStart;
+	    *Size = RunSize;
+	    Found = TRUE;
+	}
+    }
+
+    return Found;
+}
+
+/*
+ *
+ */
+void
+RHDFbHeapStats(struct rhdFbHeap *Heap, struct rhdFbStats *Stats)
+{
+    struct rhdFbBlock *Block;
+
+    bzero(Stats, sizeof(struct rhdFbStats));
+    if (!Heap)
+	return;
+
+    Stats->Total = Heap->Size;
+    for (Block = Heap->Blocks; Block; Block = Block->Next) {
+	if (Block->Used) {
+	    Stats->Used += Block->Size;
+	    Stats->UsedBlocks++;
+	} else {
+	    Stats->Free += Block->Size;
+	    Stats->FreeBlocks++;
+	    if (Block->Size > Stats->LargestFree)
+		Stats->LargestFree = Block->Size;
+	}
+    }
+
+    if (Stats->Free)
+	Stats->Fragmentation = (int)
+	    (((uint64_t)(Stats->Free - Stats->LargestFree) * 100) / Stats->Free);
+}
+
+/*
+ *
+ */
+void
+RHDFbHeapPrint(struct rhdFbHeap *Heap)
+{
+    struct rhdFbBlock *Block;
+    struct rhdFbStats Stats;
+
+    if (!Heap)
+	return;
+
+    for (Block = Heap->Blocks; Block; Block = Block->Next) {
+	if (Block->Used)
+	    LOG("FB: 0x%08X - 0x%08X %-8s %s\n", (unsigned int)Block->Offset,
+		(unsigned int)(Block->Offset + Block->Size),
+		rhdFbUsageNames[Block->Usage], Block->Name ? Block->Name : "");
+	else
+	    LOG("FB: 0x%08X - 0x%08X free\n", (unsigned int)Block->Offset,
+		(unsigned int)(Block->Offset + Block->Size));
+    }
+
+    RHDFbHeapStats(Heap, &Stats);
+    LOG("FB: %u kB used in %d blocks, %u kB free in %d blocks "
+	"(largest %u kB, %d%% fragmented)\n",
+	(unsigned int)(Stats.Used / 1024), Stats.UsedBlocks,
+	(unsigned int)(Stats.Free / 1024), Stats.FreeBlocks,
+	(unsigned int)(Stats.LargestFree / 1024), Stats.Fragmentation);
+}
@@ -0,0 +1,76 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_FBMEM_H
+# define _RHD_FBMEM_H
+
+/*
+ * VRAM heap.
+ *
+ * Works on plain offsets only and never touches the hardware, so it can be
+ * driven over any address range. There is no compaction: blocks stay where
+ * they were placed.
+ */
+
+enum rhdFbUsage {
+    RHD_FB_USAGE_OTHER,
+    RHD_FB_USAGE_SCANOUT,
+    RHD_FB_USAGE_CURSOR,
+    RHD_FB_USAGE_SHADOW,
+    RHD_FB_USAGE_SCRATCH
+};
+
+enum rhdFbPlacement {
+    RHD_FB_PLACE_BEST_FIT,	/* smallest free block that fits */
+    RHD_FB_PLACE_LOW,		/* lowest address that fits */
+    RHD_FB_PLACE_HIGH		/* highest address that fits */
+};
+
+#define RHD_FB_FLAG_TILED	(1 << 1)	/* macro tiled surface */
+
+/* tiled surfaces have to start on a macro tile group boundary */
+#define RHD_FB_TILE_ALIGNMENT	0x8000
+
+struct rhdFbStats {
+    CARD32 Total;
+    CARD32 Used;
+    CARD32 Free;
+    CARD32 LargestFree;
+    int UsedBlocks;
+    int FreeBlocks;
+    int Fragmentation;	/* % of free space outside the largest free block */
+};
+
+struct rhdFbHeap;
+
+struct rhdFbHeap *RHDFbHeapCreate(CARD32 Start, CARD32 Size);
+void RHDFbHeapDestroy(struct rhdFbHeap *Heap);
+Bool RHDFbHeapAlloc(struct rhdFbHeap *Heap, CARD32 Size, CARD32 Alignment,
+		    enum rhdFbPlacement Placement, CARD32 Flags,
+		    enum rhdFbUsage Usage, const char *Name, CARD32 *Offset);
+Bool RHDFbHeapReserve(struct rhdFbHeap *Heap, CARD32 Offset, CARD32 Size,
+		      enum rhdFbUsage Usage, const char *Name);
+Bool RHDFbHeapFree(struct rhdFbHeap *Heap, CARD32 Offset);
+Bool RHDFbHeapResize(struct rhdFbHeap *Heap, CARD32 Offset, CARD32 Size);
+Bool RHDFbHeapLargestFree(struct rhdFbHeap *Heap, CARD32 *Start, CARD32 *Size);
+void RHDFbHeapStats(struct rhdFbHeap *Heap, struct rhdFbStats *Stats);
+void RHDFbHeapPrint(struct rhdFbHeap *Heap);
+
+#endif /* _RHD_FBMEM_H */
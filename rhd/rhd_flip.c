@@ -0,0 +1,312 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_crtc.h"
+#include "rhd_fbmem.h"
+#include "rhd_regs.h"
+#include "rhd_vblank.h"
+#include "rhd_flip.h"
+
+#define D1_REG_OFFSET 0x0000
+#define D2_REG_OFFSET 0x0800
+
+/* D1GRPH_UPDATE */
+#define GRPH_SURFACE_UPDATE_PENDING	(1 << 2)
+#define GRPH_UPDATE_LOCK		(1 << 16)
+/* D1GRPH_FLIP_CONTROL */
+#define GRPH_SURFACE_UPDATE_H_RETRACE_EN	(1 << 0)
+
+/* usecs for the address write to show up as pending */
+#define FLIP_PENDING_TIMEOUT	10
+
+/*
+ *
+ */
+static CARD16
+rhdFlipRegOff(int Id)
+{
+    if (Id == RHD_CRTC_1)
+	return D1_REG_OFFSET;
+    return D2_REG_OFFSET;
+}
+
+/*
+ * The lock keeps the CRTC from taking the address while it is only partly
+ * written; once released, the update is done at the next vertical blank.
+ */
+static void
+rhdFlipProgram(RHDPtr rhdPtr, int Id, struct rhdFlip *Flip, int Buffer)
+{
+    CARD16 RegOff = rhdFlipRegOff(Id);
+    CARD32 Address = rhdPtr->FbIntAddress + Flip->Offset[Buffer];
+    int i;
+
+    RHDRegMask(rhdPtr, RegOff + D1GRPH_UPDATE, GRPH_UPDATE_LOCK,
+	       GRPH_UPDATE_LOCK);
+
+    RHDRegWrite(rhdPtr, RegOff + D1GRPH_SECONDARY_SURFACE_ADDRESS, Address);
+    RHDRegWrite(rhdPtr, RegOff + D1GRPH_PRIMARY_SURFACE_ADDRESS, Address);
+
+    for (i = 0; i < FLIP_PENDING_TIMEOUT; i++) {
+	if (RHDRegRead(rhdPtr, RegOff + D1GRPH_UPDATE) &
+	    GRPH_SURFACE_UPDATE_PENDING)
+	    break;
+	IODelay(1);
+    }
+
+    RHDRegMask(rhdPtr, RegOff + D1GRPH_UPDATE, 0, GRPH_UPDATE_LOCK);
+
+    Flip->Pending = Buffer;
+    Flip->Flips++;
+}
+
+/*
+ * Back buffers are as large as the scanout buffer of the mode set. A head
+ * that mirrors the other one scans out the same buffer, and is not flipped.
+ */
+Bool
+RHDFlipInit(RHDPtr rhdPtr, int Id, int NumBuffers, rhdFlipDoneProc Done,
+	    void *Private)
+{
+    struct rhdCrtc *Crtc, *Other;
+    struct rhdFlip *Flip;
+    int i;
+
+    if ((Id < 0) || (Id > 1) || rhdPtr->Flip[Id])
+	return FALSE;
+    if ((NumBuffers < 2) || (NumBuffers > RHD_FLIP_BUFFERS_MAX))
+	return FALSE;
+
+    Crtc = rhdPtr->Crtc[Id];
+    if (!Crtc || !Crtc->Active || !Crtc->FbSize)
+	return FALSE;
+
+    Other = rhdPtr->Crtc[Id ^ 1];
+    if (Other && Other->Active && (Other->Offset == Crtc->Offset)) {
+	LOG("%s: %s shares its scanout buffer.\n", __func__, Crtc->Name);
+	return FALSE;
+    }
+
+    Flip = IONew(struct rhdFlip, 1);
+    if (!Flip)
+	return FALSE;
+    bzero(Flip, sizeof(struct rhdFlip));
+
+    Flip->Offset[0] = Crtc->Offset;
+    for (i = 1; i < NumBuffers; i++) {
+	Flip->Offset[i] = RHDAllocFbPlaced(rhdPtr, Crtc->FbSize, 0,
+					   RHD_FB_PLACE_HIGH, 0,
+					   RHD_FB_USAGE_SCANOUT, "Back buffer");
+	if (Flip->Offset[i] == (CARD32) -1) {
+	    while (--i)
+		RHDFreeFb(rhdPtr, Flip->Offset[i]);
+	    IODelete(Flip, struct rhdFlip, 1);
+	    return FALSE;
+	}
+    }
+
+    Flip->NumBuffers = NumBuffers;
+    Flip->Front = 0;
+    Flip->Pending = -1;
+    Flip->Queued = -1;
+    Flip->Done = Done;
+    Flip->Private = Private;
+
+    /* take new addresses at vertical, not horizontal, retrace */
+    RHDRegMask(rhdPtr, rhdFlipRegOff(Id) + D1GRPH_FLIP_CONTROL, 0,
+	       GRPH_SURFACE_UPDATE_H_RETRACE_EN);
+
+    rhdPtr->Flip[Id] = Flip;
+
+    LOG("%s: %s flips between %d buffers.\n", __func__, Crtc->Name,
+	NumBuffers);
+    return TRUE;
+}
+
+/*
+ * Drops a queued flip, and puts the buffer of the mode set back up, without
+ * telling Done about either.
+ */
+void
+RHDFlipDestroy(RHDPtr rhdPtr, int Id)
+{
+    struct rhdFlip *Flip;
+    int i;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Flip[Id])
+	return;
+    Flip = rhdPtr->Flip[Id];
+
+    Flip->Done = NULL;
+    Flip->Queued = -1;
+    RHDFlipWait(rhdPtr, Id);
+    if (Flip->Front) {
+	rhdFlipProgram(rhdPtr, Id, Flip, 0);
+	RHDFlipWait(rhdPtr, Id);
+    }
+
+    for (i = 1; i < Flip->NumBuffers; i++)
+	RHDFreeFb(rhdPtr, Flip->Offset[i]);
+
+    LOG("Flip CRTC %d: %u flips, %u latched, %u stalls.\n", Id + 1,
+	(unsigned int) Flip->Flips, (unsigned int) Flip->Latched,
+	(unsigned int) Flip->Stalls);
+
+    IODelete(Flip, struct rhdFlip, 1);
+    rhdPtr->Flip[Id] = NULL;
+}
+
+/*
+ * A buffer that is neither scanned out nor waiting to be, to draw into, or
+ * -1 when there is none; RHDFlipWait frees one up then.
+ */
+int
+RHDFlipBackBuffer(RHDPtr rhdPtr, int Id)
+{
+    struct rhdFlip *Flip;
+    int i;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Flip[Id])
+	return -1;
+    Flip = rhdPtr->Flip[Id];
+
+    RHDFlipPoll(rhdPtr, Id);
+
+    for (i = 0; i < Flip->NumBuffers; i++)
+	if ((i != Flip->Front) && (i != Flip->Pending) && (i != Flip->Queued))
+	    return i;
+
+    return -1;
+}
+
+/*
+ * Flips to Buffer at the next vertical blank, or at the one after the flip
+ * that is still pending. Only one flip can wait behind a pending one.
+ */
+Bool
+RHDFlipQueue(RHDPtr rhdPtr, int Id, int Buffer)
+{
+    struct rhdFlip *Flip;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Flip[Id])
+	return FALSE;
+    Flip = rhdPtr->Flip[Id];
+
+    if ((Buffer < 0) || (Buffer >= Flip->NumBuffers) ||
+	(Buffer == Flip->Front) || (Buffer == Flip->Pending) ||
+	(Buffer == Flip->Queued))
+	return FALSE;
+
+    RHDFlipPoll(rhdPtr, Id);
+
+    if (Flip->Pending < 0)
+	rhdFlipProgram(rhdPtr, Id, Flip, Buffer);
+    else if (Flip->Queued < 0)
+	Flip->Queued = Buffer;
+    else
+	return FALSE;
+
+    return TRUE;
+}
+
+/*
+ * The pending flip becomes the front buffer, the queued one goes out, and
+ * Done hears about it.
+ */
+static void
+rhdFlipRetire(RHDPtr rhdPtr, int Id, struct rhdFlip *Flip,
+	      unsigned long long Stamp)
+{
+    Flip->Front = Flip->Pending;
+    Flip->Pending = -1;
+    Flip->Latched++;
+
+    if (Flip->Queued >= 0) {
+	rhdFlipProgram(rhdPtr, Id, Flip, Flip->Queued);
+	Flip->Queued = -1;
+    }
+
+    if (Flip->Done)
+	Flip->Done(Flip->Private, Id, Flip->Offset[Flip->Front], Stamp);
+}
+
+/*
+ * Retires the pending flip when the CRTC has taken it, and programs the
+ * queued one. To be called at least once a frame while flips are pending,
+ * for the stamps to be right.
+ */
+void
+RHDFlipPoll(RHDPtr rhdPtr, int Id)
+{
+    struct rhdFlip *Flip;
+    unsigned long long Stamp = 0;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Flip[Id])
+	return;
+    Flip = rhdPtr->Flip[Id];
+
+    if (Flip->Pending < 0)
+	return;
+    if (RHDRegRead(rhdPtr, rhdFlipRegOff(Id) + D1GRPH_UPDATE) &
+	GRPH_SURFACE_UPDATE_PENDING)
+	return;
+
+    RHDVBlankLast(rhdPtr, Id, &Stamp);
+    rhdFlipRetire(rhdPtr, Id, Flip, Stamp);
+}
+
+/*
+ * Sleeps until the flip that is pending now has latched. FALSE when the
+ * CRTC stopped scanning out; the flip is retired as if it had latched then,
+ * with a Stamp of 0, and the queued one is programmed.
+ */
+Bool
+RHDFlipWait(RHDPtr rhdPtr, int Id)
+{
+    struct rhdFlip *Flip;
+    CARD32 Latched;
+    int i;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Flip[Id])
+	return FALSE;
+    Flip = rhdPtr->Flip[Id];
+
+    RHDFlipPoll(rhdPtr, Id);
+    if (Flip->Pending < 0)
+	return TRUE;
+
+    Flip->Stalls++;
+    Latched = Flip->Latched;
+
+    /* the address might have been written just after a blank began */
+    for (i = 0; i < 2; i++) {
+	if (!RHDVBlankWait(rhdPtr, Id, TRUE, NULL))
+	    break;
+	RHDFlipPoll(rhdPtr, Id);
+	if (Flip->Latched != Latched)
+	    return TRUE;
+    }
+
+    rhdFlipRetire(rhdPtr, Id, Flip, 0);
+    return FALSE;
+}
@@ -0,0 +1,72 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_FLIP_H
+# define _RHD_FLIP_H
+
+/*
+ * Page flipping between scanout buffers of a CRTC.
+ *
+ * Next to the buffer from the mode set, one or two back buffers are taken
+ * from the framebuffer heap. A flip only programs the surface address under
+ * the update lock; the CRTC takes it at the start of its next vertical
+ * blank. Nothing raises an interrupt for that, so RHDFlipPoll has to be
+ * called, and it tells through Done. With three buffers one more flip can
+ * be queued behind the one waiting to latch.
+ *
+ * A mode set ends flipping, as the buffers no longer fit.
+ *
+ * Nothing in this driver flips yet: the framebuffer handed to the system
+ * always draws into Offset[0], so a consumer first has to render into the
+ * back buffers itself.
+ */
+
+#define RHD_FLIP_BUFFERS_MAX	3
+
+/* Offset has latched; Stamp is when the blank it latched in began */
+typedef void (*rhdFlipDoneProc)(void *Private, int Id, CARD32 Offset,
+				unsigned long long Stamp);
+
+struct rhdFlip {
+    int NumBuffers;
+    CARD32 Offset[RHD_FLIP_BUFFERS_MAX];	/* [0] is the mode set one */
+
+    int Front;		/* being scanned out */
+    int Pending;	/* programmed, not latched yet, or -1 */
+    int Queued;		/* programmed once Pending latched, or -1 */
+
+    rhdFlipDoneProc Done;
+    void *Private;
+
+    /* statistics */
+    CARD32 Flips;
+    CARD32 Latched;
+    CARD32 Stalls;	/* waits for a back buffer to free up */
+};
+
+Bool RHDFlipInit(RHDPtr rhdPtr, int Id, int NumBuffers, rhdFlipDoneProc Done,
+		 void *Private);
+void RHDFlipDestroy(RHDPtr rhdPtr, int Id);
+int RHDFlipBackBuffer(RHDPtr rhdPtr, int Id);
+Bool RHDFlipQueue(RHDPtr rhdPtr, int Id, int Buffer);
+void RHDFlipPoll(RHDPtr rhdPtr, int Id);
+Bool RHDFlipWait(RHDPtr rhdPtr, int Id);
+
+#endif /* _RHD_FLIP_H */
@@ -39,6 +39,11 @@ enum HdmiColorFormat {
     YCC_444 = 2
 };
 
+/*
+ * Clocks at 1/1.001 of a round rate cannot be given exactly in kHz, and
+ * most of them do not have an integer solution anyway. These use the values
+ * from the HDMI specification, everything else is solved for.
+ */
 struct {
     CARD32 Clock;
 
@@ -55,26 +60,108 @@ struct {
     /*             32kHz          44.1kHz        48kHz    */
     /* Clock      N     CTS      N     CTS      N     CTS */
     {  25174,  4576,  28125,  7007,  31250,  6864,  28125 }, /*  25,20/1.001 MHz */
-    {  25200,  4096,  25200,  6272,  28000,  6144,  25200 }, /*  25.20       MHz */
-    {  27000,  4096,  27000,  6272,  30000,  6144,  27000 }, /*  27.00       MHz */
-    {  27027,  4096,  27027,  6272,  30030,  6144,  27027 }, /*  27.00*1.001 MHz */
-    {  54000,  4096,  54000,  6272,  60000,  6144,  54000 }, /*  54.00       MHz */
-    {  54054,  4096,  54054,  6272,  60060,  6144,  54054 }, /*  54.00*1.001 MHz */
     {  74175, 11648, 210937, 17836, 234375, 11648, 140625 }, /*  74.25/1.001 MHz */
-    {  74250,  4096,  74250,  6272,  82500,  6144,  74250 }, /*  74.25       MHz */
     { 148351, 11648, 421875,  8918, 234375,  5824, 140625 }, /* 148.50/1.001 MHz */
-    { 148500,  4096, 148500,  6272, 165000,  6144, 148500 }, /* 148.50       MHz */
-    {      0,  4096,      0,  6272,      0,  6144,      0 }  /* Other */
+    {      0,     0,      0,     0,      0,     0,      0 }  /* Other */
 };
 
+/* CTS is a 20 bit field */
+#define HDMI_ACR_CTS_MAX 0xFFFFF
+
+static CARD32
+HdmiGcd(CARD32 a, CARD32 b)
+{
+    while (b) {
+	CARD32 t = a % b;
+	a = b;
+	b = t;
+    }
+    return a;
+}
+
 /*
- * calculate CTS value if it's not found in the table
+ * 128 * freq * CTS = Clock * N has to hold exactly, with N between
+ * 128 * freq / 1500 and 128 * freq / 300. Clock * 1000 and 128 * freq share
+ * a lot of factors, so N only has to be a multiple of what is left of the
+ * latter, and the one closest to the recommended N is taken. Where no
+ * such multiple is in range, the recommended N is kept and CTS is rounded.
+ * That never happens for 32 and 48kHz, nor for any clock on a 10kHz grid,
+ * but the 44.1kHz family needs the 7 * 7 in 44100 out of the clock and so
+ * has no exact solution for a good part of the odd kHz clocks.
+ *
+ * Returns whether the solution is exact.
  */
-static void
-HdmiCalcCTS(struct rhdHdmi *hdmi, CARD32 Clock, int* CTS, int N, int freq)
+static Bool
+HdmiSolveACR(CARD32 Clock, int freq, int *N, int *CTS)
 {
-    if(*CTS == 0) *CTS = (long long)Clock*1000*N/(128*freq);
-    LOG("Using ACR timing N=%d CTS=%d for frequency %d\n",N,*CTS,freq);
+    CARD32 Den = 128 * freq;
+    CARD32 Step = Den / HdmiGcd(Clock * 1000, Den);
+    int Rec, Min, Max, Lo, Hi;
+
+    /* recommended values, for 32kHz, 44.1kHz, 48kHz and their multiples */
+    if (!(freq % 32000))
+	Rec = 4096 * (freq / 32000);
+    else if (!(freq % 44100))
+	Rec = 6272 * (freq / 44100);
+    else
+	Rec = 6144 * (freq / 48000);
+
+    Min = (Den + 1499) / 1500;
+    Max = Den / 300;
+
+    Lo = (Rec / Step) * Step;
+    Hi = Lo + Step;
+    if ((Lo < Min) || ((Hi <= Max) && ((Hi - Rec) < (Rec - Lo))))
+	Lo = Hi;
+
+    if ((Lo >= Min) && (Lo <= Max) &&
+	(((unsigned long long)Clock * 1000 * Lo) / Den <= HDMI_ACR_CTS_MAX)) {
+	*N = Lo;
+	*CTS = ((unsigned long long)Clock * 1000 * Lo) / Den;
+	return TRUE;
+    }
+
+    *N = Rec;
+    *CTS = ((unsigned long long)Clock * 1000 * Rec + Den / 2) / Den;
+    return FALSE;
+}
+
+/*
+ * Solves all three rates for a clock, or finds it in the cache.
+ */
+static struct rhdHdmiACR *
+HdmiACRLookup(struct rhdHdmi *hdmi, CARD32 Clock)
+{
+    static const int freq[RHD_HDMI_ACR_RATES] = { 32000, 44100, 48000 };
+    struct rhdHdmiACR *ACR;
+    int i, j;
+
+    for (i = 0; i < RHD_HDMI_ACR_CACHE; i++)
+	if (hdmi->ACRCache[i].Clock == Clock)
+	    return &hdmi->ACRCache[i];
+
+    ACR = &hdmi->ACRCache[hdmi->ACRCacheNext];
+    hdmi->ACRCacheNext = (hdmi->ACRCacheNext + 1) % RHD_HDMI_ACR_CACHE;
+
+    ACR->Clock = Clock;
+
+    for (i = 0; AudioClockRegeneration[i].Clock != Clock && AudioClockRegeneration[i].Clock != 0; i++);
+    if (AudioClockRegeneration[i].Clock) {
+	ACR->N[0] = AudioClockRegeneration[i].N_32kHz;
+	ACR->CTS[0] = AudioClockRegeneration[i].CTS_32kHz;
+	ACR->N[1] = AudioClockRegeneration[i].N_44_1kHz;
+	ACR->CTS[1] = AudioClockRegeneration[i].CTS_44_1kHz;
+	ACR->N[2] = AudioClockRegeneration[i].N_48kHz;
+	ACR->CTS[2] = AudioClockRegeneration[i].CTS_48kHz;
+	return ACR;
+    }
+
+    for (j = 0; j < RHD_HDMI_ACR_RATES; j++)
+	if (!HdmiSolveACR(Clock, freq[j], &ACR->N[j], &ACR->CTS[j]))
+	    LOG("%s: No exact ACR timing for %d Hz at %u kHz, using N=%d CTS=%d\n",
+		__func__, freq[j], (unsigned int) Clock, ACR->N[j], ACR->CTS[j]);
+
+    return ACR;
 }
 
 /*
@@ -83,41 +170,37 @@ HdmiCalcCTS(struct rhdHdmi *hdmi, CARD32 Clock, int* CTS, int N, int freq)
 static void
 HdmiAudioClockRegeneration(struct rhdHdmi *hdmi, CARD32 Clock)
 {
-    int CTS;
-    int N;
-    int i;
-    for(i=0; AudioClockRegeneration[i].Clock != Clock && AudioClockRegeneration[i].Clock != 0; i++);
-
-    CTS = AudioClockRegeneration[i].CTS_32kHz;
-    N = AudioClockRegeneration[i].N_32kHz;
-    HdmiCalcCTS(hdmi, Clock, &CTS, N, 32000);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_32kHz_CTS, CTS << 12);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_32kHz_N, N);
-
-    CTS = AudioClockRegeneration[i].CTS_44_1kHz;
-    N = AudioClockRegeneration[i].N_44_1kHz;
-    HdmiCalcCTS(hdmi, Clock, &CTS, N, 44100);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_44_1kHz_CTS, CTS << 12);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_44_1kHz_N, N);
-
-    CTS = AudioClockRegeneration[i].CTS_48kHz;
-    N = AudioClockRegeneration[i].N_48kHz;
-    HdmiCalcCTS(hdmi, Clock, &CTS, N, 48000);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_48kHz_CTS, CTS << 12);
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_48kHz_N, N);
+    struct rhdHdmiACR *ACR = HdmiACRLookup(hdmi, Clock);
+
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_32kHz_CTS, ACR->CTS[0] << 12);
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_32kHz_N, ACR->N[0]);
+
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_44_1kHz_CTS, ACR->CTS[1] << 12);
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_44_1kHz_N, ACR->N[1]);
+
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_48kHz_CTS, ACR->CTS[2] << 12);
+    RHDRegWrite(hdmi, hdmi->Offset+HDMI_48kHz_N, ACR->N[2]);
 }
 
 /*
- * calculate the crc for a given info frame
+ * register writes for the infoframe slots
  */
 static void
-HdmiInfoFrameChecksum(CARD8 packetType, CARD8 versionNumber, CARD8 length, CARD8* frame)
+HdmiInfoFrameWrite(void *Private, CARD32 Reg, CARD32 Value)
 {
-    int i;
-    frame[0] = packetType + versionNumber + length;
-    for(i=1;i<=length;i++)
-	frame[0] += frame[i];
-    frame[0] = 0x100 - frame[0];
+    struct rhdHdmi *hdmi = Private;
+
+    RHDRegWrite(hdmi, Reg, Value);
+}
+
+/*
+ * write out what changed in the info frames
+ */
+static void
+HdmiInfoFrameFlush(struct rhdHdmi *hdmi)
+{
+    RHDInfoFrameSlotFlush(&hdmi->VideoInfoFrame, HdmiInfoFrameWrite, hdmi);
+    RHDInfoFrameSlotFlush(&hdmi->AudioInfoFrame, HdmiInfoFrameWrite, hdmi);
 }
 
 /*
@@ -145,45 +228,29 @@ HdmiVideoInfoFrame(
     CARD16 RightBar
 )
 {
-    CARD8 frame[14];
-
-    frame[0x0] = 0;
-    frame[0x1] =
-	(ScanInformation & 0x3) |
-	((BarInfoDataValid & 0x3) << 2) |
-	((ActiveInformationPresent & 0x1) << 4) |
-	((ColorFormat & 0x3) << 5);
-    frame[0x2] =
-	(ActiveFormatAspectRatio & 0xF) |
-	((PictureAspectRatio & 0x3) << 4) |
-	((Colorimetry & 0x3) << 6);
-    frame[0x3] =
-	(NonUniformPictureScaling & 0x3) |
-	((Quantization & 0x3) << 2) |
-	((ExColorimetry & 0x7) << 4) |
-	((ITC & 0x1) << 7);
-    frame[0x4] = (VideoFormatIdentification & 0x7F);
-    frame[0x5] = (PixelRepetition & 0xF);
-    frame[0x6] = (TopBar & 0xFF);
-    frame[0x7] = (TopBar >> 8);
-    frame[0x8] = (BottomBar & 0xFF);
-    frame[0x9] = (BottomBar >> 8);
-    frame[0xA] = (LeftBar & 0xFF);
-    frame[0xB] = (LeftBar >> 8);
-    frame[0xC] = (RightBar & 0xFF);
-    frame[0xD] = (RightBar >> 8);
-
-    HdmiInfoFrameChecksum(0x82, 0x02, 0x0D, frame);
-
-
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_VIDEOINFOFRAME_0,
-	frame[0x0] | (frame[0x1] << 8) | (frame[0x2] << 16) | (frame[0x3] << 24));
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_VIDEOINFOFRAME_1,
-	frame[0x4] | (frame[0x5] << 8) | (frame[0x6] << 16) | (frame[0x7] << 24));
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_VIDEOINFOFRAME_2,
-	frame[0x8] | (frame[0x9] << 8) | (frame[0xA] << 16) | (frame[0xB] << 24));
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_VIDEOINFOFRAME_3,
-	frame[0xC] | (frame[0xD] << 8));
+    struct rhdInfoFrameAVI AVI;
+    struct rhdInfoFrame frame;
+
+    AVI.ColorFormat = ColorFormat;
+    AVI.ActiveInformationPresent = ActiveInformationPresent;
+    AVI.ActiveFormatAspectRatio = ActiveFormatAspectRatio;
+    AVI.ScanInformation = ScanInformation;
+    AVI.Colorimetry = Colorimetry;
+    AVI.ExColorimetry = ExColorimetry;
+    AVI.Quantization = Quantization;
+    AVI.ITC = ITC;
+    AVI.PictureAspectRatio = PictureAspectRatio;
+    AVI.VideoFormatIdentification = VideoFormatIdentification;
+    AVI.PixelRepetition = PixelRepetition;
+    AVI.NonUniformPictureScaling = NonUniformPictureScaling;
+    AVI.BarInfoDataValid = BarInfoDataValid;
+    AVI.TopBar = TopBar;
+    AVI.BottomBar = BottomBar;
+    AVI.LeftBar = LeftBar;
+    AVI.RightBar = RightBar;
+
+    RHDInfoFrameAVI(&frame, &AVI);
+    RHDInfoFrameSlotSet(&hdmi->VideoInfoFrame, &frame);
 }
 
 /*
@@ -202,26 +269,20 @@ HdmiAudioInfoFrame(
     Bool DownmixInhibit
 )
 {
-    CARD8 frame[11];
-
-    frame[0x0] = 0;
-    frame[0x1] = (ChannelCount & 0x7) | ((CodingType & 0xF) << 4);
-    frame[0x2] = (SampleSize & 0x3) | ((SampleFrequency & 0x7) << 2);
-    frame[0x3] = Format;
-    frame[0x4] = ChannelAllocation;
-    frame[0x5] = ((LevelShift & 0xF) << 3) | ((DownmixInhibit & 0x1) << 7);
-    frame[0x6] = 0;
-    frame[0x7] = 0;
-    frame[0x8] = 0;
-    frame[0x9] = 0;
-    frame[0xA] = 0;
-
-    HdmiInfoFrameChecksum(0x84, 0x01, 0x0A, frame);
-
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_AUDIOINFOFRAME_0,
-	frame[0x0] | (frame[0x1] << 8) | (frame[0x2] << 16) | (frame[0x3] << 24));
-    RHDRegWrite(hdmi, hdmi->Offset+HDMI_AUDIOINFOFRAME_1,
-	frame[0x4] | (frame[0x5] << 8) | (frame[0x6] << 16) | (frame[0x8] << 24));
+    struct rhdInfoFrameAudio Audio;
+    struct rhdInfoFrame frame;
+
+    Audio.ChannelCount = ChannelCount;
+    Audio.CodingType = CodingType;
+    Audio.SampleSize = SampleSize;
+    Audio.SampleFrequency = SampleFrequency;
+    Audio.Format = Format;
+    Audio.ChannelAllocation = ChannelAllocation;
+    Audio.LevelShift = LevelShift;
+    Audio.DownmixInhibit = DownmixInhibit;
+
+    RHDInfoFrameAudio(&frame, &Audio);
+    RHDInfoFrameSlotSet(&hdmi->AudioInfoFrame, &frame);
 }
 
 /*
@@ -288,6 +349,10 @@ RHDHdmiInit(RHDPtr rhdPtr, struct rhdOutput* Output)
 		return NULL;
 		break;
 	}
+	/* the audio frame registers end before the payload does */
+	RHDInfoFrameSlotInit(&hdmi->VideoInfoFrame, hdmi->Offset+HDMI_VIDEOINFOFRAME_0, 4);
+	RHDInfoFrameSlotInit(&hdmi->AudioInfoFrame, hdmi->Offset+HDMI_AUDIOINFOFRAME_0, 2);
+
 	hdmi->Stored = FALSE;
 	//RHDAudioRegisterHdmi(rhdPtr, hdmi);
 	return hdmi;
@@ -320,6 +385,7 @@ RHDHdmiSetMode(struct rhdHdmi *hdmi, DisplayModePtr Mode)
 
     HdmiVideoInfoFrame(hdmi, RGB, FALSE, 0, 0, 0,
 	0, 0, FALSE, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    HdmiInfoFrameFlush(hdmi);
 
     /* audio packets per line, does anyone know how to calc this ? */
     RHDRegMask(hdmi, hdmi->Offset+HDMI_CNTL, 0x020000, 0x1F0000);
@@ -392,6 +458,7 @@ RHDHdmiUpdateAudioSettings(
     /* 0x021 or 0x031 sets the audio frame length */ /*
     RHDRegWrite(hdmi, hdmi->Offset+HDMI_AUDIOCNTL, 0x31);
     HdmiAudioInfoFrame(hdmi, channels-1, 0, 0, 0, 0, 0, 0, FALSE);
+    HdmiInfoFrameFlush(hdmi);
 
     /* RHDRegMask(hdmi, hdmi->Offset+HDMI_CNTL, 0x4000000, 0x4000000); */ /*
     RHDRegMask(hdmi, hdmi->Offset+HDMI_CNTL, 0x400000, 0x400000);
@@ -528,6 +595,9 @@ RHDHdmiRestore(struct rhdHdmi *hdmi)
     RHDRegWrite(hdmi, hdmi->Offset+HDMI_UNKNOWN_0, hdmi->StoreUnknown[0x0]);
     RHDRegWrite(hdmi, hdmi->Offset+HDMI_UNKNOWN_1, hdmi->StoreUnknown[0x1]);
     RHDRegWrite(hdmi, hdmi->Offset+HDMI_UNKNOWN_2, hdmi->StoreUnknown[0x2]);
+
+    RHDInfoFrameSlotInvalidate(&hdmi->VideoInfoFrame);
+    RHDInfoFrameSlotInvalidate(&hdmi->AudioInfoFrame);
 }
 
 /*
@@ -27,6 +27,18 @@
 #ifndef _RHD_HDMI_H
 #define _RHD_HDMI_H
 
+#include "rhd_infoframe.h"
+
+/* audio clock regeneration values for 32kHz, 44.1kHz and 48kHz */
+#define RHD_HDMI_ACR_RATES 3
+#define RHD_HDMI_ACR_CACHE 4
+
+struct rhdHdmiACR {
+	CARD32 Clock;	/* kHz, 0 when unused */
+	int N[RHD_HDMI_ACR_RATES];
+	int CTS[RHD_HDMI_ACR_RATES];
+};
+
 struct rhdHdmi {
 	struct rhdHdmi* Next;
 
@@ -57,13 +69,20 @@ struct rhdHdmi {
 	CARD32 Store_48kHz_CTS;
 
 	CARD32 StoreIEC60958[2];
+
+	/* what was last written to the info frame registers */
+	struct rhdInfoFrameSlot VideoInfoFrame;
+	struct rhdInfoFrameSlot AudioInfoFrame;
+
+	struct rhdHdmiACR ACRCache[RHD_HDMI_ACR_CACHE];
+	int ACRCacheNext;
 };
 
 struct rhdHdmi* RHDHdmiInit(RHDPtr rhdPtr, struct rhdOutput* Output);
 
 void RHDHdmiSetMode(struct rhdHdmi* rhdHdmi, DisplayModePtr Mode);
 void RHDHdmiEnable(struct rhdHdmi* rhdHdmi, Bool Enable);
-/*
+/* commented out along with its definition, as rhd_audio.c is not built
 void RHDHdmiUpdateAudioSettings(
 	struct rhdHdmi* rhdHdmi,
 	Bool playing,
@@ -78,6 +78,13 @@ typedef struct _rhdI2CRec
 		} Gpio;
     } u;
     int scrnIndex;
+    CARD8 ddcTiming;		/* index into rhdDDCTimings[], current transfer */
+    CARD8 ddcEdidTiming;	/* for the EDID EEPROM at 0xA0 */
+    Bool ddcTimingValid;	/* ddcEdidTiming negotiated against the attached monitor */
+    CARD8 ddcEdidId[10];	/* EDID vendor/product/serial/date of that monitor */
+    CARD8 ddcciTiming;		/* for the DDC/CI device at 0x6E */
+    Bool ddcciTimingValid;	/* ddcciTiming confirmed by a checksummed reply */
+    uint64_t ddcciReady;	/* uptime at which the next DDC/CI message may go out */
 } rhdI2CRec;
 
 enum _rhdR6xxI2CBits {
@@ -1535,6 +1542,47 @@ static void DDCSetSense(I2CBusPtr I2CPtr, int line, UInt8 sense) {
 	RHDRegWrite(I2CPtr, info.regEnable, En);
 }
 
+/*
+ * Bit-bang timing profiles. All values are in usecs; a value of 0 means
+ * that the MMIO access itself provides enough settle time.
+ *   settle:  after each SCL/SDA line change
+ *   setup:   start/stop setup and hold time
+ *   high:    SCL high period before sampling/releasing
+ *   poll:    clock stretching poll interval
+ *   stretch: maximum time a slave may hold SCL low
+ * The legacy profile reproduces the old hardcoded behaviour and is what
+ * a bus uses until it has been negotiated against the attached monitor.
+ */
+enum rhdDDCTimingIndex {
+    RHD_DDC_TIMING_LEGACY = 0,
+    RHD_DDC_TIMING_STANDARD,	/* 100kHz */
+    RHD_DDC_TIMING_FAST,	/* 400kHz */
+    RHD_DDC_TIMING_FAST_PLUS,	/* 1MHz */
+    RHD_DDC_TIMING_COUNT
+};
+
+static const struct rhdDDCTiming {
+    const char *name;
+    CARD8 settle;
+    CARD8 setup;
+    CARD8 high;
+    CARD8 poll;
+    CARD16 stretch;
+} rhdDDCTimings[RHD_DDC_TIMING_COUNT] = {
+    { "legacy",    5, 15, 10, 10, 5000 },
+    { "standard",  2,  5,  4,  5, 5000 },
+    { "fast",      1,  1,  1,  2, 2500 },
+    { "fast-plus", 0,  1,  0,  1, 1000 }
+};
+
+#define DDC_TIMING(I2CPtr) \
+    (&rhdDDCTimings[((rhdI2CPtr)((I2CPtr)->DriverPrivate.ptr))->ddcTiming])
+
+static inline void DDCDelay(unsigned int usec) {
+	if (usec)
+		IODelay(usec);
+}
+
 static UInt8 clockData;
 
 static void DDCSetClock(I2CBusPtr I2CPtr, int line, UInt8 data) {	
@@ -1542,7 +1590,7 @@ static void DDCSetClock(I2CBusPtr I2CPtr, int line, UInt8 data) {
 	if (data) outByte |= 2;
 	else outByte &= 0xFD;
 	DDCSetSense(I2CPtr, line, outByte);
-	IODelay(5);
+	DDCDelay(DDC_TIMING(I2CPtr)->settle);
 	clockData = outByte;
 }
 
@@ -1555,7 +1603,7 @@ static void DDCSetData(I2CBusPtr I2CPtr, int line, UInt8 data) {
 	if (data) outByte |= 4;
 	else outByte &= 0xFB;
 	DDCSetSense(I2CPtr, line, outByte);
-	IODelay(5);
+	DDCDelay(DDC_TIMING(I2CPtr)->settle);
 	clockData = outByte;
 }
 
@@ -1566,14 +1614,14 @@ static UInt8 DDCGetData(I2CBusPtr I2CPtr, int line) {
 static void DDCFreeClock(I2CBusPtr I2CPtr, int line) {
 	UInt8 data = clockData & 0xDF;
 	DDCSetSense(I2CPtr, line, data);
-	IODelay(5);
+	DDCDelay(DDC_TIMING(I2CPtr)->settle);
 	clockData = data;
 }
 
 static void DDCFreeData(I2CBusPtr I2CPtr, int line) {
 	UInt8 data = clockData & 0xEF;
 	DDCSetSense(I2CPtr, line, data);
-	IODelay(5);
+	DDCDelay(DDC_TIMING(I2CPtr)->settle);
 	clockData = data;
 }
 
@@ -1593,37 +1641,44 @@ static Bool areBothDataAndClock(I2CBusPtr I2CPtr, int line, UInt8 value) {
 }
 
 static UInt8 DDCWaitClockHigh(I2CBusPtr I2CPtr, int line) {
-	DDCSetClock(I2CPtr, line, 1);
+	const struct rhdDDCTiming *Timing = DDC_TIMING(I2CPtr);
 	int i;
-	for (i = 0;i < 500;i++) {
+
+	DDCSetClock(I2CPtr, line, 1);
+	/* slaves may stretch the clock; poll until they release SCL */
+	for (i = 0;i < Timing->stretch;i += Timing->poll) {
 		if (DDCGetClock(I2CPtr, line)) break;
-		IODelay(10);
+		IODelay(Timing->poll);
 	}
 	return DDCGetClock(I2CPtr, line);
 }
 
 static Bool DDCSetStart(I2CBusPtr I2CPtr, int line) {
+	const struct rhdDDCTiming *Timing = DDC_TIMING(I2CPtr);
+
 	//if (!setSenseManual(I2CPtr, line, 1)) return FALSE;
 	DDCSetData(I2CPtr, line, 1);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	if (!DDCWaitClockHigh(I2CPtr, line)) return FALSE;
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCSetData(I2CPtr, line, 0);
-	IODelay(15);
+	DDCDelay(Timing->setup);
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	return TRUE;
 }
 
 static Bool DDCSetStop(I2CBusPtr I2CPtr, int line) {
+	const struct rhdDDCTiming *Timing = DDC_TIMING(I2CPtr);
+
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCSetData(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	if (!DDCWaitClockHigh(I2CPtr, line)) return FALSE;
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCSetData(I2CPtr, line, 1);
-	IODelay(15);
+	DDCDelay(Timing->setup);
 	//setSenseManual(I2CPtr, line, 0);
 	return TRUE;
 }
@@ -1668,28 +1723,31 @@ static Bool ErrorRecovery(I2CBusPtr I2CPtr, int line) {
 }
 
 static UInt8 DDCReceiveBit(I2CBusPtr I2CPtr, int line) {
+	const struct rhdDDCTiming *Timing = DDC_TIMING(I2CPtr);
+
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCSetData(I2CPtr, line, 1);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCWaitClockHigh(I2CPtr, line);
-	IODelay(10);
-	IODelay(15);
+	DDCDelay(Timing->high + Timing->setup);
 	UInt8 getBit = DDCGetData(I2CPtr, line);
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	return getBit;
 }
 
 static Bool DDCSendBit(I2CBusPtr I2CPtr, int line, UInt8 data) {
+	const struct rhdDDCTiming *Timing = DDC_TIMING(I2CPtr);
+
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	DDCSetData(I2CPtr, line, data);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	if (!DDCWaitClockHigh(I2CPtr, line)) return FALSE;
-	IODelay(10);
+	DDCDelay(Timing->high);
 	DDCSetClock(I2CPtr, line, 0);
-	IODelay(5);
+	DDCDelay(Timing->settle);
 	return TRUE;
 }
 
@@ -1724,24 +1782,95 @@ static Bool DDCSendBlock(I2CBusPtr I2CPtr, int line, UInt32 size, UInt8* data) {
 	return TRUE;
 }
 
+#define DDC_EDID_ADDR		0xA0
+#define DDCCI_DEST_ADDR		0x6E
+
+/*
+ * Remember what each monitor could take, so that a replug or another
+ * bus carrying the same monitor does not have to renegotiate. Monitors
+ * are identified by the EDID vendor/product/serial/date bytes.
+ */
+#define DDC_TIMING_CACHE_SIZE 8
+#define DDC_EDID_ID_OFFSET 8
+#define DDC_EDID_ID_SIZE 10
+#define DDC_EDID_BLOCK_SIZE 128
+
+static struct rhdDDCTimingCacheEntry {
+	UInt8 id[DDC_EDID_ID_SIZE];
+	UInt8 timing;
+	Bool valid;
+} ddcTimingCache[DDC_TIMING_CACHE_SIZE];
+static int ddcTimingCacheNext;
+
+/*
+ * The EEPROM holding the EDID and the DDC/CI device are separate targets
+ * that may well tolerate different bus speeds, so each keeps its own
+ * timing. Anything else on the bus gets the legacy timing.
+ */
+static void DDCSelectTiming(I2CBusPtr I2CPtr, UInt8 addr) {
+	rhdI2CPtr I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+
+	switch (addr & 0xFE) {
+		case DDC_EDID_ADDR:
+			I2C->ddcTiming = I2C->ddcTimingValid ? I2C->ddcEdidTiming : RHD_DDC_TIMING_LEGACY;
+			break;
+		case DDCCI_DEST_ADDR:
+			I2C->ddcTiming = I2C->ddcciTiming;
+			break;
+		default:
+			I2C->ddcTiming = RHD_DDC_TIMING_LEGACY;
+			break;
+	}
+}
+
+/*
+ * A transfer that failed at a faster than legacy timing may mean another
+ * monitor got plugged in: forget that target's timing so it gets
+ * renegotiated on the next use. It may as well mean the monitor cannot
+ * reliably take that timing, so its cached timing is stepped down below
+ * the one that failed, or the renegotiation would just pick it again.
+ */
+static void DDCTimingFailed(I2CBusPtr I2CPtr, UInt8 addr) {
+	rhdI2CPtr I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+	int i;
+
+	if (I2C->ddcTiming == RHD_DDC_TIMING_LEGACY)
+		return;
+	if ((addr & 0xFE) == DDC_EDID_ADDR) {
+		for (i = 0; i < DDC_TIMING_CACHE_SIZE; i++)
+			if (ddcTimingCache[i].valid
+				&& ddcTimingCache[i].timing >= I2C->ddcTiming
+				&& !bcmp(ddcTimingCache[i].id, I2C->ddcEdidId, DDC_EDID_ID_SIZE))
+				ddcTimingCache[i].timing = I2C->ddcTiming - 1;
+		I2C->ddcTimingValid = FALSE;
+	} else if ((addr & 0xFE) == DDCCI_DEST_ADDR) {
+		I2C->ddcciTiming = RHD_DDC_TIMING_LEGACY;
+		I2C->ddcciTimingValid = FALSE;
+	}
+}
+
 static Bool TransferBYDDCci(UInt16 addr, UInt8* data, UInt32 size, I2CBusPtr I2CPtr, int line) {
 	Bool ret = TRUE;
 	UInt32 blockSize;
 	
+	DDCSelectTiming(I2CPtr, addr & 0xFF);
 	DDCInit(I2CPtr, line);
 	do {
 		if (!DDCSetStart(I2CPtr, line)) break;
 		if (!DDCSendByte(I2CPtr, line, addr & 0xFF)) break;
 		if (!DDCReceiveByte(I2CPtr, line, &data[0], 0)) break;
 		if (!DDCReceiveByte(I2CPtr, line, &data[1], 0)) break;
-		blockSize = data[1] & 0x7F + 1;
+		blockSize = (data[1] & 0x7F) + 1;	/* payload + checksum */
 		if ((size - 2) < blockSize)
 			ret = DDCReadBlock(I2CPtr, line, size - 2, &data[2]);
 		else
 			ret = DDCReadBlock(I2CPtr, line, blockSize, &data[2]);
 	} while (0);
 	DDCSetStop(I2CPtr, line);
-	if (!ret) ErrorRecovery(I2CPtr, line);
+	if (!ret) {
+		ErrorRecovery(I2CPtr, line);
+		DDCTimingFailed(I2CPtr, addr & 0xFF);
+	}
 	return ret;
 }
 
@@ -1757,6 +1886,7 @@ static Bool TransferI2C(UInt16 addr, UInt8* data, UInt32 size, Bool isCombined,
 		mainAddr = addr & 0xFF;
 	}
 
+	DDCSelectTiming(I2CPtr, mainAddr);
 	do {
 		DDCInit(I2CPtr, line);
 	} while (!DDCSetStart(I2CPtr, line));
@@ -1771,12 +1901,312 @@ static Bool TransferI2C(UInt16 addr, UInt8* data, UInt32 size, Bool isCombined,
 				else ret = DDCSendBlock(I2CPtr, line, size, data);
 			}
 		}
-	}
+	} else
+		ret = FALSE;	/* nobody acknowledged the address */
 	if (ret) ret = DDCSetStop(I2CPtr, line);
-	else ErrorRecovery(I2CPtr, line);
+	else {
+		ErrorRecovery(I2CPtr, line);
+		DDCTimingFailed(I2CPtr, mainAddr);
+	}
 	return ret;
 }
 
+static const UInt8 ddcEdidHeader[8] = { 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00 };
+
+static Bool DDCReadEDIDBlock(I2CBusPtr I2CPtr, int line, UInt8 *edid) {
+	UInt8 sum = 0;
+	int i;
+
+	/* an all zero block checksums fine, so also insist on the header */
+	bzero(edid, DDC_EDID_BLOCK_SIZE);
+	/* 0xA0 write of offset 0, repeated start, 0xA1 read */
+	if (!TransferI2C(0xA100, edid, DDC_EDID_BLOCK_SIZE, TRUE, TRUE, I2CPtr, line))
+		return FALSE;
+	if (bcmp(edid, ddcEdidHeader, sizeof(ddcEdidHeader)))
+		return FALSE;
+	for (i = 0; i < DDC_EDID_BLOCK_SIZE; i++)
+		sum += edid[i];
+	return (sum == 0);
+}
+
+static void DDCNegotiateTiming(I2CBusPtr I2CPtr, int line) {
+	rhdI2CPtr I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+	UInt8 ref[DDC_EDID_BLOCK_SIZE], edid[DDC_EDID_BLOCK_SIZE];
+	int i, best;
+
+	/* the reference read is done with the slow, known good timing */
+	I2C->ddcEdidTiming = RHD_DDC_TIMING_LEGACY;
+	I2C->ddcTimingValid = TRUE;
+	if (!DDCReadEDIDBlock(I2CPtr, line, ref)) {
+		LOGV("%s: no valid EDID on %s, keeping %s timing\n", __func__,
+			 I2CPtr->BusName, rhdDDCTimings[I2C->ddcEdidTiming].name);
+		return;
+	}
+	bcopy(&ref[DDC_EDID_ID_OFFSET], I2C->ddcEdidId, DDC_EDID_ID_SIZE);
+
+	for (i = 0; i < DDC_TIMING_CACHE_SIZE; i++) {
+		if (ddcTimingCache[i].valid
+			&& !bcmp(ddcTimingCache[i].id, &ref[DDC_EDID_ID_OFFSET], DDC_EDID_ID_SIZE)) {
+			I2C->ddcEdidTiming = ddcTimingCache[i].timing;
+			LOGV("%s: %s using cached %s timing\n", __func__,
+				 I2CPtr->BusName, rhdDDCTimings[I2C->ddcEdidTiming].name);
+			return;
+		}
+	}
+
+	/* step up while the monitor keeps returning an identical, valid EDID */
+	best = RHD_DDC_TIMING_LEGACY;
+	for (i = RHD_DDC_TIMING_STANDARD; i < RHD_DDC_TIMING_COUNT; i++) {
+		I2C->ddcEdidTiming = i;
+		I2C->ddcTimingValid = TRUE;
+		if (!DDCReadEDIDBlock(I2CPtr, line, edid)
+			|| bcmp(ref, edid, DDC_EDID_BLOCK_SIZE))
+			break;
+		best = i;
+	}
+	I2C->ddcEdidTiming = best;
+	I2C->ddcTimingValid = TRUE;
+
+	bcopy(&ref[DDC_EDID_ID_OFFSET], ddcTimingCache[ddcTimingCacheNext].id, DDC_EDID_ID_SIZE);
+	ddcTimingCache[ddcTimingCacheNext].timing = best;
+	ddcTimingCache[ddcTimingCacheNext].valid = TRUE;
+	ddcTimingCacheNext = (ddcTimingCacheNext + 1) % DDC_TIMING_CACHE_SIZE;
+
+	LOG("%s: %s negotiated %s timing\n", __func__, I2CPtr->BusName,
+		rhdDDCTimings[best].name);
+}
+
+/*
+ * Forget what was negotiated on this bus, so that the next transfer
+ * starts over at legacy timing. Called whenever the monitor may have
+ * changed, i.e. before its EDID is read again.
+ */
+void RHDDDCTimingReset(I2CBusPtr I2CPtr) {
+	rhdI2CPtr I2C;
+
+	if (!I2CPtr || !(I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr))
+		return;
+	I2C->ddcTiming = RHD_DDC_TIMING_LEGACY;
+	I2C->ddcEdidTiming = RHD_DDC_TIMING_LEGACY;
+	I2C->ddcTimingValid = FALSE;
+	I2C->ddcciTiming = RHD_DDC_TIMING_LEGACY;
+	I2C->ddcciTimingValid = FALSE;
+}
+
+/*
+ * DDC/CI (VESA DDC/CI 1.1) VCP batching.
+ *
+ * The standard mandates a minimum gap after each host message: the reply
+ * to a request may only be read after DDCCI_REPLY_DELAY, and the next
+ * command may only be sent DDCCI_CMD_DELAY after the previous message.
+ * Instead of sleeping a fixed amount, every bus remembers when it becomes
+ * ready again and we only wait for what is left of that interval, so time
+ * spent building and checking packets is not paid twice.
+ */
+#define DDCCI_SRC_ADDR		0x51
+#define DDCCI_HOST_ADDR		0x50	/* used for the reply checksum */
+#define DDCCI_GET_VCP		0x01
+#define DDCCI_GET_VCP_REPLY	0x02
+#define DDCCI_SET_VCP		0x03
+#define DDCCI_REPLY_DELAY	40	/* ms */
+#define DDCCI_CMD_DELAY		50	/* ms */
+#define DDCCI_GET_REPLY_SIZE	11
+#define DDCCI_RETRIES		3
+
+static void DDCCIWaitReady(rhdI2CPtr I2C) {
+	uint64_t now, left;
+
+	clock_get_uptime(&now);
+	if (now >= I2C->ddcciReady)
+		return;
+	absolutetime_to_nanoseconds(I2C->ddcciReady - now, &left);
+	/* these gaps are tens of ms, never spin for them */
+	IOSleep((left + 999999) / 1000000);
+}
+
+static void DDCCISetReady(rhdI2CPtr I2C, UInt32 ms) {
+	clock_interval_to_deadline(ms, kMillisecondScale, &I2C->ddcciReady);
+}
+
+static Bool DDCCISend(I2CBusPtr I2CPtr, int line, UInt8 *payload, int len) {
+	UInt8 msg[DDCCI_GET_REPLY_SIZE];
+	UInt8 chk = DDCCI_DEST_ADDR;
+	int i;
+
+	msg[0] = DDCCI_SRC_ADDR;
+	msg[1] = 0x80 | len;
+	bcopy(payload, &msg[2], len);
+	for (i = 0; i < len + 2; i++)
+		chk ^= msg[i];
+	msg[len + 2] = chk;
+
+	return TransferI2C(DDCCI_DEST_ADDR, msg, len + 3, FALSE, FALSE, I2CPtr, line);
+}
+
+static Bool DDCCIGetVCP(I2CBusPtr I2CPtr, int line, struct rhdDDCCIRequest *req) {
+	rhdI2CPtr I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+	UInt8 payload[2] = { DDCCI_GET_VCP, req->vcp };
+	UInt8 reply[DDCCI_GET_REPLY_SIZE];
+	UInt8 chk = DDCCI_HOST_ADDR;
+	Bool trial, ret;
+	int i;
+
+	/*
+	 * Until a checksummed reply has come back, try the DDC/CI device at
+	 * the timing its EDID EEPROM negotiated; if that does not work out,
+	 * stay at legacy timing for this monitor.
+	 */
+	trial = !I2C->ddcciTimingValid;
+	if (trial)
+		I2C->ddcciTiming = I2C->ddcTimingValid ? I2C->ddcEdidTiming : RHD_DDC_TIMING_LEGACY;
+
+	DDCCIWaitReady(I2C);
+	ret = DDCCISend(I2CPtr, line, payload, sizeof(payload));
+	DDCCISetReady(I2C, DDCCI_REPLY_DELAY);
+	if (ret) {
+		DDCCIWaitReady(I2C);
+		ret = TransferBYDDCci(DDCCI_DEST_ADDR | 1, reply, sizeof(reply), I2CPtr, line);
+		DDCCISetReady(I2C, DDCCI_CMD_DELAY);
+	}
+	if (ret) {
+		for (i = 0; i < DDCCI_GET_REPLY_SIZE; i++)
+			chk ^= reply[i];
+		ret = !chk && (reply[1] & 0x7F) == 8 && reply[2] == DDCCI_GET_VCP_REPLY
+			&& reply[4] == req->vcp;
+	}
+	if (trial) {
+		if (!ret)
+			I2C->ddcciTiming = RHD_DDC_TIMING_LEGACY;
+		I2C->ddcciTimingValid = TRUE;
+		LOGV("%s: %s DDC/CI using %s timing\n", __func__, I2CPtr->BusName,
+			 rhdDDCTimings[I2C->ddcciTiming].name);
+	}
+	if (!ret)
+		return FALSE;
+	/* result code 0 is NoError, 1 is an unsupported VCP code */
+	if (reply[3])
+		return FALSE;
+
+	req->max = (reply[6] << 8) | reply[7];
+	req->value = (reply[8] << 8) | reply[9];
+	return TRUE;
+}
+
+static Bool DDCCISetVCP(I2CBusPtr I2CPtr, int line, struct rhdDDCCIRequest *req) {
+	rhdI2CPtr I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+	UInt8 payload[4] = { DDCCI_SET_VCP, req->vcp, req->value >> 8, req->value & 0xFF };
+	Bool ret;
+
+	DDCCIWaitReady(I2C);
+	ret = DDCCISend(I2CPtr, line, payload, sizeof(payload));
+	DDCCISetReady(I2C, DDCCI_CMD_DELAY);
+	return ret;
+}
+
+void RHDDDCCIBatchInit(struct rhdDDCCIBatch *Batch, int connector) {
+	bzero(Batch, sizeof(struct rhdDDCCIBatch));
+	Batch->connector = connector;
+}
+
+Bool RHDDDCCIQueueGet(struct rhdDDCCIBatch *Batch, CARD8 vcp) {
+	if (Batch->count >= RHD_DDCCI_BATCH_MAX)
+		return FALSE;
+	Batch->req[Batch->count].op = RHD_DDCCI_GET_VCP;
+	Batch->req[Batch->count].vcp = vcp;
+	Batch->count++;
+	return TRUE;
+}
+
+Bool RHDDDCCIQueueSet(struct rhdDDCCIBatch *Batch, CARD8 vcp, CARD16 value) {
+	if (Batch->count >= RHD_DDCCI_BATCH_MAX)
+		return FALSE;
+	Batch->req[Batch->count].op = RHD_DDCCI_SET_VCP;
+	Batch->req[Batch->count].vcp = vcp;
+	Batch->req[Batch->count].value = value;
+	Batch->count++;
+	return TRUE;
+}
+
+/*
+ * A batch may come straight from a client: the count must fit the
+ * request array and every op must be known.
+ */
+Bool RHDDDCCIBatchValid(struct rhdDDCCIBatch *Batch) {
+	int i;
+
+	if (Batch->count < 0 || Batch->count > RHD_DDCCI_BATCH_MAX)
+		return FALSE;
+	for (i = 0; i < Batch->count; i++)
+		if (Batch->req[i].op != RHD_DDCCI_GET_VCP && Batch->req[i].op != RHD_DDCCI_SET_VCP)
+			return FALSE;
+	return TRUE;
+}
+
+/*
+ * Run all queued requests, in order, on the DDC bus of one connector.
+ * Returns the number of requests that succeeded; each request has its
+ * own ok flag and, for Get VCP, the current and maximum values.
+ */
+int RHDDDCCIBatchSubmit(RHDPtr rhdPtr, struct rhdDDCCIBatch *Batch) {
+	struct rhdConnector *Connector;
+	I2CBusPtr I2CPtr;
+	rhdI2CPtr I2C;
+	int i, j, done = 0;
+
+	if (!RHDDDCCIBatchValid(Batch))
+		return 0;
+	if (Batch->connector < 0 || Batch->connector >= RHD_CONNECTORS_MAX)
+		return 0;
+	Connector = rhdPtr->Connector[Batch->connector];
+	if (!Connector || !(I2CPtr = Connector->DDC))
+		return 0;
+	I2C = (rhdI2CPtr)I2CPtr->DriverPrivate.ptr;
+	if (!I2C->ddcTimingValid)
+		DDCNegotiateTiming(I2CPtr, I2C->u.line);
+
+	for (i = 0; i < Batch->count; i++) {
+		struct rhdDDCCIRequest *req = &Batch->req[i];
+
+		req->ok = FALSE;
+		for (j = 0; j < DDCCI_RETRIES && !req->ok; j++) {
+			if (req->op == RHD_DDCCI_GET_VCP)
+				req->ok = DDCCIGetVCP(I2CPtr, I2C->u.line, req);
+			else
+				req->ok = DDCCISetVCP(I2CPtr, I2C->u.line, req);
+		}
+		if (req->ok)
+			done++;
+		else
+			LOG("%s: VCP 0x%02X failed on %s\n", __func__, req->vcp, Connector->Name);
+	}
+	return done;
+}
+
+/*
+ * Backend of the cscPrivateControlCall DDC/CI request: run a batch on
+ * whatever connector drives head index. TRUE if every request succeeded.
+ */
+Bool RadeonHDDoDDCCIBatch(struct rhdDDCCIBatch *Batch, int index) {
+	RHDPtr rhdPtr = RHDPTR(xf86Screens[0]);
+	struct rhdOutput *Output;
+	int i;
+
+	if (index < 0 || index > 1)
+		return FALSE;
+	for (Output = rhdPtr->Outputs; Output; Output = Output->Next)
+		if (Output->Active && Output->Connector && Output->Crtc == rhdPtr->Crtc[index])
+			break;
+	if (!Output)
+		return FALSE;
+	for (i = 0; i < RHD_CONNECTORS_MAX; i++)
+		if (rhdPtr->Connector[i] == Output->Connector)
+			break;
+	if (i == RHD_CONNECTORS_MAX || !RHDDDCCIBatchValid(Batch))
+		return FALSE;
+	Batch->connector = i;
+	return (RHDDDCCIBatchSubmit(rhdPtr, Batch) == Batch->count);
+}
+
 Bool RadeonHDDoCommunication(VDCommunicationRec * info) {
 	Bool ret = FALSE;
 	RHDPtr rhdPtr = RHDPTR(xf86Screens[0]);
@@ -1791,8 +2221,13 @@ Bool RadeonHDDoCommunication(VDCommunicationRec * info) {
 	
 	while (Output && Output->Active) {
 		I2CPtr = Output->Connector->DDC;
-		if (!I2CPtr) continue;
+		if (!I2CPtr) {
+			Output = Output->Next;
+			continue;
+		}
 		line = ((rhdI2CPtr)(I2CPtr->DriverPrivate.ptr))->u.line;
+		if (!((rhdI2CPtr)(I2CPtr->DriverPrivate.ptr))->ddcTimingValid)
+			DDCNegotiateTiming(I2CPtr, line);
 		
 		//send
 		if (info->csSendType != kVideoNoTransactionType) {
@@ -1803,8 +2238,15 @@ Bool RadeonHDDoCommunication(VDCommunicationRec * info) {
 							  info->csSendSize, isSendCombined, useSubAddr, I2CPtr, line);
 		}
 		
-		if ((info->csSendType != kVideoNoTransactionType) && (info->csReplyType != kVideoNoTransactionType))
-			IODelay(40);
+		if ((info->csSendType != kVideoNoTransactionType) && (info->csReplyType != kVideoNoTransactionType)) {
+			if (info->csCommFlags & kVideoReplyMicroSecDelayMask) {
+				/* DDC/CI asks for 40-50ms here, sleep rather than spin */
+				if (info->csMinReplyDelay >= 1000)
+					IOSleep(info->csMinReplyDelay / 1000);
+				DDCDelay(info->csMinReplyDelay % 1000);
+			} else
+				IODelay(40);
+		}
 		
 		//reply			
 		if (ret && (info->csReplyType != kVideoNoTransactionType)) {
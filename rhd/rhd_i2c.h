@@ -67,4 +67,38 @@ typedef enum {
 RHDI2CResult
 RHDI2CFunc(int scrnIndex, I2CBusPtr *I2CList, RHDi2cFunc func,
 			RHDI2CDataArgPtr data);
+void RHDDDCTimingReset(I2CBusPtr I2CPtr);
+
+/* DDC/CI VCP request batching */
+#define RHD_DDCCI_BATCH_MAX 32
+
+enum rhdDDCCIOp {
+    RHD_DDCCI_GET_VCP,
+    RHD_DDCCI_SET_VCP
+};
+
+struct rhdDDCCIRequest {
+    enum rhdDDCCIOp op;
+    CARD8 vcp;
+    CARD16 value;	/* in for SET, out for GET */
+    CARD16 max;		/* out for GET */
+    Bool ok;
+};
+
+/*
+ * Also the parameter block of cscPrivateControlCall: connector is filled
+ * in by the driver from the head the call was made on.
+ */
+struct rhdDDCCIBatch {
+    int connector;	/* index into rhdPtr->Connector[] */
+    int count;
+    struct rhdDDCCIRequest req[RHD_DDCCI_BATCH_MAX];
+};
+
+void RHDDDCCIBatchInit(struct rhdDDCCIBatch *Batch, int connector);
+Bool RHDDDCCIQueueGet(struct rhdDDCCIBatch *Batch, CARD8 vcp);
+Bool RHDDDCCIQueueSet(struct rhdDDCCIBatch *Batch, CARD8 vcp, CARD16 value);
+Bool RHDDDCCIBatchValid(struct rhdDDCCIBatch *Batch);
+int RHDDDCCIBatchSubmit(RHDPtr rhdPtr, struct rhdDDCCIBatch *Batch);
+Bool RadeonHDDoDDCCIBatch(struct rhdDDCCIBatch *Batch, int index);
 #endif
@@ -0,0 +1,181 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_infoframe.h"
+
+/*
+ *
+ */
+static void
+rhdInfoFrameInit(struct rhdInfoFrame *Frame, CARD8 Type, CARD8 Version,
+		 CARD8 Length)
+{
+    Frame->Type = Type;
+    Frame->Version = Version;
+    Frame->Length = Length;
+    bzero(Frame->Data, RHD_INFOFRAME_BYTES);
+}
+
+/*
+ * Header and payload, checksum included, have to add up to 0.
+ */
+static void
+rhdInfoFrameChecksum(struct rhdInfoFrame *Frame)
+{
+    CARD8 Sum = Frame->Type + Frame->Version + Frame->Length;
+    int i;
+
+    for (i = 1; i <= Frame->Length; i++)
+	Sum += Frame->Data[i];
+
+    Frame->Data[0] = 0x100 - Sum;
+}
+
+/*
+ *
+ */
+static void
+rhdInfoFrameWord(CARD8 *Data, CARD16 Value)
+{
+    Data[0] = Value & 0xFF;
+    Data[1] = Value >> 8;
+}
+
+/*
+ *
+ */
+void
+RHDInfoFrameAVI(struct rhdInfoFrame *Frame, const struct rhdInfoFrameAVI *AVI)
+{
+    CARD8 *Data = Frame->Data;
+
+    rhdInfoFrameInit(Frame, RHD_INFOFRAME_AVI, 0x02, 0x0D);
+
+    Data[0x1] =
+	(AVI->ScanInformation & 0x3) |
+	((AVI->BarInfoDataValid & 0x3) << 2) |
+	((AVI->ActiveInformationPresent & 0x1) << 4) |
+	((AVI->ColorFormat & 0x3) << 5);
+    Data[0x2] =
+	(AVI->ActiveFormatAspectRatio & 0xF) |
+	((AVI->PictureAspectRatio & 0x3) << 4) |
+	((AVI->Colorimetry & 0x3) << 6);
+    Data[0x3] =
+	(AVI->NonUniformPictureScaling & 0x3) |
+	((AVI->Quantization & 0x3) << 2) |
+	((AVI->ExColorimetry & 0x7) << 4) |
+	((AVI->ITC & 0x1) << 7);
+    Data[0x4] = AVI->VideoFormatIdentification & 0x7F;
+    Data[0x5] = AVI->PixelRepetition & 0xF;
+    rhdInfoFrameWord(&Data[0x6], AVI->TopBar);
+    rhdInfoFrameWord(&Data[0x8], AVI->BottomBar);
+    rhdInfoFrameWord(&Data[0xA], AVI->LeftBar);
+    rhdInfoFrameWord(&Data[0xC], AVI->RightBar);
+
+    rhdInfoFrameChecksum(Frame);
+}
+
+/*
+ *
+ */
+void
+RHDInfoFrameAudio(struct rhdInfoFrame *Frame,
+		  const struct rhdInfoFrameAudio *Audio)
+{
+    CARD8 *Data = Frame->Data;
+
+    rhdInfoFrameInit(Frame, RHD_INFOFRAME_AUDIO, 0x01, 0x0A);
+
+    Data[0x1] = (Audio->ChannelCount & 0x7) | ((Audio->CodingType & 0xF) << 4);
+    Data[0x2] = (Audio->SampleSize & 0x3) | ((Audio->SampleFrequency & 0x7) << 2);
+    Data[0x3] = Audio->Format;
+    Data[0x4] = Audio->ChannelAllocation;
+    Data[0x5] = ((Audio->LevelShift & 0xF) << 3) |
+	((Audio->DownmixInhibit & 0x1) << 7);
+
+    rhdInfoFrameChecksum(Frame);
+}
+
+/*
+ *
+ */
+void
+RHDInfoFrameSlotInit(struct rhdInfoFrameSlot *Slot, CARD32 Reg, int NumDwords)
+{
+    bzero(Slot, sizeof(struct rhdInfoFrameSlot));
+
+    Slot->Reg = Reg;
+    Slot->NumDwords = min(NumDwords, RHD_INFOFRAME_DWORDS);
+}
+
+/*
+ * For when the registers were written behind our back, or lost.
+ */
+void
+RHDInfoFrameSlotInvalidate(struct rhdInfoFrameSlot *Slot)
+{
+    Slot->Valid = FALSE;
+}
+
+/*
+ * Marks the dwords that differ from what the slot holds. Whatever of the
+ * frame does not fit the slot is dropped.
+ */
+void
+RHDInfoFrameSlotSet(struct rhdInfoFrameSlot *Slot,
+		    const struct rhdInfoFrame *Frame)
+{
+    const CARD8 *Data = Frame->Data;
+    int i;
+
+    for (i = 0; i < Slot->NumDwords; i++) {
+	CARD32 Value = Data[4 * i] | (Data[4 * i + 1] << 8) |
+	    (Data[4 * i + 2] << 16) | ((CARD32) Data[4 * i + 3] << 24);
+
+	if (!Slot->Valid || (Slot->Shadow[i] != Value)) {
+	    Slot->Shadow[i] = Value;
+	    Slot->Dirty |= 1 << i;
+	}
+    }
+}
+
+/*
+ * Writes out the dirty dwords, and returns how many that were.
+ */
+int
+RHDInfoFrameSlotFlush(struct rhdInfoFrameSlot *Slot,
+		      rhdInfoFrameWriteProc Write, void *Private)
+{
+    int i, Count = 0;
+
+    for (i = 0; i < Slot->NumDwords; i++)
+	if (Slot->Dirty & (1 << i)) {
+	    Write(Private, Slot->Reg + 4 * i, Slot->Shadow[i]);
+	    Count++;
+	}
+
+    Slot->Dirty = 0;
+    Slot->Valid = TRUE;
+
+    return Count;
+}
@@ -0,0 +1,108 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_INFOFRAME_H
+# define _RHD_INFOFRAME_H
+
+/*
+ * HDMI infoframes.
+ *
+ * Frames are built into a byte image, checksum first, as the hardware takes
+ * them: little endian dwords of the checksum followed by the payload, with
+ * the header going to separate control bits. Each hardware slot keeps a
+ * shadow of what was last written, so that rebuilding a frame on every mode
+ * set or audio change only costs the writes of the dwords that changed.
+ * Registers are written through a callback, which keeps all of this free of
+ * hardware.
+ */
+
+enum rhdInfoFrameType {
+    RHD_INFOFRAME_AVI = 0x82,
+    RHD_INFOFRAME_AUDIO = 0x84
+};
+
+/* checksum and the longest payload, in whole dwords */
+#define RHD_INFOFRAME_BYTES	16
+#define RHD_INFOFRAME_DWORDS	(RHD_INFOFRAME_BYTES / 4)
+
+struct rhdInfoFrame {
+    CARD8 Type;
+    CARD8 Version;
+    CARD8 Length;
+    CARD8 Data[RHD_INFOFRAME_BYTES];	/* checksum, then payload */
+};
+
+struct rhdInfoFrameAVI {
+    CARD8 ColorFormat;		/* 0 RGB, 1 YCbCr 4:2:2, 2 YCbCr 4:4:4 */
+    Bool ActiveInformationPresent;
+    CARD8 ActiveFormatAspectRatio;
+    CARD8 ScanInformation;
+    CARD8 Colorimetry;
+    CARD8 ExColorimetry;
+    CARD8 Quantization;
+    Bool ITC;
+    CARD8 PictureAspectRatio;
+    CARD8 VideoFormatIdentification;
+    CARD8 PixelRepetition;
+    CARD8 NonUniformPictureScaling;
+    CARD8 BarInfoDataValid;
+    CARD16 TopBar;
+    CARD16 BottomBar;
+    CARD16 LeftBar;
+    CARD16 RightBar;
+};
+
+struct rhdInfoFrameAudio {
+    CARD8 ChannelCount;		/* channels - 1 */
+    CARD8 CodingType;
+    CARD8 SampleSize;
+    CARD8 SampleFrequency;
+    CARD8 Format;
+    CARD8 ChannelAllocation;
+    CARD8 LevelShift;
+    Bool DownmixInhibit;
+};
+
+void RHDInfoFrameAVI(struct rhdInfoFrame *Frame,
+		     const struct rhdInfoFrameAVI *AVI);
+void RHDInfoFrameAudio(struct rhdInfoFrame *Frame,
+		       const struct rhdInfoFrameAudio *Audio);
+
+typedef void (*rhdInfoFrameWriteProc)(void *Private, CARD32 Reg, CARD32 Value);
+
+/* a hardware slot: NumDwords consecutive registers from Reg */
+struct rhdInfoFrameSlot {
+    CARD32 Reg;
+    int NumDwords;
+
+    CARD32 Shadow[RHD_INFOFRAME_DWORDS];
+    CARD32 Dirty;	/* mask of dwords not yet written */
+    Bool Valid;		/* shadow matches the hardware */
+};
+
+void RHDInfoFrameSlotInit(struct rhdInfoFrameSlot *Slot, CARD32 Reg,
+			  int NumDwords);
+void RHDInfoFrameSlotInvalidate(struct rhdInfoFrameSlot *Slot);
+void RHDInfoFrameSlotSet(struct rhdInfoFrameSlot *Slot,
+			 const struct rhdInfoFrame *Frame);
+int RHDInfoFrameSlotFlush(struct rhdInfoFrameSlot *Slot,
+			  rhdInfoFrameWriteProc Write, void *Private);
+
+#endif /* _RHD_INFOFRAME_H */
@@ -31,6 +31,7 @@
 #include "rhd_lut.h"
 #include "rhd_regs.h"
 #include "rhd_crtc.h"
+#include "rhd_vblank.h"
 #include "rhd_cursor.h"
 
 //#include <compiler.h>
@@ -565,7 +566,7 @@ static void SetPaletteAccess(RHDPtr rhdPtr, UInt8 index) {
 	RHDRegWrite(rhdPtr, 0x64D4 + offset, whiteOffset);
 	RHDRegWrite(rhdPtr, 0x64D0 + offset, whiteOffset);
 	
-	if (!pScrn->options->setCLUTAtSetEntries) WaitForVBL(rhdPtr, index, FALSE);
+	if (!pScrn->options->setCLUTAtSetEntries) RHDVBlankWait(rhdPtr, index, TRUE, NULL);
 }
 
 static void RF_DacRWIdx(RHDPtr rhdPtr, UInt8 index) {
@@ -760,7 +761,7 @@ void HALSetDACWithTable(ScrnInfoPtr pScrn, SInt16 offset, UInt32 length, ColorSp
 	for (k = 0;k < 2;k++) {
 		if (!rhdPtr->Crtc[k]->Active) continue;
 		SetPaletteAccess(rhdPtr, k);
-		if (!pScrn->options->setCLUTAtSetEntries) WaitForVBL(rhdPtr, k, FALSE);
+		if (!pScrn->options->setCLUTAtSetEntries) RHDVBlankWait(rhdPtr, k, TRUE, NULL);
 		if (pScrn->bitsPerPixel == 16)
 			unitSize = 8;
 		else
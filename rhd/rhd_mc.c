@@ -54,19 +54,38 @@
 #include "rhd_mc.h"
 #include "rhd_regs.h"
 #include "rhd_crtc.h" /* for definition of Crtc->Id */
+#include "rhd_modes.h" /* for MODE_MEM_BW */
+#ifdef ATOM_BIOS
+#include "rhd_atombios.h"
+#endif
 
 #include "r600_reg_auto_r6xx.h"
 #include "r600_reg_r6xx.h"
 
+/*
+ * Scanout load of one head, as last planned.
+ */
+struct rhdMCDisplayLoad {
+    CARD32 Demand;	/* peak fetch rate, kB/s */
+    CARD32 SrcPixelRate;	/* source pixels fetched per ms while active */
+};
+
 struct rhdMC {
     int scrnIndex;
 
     CARD32 FbLocation;
     CARD32 HdpFbAddress;
     CARD32 MiscLatencyTimer;
+    CARD32 PriorityCnt[2][2]; /* [crtc][A/B] */
 
     Bool Stored;
 
+    /* display bandwidth model */
+    CARD32 Available;	/* kB/s of memory bandwidth the display may take */
+    Bool Enforce;	/* Available is based on known numbers, not guesses */
+    CARD32 Latency;	/* ns, worst case display request latency */
+    struct rhdMCDisplayLoad Load[2];
+
     void (*Save)(struct rhdMC *MC);
     void (*Restore)(struct rhdMC *MC);
     Bool (*Idle)(struct rhdMC *MC);
@@ -515,6 +534,293 @@ R700MCSetupFBLocation(struct rhdMC *MC, CARD64 Address, CARD32 Size)
 }
 
 
+/*
+ * Display bandwidth planning.
+ *
+ * A head fetches its scanout buffer only while in the active area, so the
+ * peak demand is a full source line (the viewport, before the scaler) per
+ * active line time of the mode actually being displayed. Vertical
+ * downscaling fetches more than one source line per displayed line.
+ *
+ * The supply side is the memory clock times the bus width, derated for
+ * what the display may reasonably take from it. IGPs either scan out over
+ * the shared system memory path, or from sideport memory when present.
+ * Both numbers are deliberately conservative: the point is to refuse
+ * layouts that would underflow and to set the display priority marks from
+ * the expected latency, not to model the MC exactly.
+ *
+ * Layouts are only refused when both the memory clock (AtomBIOS) and the
+ * bus width (MC registers) are known. Otherwise, and on IGPs where the UMA
+ * figure is an estimate, the model only drives the priority marks and a
+ * layout beyond it gets a warning.
+ */
+#define RHD_MC_DISPLAY_SHARE		50	/* % of raw bandwidth for scanout */
+#define RHD_MC_DEFAULT_MEMORY_CLOCK	500000	/* kHz */
+#define RHD_MC_UMA_BANDWIDTH		3200000	/* kB/s, shared system memory path */
+#define RHD_MC_RS780_UMA_BANDWIDTH	6400000	/* kB/s */
+
+#define RHD_MC_LATENCY_DISCRETE		1000	/* ns */
+#define RHD_MC_LATENCY_SIDEPORT		2000
+#define RHD_MC_LATENCY_UMA		4000
+
+/*
+ * Bus width as configured in the MC, 0 when we cannot tell.
+ */
+static int
+rhdMCBusWidthRead(RHDPtr rhdPtr)
+{
+    CARD32 RamCfg;
+    int ChannelSize;
+
+    if ((rhdPtr->ChipSet < RHD_R600) || RHDIsIGP(rhdPtr->ChipSet))
+	return 0;
+
+    if (rhdPtr->ChipSet >= RHD_RV770) {
+	RamCfg = RHDRegRead(rhdPtr, R7XX_MC_ARB_RAMCFG);
+	if (RamCfg & (1 << 11)) /* CHANSIZE_OVERRIDE */
+	    ChannelSize = 16;
+	else
+	    ChannelSize = (RamCfg & (1 << 8)) ? 64 : 32; /* CHANSIZE */
+    } else {
+	RamCfg = RHDRegRead(rhdPtr, R6XX_RAMCFG);
+	if (RamCfg & (1 << 10)) /* CHANSIZE_OVERRIDE */
+	    ChannelSize = 16;
+	else
+	    ChannelSize = (RamCfg & (1 << 7)) ? 64 : 32; /* CHANSIZE */
+    }
+
+    /* NOOFCHAN, 2 bits */
+    switch ((RHDRegRead(rhdPtr, R6XX_MC_SHARED_CHMAP) & 0x3000) >> 12) {
+	case 0:
+	    return ChannelSize;
+	case 1:
+	    return 2 * ChannelSize;
+	case 2:
+	    return 4 * ChannelSize;
+	case 3:
+	    return 8 * ChannelSize;
+	default:
+	    return 0;
+    }
+}
+
+/*
+ * Typical bus width of the family, when the MC cannot tell us.
+ */
+static int
+rhdMCBusWidth(enum RHD_CHIPSETS ChipSet)
+{
+    switch (ChipSet) {
+	case RHD_RV505:
+	case RHD_RV515:
+	case RHD_RV516:
+	case RHD_M52:
+	case RHD_M54:
+	case RHD_M62:
+	case RHD_M64:
+	case RHD_RV610:
+	case RHD_M72:
+	case RHD_M74:
+	case RHD_RV620:
+	case RHD_M82:
+	case RHD_RV710:
+	case RHD_M92:
+	case RHD_M93:
+	    return 64;
+	case RHD_R520:
+	case RHD_R580:
+	case RHD_M58:
+	case RHD_R600:
+	case RHD_RV770:
+	case RHD_R700:
+	case RHD_M98:
+	case RHD_RV790:
+	    return 256;
+	case RHD_RS690:
+	case RHD_RS740:
+	case RHD_RS780:
+	case RHD_RS880:
+	    return 16;	/* sideport */
+	default:
+	    return 128;
+    }
+}
+
+static void
+rhdMCBandwidthInit(RHDPtr rhdPtr, struct rhdMC *MC)
+{
+    CARD32 MemoryClock = RHD_MC_DEFAULT_MEMORY_CLOCK;
+    CARD64 Raw;
+    Bool Known = FALSE;
+    int BusWidth;
+#ifdef ATOM_BIOS
+    AtomBiosArgRec atomBiosArg;
+
+    if (RHDAtomBiosFunc(rhdPtr->scrnIndex, rhdPtr->atomBIOS,
+			ATOM_GET_DEFAULT_MEMORY_CLOCK, &atomBiosArg) == ATOM_SUCCESS
+	&& atomBiosArg.val) {
+	MemoryClock = atomBiosArg.val;
+	Known = TRUE;
+    }
+#endif
+
+    BusWidth = rhdMCBusWidthRead(rhdPtr);
+    if (!BusWidth) {
+	BusWidth = rhdMCBusWidth(rhdPtr->ChipSet);
+	Known = FALSE;
+    }
+
+    /* DDR: two transfers per clock */
+    Raw = (CARD64)MemoryClock * 2 * (BusWidth / 8);
+    MC->Latency = RHD_MC_LATENCY_DISCRETE;
+
+    if (RHDIsIGP(rhdPtr->ChipSet)) {
+	if (RHD_MC_IGP_SideportMemoryPresent(rhdPtr))
+	    MC->Latency = RHD_MC_LATENCY_SIDEPORT;
+	else {
+	    Raw = (rhdPtr->ChipSet >= RHD_RS780) ?
+		RHD_MC_RS780_UMA_BANDWIDTH : RHD_MC_UMA_BANDWIDTH;
+	    MC->Latency = RHD_MC_LATENCY_UMA;
+	}
+	Known = FALSE;
+    }
+
+    MC->Available = (CARD32)(Raw * RHD_MC_DISPLAY_SHARE / 100);
+    MC->Enforce = Known;
+    LOG("MC: %u kB/s available for scanout (%d bit, %s), %u ns display latency\n",
+	(unsigned int)MC->Available, BusWidth, Known ? "enforced" : "estimate only",
+	(unsigned int)MC->Latency);
+}
+
+/*
+ * Mode is what the head scans out of the framebuffer, Displayed is what
+ * goes out of the connector (differs when the scaler is in use).
+ */
+static void
+rhdMCDisplayLoadCompute(DisplayModePtr Mode, DisplayModePtr Displayed, int bpp,
+			struct rhdMCDisplayLoad *Load)
+{
+    int SrcWidth = Mode->CrtcHDisplay ? Mode->CrtcHDisplay : Mode->HDisplay;
+    int SrcHeight = Mode->CrtcVDisplay ? Mode->CrtcVDisplay : Mode->VDisplay;
+    int DstWidth = Displayed->CrtcHDisplay ? Displayed->CrtcHDisplay : Displayed->HDisplay;
+    int DstHeight = Displayed->CrtcVDisplay ? Displayed->CrtcVDisplay : Displayed->VDisplay;
+    int Clock = Displayed->SynthClock ? Displayed->SynthClock : Displayed->Clock;
+    CARD64 Demand;
+
+    bzero(Load, sizeof(struct rhdMCDisplayLoad));
+    if ((SrcWidth <= 0) || (DstWidth <= 0) || (DstHeight <= 0) || (Clock <= 0))
+	return;
+
+    /* source pixels per ms while fetching a line */
+    Load->SrcPixelRate = (CARD32)(((CARD64)Clock * SrcWidth) / DstWidth);
+
+    /* bytes per ms == kB/s */
+    Demand = (CARD64)Load->SrcPixelRate * ((bpp + 7) / 8);
+    if (SrcHeight > DstHeight)
+	Demand = (Demand * SrcHeight + DstHeight - 1) / DstHeight;
+    Load->Demand = (CARD32)Demand;
+}
+
+/*
+ * Priority mark: how many pixels (in units of 16) the line buffer needs to
+ * hold to ride out one worst case request latency.
+ */
+static CARD32
+rhdMCPriorityMark(struct rhdMC *MC, struct rhdMCDisplayLoad *Load)
+{
+    CARD64 Mark;
+
+    Mark = ((CARD64)MC->Latency * Load->SrcPixelRate + 16000000 - 1) / 16000000;
+    if (Mark > MODE_PRIORITY_MARK_MASK)
+	Mark = MODE_PRIORITY_MARK_MASK;
+    return (CARD32)Mark;
+}
+
+/*
+ * Planned scanout demand of an active head, in kB/s.
+ */
+CARD32
+RHDMCDisplayDemand(RHDPtr rhdPtr, int Crtc)
+{
+    if (!rhdPtr->MC || !rhdPtr->Crtc[Crtc] || !rhdPtr->Crtc[Crtc]->Active)
+	return 0;
+    return rhdPtr->MC->Load[Crtc].Demand;
+}
+
+/*
+ * Load[] is cleared when a head is turned off, so this also holds while
+ * the other head is still being set up and not marked Active yet.
+ */
+static CARD32
+rhdMCOtherDemand(RHDPtr rhdPtr, int Crtc)
+{
+    return rhdPtr->MC->Load[(Crtc == RHD_CRTC_1) ? RHD_CRTC_2 : RHD_CRTC_1].Demand;
+}
+
+static void
+rhdMCProgramDisplayPriority(RHDPtr rhdPtr, int Crtc)
+{
+    struct rhdMC *MC = rhdPtr->MC;
+    CARD16 RegA = (Crtc == RHD_CRTC_1) ? D1MODE_PRIORITY_A_CNT : D2MODE_PRIORITY_A_CNT;
+    CARD16 RegB = (Crtc == RHD_CRTC_1) ? D1MODE_PRIORITY_B_CNT : D2MODE_PRIORITY_B_CNT;
+    CARD32 Total = MC->Load[Crtc].Demand + rhdMCOtherDemand(rhdPtr, Crtc);
+    CARD32 Value;
+
+    if (Total > MC->Available)
+	/* we are tight: keep the display at high priority all the time */
+	Value = MODE_PRIORITY_ALWAYS_ON;
+    else
+	Value = rhdMCPriorityMark(MC, &MC->Load[Crtc]);
+
+    LOGV("%s: Crtc %d: demand %u/%u kB/s, priority 0x%08X\n", __func__, Crtc,
+	 (unsigned int)Total, (unsigned int)MC->Available, (unsigned int)Value);
+
+    RHDRegWrite(rhdPtr, RegA, Value);
+    RHDRegWrite(rhdPtr, RegB, Value);
+}
+
+/*
+ * The priority of each head depends on the load of both, so any change
+ * reprograms every head that scans out.
+ */
+static void
+rhdMCProgramDisplayPriorities(RHDPtr rhdPtr)
+{
+    int i;
+
+    if (!rhdPtr->MC->Available)
+	return;
+    for (i = 0; i < 2; i++)
+	if (rhdPtr->MC->Load[i].Demand)
+	    rhdMCProgramDisplayPriority(rhdPtr, i);
+}
+
+/*
+ * Check whether this head, next to whatever the other head currently
+ * scans out, stays within the bandwidth the display may take.
+ */
+ModeStatus
+RHDMCValidateBandwidth(RHDPtr rhdPtr, int Crtc, DisplayModePtr Mode,
+		       DisplayModePtr ScaledToMode, int bpp)
+{
+    struct rhdMC *MC = rhdPtr->MC;
+    struct rhdMCDisplayLoad Load;
+
+    if (!MC || !MC->Available)
+	return MODE_OK;
+
+    rhdMCDisplayLoadCompute(Mode, ScaledToMode ? ScaledToMode : Mode, bpp, &Load);
+    if ((Load.Demand + rhdMCOtherDemand(rhdPtr, Crtc)) > MC->Available) {
+	if (MC->Enforce)
+	    return MODE_MEM_BW;
+	LOGV("MC: %s on Crtc %d may exceed the estimated scanout bandwidth"
+	    " (%u + %u > %u kB/s)\n", Mode->name, Crtc, (unsigned int)Load.Demand,
+	    (unsigned int)rhdMCOtherDemand(rhdPtr, Crtc), (unsigned int)MC->Available);
+    }
+
+    return MODE_OK;
+}
+
 /*
  *
  */
@@ -614,6 +920,8 @@ RHDMCInit(RHDPtr rhdPtr)
     LOG("MC FBIntAddress: 0x%08X, size: %d.\n", rhdPtr->FbIntAddress, rhdPtr->FbIntSize);
 	
     rhdPtr->MC = MC;
+
+    rhdMCBandwidthInit(rhdPtr, MC);
 	
 }
 
@@ -646,6 +954,11 @@ RHDMCSave(RHDPtr rhdPtr)
 
     MC->Save(MC);
 
+    MC->PriorityCnt[0][0] = RHDRegRead(MC, D1MODE_PRIORITY_A_CNT);
+    MC->PriorityCnt[0][1] = RHDRegRead(MC, D1MODE_PRIORITY_B_CNT);
+    MC->PriorityCnt[1][0] = RHDRegRead(MC, D2MODE_PRIORITY_A_CNT);
+    MC->PriorityCnt[1][1] = RHDRegRead(MC, D2MODE_PRIORITY_B_CNT);
+
     MC->Stored = TRUE;
 }
 
@@ -671,6 +984,11 @@ RHDMCRestore(RHDPtr rhdPtr)
 	MC->Restore(MC);
     else
 	LOG("%s: MC is still not idle!!!\n", __func__);
+
+    RHDRegWrite(MC, D1MODE_PRIORITY_A_CNT, MC->PriorityCnt[0][0]);
+    RHDRegWrite(MC, D1MODE_PRIORITY_B_CNT, MC->PriorityCnt[0][1]);
+    RHDRegWrite(MC, D2MODE_PRIORITY_A_CNT, MC->PriorityCnt[1][0]);
+    RHDRegWrite(MC, D2MODE_PRIORITY_B_CNT, MC->PriorityCnt[1][1]);
 }
 
 /*
@@ -764,6 +1082,27 @@ RHDMCTuneAccessForDisplay(RHDPtr rhdPtr, int Crtc,
 
     if (MC->TuneAccessForDisplay)
 	MC->TuneAccessForDisplay(MC, Crtc, Mode, ScaledToMode);
+
+    rhdMCDisplayLoadCompute(Mode, ScaledToMode ? ScaledToMode : Mode,
+			    xf86Screens[rhdPtr->scrnIndex]->bitsPerPixel,
+			    &MC->Load[Crtc]);
+    rhdMCProgramDisplayPriorities(rhdPtr);
+}
+
+/*
+ * Crtc no longer scans out: its load is gone, and the other head may now
+ * get by with a lower priority.
+ */
+void
+RHDMCDisplayOff(RHDPtr rhdPtr, int Crtc)
+{
+    struct rhdMC *MC = rhdPtr->MC;
+
+    if (!MC || !MC->Load[Crtc].Demand)
+	return;
+
+    bzero(&MC->Load[Crtc], sizeof(struct rhdMCDisplayLoad));
+    rhdMCProgramDisplayPriorities(rhdPtr);
 }
 
 /*
@@ -38,6 +38,10 @@ extern Bool RHDMCIdleWait(RHDPtr rhdPtr, CARD32 count);
 extern void RHDMCTuneAccessForDisplay(RHDPtr rhdPtr, int Crtc, DisplayModePtr Mode,
 				DisplayModePtr ScaledToMode);
 extern CARD64 RHDMCGetFBLocation(RHDPtr rhdPtr, CARD32 *size);
+extern ModeStatus RHDMCValidateBandwidth(RHDPtr rhdPtr, int Crtc, DisplayModePtr Mode,
+				DisplayModePtr ScaledToMode, int bpp);
+extern CARD32 RHDMCDisplayDemand(RHDPtr rhdPtr, int Crtc);
+extern void RHDMCDisplayOff(RHDPtr rhdPtr, int Crtc);
 
 extern Bool RHD_MC_IGP_SideportMemoryPresent(RHDPtr rhdPtr);
 
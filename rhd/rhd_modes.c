@@ -33,6 +33,7 @@
 #include "rhd_output.h"
 #include "rhd_modes.h"
 #include "rhd_monitor.h"
+#include "rhd_mc.h"
 
 /*
  * Don't bother with checking whether X offers this. Just use the internal one
@@ -795,6 +796,15 @@ rhdModeValidateCrtc(struct rhdCrtc *Crtc, DisplayModePtr Mode, enum ValidationKi
 			if (Mode->CrtcHAdjusted || Mode->CrtcVAdjusted)
 		    continue;
 	    }
+
+	    Status = RHDMCValidateBandwidth(rhdPtr, Crtc->Id, Mode,
+					    (ValidateScaleModeKind == VALIDATE_SCALE_FROM) ?
+					    Crtc->ScaledToMode : NULL,
+					    pScrn->bitsPerPixel);
+	    if (Status != MODE_OK) {
+		LOG("RHDMCValidateBandwidth failed\n");
+		return Status;
+	    }
 	}
 
 	if (ValidateScaleModeKind != VALIDATE_SCALE_FROM) {
@@ -938,6 +948,256 @@ rhdModeValidate(ScrnInfoPtr pScrn, DisplayModePtr Mode)
     return MODE_OK;
 }
 
+/*
+ * Mode validation cache.
+ *
+ * Validating a mode walks the whole Crtc/PLL/Output/Monitor chain, and the
+ * same monitor modes get pushed through it again on every pool creation
+ * and RandR fixup. Remember the verdict, together with the Crtc values the
+ * chain settled on, per mode timing and validation context. The cache is
+ * tagged with a signature of everything the chain depends on (Crtc and
+ * Output routing, PLL limits, scanout space, monitor ranges), so any change
+ * there implicitly flushes it.
+ */
+#define RHD_MODE_CACHE_SIZE 128
+
+/* Clock through CrtcVTotal: the user timing plus the hardware values */
+#define RHD_MODE_TIMING_INTS \
+    ((offsetof(DisplayModeRec, CrtcHAdjusted) - offsetof(DisplayModeRec, Clock)) / sizeof(int))
+#define RHD_MODE_TIMING(Mode) (&(Mode)->Clock)
+
+struct rhdModeCacheEntry {
+    Bool Valid;
+    CARD32 Signature;
+    void *Context[4]; /* Crtc, Connector, Output, Monitor */
+    Bool ScaledMode;
+    int Type; /* M_T_*: validation may depend on where the mode came from */
+    int Key[RHD_MODE_TIMING_INTS];
+    int Status;
+    int Result[RHD_MODE_TIMING_INTS];
+    Bool CrtcHAdjusted;
+    Bool CrtcVAdjusted;
+    float HSync;
+    float VRefresh;
+};
+
+struct rhdModeCache {
+    CARD32 Signature;
+    CARD32 Hits;
+    CARD32 Misses;
+    struct rhdModeCacheEntry Entry[RHD_MODE_CACHE_SIZE];
+};
+
+static inline CARD32
+rhdModeHash(CARD32 Hash, CARD32 Value)
+{
+    /* FNV-1a, a word at a time is plenty here */
+    return (Hash ^ Value) * 16777619;
+}
+
+static CARD32
+rhdModeHashFloat(CARD32 Hash, float Value)
+{
+    CARD32 Bits;
+
+    bcopy(&Value, &Bits, sizeof(Bits));
+    return rhdModeHash(Hash, Bits);
+}
+
+/*
+ * Everything the validation chain looks at besides the mode itself.
+ */
+static CARD32
+rhdModeCacheSignature(ScrnInfoPtr pScrn)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct rhdOutput *Output;
+    CARD32 Hash = 2166136261U;
+    int i, j;
+
+    Hash = rhdModeHash(Hash, pScrn->bitsPerPixel);
+    Hash = rhdModeHash(Hash, rhdPtr->FbFreeStart);
+    Hash = rhdModeHash(Hash, rhdPtr->FbFreeSize);
+
+    for (i = 0; i < 2; i++) {
+	struct rhdCrtc *Crtc = rhdPtr->Crtc[i];
+
+	if (!Crtc)
+	    continue;
+	Hash = rhdModeHash(Hash, Crtc->Active);
+	Hash = rhdModeHash(Hash, Crtc->ScaleType);
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Crtc->ScaledToMode);
+	Hash = rhdModeHash(Hash, RHDMCDisplayDemand(rhdPtr, i));
+	if (Crtc->PLL) {
+	    Hash = rhdModeHash(Hash, Crtc->PLL->PixMin);
+	    Hash = rhdModeHash(Hash, Crtc->PLL->PixMax);
+	}
+    }
+
+    for (Output = rhdPtr->Outputs; Output; Output = Output->Next) {
+	Hash = rhdModeHash(Hash, Output->Active);
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Output->Crtc);
+    }
+
+    for (i = 0; i < RHD_CONNECTORS_MAX; i++) {
+	struct rhdConnector *Connector = rhdPtr->Connector[i];
+	struct rhdMonitor *Monitor;
+
+	if (!Connector)
+	    continue;
+	Monitor = Connector->Monitor;
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Monitor);
+	if (!Monitor)
+	    continue;
+	for (j = 0; j < Monitor->numHSync; j++) {
+	    Hash = rhdModeHashFloat(Hash, Monitor->HSync[j].lo);
+	    Hash = rhdModeHashFloat(Hash, Monitor->HSync[j].hi);
+	}
+	for (j = 0; j < Monitor->numVRefresh; j++) {
+	    Hash = rhdModeHashFloat(Hash, Monitor->VRefresh[j].lo);
+	    Hash = rhdModeHashFloat(Hash, Monitor->VRefresh[j].hi);
+	}
+	Hash = rhdModeHash(Hash, Monitor->Bandwidth);
+	Hash = rhdModeHash(Hash, Monitor->ReducedAllowed);
+	Hash = rhdModeHash(Hash, Monitor->UseFixedModes);
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Monitor->Modes);
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Monitor->NativeMode);
+    }
+
+    return Hash;
+}
+
+/*
+ * Returns the cache slot for this mode/context; *Hit tells whether it
+ * holds a usable verdict. NULL when the mode should not be cached.
+ */
+static struct rhdModeCacheEntry *
+rhdModeCacheLookup(ScrnInfoPtr pScrn, DisplayModePtr Mode, void *Context[4],
+		   Bool ScaledMode, Bool *Hit)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    struct rhdModeCache *Cache = rhdPtr->ModeCache;
+    struct rhdModeCacheEntry *Entry;
+    CARD32 Signature, Hash;
+    int *Timing = RHD_MODE_TIMING(Mode);
+    int i;
+
+    *Hit = FALSE;
+
+    /* leave the odd cases to the full chain, it reports them */
+    if ((Mode->status != MODE_OK) || !strlen(Mode->name))
+	return NULL;
+
+    if (!Cache) {
+	Cache = IONew(struct rhdModeCache, 1);
+	if (!Cache)
+	    return NULL;
+	bzero(Cache, sizeof(struct rhdModeCache));
+	rhdPtr->ModeCache = Cache;
+    }
+
+    Signature = rhdModeCacheSignature(pScrn);
+    if (Signature != Cache->Signature) {
+	for (i = 0; i < RHD_MODE_CACHE_SIZE; i++)
+	    Cache->Entry[i].Valid = FALSE;
+	Cache->Signature = Signature;
+    }
+
+    Hash = Signature;
+    for (i = 0; i < 4; i++)
+	Hash = rhdModeHash(Hash, (CARD32)(unsigned long)Context[i]);
+    Hash = rhdModeHash(Hash, ScaledMode);
+    Hash = rhdModeHash(Hash, Mode->type);
+    for (i = 0; i < RHD_MODE_TIMING_INTS; i++)
+	Hash = rhdModeHash(Hash, Timing[i]);
+
+    Entry = &Cache->Entry[Hash % RHD_MODE_CACHE_SIZE];
+    if (Entry->Valid && (Entry->Signature == Signature)
+	&& (Entry->ScaledMode == ScaledMode)
+	&& (Entry->Type == Mode->type)
+	&& !bcmp(Entry->Context, Context, sizeof(Entry->Context))
+	&& !bcmp(Entry->Key, Timing, sizeof(Entry->Key))) {
+	Cache->Hits++;
+	*Hit = TRUE;
+    } else
+	Cache->Misses++;
+
+    return Entry;
+}
+
+static int
+rhdModeCacheApply(struct rhdModeCacheEntry *Entry, DisplayModePtr Mode)
+{
+    if (Entry->Status == MODE_OK) {
+	bcopy(Entry->Result, RHD_MODE_TIMING(Mode), sizeof(Entry->Result));
+	Mode->CrtcHAdjusted = Entry->CrtcHAdjusted;
+	Mode->CrtcVAdjusted = Entry->CrtcVAdjusted;
+	Mode->HSync = Entry->HSync;
+	Mode->VRefresh = Entry->VRefresh;
+    }
+    return Entry->Status;
+}
+
+/*
+ * Store the verdict; Key is the timing as it was before validation.
+ */
+static void
+rhdModeCacheStore(ScrnInfoPtr pScrn, struct rhdModeCacheEntry *Entry, int *Key,
+		  void *Context[4], Bool ScaledMode, DisplayModePtr Mode, int Status)
+{
+    Entry->Valid = TRUE;
+    Entry->Signature = RHDPTR(pScrn)->ModeCache->Signature;
+    bcopy(Context, Entry->Context, sizeof(Entry->Context));
+    Entry->ScaledMode = ScaledMode;
+    Entry->Type = Mode->type;
+    bcopy(Key, Entry->Key, sizeof(Entry->Key));
+    Entry->Status = Status;
+    bcopy(RHD_MODE_TIMING(Mode), Entry->Result, sizeof(Entry->Result));
+    Entry->CrtcHAdjusted = Mode->CrtcHAdjusted;
+    Entry->CrtcVAdjusted = Mode->CrtcVAdjusted;
+    Entry->HSync = Mode->HSync;
+    Entry->VRefresh = Mode->VRefresh;
+}
+
+/*
+ *
+ */
+static int
+rhdModeValidateCached(ScrnInfoPtr pScrn, DisplayModePtr Mode)
+{
+    struct rhdModeCacheEntry *Entry;
+    void *Context[4] = { NULL, NULL, NULL, NULL };
+    int Key[RHD_MODE_TIMING_INTS];
+    Bool Hit;
+    int Status;
+
+    Entry = rhdModeCacheLookup(pScrn, Mode, Context, FALSE, &Hit);
+    if (!Entry)
+	return rhdModeValidate(pScrn, Mode);
+    if (Hit)
+	return rhdModeCacheApply(Entry, Mode);
+
+    bcopy(RHD_MODE_TIMING(Mode), Key, sizeof(Key));
+    Status = rhdModeValidate(pScrn, Mode);
+    rhdModeCacheStore(pScrn, Entry, Key, Context, FALSE, Mode, Status);
+    return Status;
+}
+
+/*
+ *
+ */
+void
+RHDModeCacheDestroy(RHDPtr rhdPtr)
+{
+    if (!rhdPtr->ModeCache)
+	return;
+
+    LOGV("%s: %u hits, %u misses\n", __func__,
+	 (unsigned int)rhdPtr->ModeCache->Hits, (unsigned int)rhdPtr->ModeCache->Misses);
+    IODelete(rhdPtr->ModeCache, struct rhdModeCache, 1);
+    rhdPtr->ModeCache = NULL;
+}
+
 /*
  * Wrap the limited xf86 Mode statusses with our own message.
  */
@@ -1204,7 +1464,7 @@ rhdModeCreateFromName(ScrnInfoPtr pScrn, char *name, Bool Silent)
 	snprintf(Mode->name, 10, "%dx%d", HDisplay, VDisplay);
     Mode->type = M_T_USERDEF;
 
-    Status = rhdModeValidate(pScrn, Mode);
+    Status = rhdModeValidateCached(pScrn, Mode);
     if (Status == MODE_OK)
         return Mode;
     rhdModesDestroy(Mode);
@@ -1240,6 +1500,99 @@ rhdModeCreateFromName(ScrnInfoPtr pScrn, char *name, Bool Silent)
     return NULL;
 }
 
+/*
+ * Cheap checks over a whole mode list at once, one stage at a time, on flat
+ * arrays of timings. Only checks that the full validation chain makes first
+ * thing anyway are done here, so that nothing gets rejected that the chain
+ * would accept: the rhdModeSanity() clock check, then the DxModeValid()
+ * Crtc H/V total limits. Whatever fails here does not need to go through
+ * the full (and per mode) validation chain.
+ */
+#define RHD_CRTC_TIMING_MAX 0x2000 /* D1CRTC_H/V_TOTAL - 1: 13bits */
+
+struct rhdModeTimings {
+    int Count;
+    int *Clock;
+    int *HTotal;	/* Crtc timing, 0 when not filled out yet */
+    int *VTotal;
+    int *Status;	/* MODE_OK when left to the full chain */
+};
+
+static Bool
+rhdModeTimingsInit(struct rhdModeTimings *Timings, DisplayModePtr Modes)
+{
+    DisplayModePtr Mode;
+    int i;
+
+    bzero(Timings, sizeof(struct rhdModeTimings));
+    for (Mode = Modes; Mode; Mode = Mode->next)
+	Timings->Count++;
+    if (!Timings->Count)
+	return FALSE;
+
+    Timings->Clock = IONew(int, 4 * Timings->Count);
+    if (!Timings->Clock)
+	return FALSE;
+    Timings->HTotal = Timings->Clock + Timings->Count;
+    Timings->VTotal = Timings->HTotal + Timings->Count;
+    Timings->Status = Timings->VTotal + Timings->Count;
+
+    for (Mode = Modes, i = 0; Mode; Mode = Mode->next, i++) {
+	/* modes already marked bad are left for the full chain to report */
+	if (Mode->status != MODE_OK) {
+	    Timings->Clock[i] = 1;
+	    Timings->HTotal[i] = 0;
+	    Timings->VTotal[i] = 0;
+	} else {
+	    Timings->Clock[i] = Mode->Clock;
+	    Timings->HTotal[i] = Mode->CrtcHTotal;
+	    Timings->VTotal[i] = Mode->CrtcVTotal;
+	}
+	Timings->Status[i] = MODE_OK;
+    }
+    return TRUE;
+}
+
+static void
+rhdModeTimingsDestroy(struct rhdModeTimings *Timings)
+{
+    if (Timings->Clock)
+	IODelete(Timings->Clock, int, 4 * Timings->Count);
+}
+
+static void
+rhdModeTimingsValidate(RHDPtr rhdPtr, struct rhdModeTimings *Timings)
+{
+    int i, j, n = Timings->Count;
+    Bool CrtcCheck = FALSE;
+
+    /* Stage 1: rhdModeSanity() */
+    for (i = 0; i < n; i++)
+	if (Timings->Clock[i] <= 0)
+	    Timings->Status[i] = MODE_NOCLOCK;
+
+    /*
+     * Stage 2: Crtc timing register width. The chain only asks
+     * Crtc->ModeValid() for active Crtcs that do not scale, and does so
+     * before anything can adjust the Crtc timings. Modes without Crtc
+     * timings yet are left alone.
+     */
+    for (j = 0; j < 2; j++)
+	if (rhdPtr->Crtc[j] && rhdPtr->Crtc[j]->Active && !rhdPtr->Crtc[j]->ScaledToMode)
+	    CrtcCheck = TRUE;
+    if (!CrtcCheck)
+	return;
+
+    for (i = 0; i < n; i++) {
+	if (Timings->Status[i] != MODE_OK)
+	    continue;
+	if (Timings->HTotal[i] > RHD_CRTC_TIMING_MAX)
+	    Timings->Status[i] = MODE_BAD_HVALUE;
+	else if (Timings->VTotal[i] > RHD_CRTC_TIMING_MAX)
+	    Timings->Status[i] = MODE_BAD_VVALUE;
+    }
+}
+
 /*
  *
  */
@@ -1247,12 +1600,27 @@ static DisplayModePtr
 rhdModesListValidateAndCopy(ScrnInfoPtr pScrn, DisplayModePtr Modes, Bool Silent)
 {
     DisplayModePtr Keepers = NULL, Check, Mode;
-    int Status;
+    struct rhdModeTimings Timings;
+    Bool Filtered;
+    int Status, i;
+
+    Filtered = rhdModeTimingsInit(&Timings, Modes);
+    if (Filtered)
+	rhdModeTimingsValidate(RHDPTR(pScrn), &Timings);
+
+    for (Check = Modes, i = 0; Check; Check = Check->next, i++) {
+	if (Filtered && (Timings.Status[i] != MODE_OK)) {
+	    if (!Silent)
+		LOG("Rejected mode \"%s\" "
+			   "(%dx%d:%dMhz): %s\n", Check->name,
+			   Check->HDisplay, Check->VDisplay,
+			   (int)(Check->Clock / 1000.0), RHDModeStatusToString(Timings.Status[i]));
+	    continue;
+	}
 
-    for (Check = Modes; Check; Check = Check->next) {
 	Mode = RHDModeCopy(Check);
 
-	Status = rhdModeValidate(pScrn, Mode);
+	Status = rhdModeValidateCached(pScrn, Mode);
 	if (Status == MODE_OK)
 	    Keepers = RHDModesAdd(Keepers, Mode);
 	else {
@@ -1265,6 +1633,7 @@ rhdModesListValidateAndCopy(ScrnInfoPtr pScrn, DisplayModePtr Modes, Bool Silent
 	}
     }
 
+    rhdModeTimingsDestroy(&Timings);
     return Keepers;
 }
 
@@ -1506,8 +1875,8 @@ RHDGetVirtualFromModesAndFilter(ScrnInfoPtr pScrn, DisplayModePtr Modes, Bool Si
  * RandR entry point: fixup per Crtc and Output (in RandR speech)
  * Due to misconceptions we might end up fixing *everything* here.
  */
-int
-RHDRRModeFixup(ScrnInfoPtr pScrn, DisplayModePtr Mode, struct rhdCrtc *Crtc,
+static int
+rhdRRModeFixup(ScrnInfoPtr pScrn, DisplayModePtr Mode, struct rhdCrtc *Crtc,
 	       struct rhdConnector *Connector, struct rhdOutput *Output,
 	       struct rhdMonitor *Monitor, Bool ScaledMode)
 {
@@ -1623,6 +1992,32 @@ RHDRRModeFixup(ScrnInfoPtr pScrn, DisplayModePtr Mode, struct rhdCrtc *Crtc,
     return MODE_OK;
 }
 
+/*
+ *
+ */
+int
+RHDRRModeFixup(ScrnInfoPtr pScrn, DisplayModePtr Mode, struct rhdCrtc *Crtc,
+	       struct rhdConnector *Connector, struct rhdOutput *Output,
+	       struct rhdMonitor *Monitor, Bool ScaledMode)
+{
+    struct rhdModeCacheEntry *Entry;
+    void *Context[4] = { Crtc, Connector, Output, Monitor };
+    int Key[RHD_MODE_TIMING_INTS];
+    Bool Hit;
+    int Status;
+
+    Entry = rhdModeCacheLookup(pScrn, Mode, Context, ScaledMode, &Hit);
+    if (!Entry)
+	return rhdRRModeFixup(pScrn, Mode, Crtc, Connector, Output, Monitor, ScaledMode);
+    if (Hit)
+	return rhdModeCacheApply(Entry, Mode);
+
+    bcopy(RHD_MODE_TIMING(Mode), Key, sizeof(Key));
+    Status = rhdRRModeFixup(pScrn, Mode, Crtc, Connector, Output, Monitor, ScaledMode);
+    rhdModeCacheStore(pScrn, Entry, Key, Context, ScaledMode, Mode, Status);
+    return Status;
+}
+
 /*
  * RHDRRValidateScaledToMode(): like RHDValidateScaledMode() - but we cannot validate against a CRTC
  * as this isn't known when this function is called. So at least validate against the 'output' here.
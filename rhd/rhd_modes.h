@@ -81,5 +81,6 @@ int RHDValidateScaledToMode(struct rhdCrtc *Crtc, DisplayModePtr Mode);
 int RHDRRValidateScaledToMode(struct rhdOutput *Output, DisplayModePtr Mode);
 void RHDSynthModes(DisplayModePtr Mode, DisplayModePtr NativeMode);
 void rhdModeFillOutCrtcValues(DisplayModePtr Mode);
+void RHDModeCacheDestroy(RHDPtr rhdPtr);
 
 #endif /* _RHD_MODES_H */
@@ -28,6 +28,7 @@
 
 #include "rhd.h"
 #include "rhd_connector.h"
+#include "rhd_i2c.h"
 #include "rhd_modes.h"
 #include "rhd_monitor.h"
 #include "rhd_output.h"
@@ -385,6 +386,10 @@ RHDMonitorInit(struct rhdOutput *Output)
 	
     RHDFUNC(Connector);
 	
+	/* this may be another monitor than last time round */
+	if (Connector->DDC)
+		RHDDDCTimingReset(Connector->DDC);
+
     if (Connector->Type == RHD_CONNECTOR_PANEL)
 		Monitor = rhdMonitorPanel(Connector);
     else if (Connector->Type == RHD_CONNECTOR_TV)
@@ -31,6 +31,7 @@
 
 #include "rhd.h"
 #include "rhd_pm.h"
+#include "rhd_crtc.h"
 
 #ifdef ATOM_BIOS
 #include "rhd_atombios.h"
@@ -179,6 +180,35 @@ static void rhdPmValidateClearSetting (struct rhdPm *Pm, struct rhdPowerState *s
 	setting->VDDCVoltage = 0;
 }
 
+/* Can Config run everything State asks for? Unknown clocks can't be vouched for. */
+static Bool rhdPmCovers (struct rhdPowerState *Config, struct rhdPowerState *State)
+{
+    return Config->EngineClock && Config->MemoryClock &&
+	Config->EngineClock >= State->EngineClock &&
+	Config->MemoryClock >= State->MemoryClock;
+}
+
+/* The lowest voltage that a known good configuration (the default among
+ * them) runs the clocks of State at. 0 (leave alone) when the default covers
+ * State but its voltage is unknown; the maximum when nothing covers State. */
+static CARD32 rhdPmVoltageFor (struct rhdPm *Pm, struct rhdPowerState *State)
+{
+    CARD32 Voltage = 0;
+    int i;
+
+    if (rhdPmCovers (&Pm->Default, State)) {
+	if (! Pm->Default.VDDCVoltage)
+	    return 0;
+	Voltage = Pm->Default.VDDCVoltage;
+    }
+    for (i = 0; i < Pm->NumKnown; i++)
+	if (Pm->Known[i].VDDCVoltage && rhdPmCovers (&Pm->Known[i], State) &&
+	    (! Voltage || Pm->Known[i].VDDCVoltage < Voltage))
+	    Voltage = Pm->Known[i].VDDCVoltage;
+
+    return Voltage ? Voltage : Pm->Maximum.VDDCVoltage;
+}
+
 /* Have: a list of possible power settings, eventual minimum and maximum settings.
  * Want: all rhdPowerState_e settings */
 static void rhdPmSelectSettings (RHDPtr rhdPtr)
@@ -195,13 +225,20 @@ static void rhdPmSelectSettings (RHDPtr rhdPtr)
     /* RHD_PM_OFF: minimum */
     memcpy (&Pm->States[RHD_PM_OFF], &Pm->Minimum, sizeof (struct rhdPowerState));
 
-    /* Idle: !!!HACK!!! Take half the default */
-    /* TODO: copy lowest config with default Voltage/Mem setting? */
+    /* Idle: the clocks of the known good configuration with the slowest
+     * engine clock, or half the default engine clock when there is none */
     /* TODO: this should actually set the user mode */
     Pm->States[RHD_PM_IDLE].EngineClock = Pm->Default.EngineClock / 2;
+    for (i = 0; i < Pm->NumKnown; i++)
+	if (Pm->Known[i].EngineClock &&
+	    Pm->Known[i].EngineClock < Pm->States[RHD_PM_IDLE].EngineClock) {
+	    Pm->States[RHD_PM_IDLE].EngineClock = Pm->Known[i].EngineClock;
+	    Pm->States[RHD_PM_IDLE].MemoryClock = Pm->Known[i].MemoryClock ?
+		Pm->Known[i].MemoryClock : Pm->Default.MemoryClock;
+	}
+    rhdPmValidateSetting (Pm, &Pm->States[RHD_PM_IDLE], 1);
     if (rhdPtr->lowPowerMode) {
         if (!rhdPtr->lowPowerModeEngineClock) {
-	    Pm->States[RHD_PM_IDLE].EngineClock = Pm->Default.EngineClock / 2;
                 LOG("ForceLowPowerMode: calculated engine clock at %dkHz\n",
 			   (int) Pm->States[RHD_PM_IDLE].EngineClock);
         } else {
@@ -222,6 +259,8 @@ static void rhdPmSelectSettings (RHDPtr rhdPtr)
 
 	rhdPmValidateSetting (Pm, &Pm->States[RHD_PM_IDLE], 1);
     }
+    /* only now that the clocks are final; forced ones may need more */
+    Pm->States[RHD_PM_IDLE].VDDCVoltage = rhdPmVoltageFor (Pm, &Pm->States[RHD_PM_IDLE]);
 
     memcpy (&Pm->States[RHD_PM_MAX_3D], &Pm->Maximum, sizeof (struct rhdPowerState));
 
@@ -247,51 +286,182 @@ rhdPmGetRawState (RHDPtr rhdPtr, struct rhdPowerState *state)
         state->VDDCVoltage = data.val;
 }
 
+static CARD32
+rhdPmUsecs (void)
+{
+    uint64_t Now, Nsecs;
+
+    clock_get_uptime (&Now);
+    absolutetime_to_nanoseconds (Now, &Nsecs);
+    return (CARD32) (Nsecs / 1000);
+}
+
+/*
+ * Costs go up with the first sample that is higher, and only slowly come
+ * down again: they decide whether a change fits into a blank.
+ */
+static void
+rhdPmCostUpdate (CARD32 *Cost, CARD32 Sample)
+{
+    if (Sample > *Cost)
+	*Cost = Sample;
+    else
+	*Cost = (*Cost * 7 + Sample) / 8;
+}
+
+/*
+ * Waits until all active CRTCs are in vertical blank, with room for Cost
+ * usecs of it left. Without a Cost, the first quarter of each blank has to
+ * be hit. Heads that scan out independently might not share that much blank
+ * for a long time, so this gives up after two frames of the slowest one.
+ */
 static Bool
-rhdPmSetRawState (RHDPtr rhdPtr, struct rhdPowerState *state)
+rhdPmWaitBlank (RHDPtr rhdPtr, CARD32 Cost)
 {
+    CARD32 Start = rhdPmUsecs (), Timeout = 0;
+    CARD32 Left, Length, Frame;
+    Bool Ready;
+    int i;
+
+    for (;;) {
+	Ready = TRUE;
+
+	for (i = 0; i < 2; i++) {
+	    CARD32 Need;
+
+	    if (!rhdPtr->Crtc[i] ||
+		!RHDCrtcBlankTime (rhdPtr->Crtc[i], &Left, &Length, &Frame))
+		continue;
+
+	    if (Cost)
+		Need = Cost + Cost / 4;
+	    else
+		Need = Length - Length / 4;
+	    if (Need > Length)
+		return FALSE;
+	    if (Left < Need)
+		Ready = FALSE;
+
+	    if (Timeout < 2 * Frame)
+		Timeout = 2 * Frame;
+	}
+
+	if (Ready)
+	    return TRUE;
+	if ((rhdPmUsecs () - Start) > Timeout)
+	    return FALSE;
+    }
+}
+
+static Bool
+rhdPmSetEngineClock (RHDPtr rhdPtr, CARD32 Clock)
+{
+    struct rhdPm *Pm = rhdPtr->Pm;
     union AtomBiosArg data;
+    CARD32 Start;
+
+    if (!Clock || Clock == Pm->Current.EngineClock)
+	return TRUE;
+
+    Start = rhdPmUsecs ();
+    data.clockValue = Clock;
+    if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
+			 ATOM_SET_ENGINE_CLOCK, &data) != ATOM_SUCCESS)
+	return FALSE;
+    rhdPmCostUpdate (&Pm->EngineClockCost, rhdPmUsecs () - Start);
+
+    Pm->Current.EngineClock = Clock;
+    return TRUE;
+}
+
+/*
+ * Memory is not available to scanout while it is reclocked, so with Sync
+ * this is only done within the vertical blank of all active CRTCs. When it
+ * does not fit, the change is Deferred and the old clock kept.
+ */
+static Bool
+rhdPmSetMemoryClock (RHDPtr rhdPtr, CARD32 Clock, Bool Sync, Bool *Deferred)
+{
+    struct rhdPm *Pm = rhdPtr->Pm;
+    union AtomBiosArg data;
+    CARD32 Start;
+
+    if (!Clock || Clock == Pm->Current.MemoryClock)
+	return TRUE;
+
+    if (Sync && !rhdPmWaitBlank (rhdPtr, Pm->MemoryClockCost)) {
+	Pm->MemoryDeferred++;
+	*Deferred = TRUE;
+	return TRUE;
+    }
+
+    Start = rhdPmUsecs ();
+    data.clockValue = Clock;
+    if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
+			 ATOM_SET_MEMORY_CLOCK, &data) != ATOM_SUCCESS)
+	return FALSE;
+    rhdPmCostUpdate (&Pm->MemoryClockCost, rhdPmUsecs () - Start);
+
+    Pm->Current.MemoryClock = Clock;
+    return TRUE;
+}
+
+static Bool
+rhdPmSetVoltage (RHDPtr rhdPtr, CARD32 Voltage)
+{
+    struct rhdPm *Pm = rhdPtr->Pm;
+    union AtomBiosArg data;
+    CARD32 Start;
+
+    if (!Voltage || Voltage == Pm->Current.VDDCVoltage)
+	return TRUE;
+
+    Start = rhdPmUsecs ();
+    data.val = Voltage;
+    if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
+			 ATOM_SET_VOLTAGE, &data) != ATOM_SUCCESS)
+	return FALSE;
+    rhdPmCostUpdate (&Pm->VoltageCost, rhdPmUsecs () - Start);
+
+    Pm->Current.VDDCVoltage = Voltage;
+    return TRUE;
+}
+
+/*
+ * Clocks must never run ahead of the voltage: when the voltage goes up, it
+ * does so first, and when it goes down, only after the clocks did. If
+ * raising the voltage fails, the clocks are left alone; if lowering a clock
+ * fails or is deferred, so is the voltage.
+ * Memory clock and voltage are only touched when the user asked for it.
+ */
+static Bool
+rhdPmSetRawState (RHDPtr rhdPtr, struct rhdPowerState *state, Bool Sync)
+{
+    struct rhdPm *Pm = rhdPtr->Pm;
+    CARD32 Voltage = Pm->MemoryAndVoltage ? state->VDDCVoltage : 0;
+    CARD32 MemoryClock = Pm->MemoryAndVoltage ? state->MemoryClock : 0;
+    Bool Raise = Voltage > Pm->Current.VDDCVoltage;
+    Bool Deferred = FALSE;
     Bool ret = TRUE;
-    struct rhdPowerState dummy;
 
     /* TODO: Idle first; find which idles are needed and expose them */
-    /* FIXME: Voltage */
-    /* FIXME: If Voltage is to be rised, then do that first, then change frequencies.
-     *        If Voltage is to be lowered, do it the other way round. */
-    if (state->EngineClock && state->EngineClock != rhdPtr->Pm->Current.EngineClock) {
-	data.clockValue = state->EngineClock;
-	if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
-			     ATOM_SET_ENGINE_CLOCK, &data) == ATOM_SUCCESS)
-	    rhdPtr->Pm->Current.EngineClock = state->EngineClock;
-	else
-	    ret = FALSE;
-    }
-#if 0	/* don't do for the moment */
-    if (state->MemoryClock && state->MemoryClock != rhdPtr->Pm->Current.MemoryClock) {
-	data.clockValue = state->MemoryClock;
-	if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
-			     ATOM_SET_MEMORY_CLOCK, &data) != ATOM_SUCCESS)
-	    rhdPtr->Pm->Current.MemoryClock = state->MemoryClock;
-	else
-	    ret = FALSE;
-    }
-#endif
-#if 0	/* don't do for the moment */
-    if (state->VDDCVoltage && state->VDDCVoltage != rhdPtr->Pm->Current.VDDCVoltage) {
-	data.val = state->VDDCVoltage;
-	if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
-			     ATOM_SET_VOLTAGE, &data) != ATOM_SUCCESS)
-	    rhdPtr->Pm->Current.VDDCVoltage = state->VDDCVoltage;
-	else
-	    ret = FALSE;
+    if (Raise)
+	ret = rhdPmSetVoltage (rhdPtr, Voltage);
+    if (ret) {
+	ret = rhdPmSetEngineClock (rhdPtr, state->EngineClock);
+	ret = rhdPmSetMemoryClock (rhdPtr, MemoryClock, Sync,
+				   &Deferred) && ret;
     }
-#endif
+    if (ret && !Raise && !Deferred)
+	ret = rhdPmSetVoltage (rhdPtr, Voltage);
 
-    /* AtomBIOS might change values, so that later comparisons would fail, even
-     * if re-setting wouldn't change the actual values. So don't save real
-     * state in Current, but update only to current values. */
-    rhdPmGetRawState (rhdPtr, &dummy);
-    return ret;
+    /* AtomBIOS might round the values it is given, so Current holds what was
+     * asked for, and repeating a state is recognized as such. Only after a
+     * failure is it unknown how far AtomBIOS got; ask it then. */
+    if (!ret)
+	rhdPmGetRawState (rhdPtr, &Pm->Current);
+
+    return ret && !Deferred;
 }
 
 
@@ -299,10 +469,35 @@ rhdPmSetRawState (RHDPtr rhdPtr, struct rhdPowerState *state)
  * API
  */
 
+/*
+ * Keeps track of what each transition between states costs.
+ */
 static Bool
 rhdPmSelectState (RHDPtr rhdPtr, enum rhdPowerState_e num)
 {
-    return rhdPmSetRawState (rhdPtr, &rhdPtr->Pm->States[num]);
+    struct rhdPm *Pm = rhdPtr->Pm;
+    CARD32 Start, Cost;
+    Bool ret;
+
+    Start = rhdPmUsecs ();
+    ret = rhdPmSetRawState (rhdPtr, &Pm->States[num], TRUE);
+    Cost = rhdPmUsecs () - Start;
+
+    if (ret && (Pm->CurrentState != RHD_PM_NUM_STATES) &&
+	(Pm->CurrentState != num)) {
+	if (!Pm->TransitionCost[Pm->CurrentState][num])
+	    LOG("Power Management: %s -> %s took %u usecs\n",
+		PmLevels[Pm->CurrentState], PmLevels[num], (unsigned int) Cost);
+	rhdPmCostUpdate (&Pm->TransitionCost[Pm->CurrentState][num], Cost);
+    }
+
+    /* a deferred memory clock leaves us in between */
+    if (ret)
+	Pm->CurrentState = num;
+    else
+	Pm->CurrentState = RHD_PM_NUM_STATES;
+
+    return ret;
 }
 
 static Bool
@@ -323,8 +518,10 @@ void RHDPmInit(RHDPtr rhdPtr)
     rhdPtr->Pm = Pm;
 
     Pm->scrnIndex   = rhdPtr->scrnIndex;
+    Pm->CurrentState = RHD_PM_NUM_STATES;
     Pm->SelectState = rhdPmSelectState;
     Pm->DefineState = rhdPmDefineState;
+    Pm->MemoryAndVoltage = xf86Screens[rhdPtr->scrnIndex]->options->enableMemoryAndVoltageScaling;
 
     if (RHDAtomBiosFunc (rhdPtr->scrnIndex, rhdPtr->atomBIOS,
 			 ATOM_GET_CHIP_LIMITS, &data) != ATOM_SUCCESS) {
@@ -460,7 +657,13 @@ RHDPmRestore (RHDPtr rhdPtr)
         return;
     }
 #ifdef ATOM_BIOS
-    rhdPmSetRawState (rhdPtr, &Pm->Stored);
+    /* a glitch on the way out is better than leaving memory slow */
+    rhdPmSetRawState (rhdPtr, &Pm->Stored, FALSE);
+    Pm->CurrentState = RHD_PM_NUM_STATES;
+
+    if (Pm->MemoryDeferred)
+	LOG("Power Management: %u memory clock changes deferred, "
+	    "not fitting into vertical blank\n",
+	    (unsigned int) Pm->MemoryDeferred);
 #endif
 }
-
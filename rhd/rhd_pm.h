@@ -62,6 +62,18 @@ struct rhdPm {
     struct rhdPowerState States[RHD_PM_NUM_STATES];
     struct rhdPowerState Current;
     struct rhdPowerState Stored;
+    /* memory clock and voltage may be changed, not just the engine clock */
+    Bool MemoryAndVoltage;
+    /* state Current was set from, RHD_PM_NUM_STATES if none */
+    enum rhdPowerState_e CurrentState;
+
+    /* measured costs, in usecs, 0 while unknown */
+    CARD32 EngineClockCost;
+    CARD32 MemoryClockCost;
+    CARD32 VoltageCost;
+    CARD32 TransitionCost[RHD_PM_NUM_STATES][RHD_PM_NUM_STATES];
+    /* memory clock changes not done, as they did not fit into the blank */
+    CARD32 MemoryDeferred;
 
     Bool (*DefineState) (RHDPtr rhdPtr, enum rhdPowerState_e num, struct rhdPowerState *state);
     Bool (*SelectState) (RHDPtr rhdPtr, enum rhdPowerState_e num);
@@ -0,0 +1,883 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software PM4 command processor.
+ *
+ * Everything is executed synchronously, so the flush, sync and wait packets
+ * are accepted and counted, but have nothing to do. Card internal addresses
+ * are resolved through the ranges mapped with RHDPM4EmuMap().
+ *
+ * The R6xx side does not run shaders. A RECTLIST draw is treated the way
+ * the EXA code sets it up: 8 byte vertices are a solid fill with the first
+ * pixel shader constant, 16 byte vertices are a copy from texture resource
+ * 0 with the source position in the second vertex pair. CP_DMA copies are
+ * plain memmoves, only the low 32 address bits are looked at.
+ */
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_cs.h"
+#include "rhd_pm4.h"
+#include "r5xx_regs.h"
+#include "r600_reg.h"
+
+#define PM4_TYPE(h)	((h) >> 30)
+#define PM4_COUNT(h)	((((h) >> 16) & 0x3FFF) + 1) /* payload dwords */
+#define PM4_OPCODE(h)	(((h) >> 8) & 0xFF)
+
+#define PM4_R5XX_ONE_REG_WR	(1 << 15)
+
+#define PM4_MIN(a, b)	(((a) < (b)) ? (a) : (b))
+#define PM4_MAX(a, b)	(((a) > (b)) ? (a) : (b))
+
+#define PM4_REG(Emu, Reg)	((Emu)->Regs[(Reg) >> 2])
+
+/* without scissors, keep within what the engines can address */
+#define PM4_COORD_MAX	8192
+
+struct rhdPM4Surface {
+    CARD32 Address;
+    CARD32 Pitch;	/* bytes */
+    int Bpp;		/* bytes per pixel */
+};
+
+struct rhdPM4Blit {
+    struct rhdPM4Surface Dst;
+    struct rhdPM4Surface Src;	/* Bpp 0: no source surface */
+    const CARD8 *Data;		/* host data as source */
+    CARD32 DataPitch;
+
+    int X, Y, W, H;
+    int SrcX, SrcY;
+    Bool RightToLeft;
+    Bool BottomToTop;
+
+    int ClipX1, ClipY1, ClipX2, ClipY2; /* x2, y2 exclusive */
+
+    CARD8 Rop;
+    CARD32 Pattern;
+    CARD32 Solid;	/* source value when there is no source */
+    CARD32 WriteMask;
+};
+
+/*
+ *
+ */
+static CARD8 *
+rhdPM4Address(struct RhdPM4Emu *Emu, CARD32 Address, CARD32 Size)
+{
+    int i;
+
+    for (i = 0; i < Emu->NumRanges; i++) {
+	struct RhdPM4Range *Range = &Emu->Range[i];
+
+	if ((Address >= Range->Base)
+	    && ((Address - Range->Base) < Range->Size)
+	    && (Size <= (Range->Size - (Address - Range->Base))))
+	    return Range->Ptr + (Address - Range->Base);
+    }
+
+    LOG("%s: 0x%08X (0x%X bytes) is not mapped.\n", __func__,
+	(unsigned int) Address, (unsigned int) Size);
+    Emu->Stats.Errors++;
+    return NULL;
+}
+
+/*
+ *
+ */
+static CARD32
+rhdPM4PixelRead(const CARD8 *Ptr, int Bpp)
+{
+    switch (Bpp) {
+    case 1:
+	return *Ptr;
+    case 2:
+	return *(const CARD16 *) Ptr;
+    default:
+	return *(const CARD32 *) Ptr;
+    }
+}
+
+static void
+rhdPM4PixelWrite(CARD8 *Ptr, int Bpp, CARD32 Value)
+{
+    switch (Bpp) {
+    case 1:
+	*Ptr = Value;
+	break;
+    case 2:
+	*(CARD16 *) Ptr = Value;
+	break;
+    default:
+	*(CARD32 *) Ptr = Value;
+	break;
+    }
+}
+
+/*
+ * Bit i of the ROP3 code is the result for pattern (i & 4), source (i & 2)
+ * and destination (i & 1).
+ */
+static CARD32
+rhdPM4Rop3(CARD8 Rop, CARD32 P, CARD32 S, CARD32 D)
+{
+    CARD32 Result = 0;
+    int i;
+
+    switch (Rop) {
+    case 0xCC: /* S */
+	return S;
+    case 0xF0: /* P */
+	return P;
+    default:
+	break;
+    }
+
+    for (i = 0; i < 8; i++)
+	if (Rop & (1 << i))
+	    Result |= ((i & 4) ? P : ~P) & ((i & 2) ? S : ~S) & ((i & 1) ? D : ~D);
+
+    return Result;
+}
+
+/*
+ *
+ */
+static void
+rhdPM4BlitExecute(struct RhdPM4Emu *Emu, struct rhdPM4Blit *Blit)
+{
+    CARD8 *Dst, *Src = NULL;
+    const CARD8 *Data = Blit->Data;
+    int Bpp = Blit->Dst.Bpp;
+    int i, j, d;
+
+    /* clip, dragging the source along */
+    d = Blit->ClipX1 - Blit->X;
+    if (d > 0) {
+	Blit->X += d;
+	Blit->SrcX += d;
+	Blit->W -= d;
+	if (Data)
+	    Data += d * Bpp;
+    }
+    d = Blit->ClipY1 - Blit->Y;
+    if (d > 0) {
+	Blit->Y += d;
+	Blit->SrcY += d;
+	Blit->H -= d;
+	if (Data)
+	    Data += d * Blit->DataPitch;
+    }
+    if ((Blit->X + Blit->W) > Blit->ClipX2)
+	Blit->W = Blit->ClipX2 - Blit->X;
+    if ((Blit->Y + Blit->H) > Blit->ClipY2)
+	Blit->H = Blit->ClipY2 - Blit->Y;
+
+    if ((Blit->W <= 0) || (Blit->H <= 0))
+	return;
+    if ((Blit->X < 0) || (Blit->Y < 0) || (Blit->SrcX < 0) || (Blit->SrcY < 0)
+	|| !Bpp) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    Dst = rhdPM4Address(Emu, Blit->Dst.Address + Blit->Y * Blit->Dst.Pitch + Blit->X * Bpp,
+			(Blit->H - 1) * Blit->Dst.Pitch + Blit->W * Bpp);
+    if (!Dst)
+	return;
+
+    if (Blit->Src.Bpp) {
+	if (Blit->Src.Bpp != Bpp) {
+	    Emu->Stats.Unhandled++;
+	    return;
+	}
+	Src = rhdPM4Address(Emu, Blit->Src.Address + Blit->SrcY * Blit->Src.Pitch
+			    + Blit->SrcX * Bpp,
+			    (Blit->H - 1) * Blit->Src.Pitch + Blit->W * Bpp);
+	if (!Src)
+	    return;
+    }
+
+    for (j = 0; j < Blit->H; j++) {
+	int y = Blit->BottomToTop ? (Blit->H - 1 - j) : j;
+	CARD8 *DstLine = Dst + y * Blit->Dst.Pitch;
+
+	for (i = 0; i < Blit->W; i++) {
+	    int x = Blit->RightToLeft ? (Blit->W - 1 - i) : i;
+	    CARD32 S = Blit->Solid, D, Value;
+
+	    if (Src)
+		S = rhdPM4PixelRead(Src + y * Blit->Src.Pitch + x * Bpp, Bpp);
+	    else if (Data)
+		S = rhdPM4PixelRead(Data + y * Blit->DataPitch + x * Bpp, Bpp);
+
+	    D = rhdPM4PixelRead(DstLine + x * Bpp, Bpp);
+	    Value = rhdPM4Rop3(Blit->Rop, Blit->Pattern, S, D);
+	    Value = (Value & Blit->WriteMask) | (D & ~Blit->WriteMask);
+	    rhdPM4PixelWrite(DstLine + x * Bpp, Bpp, Value);
+	}
+    }
+
+    Emu->Stats.Pixels += Blit->W * Blit->H;
+}
+
+/*
+ *
+ * R5xx 2D engine.
+ *
+ */
+static int
+rhdPM4R5xxBpp(CARD32 Gmc)
+{
+    switch ((Gmc & R5XX_GMC_DST_DATATYPE_MASK) >> R5XX_GMC_DST_DATATYPE_SHIFT) {
+    case R5XX_DATATYPE_CI8:
+    case R5XX_DATATYPE_RGB332:
+    case R5XX_DATATYPE_Y8:
+    case R5XX_DATATYPE_RGB8:
+	return 1;
+    case R5XX_DATATYPE_ARGB1555:
+    case R5XX_DATATYPE_RGB565:
+    case R5XX_DATATYPE_ARGB4444:
+	return 2;
+    case R5XX_DATATYPE_ARGB8888:
+	return 4;
+    default:
+	return 0;
+    }
+}
+
+/*
+ * PITCH_OFFSET: pitch in 64 byte units at 29:22, offset in kB at 21:0.
+ */
+static void
+rhdPM4R5xxSurface(CARD32 PitchOffset, int Bpp, struct rhdPM4Surface *Surface)
+{
+    Surface->Pitch = ((PitchOffset >> 22) & 0xFF) * 64;
+    Surface->Address = (PitchOffset & 0x3FFFFF) << 10;
+    Surface->Bpp = Bpp;
+}
+
+static void
+rhdPM4R5xxClip(struct RhdPM4Emu *Emu, CARD32 Gmc, CARD32 TopLeft, CARD32 BottomRight,
+	       struct rhdPM4Blit *Blit)
+{
+    if (Gmc & R5XX_GMC_DST_CLIPPING) {
+	Blit->ClipX1 = (short) (TopLeft & 0xFFFF);
+	Blit->ClipY1 = (short) (TopLeft >> 16);
+	Blit->ClipX2 = (short) (BottomRight & 0xFFFF);
+	Blit->ClipY2 = (short) (BottomRight >> 16);
+    } else {
+	Blit->ClipX1 = 0;
+	Blit->ClipY1 = 0;
+	Blit->ClipX2 = PM4_COORD_MAX;
+	Blit->ClipY2 = PM4_COORD_MAX;
+    }
+}
+
+/*
+ * Writing the size kicks off the operation set up in the other registers.
+ */
+static void
+rhdPM4R5xx2D(struct RhdPM4Emu *Emu, CARD32 Reg)
+{
+    CARD32 Gmc = PM4_REG(Emu, R5XX_DP_GUI_MASTER_CNTL);
+    CARD32 Cntl = PM4_REG(Emu, R5XX_DP_CNTL);
+    CARD32 Size = PM4_REG(Emu, Reg);
+    struct rhdPM4Blit Blit;
+
+    bzero(&Blit, sizeof(struct rhdPM4Blit));
+
+    rhdPM4R5xxSurface(PM4_REG(Emu, R5XX_DST_PITCH_OFFSET), rhdPM4R5xxBpp(Gmc), &Blit.Dst);
+    Blit.X = (short) (PM4_REG(Emu, R5XX_DST_Y_X) & 0xFFFF);
+    Blit.Y = (short) (PM4_REG(Emu, R5XX_DST_Y_X) >> 16);
+    if (Reg == R5XX_DST_HEIGHT_WIDTH) {
+	Blit.W = Size & 0xFFFF;
+	Blit.H = Size >> 16;
+    } else {
+	Blit.W = Size >> 16;
+	Blit.H = Size & 0xFFFF;
+    }
+
+    Blit.Rop = (Gmc & R5XX_GMC_ROP3_MASK) >> 16;
+    Blit.Pattern = PM4_REG(Emu, R5XX_DP_BRUSH_FRGD_CLR);
+    Blit.WriteMask = PM4_REG(Emu, R5XX_DP_WRITE_MASK);
+    Blit.RightToLeft = !(Cntl & R5XX_DST_X_LEFT_TO_RIGHT);
+    Blit.BottomToTop = !(Cntl & R5XX_DST_Y_TOP_TO_BOTTOM);
+
+    rhdPM4R5xxClip(Emu, Gmc, PM4_REG(Emu, R5XX_SC_TOP_LEFT),
+		   PM4_REG(Emu, R5XX_SC_BOTTOM_RIGHT), &Blit);
+
+    if ((Gmc & R5XX_DP_SRC_SOURCE_MASK) == R5XX_DP_SRC_SOURCE_MEMORY) {
+	rhdPM4R5xxSurface(PM4_REG(Emu, R5XX_SRC_PITCH_OFFSET), Blit.Dst.Bpp, &Blit.Src);
+	Blit.SrcX = (short) (PM4_REG(Emu, R5XX_SRC_Y_X) & 0xFFFF);
+	Blit.SrcY = (short) (PM4_REG(Emu, R5XX_SRC_Y_X) >> 16);
+	Emu->Stats.Copies++;
+    } else
+	Emu->Stats.Fills++;
+
+    /* decrementing blits are handed the far corner */
+    if (Blit.RightToLeft) {
+	Blit.X -= Blit.W - 1;
+	Blit.SrcX -= Blit.W - 1;
+    }
+    if (Blit.BottomToTop) {
+	Blit.Y -= Blit.H - 1;
+	Blit.SrcY -= Blit.H - 1;
+    }
+
+    rhdPM4BlitExecute(Emu, &Blit);
+}
+
+/*
+ * CNTL_HOSTDATA_BLT: GMC, PITCH_OFFSET, SC_TOP_LEFT, SC_BOTTOM_RIGHT,
+ * FRGD_CLR, BKGD_CLR, DST_Y_X, DST_HEIGHT_WIDTH, dwords, data.
+ */
+static void
+rhdPM4R5xxHostDataBlt(struct RhdPM4Emu *Emu, const CARD32 *Payload, CARD32 Count)
+{
+    struct rhdPM4Blit Blit;
+    CARD32 Gmc;
+
+    if (Count < 9) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    Gmc = Payload[0];
+    if ((Gmc & R5XX_GMC_SRC_DATATYPE_MASK) != R5XX_GMC_SRC_DATATYPE_COLOR) {
+	/* mono expansion is not implemented */
+	Emu->Stats.Unhandled++;
+	return;
+    }
+
+    bzero(&Blit, sizeof(struct rhdPM4Blit));
+
+    rhdPM4R5xxSurface(Payload[1], rhdPM4R5xxBpp(Gmc), &Blit.Dst);
+    rhdPM4R5xxClip(Emu, Gmc, Payload[2], Payload[3], &Blit);
+    Blit.Pattern = Payload[4];
+    Blit.X = (short) (Payload[6] & 0xFFFF);
+    Blit.Y = (short) (Payload[6] >> 16);
+    Blit.W = Payload[7] & 0xFFFF;
+    Blit.H = Payload[7] >> 16;
+    Blit.Rop = (Gmc & R5XX_GMC_ROP3_MASK) >> 16;
+    Blit.WriteMask = (Gmc & R5XX_GMC_WR_MSK_DIS) ?
+	0xFFFFFFFF : PM4_REG(Emu, R5XX_DP_WRITE_MASK);
+
+    Blit.Data = (const CARD8 *) &Payload[9];
+    Blit.DataPitch = (Blit.W * Blit.Dst.Bpp + 3) & ~3;
+
+    if ((Payload[8] > (Count - 9))
+	|| ((CARD32) Blit.H * Blit.DataPitch > Payload[8] * 4)) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    Emu->Stats.HostBlits++;
+    rhdPM4BlitExecute(Emu, &Blit);
+}
+
+/*
+ *
+ * R6xx 3D engine.
+ *
+ */
+
+/* the FMT_ texture formats share their numbering with the COLOR_ ones */
+static int
+rhdPM4R6xxBpp(CARD32 Format)
+{
+    switch (Format) {
+    case COLOR_8:
+	return 1;
+    case COLOR_5_6_5:
+	return 2;
+    case COLOR_8_8_8_8:
+	return 4;
+    default:
+	return 0;
+    }
+}
+
+static CARD32
+rhdPM4R6xxSolid(struct RhdPM4Emu *Emu, int Bpp)
+{
+    CARD32 c[4];
+    int i;
+
+    /* R, G, B, A in the first pixel shader constant */
+    for (i = 0; i < 4; i++) {
+	union { CARD32 d; float f; } u;
+
+	u.d = PM4_REG(Emu, SQ_ALU_CONSTANT + 4 * i);
+	if (!(u.f > 0.0))
+	    u.f = 0.0;
+	else if (u.f > 1.0)
+	    u.f = 1.0;
+	c[i] = (CARD32) (u.f * 255.0 + 0.5);
+    }
+
+    switch (Bpp) {
+    case 1:
+	return c[3];
+    case 2:
+	return ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+    default:
+	return (c[3] << 24) | (c[0] << 16) | (c[1] << 8) | c[2];
+    }
+}
+
+static CARD32
+rhdPM4R6xxIndex(struct RhdPM4Emu *Emu, const CARD32 *Indices, CARD32 i)
+{
+    if (!Indices)
+	return i;
+    if (Emu->IndexType == DI_INDEX_SIZE_32_BIT)
+	return Indices[i];
+    return (i & 1) ? (Indices[i >> 1] >> 16) : (Indices[i >> 1] & 0xFFFF);
+}
+
+/*
+ *
+ */
+static void
+rhdPM4R6xxDraw(struct RhdPM4Emu *Emu, const CARD32 *Indices, CARD32 NumIndices)
+{
+    CARD32 Vtx = SQ_VTX_RESOURCE + SQ_VTX_RESOURCE_vs * SQ_VTX_RESOURCE_offset;
+    CARD32 VtxBase, VtxSize, Stride, i;
+    const CARD8 *Vertices;
+    struct rhdPM4Blit Blit;
+
+    Emu->Stats.Draws++;
+
+    if ((PM4_REG(Emu, VGT_PRIMITIVE_TYPE) & 0x3F) != DI_PT_RECTLIST) {
+	Emu->Stats.Unhandled++;
+	return;
+    }
+
+    VtxBase = PM4_REG(Emu, Vtx);
+    VtxSize = PM4_REG(Emu, Vtx + 4) + 1;
+    Stride = (PM4_REG(Emu, Vtx + 8) & SQ_VTX_CONSTANT_WORD2_0__STRIDE_mask)
+	>> SQ_VTX_CONSTANT_WORD2_0__STRIDE_shift;
+    if ((Stride != 8) && (Stride != 16)) {
+	Emu->Stats.Unhandled++;
+	return;
+    }
+
+    Vertices = rhdPM4Address(Emu, VtxBase, VtxSize);
+    if (!Vertices)
+	return;
+
+    bzero(&Blit, sizeof(struct rhdPM4Blit));
+
+    Blit.Dst.Address = PM4_REG(Emu, CB_COLOR0_BASE) << 8;
+    Blit.Dst.Bpp = rhdPM4R6xxBpp((PM4_REG(Emu, CB_COLOR0_INFO) & CB_COLOR0_INFO__FORMAT_mask)
+				 >> CB_COLOR0_INFO__FORMAT_shift);
+    Blit.Dst.Pitch = (((PM4_REG(Emu, CB_COLOR0_SIZE) & PITCH_TILE_MAX_mask)
+		       >> PITCH_TILE_MAX_shift) + 1) * 8 * Blit.Dst.Bpp;
+    Blit.Rop = (PM4_REG(Emu, CB_COLOR_CONTROL) & ROP3_mask) >> ROP3_shift;
+    Blit.WriteMask = 0xFFFFFFFF;
+    Blit.ClipX2 = PM4_COORD_MAX;
+    Blit.ClipY2 = PM4_COORD_MAX;
+
+    if (Stride == 8)
+	Blit.Solid = rhdPM4R6xxSolid(Emu, Blit.Dst.Bpp);
+    else {
+	CARD32 Tex = SQ_TEX_RESOURCE; /* resource 0 */
+
+	Blit.Src.Address = PM4_REG(Emu, Tex + 8) << 8;
+	Blit.Src.Bpp = rhdPM4R6xxBpp((PM4_REG(Emu, Tex + 4) & SQ_TEX_RESOURCE_WORD1_0__DATA_FORMAT_mask)
+				     >> SQ_TEX_RESOURCE_WORD1_0__DATA_FORMAT_shift);
+	Blit.Src.Pitch = (((PM4_REG(Emu, Tex) >> PITCH_shift) & 0x7FF) + 1) * 8 * Blit.Src.Bpp;
+    }
+
+    for (i = 0; (i + 3) <= NumIndices; i += 3) {
+	float x[3], y[3], s = 0.0, t = 0.0;
+	struct rhdPM4Blit Rect;
+	int k;
+
+	for (k = 0; k < 3; k++) {
+	    CARD32 Index = rhdPM4R6xxIndex(Emu, Indices, i + k);
+	    const float *v;
+
+	    if ((Index + 1) * Stride > VtxSize) {
+		Emu->Stats.Errors++;
+		return;
+	    }
+	    v = (const float *) (Vertices + Index * Stride);
+	    x[k] = v[0];
+	    y[k] = v[1];
+	    if (!k && (Stride == 16)) {
+		s = v[2];
+		t = v[3];
+	    }
+	}
+
+	Rect = Blit;
+	Rect.X = (int) PM4_MIN(x[0], PM4_MIN(x[1], x[2]));
+	Rect.Y = (int) PM4_MIN(y[0], PM4_MIN(y[1], y[2]));
+	Rect.W = (int) PM4_MAX(x[0], PM4_MAX(x[1], x[2])) - Rect.X;
+	Rect.H = (int) PM4_MAX(y[0], PM4_MAX(y[1], y[2])) - Rect.Y;
+	/* the copy vertices move the source along with the destination */
+	Rect.SrcX = (int) s + (Rect.X - (int) x[0]);
+	Rect.SrcY = (int) t + (Rect.Y - (int) y[0]);
+
+	Emu->Stats.Rects++;
+	rhdPM4BlitExecute(Emu, &Rect);
+    }
+}
+
+/*
+ *
+ */
+static void
+rhdPM4R6xxDma(struct RhdPM4Emu *Emu, const CARD32 *Payload)
+{
+    CARD32 Size = Payload[4] & 0x1FFFFF;
+    const CARD8 *Src;
+    CARD8 *Dst;
+
+    Emu->Stats.Dmas++;
+
+    if (Size & 3) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    Src = rhdPM4Address(Emu, Payload[0], Size);
+    Dst = rhdPM4Address(Emu, Payload[2], Size);
+    if (!Src || !Dst)
+	return;
+
+    memmove(Dst, Src, Size);
+    Emu->Stats.DmaBytes += Size;
+}
+
+/*
+ *
+ */
+static const struct {
+    CARD8 Opcode;
+    CARD32 Start;
+    CARD32 End;
+} rhdPM4R6xxRegRanges[] = {
+    { IT_SET_CONFIG_REG,  SET_CONFIG_REG_offset,  SET_CONFIG_REG_end },
+    { IT_SET_CONTEXT_REG, SET_CONTEXT_REG_offset, SET_CONTEXT_REG_end },
+    { IT_SET_ALU_CONST,   SET_ALU_CONST_offset,   SET_ALU_CONST_end },
+    { IT_SET_BOOL_CONST,  SET_BOOL_CONST_offset,  SET_BOOL_CONST_end },
+    { IT_SET_LOOP_CONST,  SET_LOOP_CONST_offset,  SET_LOOP_CONST_end },
+    { IT_SET_RESOURCE,    SET_RESOURCE_offset,    SET_RESOURCE_end },
+    { IT_SET_SAMPLER,     SET_SAMPLER_offset,     SET_SAMPLER_end },
+    { IT_SET_CTL_CONST,   SET_CTL_CONST_offset,   SET_CTL_CONST_end },
+    { 0, 0, 0 }
+};
+
+/*
+ * Writing CP_IB_BUFSZ runs the buffer at CP_IB_BASE, in line with the ring,
+ * as the CP does. Indirect buffers cannot chain.
+ */
+static void
+rhdPM4R5xxIndirect(struct RhdPM4Emu *Emu, CARD32 Address, CARD32 Count)
+{
+    const CARD32 *Buffer;
+
+    if (Emu->Indirect) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    Buffer = (const CARD32 *) rhdPM4Address(Emu, Address, Count * 4);
+    if (!Buffer)
+	return;
+
+    Emu->Stats.Indirects++;
+
+    Emu->Indirect = TRUE;
+    RHDPM4EmuExecute(Emu, Buffer, Count);
+    Emu->Indirect = FALSE;
+}
+
+static void
+rhdPM4RegWrite(struct RhdPM4Emu *Emu, CARD32 Reg, CARD32 Value)
+{
+    if (Reg >= RHD_PM4_REG_SPACE) {
+	Emu->Stats.Errors++;
+	return;
+    }
+
+    PM4_REG(Emu, Reg) = Value;
+    Emu->Stats.RegWrites++;
+
+    if ((Emu->Family == RHD_PM4_R5XX)
+	&& ((Reg == R5XX_DST_HEIGHT_WIDTH) || (Reg == R5XX_DST_WIDTH_HEIGHT)))
+	rhdPM4R5xx2D(Emu, Reg);
+    else if ((Emu->Family == RHD_PM4_R5XX) && (Reg == R5XX_CP_IB_BUFSZ))
+	rhdPM4R5xxIndirect(Emu, PM4_REG(Emu, R5XX_CP_IB_BASE), Value);
+}
+
+static void
+rhdPM4Type0(struct RhdPM4Emu *Emu, CARD32 Header, const CARD32 *Payload, CARD32 Count)
+{
+    CARD32 Reg, i;
+    Bool OneReg = FALSE;
+
+    if (Emu->Family == RHD_PM4_R5XX) {
+	Reg = (Header & 0x1FFF) << 2;
+	OneReg = (Header & PM4_R5XX_ONE_REG_WR) ? TRUE : FALSE;
+    } else
+	Reg = (Header & 0xFFFF) << 2;
+
+    for (i = 0; i < Count; i++)
+	rhdPM4RegWrite(Emu, OneReg ? Reg : (Reg + 4 * i), Payload[i]);
+}
+
+static void
+rhdPM4Type3(struct RhdPM4Emu *Emu, CARD8 Opcode, const CARD32 *Payload, CARD32 Count)
+{
+    int i;
+
+    Emu->Stats.Type3[Opcode]++;
+
+    if (Emu->Family == RHD_PM4_R5XX) {
+	if (Opcode == PM4_OPCODE(R5XX_CP_PACKET3_CNTL_HOSTDATA_BLT))
+	    rhdPM4R5xxHostDataBlt(Emu, Payload, Count);
+	else
+	    Emu->Stats.Unhandled++;
+	return;
+    }
+
+    for (i = 0; rhdPM4R6xxRegRanges[i].Opcode; i++)
+	if (rhdPM4R6xxRegRanges[i].Opcode == Opcode) {
+	    CARD32 Reg = rhdPM4R6xxRegRanges[i].Start + (Payload[0] << 2);
+	    CARD32 j;
+
+	    for (j = 1; j < Count; j++, Reg += 4) {
+		if (Reg >= rhdPM4R6xxRegRanges[i].End) {
+		    Emu->Stats.Errors++;
+		    break;
+		}
+		rhdPM4RegWrite(Emu, Reg, Payload[j]);
+	    }
+	    return;
+	}
+
+    switch (Opcode) {
+    case IT_INDEX_TYPE:
+	Emu->IndexType = Payload[0] & 0x3;
+	break;
+    case IT_NUM_INSTANCES:
+	Emu->NumInstances = Payload[0];
+	break;
+    case IT_DRAW_INDEX_AUTO:
+	if (Count < 2)
+	    Emu->Stats.Errors++;
+	else
+	    rhdPM4R6xxDraw(Emu, NULL, Payload[0]);
+	break;
+    case IT_DRAW_INDEX_IMMD:
+	if ((Count < 2) || (((Emu->IndexType == DI_INDEX_SIZE_32_BIT) ?
+			     Payload[0] : ((Payload[0] + 1) / 2)) > (Count - 2)))
+	    Emu->Stats.Errors++;
+	else
+	    rhdPM4R6xxDraw(Emu, &Payload[2], Payload[0]);
+	break;
+    case IT_CP_DMA:
+	if (Count < 5)
+	    Emu->Stats.Errors++;
+	else
+	    rhdPM4R6xxDma(Emu, Payload);
+	break;
+    case IT_NOP:
+    case IT_CONTEXT_CONTROL:
+    case IT_EVENT_WRITE:
+    case IT_EVENT_WRITE_EOP:
+    case IT_SURFACE_SYNC:
+    case IT_SURFACE_BASE_UPDATE:
+    case IT_WAIT_REG_MEM:
+    case IT_ME_INITIALIZE:
+    case IT_START_3D_CMDBUF:
+	/* we are always idle and coherent */
+	break;
+    default:
+	Emu->Stats.Unhandled++;
+	break;
+    }
+}
+
+/*
+ *
+ */
+struct RhdPM4Emu *
+RHDPM4EmuCreate(enum RhdPM4Family Family)
+{
+    struct RhdPM4Emu *Emu = IONew(struct RhdPM4Emu, 1);
+
+    if (!Emu)
+	return NULL;
+    bzero(Emu, sizeof(struct RhdPM4Emu));
+
+    Emu->Regs = (CARD32 *) IOMalloc(RHD_PM4_REG_SPACE);
+    if (!Emu->Regs) {
+	IODelete(Emu, struct RhdPM4Emu, 1);
+	return NULL;
+    }
+    bzero(Emu->Regs, RHD_PM4_REG_SPACE);
+
+    Emu->Family = Family;
+    Emu->IndexType = DI_INDEX_SIZE_16_BIT;
+    Emu->NumInstances = 1;
+
+    /* reset values that matter */
+    if (Family == RHD_PM4_R5XX) {
+	PM4_REG(Emu, R5XX_DP_WRITE_MASK) = 0xFFFFFFFF;
+	PM4_REG(Emu, R5XX_DP_CNTL) = R5XX_DST_X_LEFT_TO_RIGHT | R5XX_DST_Y_TOP_TO_BOTTOM;
+    } else
+	PM4_REG(Emu, CB_COLOR_CONTROL) = 0xCC << ROP3_shift;
+
+    return Emu;
+}
+
+/*
+ *
+ */
+void
+RHDPM4EmuDestroy(struct RhdPM4Emu *Emu)
+{
+    if (!Emu)
+	return;
+
+    IOFree(Emu->Regs, RHD_PM4_REG_SPACE);
+    IODelete(Emu, struct RhdPM4Emu, 1);
+}
+
+/*
+ * Back a range of card internal addresses with memory.
+ */
+Bool
+RHDPM4EmuMap(struct RhdPM4Emu *Emu, CARD32 Base, CARD32 Size, void *Ptr)
+{
+    if (Emu->NumRanges == RHD_PM4_RANGES_MAX)
+	return FALSE;
+
+    Emu->Range[Emu->NumRanges].Base = Base;
+    Emu->Range[Emu->NumRanges].Size = Size;
+    Emu->Range[Emu->NumRanges].Ptr = Ptr;
+    Emu->NumRanges++;
+
+    return TRUE;
+}
+
+/*
+ * Returns the number of dwords consumed, -1 when the stream is corrupt.
+ */
+int
+RHDPM4EmuExecute(struct RhdPM4Emu *Emu, const CARD32 *Buffer, CARD32 Count)
+{
+    CARD32 i = 0, Header, Size;
+
+    while (i < Count) {
+	Header = Buffer[i];
+
+	switch (PM4_TYPE(Header)) {
+	case 0:
+	case 3:
+	    Size = PM4_COUNT(Header);
+	    if (Size > (Count - i - 1)) {
+		LOG("%s: packet 0x%08X at %u runs past the end (%u dwords).\n",
+		    __func__, (unsigned int) Header, (unsigned int) i,
+		    (unsigned int) Count);
+		Emu->Stats.Errors++;
+		Emu->Stats.Dwords += i;
+		return -1;
+	    }
+	    if (PM4_TYPE(Header))
+		rhdPM4Type3(Emu, PM4_OPCODE(Header), &Buffer[i + 1], Size);
+	    else
+		rhdPM4Type0(Emu, Header, &Buffer[i + 1], Size);
+	    i += Size + 1;
+	    break;
+	case 2:
+	    i++;
+	    break;
+	default:
+	    LOG("%s: type-1 packet 0x%08X at %u.\n", __func__,
+		(unsigned int) Header, (unsigned int) i);
+	    Emu->Stats.Errors++;
+	    Emu->Stats.Dwords += i;
+	    return -1;
+	}
+
+	Emu->Stats.Packets[PM4_TYPE(Header)]++;
+    }
+
+    Emu->Stats.Dwords += i;
+    return i;
+}
+
+/*
+ *
+ */
+CARD32
+RHDPM4EmuRegRead(struct RhdPM4Emu *Emu, CARD32 Reg)
+{
+    if (Reg >= RHD_PM4_REG_SPACE)
+	return 0;
+    return PM4_REG(Emu, Reg);
+}
+
+/*
+ *
+ */
+void
+RHDPM4EmuStatsReset(struct RhdPM4Emu *Emu)
+{
+    bzero(&Emu->Stats, sizeof(struct RhdPM4Stats));
+}
+
+/*
+ *
+ */
+void
+RHDPM4EmuStatsPrint(struct RhdPM4Emu *Emu)
+{
+    struct RhdPM4Stats *Stats = &Emu->Stats;
+    int i;
+
+    LOG("PM4: %u dwords, packets: %u type-0, %u type-2, %u type-3, %u register writes\n",
+	(unsigned int) Stats->Dwords, (unsigned int) Stats->Packets[0],
+	(unsigned int) Stats->Packets[2], (unsigned int) Stats->Packets[3],
+	(unsigned int) Stats->RegWrites);
+    for (i = 0; i < 256; i++)
+	if (Stats->Type3[i])
+	    LOG("PM4:     opcode 0x%02X: %u\n", i, (unsigned int) Stats->Type3[i]);
+    LOG("PM4: %u fills, %u copies, %u host blits, %u draws (%u rects), %u pixels\n",
+	(unsigned int) Stats->Fills, (unsigned int) Stats->Copies,
+	(unsigned int) Stats->HostBlits, (unsigned int) Stats->Draws,
+	(unsigned int) Stats->Rects, (unsigned int) Stats->Pixels);
+    if (Stats->Dmas)
+	LOG("PM4: %u CP DMA copies, %u bytes\n",
+	    (unsigned int) Stats->Dmas, (unsigned int) Stats->DmaBytes);
+    if (Stats->Indirects)
+	LOG("PM4: %u indirect buffers\n", (unsigned int) Stats->Indirects);
+    if (Stats->Unhandled || Stats->Errors)
+	LOG("PM4: %u unhandled, %u errors\n",
+	    (unsigned int) Stats->Unhandled, (unsigned int) Stats->Errors);
+}
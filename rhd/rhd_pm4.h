@@ -0,0 +1,94 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Software PM4 command processor.
+ *
+ * Decodes the packet streams built by the CS and R6xx accel code, keeps a
+ * register file, and executes the subset of packets the 2D acceleration
+ * uses against plain memory: R5xx 2D engine fills, copies and host data
+ * blits, R5xx indirect buffers, R6xx RECTLIST draws for solid fills and
+ * copies, and R6xx CP DMA.
+ */
+#ifndef _HAVE_RHD_PM4_
+#define _HAVE_RHD_PM4_ 1
+
+/* register space covered by the register file, in bytes */
+#define RHD_PM4_REG_SPACE	0x40000
+
+#define RHD_PM4_RANGES_MAX	4
+
+enum RhdPM4Family {
+    RHD_PM4_R5XX,
+    RHD_PM4_R6XX
+};
+
+struct RhdPM4Stats {
+    CARD32 Dwords;
+    CARD32 Packets[4];	/* per packet type */
+    CARD32 Type3[256];	/* per type-3 opcode */
+    CARD32 RegWrites;
+
+    CARD32 Fills;	/* R5xx solid fills */
+    CARD32 Copies;	/* R5xx screen to screen copies */
+    CARD32 HostBlits;	/* R5xx host data blits */
+    CARD32 Draws;	/* R6xx draw packets */
+    CARD32 Rects;	/* R6xx rectangles rendered */
+    CARD32 Pixels;
+    CARD32 Dmas;	/* R6xx CP DMA copies */
+    CARD32 DmaBytes;
+    CARD32 Indirects;	/* R5xx indirect buffers run */
+
+    CARD32 Unhandled;	/* understood but not executed */
+    CARD32 Errors;	/* malformed packets or bad addresses */
+};
+
+struct RhdPM4Range {
+    CARD32 Base;	/* card internal address */
+    CARD32 Size;
+    CARD8 *Ptr;
+};
+
+struct RhdPM4Emu {
+    enum RhdPM4Family Family;
+
+    CARD32 *Regs;	/* indexed by register offset / 4 */
+
+    struct RhdPM4Range Range[RHD_PM4_RANGES_MAX];
+    int NumRanges;
+
+    /* draw state that does not live in registers */
+    CARD32 IndexType;
+    CARD32 NumInstances;
+
+    Bool Indirect;	/* running an indirect buffer */
+
+    struct RhdPM4Stats Stats;
+};
+
+struct RhdPM4Emu *RHDPM4EmuCreate(enum RhdPM4Family Family);
+void RHDPM4EmuDestroy(struct RhdPM4Emu *Emu);
+Bool RHDPM4EmuMap(struct RhdPM4Emu *Emu, CARD32 Base, CARD32 Size, void *Ptr);
+int RHDPM4EmuExecute(struct RhdPM4Emu *Emu, const CARD32 *Buffer, CARD32 Count);
+CARD32 RHDPM4EmuRegRead(struct RhdPM4Emu *Emu, CARD32 Reg);
+void RHDPM4EmuStatsReset(struct RhdPM4Emu *Emu);
+void RHDPM4EmuStatsPrint(struct RhdPM4Emu *Emu);
+
+#endif /* _HAVE_RHD_PM4_ */
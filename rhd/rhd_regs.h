@@ -115,9 +115,12 @@ enum {
 
     AGP_STATUS                     = 0x0F5C,
 
+    R6XX_MC_SHARED_CHMAP	   = 0x2004, /* also rv770 */
     R7XX_MC_VM_FB_LOCATION	   = 0x2024,
 
     R6XX_MC_VM_FB_LOCATION	   = 0x2180,
+    R6XX_RAMCFG			   = 0x2408,
+    R7XX_MC_ARB_RAMCFG		   = 0x2760,
     R6XX_HDP_NONSURFACE_BASE       = 0x2C04,
     R6XX_CONFIG_MEMSIZE            = 0x5428,
     R6XX_CONFIG_FB_BASE            = 0x542C, /* AKA CONFIG_F0_BASE */
@@ -145,6 +148,7 @@ enum {
     D1CRTC_INTERLACE_CONTROL	   = 0x6088,
     D1CRTC_BLACK_COLOR             = 0x6098,
     D1CRTC_STATUS                  = 0x609C,
+    D1CRTC_STATUS_POSITION         = 0x60A0,
     D1CRTC_COUNT_CONTROL           = 0x60B4,
 
     /* D1GRPH registers */
@@ -162,6 +166,7 @@ enum {
     D1GRPH_X_END                   = 0x6134,
     D1GRPH_Y_END                   = 0x6138,
     D1GRPH_UPDATE                  = 0x6144,
+    D1GRPH_FLIP_CONTROL            = 0x6148,
 
     /* LUT */
     DC_LUT_RW_SELECT               = 0x6480,
@@ -200,6 +205,8 @@ enum {
     D1MODE_EXT_OVERSCAN_LEFT_RIGHT = 0x6588,
     D1MODE_EXT_OVERSCAN_TOP_BOTTOM = 0x658C,
     D1MODE_DATA_FORMAT             = 0x6528,
+    D1MODE_PRIORITY_A_CNT          = 0x6548,
+    D1MODE_PRIORITY_B_CNT          = 0x654C,
 
     /* D1SCL */
     D1SCL_ENABLE                   = 0x6590,
@@ -232,6 +239,7 @@ enum {
     D2CRTC_BLACK_COLOR             = 0x6898,
     D2CRTC_INTERLACE_CONTROL       = 0x6888,
     D2CRTC_STATUS                  = 0x689C,
+    D2CRTC_STATUS_POSITION         = 0x68A0,
     D2CRTC_COUNT_CONTROL           = 0x68B4,
 
     /* D2GRPH registers */
@@ -266,6 +274,8 @@ enum {
     D2MODE_EXT_OVERSCAN_LEFT_RIGHT = 0x6D88,
     D2MODE_EXT_OVERSCAN_TOP_BOTTOM = 0x6D8C,
     D2MODE_DATA_FORMAT             = 0x6D28,
+    D2MODE_PRIORITY_A_CNT          = 0x6D48,
+    D2MODE_PRIORITY_B_CNT          = 0x6D4C,
 
     /* D2SCL */
     D2SCL_ENABLE                   = 0x6D90,
@@ -839,6 +849,13 @@ enum _rs690MCRegs {
     RS69_MC_INIT_MISC_LAT_TIMER         =       0x104
 };
 
+enum DxMODE_PRIORITY_CNT_BITS {
+    MODE_PRIORITY_MARK_MASK   = 0x7FFF,
+    MODE_PRIORITY_OFF         = 1 << 16,
+    MODE_PRIORITY_ALWAYS_ON   = 1 << 20,
+    MODE_PRIORITY_FORCE_MASK  = 1 << 24
+};
+
 enum MC_MISC_LAT_TIMER_BITS {
     MC_CPR_INIT_LAT_SHIFT    =  0,
     MC_VF_INIT_LAT           =  4,
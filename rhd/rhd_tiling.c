@@ -0,0 +1,302 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A 1D tiled surface is a row major array of 8x8 pixel micro tiles, each
+ * stored as one contiguous block. Within a tile the pixels of the displayable
+ * layout are interleaved so that, depending on the pixel size, runs of 8 or
+ * 4 pixels of a row stay together; those runs are moved as a whole.
+ *
+ * 2D tiles group micro tiles into macro tiles spread over the memory pipes
+ * and banks. Only their alignment is known here, their addressing is not.
+ */
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_tiling.h"
+
+#define MICRO_TILE_WIDTH	8
+#define MICRO_TILE_HEIGHT	8
+
+/*
+ *
+ */
+void
+RHDTilingConfigR6xx(CARD32 GbTilingConfig, struct rhdTilingConfig *Config)
+{
+    Config->Pipes = 1 << ((GbTilingConfig >> 1) & 0x7);
+    Config->Banks = 4 << ((GbTilingConfig >> 4) & 0x3);
+    Config->GroupBytes = ((GbTilingConfig >> 6) & 0x3) ? 512 : 256;
+}
+
+/*
+ *
+ */
+static CARD32
+rhdAlign(CARD32 Value, CARD32 Alignment)
+{
+    return ((Value + Alignment - 1) / Alignment) * Alignment;
+}
+
+/*
+ * Fills in the padded size of a Width x Height surface. Width and Height
+ * that are aligned already come back unchanged, which is how a layout
+ * chosen elsewhere can be checked.
+ */
+Bool
+RHDSurfaceLayout(struct rhdTilingConfig *Config, enum rhdArrayMode Mode,
+		 int Cpp, int Width, int Height,
+		 struct rhdSurfaceLayout *Layout)
+{
+    CARD32 TileBytes = MICRO_TILE_WIDTH * MICRO_TILE_HEIGHT * Cpp;
+
+    if ((Cpp != 1) && (Cpp != 2) && (Cpp != 4))
+	return FALSE;
+    if ((Width <= 0) || (Height <= 0))
+	return FALSE;
+
+    Layout->Mode = Mode;
+    Layout->Cpp = Cpp;
+
+    switch (Mode) {
+    case RHD_ARRAY_LINEAR_GENERAL:
+	Layout->PitchAlign = 1;
+	Layout->HeightAlign = 1;
+	Layout->BaseAlign = 1;
+	break;
+    case RHD_ARRAY_LINEAR_ALIGNED:
+	Layout->PitchAlign = max(64, Config->GroupBytes / Cpp);
+	Layout->HeightAlign = 1;
+	Layout->BaseAlign = Config->GroupBytes;
+	break;
+    case RHD_ARRAY_1D_TILED_THIN1:
+	Layout->PitchAlign = max(MICRO_TILE_WIDTH,
+				 Config->GroupBytes / (MICRO_TILE_HEIGHT * Cpp));
+	Layout->HeightAlign = MICRO_TILE_HEIGHT;
+	Layout->BaseAlign = Config->GroupBytes;
+	break;
+    case RHD_ARRAY_2D_TILED_THIN1:
+	/* a macro tile is banks micro tiles wide and pipes high */
+	Layout->PitchAlign = max(MICRO_TILE_WIDTH * Config->Banks,
+				 (Config->GroupBytes * Config->Banks) /
+				 (Cpp * MICRO_TILE_WIDTH));
+	Layout->HeightAlign = MICRO_TILE_HEIGHT * Config->Pipes;
+	Layout->BaseAlign = max(Config->GroupBytes,
+				Config->Banks * Config->Pipes * TileBytes);
+	break;
+    default:
+	return FALSE;
+    }
+
+    Layout->Pitch = rhdAlign(Width, Layout->PitchAlign);
+    Layout->Height = rhdAlign(Height, Layout->HeightAlign);
+    Layout->Size = Layout->Pitch * Layout->Height * Cpp;
+
+    return TRUE;
+}
+
+/*
+ * Index of a pixel inside its micro tile, displayable layout. From the lowest
+ * bit up:
+ *   8bpp:  x0 x1 x2 y1 y0 y2
+ *   16bpp: x0 x1 x2 y0 y1 y2
+ *   32bpp: x0 x1 y0 x2 y1 y2
+ */
+static inline CARD32
+rhdMicroTilePixel(int Cpp, int X, int Y)
+{
+    switch (Cpp) {
+    case 1:
+	return X | ((Y & 2) << 2) | ((Y & 1) << 4) | ((Y & 4) << 3);
+    case 2:
+	return X | (Y << 3);
+    default:
+	return (X & 3) | ((Y & 1) << 2) | ((X & 4) << 1) | ((Y & 6) << 3);
+    }
+}
+
+/*
+ *
+ */
+static inline CARD32
+rhdTiledOffset1D(struct rhdSurfaceLayout *Layout, int X, int Y)
+{
+    int Cpp = Layout->Cpp;
+
+    return (Y / MICRO_TILE_HEIGHT) * (Layout->Pitch * MICRO_TILE_HEIGHT * Cpp) +
+	(X / MICRO_TILE_WIDTH) * (MICRO_TILE_WIDTH * MICRO_TILE_HEIGHT * Cpp) +
+	rhdMicroTilePixel(Cpp, X & (MICRO_TILE_WIDTH - 1),
+			  Y & (MICRO_TILE_HEIGHT - 1)) * Cpp;
+}
+
+/*
+ * Byte offset of a pixel; linear and 1D tiled surfaces only.
+ */
+CARD32
+RHDSurfaceOffset(struct rhdSurfaceLayout *Layout, int X, int Y)
+{
+    if (Layout->Mode == RHD_ARRAY_1D_TILED_THIN1)
+	return rhdTiledOffset1D(Layout, X, Y);
+
+    return (Y * Layout->Pitch + X) * Layout->Cpp;
+}
+
+/*
+ * One run of pixels that the micro tile keeps together: 8 bytes at 8bpp,
+ * 16 bytes otherwise. On the tiled side these are naturally aligned, which
+ * is VRAM most of the time, so stores there bypass the caches.
+ */
+static inline void
+rhdRunToTiled(CARD8 *Tiled, const CARD8 *Linear, int Bytes)
+{
+#ifdef __SSE2__
+    if ((Bytes == 16) && !((unsigned long) Tiled & 15)) {
+	_mm_stream_si128((__m128i *) Tiled,
+			 _mm_loadu_si128((const __m128i *) Linear));
+	return;
+    }
+#endif
+    memcpy(Tiled, Linear, Bytes);
+}
+
+/*
+ *
+ */
+static inline void
+rhdRunFromTiled(CARD8 *Linear, const CARD8 *Tiled, int Bytes)
+{
+#ifdef __SSE2__
+    if ((Bytes == 16) && !((unsigned long) Tiled & 15)) {
+	_mm_storeu_si128((__m128i *) Linear,
+			 _mm_load_si128((const __m128i *) Tiled));
+	return;
+    }
+#endif
+    memcpy(Linear, Tiled, Bytes);
+}
+
+/*
+ * Walks a rectangle of a 1D tiled surface, moving whole runs where the
+ * rectangle covers them and single pixels at its edges.
+ */
+static void
+rhdTiledRect1D(struct rhdSurfaceLayout *Layout, CARD8 *Surface,
+	       int X, int Y, int Width, int Height,
+	       CARD8 *Linear, int LinearPitch, Bool ToTiled)
+{
+    int Cpp = Layout->Cpp;
+    int Run = (Cpp == 4) ? 4 : 8;	/* pixels */
+    int RunBytes = Run * Cpp;
+    int i, j;
+
+    for (j = 0; j < Height; j++) {
+	CARD8 *Line = Linear + j * LinearPitch;
+
+	for (i = X; i < (X + Width); ) {
+	    CARD8 *Tiled = Surface + rhdTiledOffset1D(Layout, i, Y + j);
+	    CARD8 *Pixel = Line + (i - X) * Cpp;
+
+	    if (!(i & (Run - 1)) && ((i + Run) <= (X + Width))) {
+		if (ToTiled)
+		    rhdRunToTiled(Tiled, Pixel, RunBytes);
+		else
+		    rhdRunFromTiled(Pixel, Tiled, RunBytes);
+		i += Run;
+	    } else {
+		if (ToTiled)
+		    memcpy(Tiled, Pixel, Cpp);
+		else
+		    memcpy(Pixel, Tiled, Cpp);
+		i++;
+	    }
+	}
+    }
+
+#ifdef __SSE2__
+    if (ToTiled)
+	_mm_sfence();
+#endif
+}
+
+/*
+ *
+ */
+static Bool
+rhdSurfaceRect(struct rhdSurfaceLayout *Layout, CARD8 *Surface,
+	       int X, int Y, int Width, int Height,
+	       CARD8 *Linear, int LinearPitch, Bool ToTiled)
+{
+    int j;
+
+    if ((X < 0) || (Y < 0) || (Width <= 0) || (Height <= 0) ||
+	((CARD32) (X + Width) > Layout->Pitch) ||
+	((CARD32) (Y + Height) > Layout->Height))
+	return FALSE;
+
+    switch (Layout->Mode) {
+    case RHD_ARRAY_LINEAR_GENERAL:
+    case RHD_ARRAY_LINEAR_ALIGNED:
+	for (j = 0; j < Height; j++) {
+	    CARD8 *Row = Surface + RHDSurfaceOffset(Layout, X, Y + j);
+
+	    if (ToTiled)
+		memcpy(Row, Linear, Width * Layout->Cpp);
+	    else
+		memcpy(Linear, Row, Width * Layout->Cpp);
+	    Linear += LinearPitch;
+	}
+	return TRUE;
+    case RHD_ARRAY_1D_TILED_THIN1:
+	rhdTiledRect1D(Layout, Surface, X, Y, Width, Height,
+		       Linear, LinearPitch, ToTiled);
+	return TRUE;
+    default:
+	return FALSE;
+    }
+}
+
+/*
+ * Copies a rectangle of the surface out into linear memory.
+ */
+Bool
+RHDSurfaceDetile(struct rhdSurfaceLayout *Layout, const void *Surface,
+		 int X, int Y, int Width, int Height,
+		 void *Dst, int DstPitch)
+{
+    return rhdSurfaceRect(Layout, (CARD8 *) Surface, X, Y, Width, Height,
+			  Dst, DstPitch, FALSE);
+}
+
+/*
+ * Copies linear memory into a rectangle of the surface.
+ */
+Bool
+RHDSurfaceRetile(struct rhdSurfaceLayout *Layout, void *Surface,
+		 int X, int Y, int Width, int Height,
+		 const void *Src, int SrcPitch)
+{
+    return rhdSurfaceRect(Layout, Surface, X, Y, Width, Height,
+			  (CARD8 *) Src, SrcPitch, TRUE);
+}
@@ -0,0 +1,70 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_TILING_H
+# define _RHD_TILING_H
+
+/*
+ * R6xx/R7xx surface layouts.
+ *
+ * Pitch, height and base alignment of linear and tiled surfaces, the address
+ * of a pixel in them, and conversion of rectangles between a tiled surface
+ * and plain linear memory. Nothing here touches the hardware.
+ */
+
+/* values of the ARRAY_MODE fields of CB_COLORn_INFO and SQ_TEX_RESOURCE */
+enum rhdArrayMode {
+    RHD_ARRAY_LINEAR_GENERAL = 0,
+    RHD_ARRAY_LINEAR_ALIGNED = 1,
+    RHD_ARRAY_1D_TILED_THIN1 = 2,
+    RHD_ARRAY_2D_TILED_THIN1 = 4
+};
+
+/* as programmed into GB_TILING_CONFIG */
+struct rhdTilingConfig {
+    int Pipes;
+    int Banks;
+    int GroupBytes;
+};
+
+struct rhdSurfaceLayout {
+    enum rhdArrayMode Mode;
+    int Cpp;
+    CARD32 Pitch;	/* pixels */
+    CARD32 Height;	/* rows, padded */
+    CARD32 Size;	/* bytes */
+    CARD32 PitchAlign;	/* pixels */
+    CARD32 HeightAlign;	/* rows */
+    CARD32 BaseAlign;	/* bytes */
+};
+
+void RHDTilingConfigR6xx(CARD32 GbTilingConfig, struct rhdTilingConfig *Config);
+Bool RHDSurfaceLayout(struct rhdTilingConfig *Config, enum rhdArrayMode Mode,
+		      int Cpp, int Width, int Height,
+		      struct rhdSurfaceLayout *Layout);
+CARD32 RHDSurfaceOffset(struct rhdSurfaceLayout *Layout, int X, int Y);
+Bool RHDSurfaceDetile(struct rhdSurfaceLayout *Layout, const void *Surface,
+		      int X, int Y, int Width, int Height,
+		      void *Dst, int DstPitch);
+Bool RHDSurfaceRetile(struct rhdSurfaceLayout *Layout, void *Surface,
+		      int X, int Y, int Width, int Height,
+		      const void *Src, int SrcPitch);
+
+#endif /* _RHD_TILING_H */
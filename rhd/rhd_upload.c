@@ -0,0 +1,248 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * A slot is filled with as many packets as fit, then handed to the CP and
+ * fenced, and the next slot is taken. Lines never straddle packets, so the
+ * rows per packet follow from the line length: as many as the packet count
+ * field allows, fewer where a slot runs out. A slot that is only partly
+ * used when an upload ends is submitted as is; the next upload starts on a
+ * fresh one, so consecutive frames never wait on each other unless all
+ * slots are in flight.
+ *
+ * Only the ring backends can point the CP at an indirect buffer. With the
+ * software PM4 processor everything has passed by the time it is fenced,
+ * which makes it a sink for measuring the CPU side on its own.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_cs.h"
+#include "rhd_upload.h"
+#include "r5xx_regs.h"
+
+/* HOSTDATA_BLT header and register dwords in front of the data */
+#define UPLOAD_PACKET_HEADER	10
+/* data dwords a single packet can carry, as limited by its count field */
+#define UPLOAD_PACKET_DATA_MAX	(0x3FFF - (UPLOAD_PACKET_HEADER - 2))
+
+#define UPLOAD_TIMEOUT		2000000 /* usecs */
+
+/*
+ *
+ */
+struct rhdUpload *
+RHDUploadCreate(struct RhdCS *CS, void *Base, CARD32 IntAddress, CARD32 Size,
+		int Slots)
+{
+    struct rhdUpload *Upload;
+    CARD32 SlotBytes;
+    int i;
+
+    /* DRM buffers are indirect buffers themselves, which cannot chain */
+    if ((CS->Type != RHD_CS_CP) && (CS->Type != RHD_CS_EMUL))
+	return NULL;
+
+    if (Slots > RHD_UPLOAD_SLOTS_MAX)
+	Slots = RHD_UPLOAD_SLOTS_MAX;
+    if (Slots < 2)
+	return NULL;
+
+    /* qword aligned, as the CP fetches them */
+    SlotBytes = (Size / Slots) & ~7;
+    if ((SlotBytes / 4) <= (UPLOAD_PACKET_HEADER + 1))
+	return NULL;
+
+    Upload = IONew(struct rhdUpload, 1);
+    if (!Upload)
+	return NULL;
+    bzero(Upload, sizeof(struct rhdUpload));
+
+    Upload->CS = CS;
+    Upload->NumSlots = Slots;
+    Upload->SlotDwords = SlotBytes / 4;
+
+    for (i = 0; i < Slots; i++) {
+	Upload->Slot[i].Ptr = (CARD32 *) ((CARD8 *) Base + i * SlotBytes);
+	Upload->Slot[i].IntAddress = IntAddress + i * SlotBytes;
+    }
+
+    return Upload;
+}
+
+/*
+ * Waits for the CP to be done with whatever was submitted from the slots.
+ */
+void
+RHDUploadDestroy(struct rhdUpload *Upload)
+{
+    int i;
+
+    if (!Upload)
+	return;
+
+    for (i = 0; i < Upload->NumSlots; i++)
+	if (Upload->Slot[i].Busy)
+	    RHDCSFenceWait(Upload->CS, Upload->Slot[i].Fence, UPLOAD_TIMEOUT);
+
+    IODelete(Upload, struct rhdUpload, 1);
+}
+
+/*
+ *
+ */
+static Bool
+rhdUploadSlotWait(struct rhdUpload *Upload, struct rhdUploadSlot *Slot)
+{
+    if (!Slot->Busy)
+	return TRUE;
+
+    if (!RHDCSFenceWait(Upload->CS, Slot->Fence, 0)) {
+	Upload->Stalls++;
+	if (!RHDCSFenceWait(Upload->CS, Slot->Fence, UPLOAD_TIMEOUT)) {
+	    LOG("%s: Timeout on fence %u.\n", __func__,
+		(unsigned int) Slot->Fence);
+	    return FALSE;
+	}
+    }
+
+    Slot->Busy = FALSE;
+    return TRUE;
+}
+
+/*
+ * Points the CP at the slot from the command stream, and fences it.
+ */
+static void
+rhdUploadSubmit(struct rhdUpload *Upload, struct rhdUploadSlot *Slot,
+		CARD32 Used)
+{
+    struct RhdCS *CS = Upload->CS;
+
+    if (Used & 1)
+	Slot->Ptr[Used++] = CP_PACKET2();
+
+    RHDCSGrab(CS, 3);
+    RHDCSWrite(CS, CP_PACKET0(R5XX_CP_IB_BASE, 2));
+    RHDCSWrite(CS, Slot->IntAddress);
+    RHDCSWrite(CS, Used);
+
+    Slot->Fence = RHDCSFenceEmit(CS);
+    Slot->Busy = TRUE;
+
+    Upload->Submits++;
+    Upload->Dwords += Used;
+    Upload->Current = (Upload->Current + 1) % Upload->NumSlots;
+}
+
+/*
+ * Blits Height lines of Width pixels of Cpp bytes to the surface given by
+ * PitchOffset, as the 2D engine takes it. Control is the GMC setup of the
+ * blit. Packets always hold a multiple of RowStep lines, so that Fill can
+ * rely on, for instance, only being asked for pairs of lines; Height does
+ * not have to be one.
+ */
+Bool
+RHDUploadHostData(struct rhdUpload *Upload, CARD32 Control,
+		  CARD32 PitchOffset, int Width, int Cpp, int Height,
+		  int RowStep, rhdUploadFillProc Fill, void *Private)
+{
+    struct rhdUploadSlot *Slot = NULL;
+    CARD32 LineDwords = (Width * Cpp + 3) / 4;
+    CARD32 Rows, Used = 0;
+    int y = 0;
+
+    Rows = min(UPLOAD_PACKET_DATA_MAX,
+	       Upload->SlotDwords - UPLOAD_PACKET_HEADER - 1) / LineDwords;
+    Rows -= Rows % RowStep;
+    if (!Rows)
+	return FALSE;
+
+    Upload->Uploads++;
+
+    while (y < Height) {
+	CARD32 *Packet, Count, Room;
+
+	if (!Slot) {
+	    Slot = &Upload->Slot[Upload->Current];
+	    if (!rhdUploadSlotWait(Upload, Slot))
+		return FALSE;
+	    Used = 0;
+	}
+
+	/* keep one dword for padding to a qword */
+	Room = Upload->SlotDwords - Used - 1;
+	if (Room > UPLOAD_PACKET_HEADER)
+	    Count = min(Rows, (Room - UPLOAD_PACKET_HEADER) / LineDwords);
+	else
+	    Count = 0;
+	Count -= Count % RowStep;
+	if (!Count) {
+	    rhdUploadSubmit(Upload, Slot, Used);
+	    Slot = NULL;
+	    continue;
+	}
+	if (Count > (CARD32) (Height - y))
+	    Count = Height - y;
+
+	Packet = Slot->Ptr + Used;
+	Packet[0] = CP_PACKET3(R5XX_CP_PACKET3_CNTL_HOSTDATA_BLT,
+			       Count * LineDwords + UPLOAD_PACKET_HEADER - 2);
+	Packet[1] = Control;
+	Packet[2] = PitchOffset;
+	Packet[3] = y << 16;
+	Packet[4] = ((y + Count) << 16) | Width;
+	Packet[5] = 0xFFFFFFFF;
+	Packet[6] = 0xFFFFFFFF;
+	Packet[7] = y << 16;
+	Packet[8] = (Count << 16) | Width;
+	Packet[9] = Count * LineDwords;
+
+	Fill(Private, (CARD8 *) &Packet[UPLOAD_PACKET_HEADER], LineDwords * 4,
+	     y, Count);
+
+	Used += UPLOAD_PACKET_HEADER + Count * LineDwords;
+	y += Count;
+	Upload->Packets++;
+    }
+
+    if (Slot)
+	rhdUploadSubmit(Upload, Slot, Used);
+
+    return TRUE;
+}
+
+/*
+ *
+ */
+void
+RHDUploadStatsPrint(struct rhdUpload *Upload)
+{
+    if (!Upload->Uploads)
+	return;
+
+    LOG("Upload: %u uploads, %u packets, %u submissions, %u kB, "
+	"%u stalls on %d slots of %u kB.\n",
+	(unsigned int) Upload->Uploads, (unsigned int) Upload->Packets,
+	(unsigned int) Upload->Submits, (unsigned int) (Upload->Dwords >> 8),
+	(unsigned int) Upload->Stalls, Upload->NumSlots,
+	(unsigned int) (Upload->SlotDwords >> 8));
+}
@@ -0,0 +1,71 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_UPLOAD_H
+# define _RHD_UPLOAD_H
+
+/*
+ * R5xx host data uploads through a ring of staging buffers.
+ *
+ * HOSTDATA_BLT packets, image data included, are built into indirect
+ * buffers that the CP is pointed at from the command stream. Each buffer
+ * carries the fence of its last submission, and is only waited on when it
+ * comes round to be filled again, so the CPU prepares the next chunk or
+ * frame while the CP still blits the previous ones.
+ */
+
+#define RHD_UPLOAD_SLOTS_MAX	8
+
+/* fills Height lines, starting at line Y of the image */
+typedef void (*rhdUploadFillProc)(void *Private, CARD8 *Dst, int DstPitch,
+				  int Y, int Height);
+
+struct rhdUploadSlot {
+    CARD32 *Ptr;
+    CARD32 IntAddress;
+    CARD32 Fence;
+    Bool Busy;	/* submitted, fence not seen */
+};
+
+struct rhdUpload {
+    struct RhdCS *CS;
+
+    struct rhdUploadSlot Slot[RHD_UPLOAD_SLOTS_MAX];
+    int NumSlots;
+    CARD32 SlotDwords;
+    int Current;
+
+    /* statistics */
+    CARD32 Uploads;
+    CARD32 Packets;
+    CARD32 Submits;
+    CARD32 Dwords;
+    CARD32 Stalls;	/* slots that were still busy when needed */
+};
+
+struct rhdUpload *RHDUploadCreate(struct RhdCS *CS, void *Base,
+				  CARD32 IntAddress, CARD32 Size, int Slots);
+void RHDUploadDestroy(struct rhdUpload *Upload);
+Bool RHDUploadHostData(struct rhdUpload *Upload, CARD32 Control,
+		       CARD32 PitchOffset, int Width, int Cpp, int Height,
+		       int RowStep, rhdUploadFillProc Fill, void *Private);
+void RHDUploadStatsPrint(struct rhdUpload *Upload);
+
+#endif /* _RHD_UPLOAD_H */
@@ -0,0 +1,220 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_crtc.h"
+#include "rhd_vblank.h"
+
+/* wake up this long before the blank is due, for the scheduler to be late */
+#define VBLANK_SLEEP_MARGIN	1500000 /* nsecs */
+
+/*
+ *
+ */
+static unsigned long long
+rhdVBlankNow(void)
+{
+    uint64_t Now, Nsecs;
+
+    clock_get_uptime(&Now);
+    absolutetime_to_nanoseconds(Now, &Nsecs);
+    return Nsecs;
+}
+
+/*
+ *
+ */
+static Bool
+rhdVBlankIn(struct rhdCrtcScan *Scan)
+{
+    return (Scan->Line >= Scan->BlankStart) || (Scan->Line < Scan->BlankEnd);
+}
+
+/*
+ * Lines until the next blank begins; a whole frame when it just did.
+ */
+static CARD32
+rhdVBlankLinesTo(struct rhdCrtcScan *Scan)
+{
+    if (Scan->Line < Scan->BlankStart)
+	return Scan->BlankStart - Scan->Line;
+    return Scan->Total - Scan->Line + Scan->BlankStart;
+}
+
+/*
+ * Lines since the last blank began.
+ */
+static CARD32
+rhdVBlankLinesIn(struct rhdCrtcScan *Scan)
+{
+    if (Scan->Line >= Scan->BlankStart)
+	return Scan->Line - Scan->BlankStart;
+    return Scan->Total - Scan->BlankStart + Scan->Line;
+}
+
+/*
+ *
+ */
+void
+RHDVBlankInit(RHDPtr rhdPtr)
+{
+    struct rhdVBlank *VBlank;
+
+    VBlank = IONew(struct rhdVBlank, 1);
+    if (!VBlank)
+	return;
+    bzero(VBlank, sizeof(struct rhdVBlank));
+
+    rhdPtr->VBlank = VBlank;
+}
+
+/*
+ *
+ */
+void
+RHDVBlankDestroy(RHDPtr rhdPtr)
+{
+    if (!rhdPtr->VBlank)
+	return;
+
+    RHDVBlankStatsPrint(rhdPtr);
+
+    IODelete(rhdPtr->VBlank, struct rhdVBlank, 1);
+    rhdPtr->VBlank = NULL;
+}
+
+/*
+ * When the last blank of CRTC Id began, be it over or not.
+ */
+Bool
+RHDVBlankLast(RHDPtr rhdPtr, int Id, unsigned long long *Stamp)
+{
+    struct rhdCrtcScan Scan;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Crtc[Id] ||
+	!RHDCrtcScanPosition(rhdPtr->Crtc[Id], &Scan))
+	return FALSE;
+
+    *Stamp = rhdVBlankNow() -
+	(unsigned long long) rhdVBlankLinesIn(&Scan) * Scan.LineTime;
+    return TRUE;
+}
+
+/*
+ * When the next blank of CRTC Id will begin.
+ */
+Bool
+RHDVBlankNext(RHDPtr rhdPtr, int Id, unsigned long long *Stamp)
+{
+    struct rhdCrtcScan Scan;
+
+    if ((Id < 0) || (Id > 1) || !rhdPtr->Crtc[Id] ||
+	!RHDCrtcScanPosition(rhdPtr->Crtc[Id], &Scan))
+	return FALSE;
+
+    *Stamp = rhdVBlankNow() +
+	(unsigned long long) rhdVBlankLinesTo(&Scan) * Scan.LineTime;
+    return TRUE;
+}
+
+/*
+ * Waits for CRTC Id to be in vertical blank. Without Next, a blank that is
+ * already going on will do; with it, only the start of the next one. Stamp,
+ * if given, gets when the blank began.
+ *
+ * This sleeps, so it must not be called from interrupt context.
+ */
+Bool
+RHDVBlankWait(RHDPtr rhdPtr, int Id, Bool Next, unsigned long long *Stamp)
+{
+    struct rhdVBlankCrtc *VCrtc;
+    struct rhdCrtcScan Scan;
+    unsigned long long Now, Due, Deadline;
+
+    if (!rhdPtr->VBlank || (Id < 0) || (Id > 1) || !rhdPtr->Crtc[Id] ||
+	!RHDCrtcScanPosition(rhdPtr->Crtc[Id], &Scan))
+	return FALSE;
+
+    VCrtc = &rhdPtr->VBlank->Crtc[Id];
+    VCrtc->Waits++;
+
+    Now = rhdVBlankNow();
+
+    if (Next || !rhdVBlankIn(&Scan)) {
+	Due = Now + (unsigned long long) rhdVBlankLinesTo(&Scan) * Scan.LineTime;
+	Deadline = Due + 2ULL * Scan.Total * Scan.LineTime;
+
+	if ((Due - Now) > (VBLANK_SLEEP_MARGIN + 1000000)) {
+	    CARD32 Ms = (CARD32) ((Due - Now - VBLANK_SLEEP_MARGIN) / 1000000);
+
+	    IOSleep(Ms);
+	    VCrtc->Sleeps++;
+	    VCrtc->SleptMs += Ms;
+	}
+
+	/* a blank seen a line ahead of time is still the one before */
+	for (;;) {
+	    if (!RHDCrtcScanPosition(rhdPtr->Crtc[Id], &Scan))
+		return FALSE;
+	    VCrtc->Polls++;
+
+	    Now = rhdVBlankNow();
+	    if (rhdVBlankIn(&Scan) && ((Now + Scan.LineTime) >= Due))
+		break;
+
+	    if (Now > Deadline) {
+		VCrtc->Timeouts++;
+		return FALSE;
+	    }
+	}
+    } else
+	VCrtc->Immediate++;
+
+    VCrtc->Stamp = Now -
+	(unsigned long long) rhdVBlankLinesIn(&Scan) * Scan.LineTime;
+    if (Stamp)
+	*Stamp = VCrtc->Stamp;
+
+    return TRUE;
+}
+
+/*
+ *
+ */
+void
+RHDVBlankStatsPrint(RHDPtr rhdPtr)
+{
+    struct rhdVBlankCrtc *VCrtc;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+	VCrtc = &rhdPtr->VBlank->Crtc[i];
+	if (!VCrtc->Waits)
+	    continue;
+
+	LOG("VBlank CRTC %d: %u waits, %u immediate, %u sleeps for %u ms, "
+	    "%u polls, %u timeouts.\n", i + 1,
+	    (unsigned int) VCrtc->Waits, (unsigned int) VCrtc->Immediate,
+	    (unsigned int) VCrtc->Sleeps, (unsigned int) VCrtc->SleptMs,
+	    (unsigned int) VCrtc->Polls, (unsigned int) VCrtc->Timeouts);
+    }
+}
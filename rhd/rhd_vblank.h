@@ -0,0 +1,56 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_VBLANK_H
+# define _RHD_VBLANK_H
+
+/*
+ * Vertical blank timing, from the CRTC registers and the mode.
+ *
+ * Waiting for a blank sleeps until shortly before it is due, and only polls
+ * the scanout position for the rest, so that CLUT and gamma updates do not
+ * keep a CPU spinning for up to a frame. Times are uptime in nsecs.
+ */
+
+struct rhdVBlankCrtc {
+    /* when the last blank that was waited for began */
+    unsigned long long Stamp;
+
+    /* statistics */
+    CARD32 Waits;
+    CARD32 Immediate;	/* already in blank, as asked for */
+    CARD32 Sleeps;
+    CARD32 SleptMs;
+    CARD32 Polls;	/* scanout position reads after sleeping */
+    CARD32 Timeouts;
+};
+
+struct rhdVBlank {
+    struct rhdVBlankCrtc Crtc[2];
+};
+
+void RHDVBlankInit(RHDPtr rhdPtr);
+void RHDVBlankDestroy(RHDPtr rhdPtr);
+Bool RHDVBlankLast(RHDPtr rhdPtr, int Id, unsigned long long *Stamp);
+Bool RHDVBlankNext(RHDPtr rhdPtr, int Id, unsigned long long *Stamp);
+Bool RHDVBlankWait(RHDPtr rhdPtr, int Id, Bool Next, unsigned long long *Stamp);
+void RHDVBlankStatsPrint(RHDPtr rhdPtr);
+
+#endif /* _RHD_VBLANK_H */
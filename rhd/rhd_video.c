@@ -47,6 +47,7 @@
 
 #include "rhd.h"
 #include "rhd_cs.h"
+#include "rhd_fbmem.h"
 
 #include "r5xx_regs.h"
 
@@ -54,6 +55,8 @@
 #include "r5xx_accel.h"
 
 #include "rhd_video.h"
+#include "rhd_yuv.h"
+#include "rhd_upload.h"
 
 #include "xf86.h"
 #include "dixstruct.h"
@@ -62,8 +65,60 @@
 #include <X11/extensions/Xv.h>
 #include "fourcc.h"
 
+/* not every fourcc.h knows the semi-planar formats, see rhd_video.h */
+#ifndef XVIMAGE_NV12
+#define XVIMAGE_NV12 \
+   { \
+	FOURCC_NV12, \
+	XvYUV, \
+	LSBFirst, \
+	{'N','V','1','2', \
+	  0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+	12, \
+	XvPlanar, \
+	2, \
+	0, 0, 0, \
+	8, 8, 8, \
+	1, 2, 2, \
+	1, 2, 2, \
+	{'Y','U','V', \
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+	XvTopToBottom \
+   }
+#endif
+
+#ifndef XVIMAGE_P010
+#define XVIMAGE_P010 \
+   { \
+	FOURCC_P010, \
+	XvYUV, \
+	LSBFirst, \
+	{'P','0','1','0', \
+	  0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+	24, \
+	XvPlanar, \
+	2, \
+	0, 0, 0, \
+	16, 16, 16, \
+	1, 2, 2, \
+	1, 2, 2, \
+	{'Y','U','V', \
+	  0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+	XvTopToBottom \
+   }
+#endif
+
 static Atom xvColorSpace;
 
+/* picked for the CPU in RHDInitVideo() */
+static struct rhdYUVPacker xvPacker;
+
+/* staging ring for R5xx uploads over the direct CP, see rhdXvUploadInit() */
+static struct rhdUpload *xvUpload;
+
+#define XV_UPLOAD_SIZE	(4 << 20)
+#define XV_UPLOAD_SLOTS	4
+
 #ifdef USE_EXA
 /*
  *
@@ -294,6 +349,22 @@ rhdQueryImageAttributes(ScrnInfoPtr pScrn, int id, CARD16 *w, CARD16 *h,
 
 	size = *h * (pitches[0] + pitches[1]);
 	break;
+    case FOURCC_NV12:
+    case FOURCC_P010:
+	*h = ALIGN(*h, 2);
+
+	offsets[0] = 0;
+	if (id == FOURCC_P010)
+	    pitches[0] = ALIGN(2 * *w, 4);
+	else
+	    pitches[0] = ALIGN(*w, 4);
+
+	/* one line of U/V pairs for every two lines of Y */
+	offsets[1] = *h * pitches[0];
+	pitches[1] = pitches[0];
+
+	size = *h * pitches[0] + (*h / 2) * pitches[1];
+	break;
     case FOURCC_UYVY:
     case FOURCC_YUY2:
     default:
@@ -413,7 +484,7 @@ R5xxXvCopyPacked(RHDPtr rhdPtr, CARD8 *src, CARD8 *dst,
 }
 
 /*
- *
+ * src2 and src3 are the V and U planes.
  */
 static void
 R5xxXvCopyPlanarToPacked(CARD8 *dst, CARD16 dstPitch,
@@ -421,40 +492,8 @@ R5xxXvCopyPlanarToPacked(CARD8 *dst, CARD16 dstPitch,
 			 CARD8 *src2, CARD16 src2Pitch,
 			 CARD8 *src3, CARD16 width, CARD16 height)
 {
-    int i, j;
-
-    for (i = 0; i < height; i++) {
-	CARD32 *d = (CARD32 *) dst;
-	CARD8 *s1 = src1;
-	CARD8 *s2 = src2;
-	CARD8 *s3 = src3;
-
-	for (j = width / 2; j > 4; j -= 4) {
-	    d[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
-	    d[1] = s1[2] | (s1[3] << 16) | (s3[1] << 8) | (s2[1] << 24);
-	    d[2] = s1[4] | (s1[5] << 16) | (s3[2] << 8) | (s2[2] << 24);
-	    d[3] = s1[6] | (s1[7] << 16) | (s3[3] << 8) | (s2[3] << 24);
-	    d += 4;
-	    s2 += 4;
-	    s3 += 4;
-	    s1 += 8;
-	}
-
-	for (; j; j--) {
-	    d[0] = s1[0] | (s1[1] << 16) | (s3[0] << 8) | (s2[0] << 24);
-	    d++;
-	    s2++;
-	    s3++;
-	    s1 += 2;
-	}
-
-	dst += dstPitch;
-	src1 += src1Pitch;
-	if (i & 1) {
-	    src2 += src2Pitch;
-	    src3 += src2Pitch;
-	}
-    }
+    RHDYUVPlanarToPacked(&xvPacker, RHD_YUV_YUY2, dst, dstPitch,
+			 src1, src1Pitch, src3, src2, src2Pitch, width, height);
 }
 
 /*
@@ -533,6 +572,102 @@ R5xxXvCopyPlanar(RHDPtr rhdPtr, CARD8 *src1, CARD8 *src2, CARD8 *src3,
 #endif
 }
 
+/*
+ * What the staged uploads fill their packets from.
+ */
+struct rhdXvFill {
+    CARD8 *src1, *src2, *src3;
+    CARD16 srcPitch, srcPitch2;
+    CARD16 w;
+};
+
+/*
+ *
+ */
+static void
+R5xxXvFillPacked(void *Private, CARD8 *Dst, int DstPitch, int Y, int Height)
+{
+    struct rhdXvFill *Fill = Private;
+    CARD8 *src = Fill->src1 + Y * Fill->srcPitch;
+
+    while (Height--) {
+	MemCopySwap32(Dst, src, Fill->srcPitch);
+	src += Fill->srcPitch;
+	Dst += DstPitch;
+    }
+}
+
+/*
+ * Always starts on an even line, so that the chroma lines line up.
+ */
+static void
+R5xxXvFillPlanar(void *Private, CARD8 *Dst, int DstPitch, int Y, int Height)
+{
+    struct rhdXvFill *Fill = Private;
+
+    R5xxXvCopyPlanarToPacked(Dst, DstPitch,
+			     Fill->src1 + Y * Fill->srcPitch, Fill->srcPitch,
+			     Fill->src2 + (Y / 2) * Fill->srcPitch2,
+			     Fill->srcPitch2,
+			     Fill->src3 + (Y / 2) * Fill->srcPitch2,
+			     Fill->w, Height);
+}
+
+/*
+ * As R5xxXvCopyPackedDMA, but built in the staging ring while the CP is
+ * still busy with the previous frame.
+ */
+static void
+R5xxXvCopyPackedStaged(RHDPtr rhdPtr, CARD8 *src, CARD8 *dst,
+		       CARD16 srcPitch, CARD16 dstPitch, CARD16 h)
+{
+    CARD32 Offset = dst - (CARD8 *)rhdPtr->FbBase + rhdPtr->FbIntAddress;
+    CARD32 Control = R5XX_GMC_DST_PITCH_OFFSET_CNTL |
+	R5XX_GMC_DST_CLIPPING | R5XX_GMC_BRUSH_NONE |
+	R5XX_GMC_DST_8BPP_CI | R5XX_GMC_SRC_DATATYPE_COLOR |
+	R5XX_ROP3_S | R5XX_DP_SRC_SOURCE_HOST_DATA |
+	R5XX_GMC_CLR_CMP_CNTL_DIS | R5XX_GMC_WR_MSK_DIS;
+    struct rhdXvFill Fill;
+
+    Fill.src1 = src;
+    Fill.srcPitch = srcPitch;
+
+    if (!RHDUploadHostData(xvUpload, Control,
+			   (dstPitch << 16) | (Offset >> 10), srcPitch, 1, h, 1,
+			   R5xxXvFillPacked, &Fill))
+	R5xxXvCopyPacked(rhdPtr, src, dst, srcPitch, dstPitch, h);
+}
+
+/*
+ *
+ */
+static void
+R5xxXvCopyPlanarStaged(RHDPtr rhdPtr, CARD8 *src1, CARD8 *src2, CARD8 *src3,
+		       CARD8 *dst1, CARD16 srcPitch, CARD16 srcPitch2,
+		       CARD16 dstPitch, CARD16 h, CARD16 w)
+{
+    CARD32 Offset = dst1 - (CARD8 *)rhdPtr->FbBase + rhdPtr->FbIntAddress;
+    CARD32 Control = R5XX_GMC_DST_PITCH_OFFSET_CNTL |
+	R5XX_GMC_DST_CLIPPING | R5XX_GMC_BRUSH_NONE |
+	R5XX_GMC_DST_32BPP | R5XX_GMC_SRC_DATATYPE_COLOR |
+	R5XX_ROP3_S | R5XX_DP_SRC_SOURCE_HOST_DATA |
+	R5XX_GMC_CLR_CMP_CNTL_DIS | R5XX_GMC_WR_MSK_DIS;
+    struct rhdXvFill Fill;
+
+    Fill.src1 = src1;
+    Fill.src2 = src2;
+    Fill.src3 = src3;
+    Fill.srcPitch = srcPitch;
+    Fill.srcPitch2 = srcPitch2;
+    Fill.w = w;
+
+    if (!RHDUploadHostData(xvUpload, Control,
+			   (dstPitch << 16) | (Offset >> 10), w / 2, 4, h, 2,
+			   R5xxXvFillPlanar, &Fill))
+	R5xxXvCopyPlanar(rhdPtr, src1, src2, src3, dst1, srcPitch, srcPitch2,
+			 dstPitch, h, w);
+}
+
 static void
 R600CopyPlanarHW(ScrnInfoPtr pScrn,
 		 unsigned char *y_src, unsigned char *u_src, unsigned char *v_src,
@@ -581,6 +716,32 @@ R600CopyPackedHW(ScrnInfoPtr pScrn,
 		   0, 0, w >> 1, h);
 }
 
+/*
+ * NV12 and P010 go up as they are: the Y plane, then the U/V plane at the
+ * next 256 byte boundary, where R600DisplayTexturedVideo() expects it.
+ */
+static void
+R600CopySemiPlanarHW(ScrnInfoPtr pScrn,
+		     unsigned char *y_src, unsigned char *uv_src,
+		     uint32_t dst_mc_addr,
+		     int srcPitch, int dstPitch, int cpp,
+		     int w, int h)
+{
+    int uv_offset = (dstPitch * h + 255) & ~255;
+
+    /* Y */
+    R600CopyToVRAM(pScrn,
+		   (char *)y_src, srcPitch,
+		   dstPitch / cpp, dst_mc_addr, h, 8 * cpp,
+		   0, 0, w, h);
+
+    /* UV, a pair per pixel */
+    R600CopyToVRAM(pScrn,
+		   (char *)uv_src, srcPitch,
+		   dstPitch / (2 * cpp), dst_mc_addr + uv_offset, h >> 1, 16 * cpp,
+		   0, 0, w >> 1, h >> 1);
+}
+
 static void
 R600CopyPlanarSW(ScrnInfoPtr pScrn,
 		 unsigned char *y_src, unsigned char *u_src, unsigned char *v_src,
@@ -657,6 +818,29 @@ R600CopyPackedSW(ScrnInfoPtr pScrn,
     }
 }
 
+static void
+R600CopySemiPlanarSW(ScrnInfoPtr pScrn,
+		     unsigned char *y_src, unsigned char *uv_src,
+		     unsigned char *dst,
+		     int srcPitch, int dstPitch,
+		     int w, int h)
+{
+    unsigned char *uv_dst = dst + ((dstPitch * h + 255) & ~255);
+    int i;
+
+    for (i = 0; i < h; i++) {
+	memcpy(dst, y_src, srcPitch);
+	y_src += srcPitch;
+	dst += dstPitch;
+    }
+
+    for (i = 0; i < (h >> 1); i++) {
+	memcpy(uv_dst, uv_src, srcPitch);
+	uv_src += srcPitch;
+	uv_dst += dstPitch;
+    }
+}
+
 /*
  *
  */
@@ -770,7 +954,12 @@ rhdPutImageTextured(ScrnInfoPtr pScrn,
 					 FBBuf,
 					 srcPitch, srcPitch2, pPriv->BufferPitch,
 					 width, height);
-		} else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
+		} else if (xvUpload)
+		    R5xxXvCopyPlanarStaged(rhdPtr, buf, buf + s2offset,
+					   buf + s3offset, FBBuf, srcPitch,
+					   srcPitch2, pPriv->BufferPitch,
+					   height, width);
+		else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
 		    R5xxXvCopyPlanarDMA(rhdPtr, buf, buf + s2offset,
 					buf + s3offset, FBBuf, srcPitch,
 					srcPitch2, pPriv->BufferPitch,
@@ -792,7 +981,12 @@ rhdPutImageTextured(ScrnInfoPtr pScrn,
 					 FBBuf,
 					 srcPitch, srcPitch2, pPriv->BufferPitch,
 					 width, height);
-		} else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
+		} else if (xvUpload)
+		    R5xxXvCopyPlanarStaged(rhdPtr, buf, buf + s3offset,
+					   buf + s2offset, FBBuf, srcPitch,
+					   srcPitch2, pPriv->BufferPitch,
+					   height, width);
+		else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
 		    R5xxXvCopyPlanarDMA(rhdPtr, buf, buf + s3offset,
 					buf + s2offset, FBBuf, srcPitch,
 					srcPitch2, pPriv->BufferPitch,
@@ -805,6 +999,26 @@ rhdPutImageTextured(ScrnInfoPtr pScrn,
 	    }
 	}
 	break;
+    case FOURCC_NV12:
+    case FOURCC_P010:
+	/* only advertised on R600 and up */
+	{
+	    int cpp = (id == FOURCC_P010) ? 2 : 1;
+	    int srcPitch = ALIGN(cpp * width, 4);
+	    unsigned char *uv_src = buf + srcPitch * ALIGN(height, 2);
+
+	    pPriv->BufferPitch = ALIGN(cpp * width, 256);
+	    if (rhdPtr->cardType != RHD_CARD_AGP)
+		R600CopySemiPlanarHW(pScrn, buf, uv_src,
+				     pPriv->BufferOffset + rhdPtr->FbIntAddress + rhdPtr->FbScanoutStart,
+				     srcPitch, pPriv->BufferPitch, cpp,
+				     width, height);
+	    else
+		R600CopySemiPlanarSW(pScrn, buf, uv_src, FBBuf,
+				     srcPitch, pPriv->BufferPitch,
+				     width, height);
+	}
+	break;
     case FOURCC_UYVY:
     case FOURCC_YUY2:
     default:
@@ -818,7 +1032,10 @@ rhdPutImageTextured(ScrnInfoPtr pScrn,
 		R600CopyPackedSW(pScrn, buf, FBBuf,
 				 2 * width, pPriv->BufferPitch,
 				 width, height);
-	} else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
+	} else if (xvUpload)
+	    R5xxXvCopyPackedStaged(rhdPtr, buf, FBBuf, 2 * width,
+				   pPriv->BufferPitch, height);
+	else if (rhdPtr->CS->Type == RHD_CS_CPDMA)
 	    R5xxXvCopyPackedDMA(rhdPtr, buf, FBBuf, 2 * width,
 				pPriv->BufferPitch, height);
 	else
@@ -880,14 +1097,18 @@ static XF86VideoFormatRec Formats[NUM_FORMATS] =
     {15, TrueColor}, {16, TrueColor}, {24, TrueColor}
 };
 
-#define NUM_IMAGES 4
+#define NUM_IMAGES 6
+/* R5xx cannot sample the semi-planar formats at the end of the list */
+#define NUM_IMAGES_R500 4
 
 static XF86ImageRec Images[NUM_IMAGES] =
 {
     XVIMAGE_YUY2,
     XVIMAGE_YV12,
     XVIMAGE_I420,
-    XVIMAGE_UYVY
+    XVIMAGE_UYVY,
+    XVIMAGE_NV12,
+    XVIMAGE_P010
 };
 
 #define NUM_ATTRIBUTES 1
@@ -949,7 +1170,10 @@ rhdSetupImageTexturedVideo(ScreenPtr pScreen)
         adapt->pAttributes = NULL;
     }
     adapt->pImages = Images;
-    adapt->nImages = NUM_IMAGES;
+    if (rhdPtr->ChipSet >= RHD_R600)
+	adapt->nImages = NUM_IMAGES;
+    else
+	adapt->nImages = NUM_IMAGES_R500;
     adapt->PutVideo = NULL;
     adapt->PutStill = NULL;
     adapt->GetVideo = NULL;
@@ -977,6 +1201,39 @@ rhdSetupImageTexturedVideo(ScreenPtr pScreen)
     return adapt;
 }
 
+/*
+ * The DRM CP already rotates its own buffers, the direct CP needs a ring of
+ * staging buffers to do the same.
+ */
+static void
+rhdXvUploadInit(ScrnInfoPtr pScrn)
+{
+    RHDPtr rhdPtr = RHDPTR(pScrn);
+    CARD32 Offset;
+
+    if (xvUpload || (rhdPtr->CS->Type != RHD_CS_CP))
+	return;
+
+    Offset = RHDAllocFbPlaced(rhdPtr, XV_UPLOAD_SIZE, 4096, RHD_FB_PLACE_HIGH,
+			      0, RHD_FB_USAGE_SCRATCH,
+			      "Xv upload");
+    if (Offset == (CARD32) -1) {
+	LOG("Xv: No room for staging uploads.\n");
+	return;
+    }
+
+    xvUpload = RHDUploadCreate(rhdPtr->CS, (CARD8 *) rhdPtr->FbBase + Offset,
+			       rhdPtr->FbIntAddress + Offset, XV_UPLOAD_SIZE,
+			       XV_UPLOAD_SLOTS);
+    if (!xvUpload) {
+	RHDFreeFb(rhdPtr, Offset);
+	return;
+    }
+
+    LOG("Xv: Uploads staged through %d slots of %d kB.\n", XV_UPLOAD_SLOTS,
+	(XV_UPLOAD_SIZE / XV_UPLOAD_SLOTS) >> 10);
+}
+
 /*
  *
  */
@@ -1005,6 +1262,9 @@ RHDInitVideo(ScreenPtr pScreen)
 
 	texturedAdaptor = rhdSetupImageTexturedVideo(pScreen);
 
+	RHDYUVPackerInit(&xvPacker, TRUE);
+	LOG("Xv: %s planar to packed YUV conversion.\n", xvPacker.Name);
+
 	adaptors[num_adaptors++] = texturedAdaptor;
 	LOG("Xv: Textured Video initialised.\n");
 
@@ -1012,6 +1272,7 @@ RHDInitVideo(ScreenPtr pScreen)
 	if (rhdPtr->ChipSet < RHD_R600) {
 	    if (!rhdPtr->ThreeDPrivate)
 		R5xx3DInit(pScrn);
+	    rhdXvUploadInit(pScrn);
 	}
     } else
 	LOG("Xv: No Textured Video "
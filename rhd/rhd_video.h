@@ -37,6 +37,17 @@ enum RHDXvColorSpace {
     RHD_XV_NUM_COLOR_SPACE
 };
 
+/*
+ * Semi-planar 4:2:0: a Y plane, followed by a plane of interleaved U and V.
+ * P010 has 16bit samples, with the 10 significant bits at the top.
+ */
+#ifndef FOURCC_NV12
+#define FOURCC_NV12 0x3231564e
+#endif
+#ifndef FOURCC_P010
+#define FOURCC_P010 0x30313050
+#endif
+
 /* Xvideo port struct */
 struct RHDPortPriv {
     DrawablePtr pDraw;
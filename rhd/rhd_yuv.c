@@ -0,0 +1,237 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The C routines build each pixel pair as a host order dword, as the
+ * hardware expects it: on big endian hosts the surface or CP swapper turns
+ * them around, so there is no separate swapping variant. The SSE2 ones only
+ * exist on x86, which is little endian, and so can simply interleave bytes.
+ * SSSE3 byte shuffles do not beat the SSE2 unpacks at this, so there is no
+ * routine of that kind.
+ */
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+# define RHD_YUV_SSE2 1
+# include <cpuid.h>
+# include <emmintrin.h>
+#endif
+
+#include "xf86.h"
+
+#include "rhd.h"
+#include "rhd_yuv.h"
+
+/*
+ *
+ */
+static void
+rhdYUVPackLineYUY2(CARD8 *Dst, const CARD8 *Y, const CARD8 *U, const CARD8 *V,
+		   int Pairs)
+{
+    CARD32 *d = (CARD32 *) Dst;
+
+    for (; Pairs > 4; Pairs -= 4) {
+	d[0] = Y[0] | (Y[1] << 16) | (U[0] << 8) | (V[0] << 24);
+	d[1] = Y[2] | (Y[3] << 16) | (U[1] << 8) | (V[1] << 24);
+	d[2] = Y[4] | (Y[5] << 16) | (U[2] << 8) | (V[2] << 24);
+	d[3] = Y[6] | (Y[7] << 16) | (U[3] << 8) | (V[3] << 24);
+	d += 4;
+	U += 4;
+	V += 4;
+	Y += 8;
+    }
+
+    for (; Pairs; Pairs--) {
+	d[0] = Y[0] | (Y[1] << 16) | (U[0] << 8) | (V[0] << 24);
+	d++;
+	U++;
+	V++;
+	Y += 2;
+    }
+}
+
+/*
+ *
+ */
+static void
+rhdYUVPackLineUYVY(CARD8 *Dst, const CARD8 *Y, const CARD8 *U, const CARD8 *V,
+		   int Pairs)
+{
+    CARD32 *d = (CARD32 *) Dst;
+
+    for (; Pairs > 4; Pairs -= 4) {
+	d[0] = U[0] | (V[0] << 16) | (Y[0] << 8) | (Y[1] << 24);
+	d[1] = U[1] | (V[1] << 16) | (Y[2] << 8) | (Y[3] << 24);
+	d[2] = U[2] | (V[2] << 16) | (Y[4] << 8) | (Y[5] << 24);
+	d[3] = U[3] | (V[3] << 16) | (Y[6] << 8) | (Y[7] << 24);
+	d += 4;
+	U += 4;
+	V += 4;
+	Y += 8;
+    }
+
+    for (; Pairs; Pairs--) {
+	d[0] = U[0] | (V[0] << 16) | (Y[0] << 8) | (Y[1] << 24);
+	d++;
+	U++;
+	V++;
+	Y += 2;
+    }
+}
+
+#ifdef RHD_YUV_SSE2
+/*
+ * Destinations are usually the framebuffer or a command buffer, both write
+ * combined, so aligned lines are written around the caches. Pitches of
+ * client images are arbitrary, so loads are unaligned.
+ */
+#define RHD_YUV_STORE(Aligned, Dst, Value)				\
+    do {								\
+	if (Aligned)							\
+	    _mm_stream_si128((__m128i *) (Dst), (Value));		\
+	else								\
+	    _mm_storeu_si128((__m128i *) (Dst), (Value));		\
+    } while (0)
+
+/*
+ * 16 pixel pairs per round: U and V are interleaved into chroma pairs, which
+ * then go between the luma bytes, or the other way around for UYVY.
+ */
+static void __attribute__((target("sse2")))
+rhdYUVPackLineSSE2(CARD8 *Dst, const CARD8 *Y, const CARD8 *U, const CARD8 *V,
+		   int Pairs, Bool UYVY)
+{
+    Bool Aligned = !((unsigned long) Dst & 15);
+
+    for (; Pairs >= 16; Pairs -= 16) {
+	__m128i y0 = _mm_loadu_si128((const __m128i *) Y);
+	__m128i y1 = _mm_loadu_si128((const __m128i *) (Y + 16));
+	__m128i u = _mm_loadu_si128((const __m128i *) U);
+	__m128i v = _mm_loadu_si128((const __m128i *) V);
+	__m128i uv0 = _mm_unpacklo_epi8(u, v);
+	__m128i uv1 = _mm_unpackhi_epi8(u, v);
+
+	if (UYVY) {
+	    RHD_YUV_STORE(Aligned, Dst, _mm_unpacklo_epi8(uv0, y0));
+	    RHD_YUV_STORE(Aligned, Dst + 16, _mm_unpackhi_epi8(uv0, y0));
+	    RHD_YUV_STORE(Aligned, Dst + 32, _mm_unpacklo_epi8(uv1, y1));
+	    RHD_YUV_STORE(Aligned, Dst + 48, _mm_unpackhi_epi8(uv1, y1));
+	} else {
+	    RHD_YUV_STORE(Aligned, Dst, _mm_unpacklo_epi8(y0, uv0));
+	    RHD_YUV_STORE(Aligned, Dst + 16, _mm_unpackhi_epi8(y0, uv0));
+	    RHD_YUV_STORE(Aligned, Dst + 32, _mm_unpacklo_epi8(y1, uv1));
+	    RHD_YUV_STORE(Aligned, Dst + 48, _mm_unpackhi_epi8(y1, uv1));
+	}
+
+	Dst += 64;
+	Y += 32;
+	U += 16;
+	V += 16;
+    }
+
+    if (Aligned)
+	_mm_sfence();
+
+    if (UYVY)
+	rhdYUVPackLineUYVY(Dst, Y, U, V, Pairs);
+    else
+	rhdYUVPackLineYUY2(Dst, Y, U, V, Pairs);
+}
+
+/*
+ *
+ */
+static void
+rhdYUVPackLineYUY2SSE2(CARD8 *Dst, const CARD8 *Y, const CARD8 *U,
+		       const CARD8 *V, int Pairs)
+{
+    rhdYUVPackLineSSE2(Dst, Y, U, V, Pairs, FALSE);
+}
+
+/*
+ *
+ */
+static void
+rhdYUVPackLineUYVYSSE2(CARD8 *Dst, const CARD8 *Y, const CARD8 *U,
+		       const CARD8 *V, int Pairs)
+{
+    rhdYUVPackLineSSE2(Dst, Y, U, V, Pairs, TRUE);
+}
+
+/*
+ *
+ */
+static Bool
+rhdYUVHasSSE2(void)
+{
+    unsigned int Eax, Ebx, Ecx, Edx;
+
+    if (!__get_cpuid(1, &Eax, &Ebx, &Ecx, &Edx))
+	return FALSE;
+
+    return (Edx & bit_SSE2) ? TRUE : FALSE;
+}
+#endif /* RHD_YUV_SSE2 */
+
+/*
+ * Without UseSIMD, the reference routines are used throughout.
+ */
+void
+RHDYUVPackerInit(struct rhdYUVPacker *Packer, Bool UseSIMD)
+{
+    Packer->Name = "C";
+    Packer->PackLine[RHD_YUV_YUY2] = rhdYUVPackLineYUY2;
+    Packer->PackLine[RHD_YUV_UYVY] = rhdYUVPackLineUYVY;
+
+#ifdef RHD_YUV_SSE2
+    if (UseSIMD && rhdYUVHasSSE2()) {
+	Packer->Name = "SSE2";
+	Packer->PackLine[RHD_YUV_YUY2] = rhdYUVPackLineYUY2SSE2;
+	Packer->PackLine[RHD_YUV_UYVY] = rhdYUVPackLineUYVYSSE2;
+    }
+#endif
+}
+
+/*
+ * Width is rounded down to whole pixel pairs. Chroma lines are stepped every
+ * second line, counted from the first one given; split images up at even
+ * lines only.
+ */
+void
+RHDYUVPlanarToPacked(struct rhdYUVPacker *Packer, enum rhdYUVPacked Format,
+		     CARD8 *Dst, int DstPitch,
+		     const CARD8 *Y, int YPitch,
+		     const CARD8 *U, const CARD8 *V, int UVPitch,
+		     int Width, int Height)
+{
+    rhdYUVPackLineProc PackLine = Packer->PackLine[Format];
+    int i;
+
+    for (i = 0; i < Height; i++) {
+	PackLine(Dst, Y, U, V, Width / 2);
+
+	Dst += DstPitch;
+	Y += YPitch;
+	if (i & 1) {
+	    U += UVPitch;
+	    V += UVPitch;
+	}
+    }
+}
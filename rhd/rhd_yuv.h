@@ -0,0 +1,55 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _RHD_YUV_H
+# define _RHD_YUV_H
+
+/*
+ * YUV format conversion for Xv uploads.
+ *
+ * Planar 4:2:0 images (YV12, I420) are packed into 4:2:2 (YUY2, UYVY) for
+ * chips that cannot sample planar textures. The routines are picked once,
+ * at runtime, from what the CPU supports; the plain C ones are the
+ * reference the others have to match byte for byte.
+ */
+
+enum rhdYUVPacked {
+    RHD_YUV_YUY2 = 0,	/* Y0 U Y1 V */
+    RHD_YUV_UYVY,	/* U Y0 V Y1 */
+    RHD_YUV_PACKED_NUM
+};
+
+/* packs Pairs pixel pairs of one line */
+typedef void (*rhdYUVPackLineProc)(CARD8 *Dst, const CARD8 *Y,
+				   const CARD8 *U, const CARD8 *V, int Pairs);
+
+struct rhdYUVPacker {
+    const char *Name;
+    rhdYUVPackLineProc PackLine[RHD_YUV_PACKED_NUM];
+};
+
+void RHDYUVPackerInit(struct rhdYUVPacker *Packer, Bool UseSIMD);
+void RHDYUVPlanarToPacked(struct rhdYUVPacker *Packer, enum rhdYUVPacked Format,
+			  CARD8 *Dst, int DstPitch,
+			  const CARD8 *Y, int YPitch,
+			  const CARD8 *U, const CARD8 *V, int UVPitch,
+			  int Width, int Height);
+
+#endif /* _RHD_YUV_H */
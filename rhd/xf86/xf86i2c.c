@@ -19,12 +19,14 @@
  * should supply this function too.
  *
  * Delay execution at least usec microseconds.
- * All values 0 to 1e6 inclusive must be expected.
+ * All values 0 to 1e6 inclusive must be expected. A zero delay is a
+ * no-op: at fast bus timings the register access is slow enough.
  */
 static void
 I2CUDelay(I2CBusPtr b, int usec)
 {
-	IODelay(usec);
+	if (usec > 0)
+		IODelay(usec);
 }
 
 /* Most drivers will register just with GetBits/PutBits functions.
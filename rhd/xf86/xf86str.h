@@ -346,6 +346,7 @@ typedef struct {
 		Bool        lowPowerMode;
 		int			lowPowerModeEngineClock;
 		int			lowPowerModeMemoryClock;
+		Bool		enableMemoryAndVoltageScaling;
 		int			verbosity;
 		char		modeNameByUser[25];	//15 should be enough
 		
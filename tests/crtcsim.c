@@ -0,0 +1,178 @@
+/*
+ * A simulated CRTC for the host tests.
+ */
+#include <math.h>
+
+#include "stubs.h"
+
+#include "rhd_regs.h"
+#include "rhd_mc.h"
+#include "rhd_modes.h"
+#include "rhd_vblank.h"
+#include "crtcsim.h"
+
+#define D1_REG_OFFSET 0x0000
+#define D2_REG_OFFSET 0x0800
+
+/* D1GRPH_UPDATE */
+#define GRPH_SURFACE_UPDATE_PENDING	(1 << 2)
+#define GRPH_UPDATE_LOCK		(1 << 16)
+
+struct crtcSim Sim;
+
+/* what rhd_crtc.c needs from elsewhere */
+Bool
+RHDUseAtom(RHDPtr rhdPtr, enum RHD_CHIPSETS *BlackList, enum atomSubSystem subsys)
+{
+    return FALSE;
+}
+
+void
+RHDMCTuneAccessForDisplay(RHDPtr rhdPtr, int Crtc, DisplayModePtr Mode,
+			  DisplayModePtr ScaledToMode)
+{
+}
+
+void
+RHDMCDisplayOff(RHDPtr rhdPtr, int Crtc)
+{
+}
+
+void
+RHDPrintModeline(DisplayModePtr mode)
+{
+}
+
+/*
+ * Fractional lines scanned out since the first frame began, at time t.
+ */
+double
+SimLines(UInt64 t)
+{
+    return Sim.Phase + (double) t * Sim.Mode.Clock / (Sim.Mode.CrtcHTotal * 1e6);
+}
+
+/*
+ * When the first blank to begin after time t does.
+ */
+UInt64
+SimBlankAfter(UInt64 t)
+{
+    double Lines = SimLines(t);
+    double Start = floor((Lines - Sim.BlankStart) / Sim.Total + 1) * Sim.Total + Sim.BlankStart;
+
+    return (UInt64) ceil((Start - Sim.Phase) * Sim.Mode.CrtcHTotal * 1e6 / Sim.Mode.Clock);
+}
+
+UInt64
+SimFrame(void)
+{
+    return (UInt64) (Sim.Total * Sim.Mode.CrtcHTotal * 1e6 / Sim.Mode.Clock);
+}
+
+UInt64
+SimLineTime(void)
+{
+    return (UInt64) ceil(Sim.Mode.CrtcHTotal * 1e6 / Sim.Mode.Clock);
+}
+
+/*
+ * Latches a pending address once a blank began after it was let go of.
+ */
+void
+SimUpdate(void)
+{
+    UInt64 Blank;
+
+    if (!Sim.Pending || Sim.Locked || Sim.Frozen ||
+	!(stubRegs[(Sim.RegOff + D1CRTC_CONTROL) / 4] & 0x01))
+	return;
+
+    Blank = SimBlankAfter(Sim.Released);
+    if (Blank > stubNow)
+	return;
+
+    Sim.Scanout = Sim.Address;
+    Sim.LatchedAt = Blank;
+    Sim.Pending = FALSE;
+    Sim.Latches++;
+}
+
+static void
+SimRead(CARD16 offset, CARD32 *value)
+{
+    stubNow += SIM_READ_COST;
+
+    if (offset == Sim.RegOff + D1CRTC_STATUS_POSITION) {
+	if (!Sim.FirstPosition)
+	    Sim.FirstPosition = stubNow;
+	if (Sim.Frozen)
+	    *value = Sim.BlankEnd + 10;
+	else
+	    *value = ((CARD32) floor(SimLines(stubNow))) % Sim.Total;
+    } else if (offset == Sim.RegOff + D1GRPH_UPDATE) {
+	SimUpdate();
+	*value &= ~GRPH_SURFACE_UPDATE_PENDING;
+	if (Sim.Pending)
+	    *value |= GRPH_SURFACE_UPDATE_PENDING;
+    }
+}
+
+static void
+SimWrite(CARD16 offset, CARD32 value)
+{
+    if (offset == Sim.RegOff + D1GRPH_UPDATE) {
+	Bool Locked = (value & GRPH_UPDATE_LOCK) ? TRUE : FALSE;
+
+	if (Sim.Locked && !Locked)
+	    Sim.Released = stubNow;
+	Sim.Locked = Locked;
+    } else if (offset == Sim.RegOff + D1GRPH_PRIMARY_SURFACE_ADDRESS) {
+	SimUpdate();
+	Sim.Address = value;
+	Sim.Pending = TRUE;
+	Sim.Released = stubNow;
+    }
+}
+
+/*
+ * A CRTC scanning out Clock kHz with HTotal by VTotal, blanked from line
+ * BlankStart to the end of the frame and up to BlankEnd.
+ */
+void
+SimSetup(RHDPtr rhdPtr, int Id, int Clock, int HTotal, int VTotal,
+	 int BlankStart, int BlankEnd, double Phase)
+{
+    stubInit();
+    bzero(&Sim, sizeof(Sim));
+
+    Sim.Mode.Clock = Clock;
+    Sim.Mode.CrtcHTotal = HTotal;
+    Sim.Mode.CrtcVTotal = VTotal;
+    Sim.Total = VTotal;
+    Sim.BlankStart = BlankStart;
+    Sim.BlankEnd = BlankEnd;
+    Sim.Phase = Phase;
+    Sim.RegOff = Id ? D2_REG_OFFSET : D1_REG_OFFSET;
+
+    Sim.Crtc.Name = Id ? "CRTC 2" : "CRTC 1";
+    Sim.Crtc.Id = Id;
+    Sim.Crtc.Active = TRUE;
+    Sim.Crtc.CurrentMode = &Sim.Mode;
+
+    stubRegs[(Sim.RegOff + D1CRTC_CONTROL) / 4] = 0x01;
+    stubRegs[(Sim.RegOff + D1CRTC_V_TOTAL) / 4] = VTotal - 1;
+    stubRegs[(Sim.RegOff + D1CRTC_V_BLANK_START_END) / 4] = BlankStart | (BlankEnd << 16);
+    stubRegReadHook = SimRead;
+    stubRegWriteHook = SimWrite;
+
+    rhdPtr->Crtc[Id] = &Sim.Crtc;
+    RHDVBlankInit(rhdPtr);
+}
+
+void
+SimDone(RHDPtr rhdPtr)
+{
+    RHDVBlankDestroy(rhdPtr);
+    rhdPtr->Crtc[0] = rhdPtr->Crtc[1] = NULL;
+}
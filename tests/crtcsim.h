@@ -0,0 +1,44 @@
+/*
+ * A simulated CRTC for the host tests: the line counter runs off the
+ * simulated clock at the pixel clock of the mode, a surface address written
+ * outside of the update lock latches at the start of the next vertical
+ * blank, and every register read costs a microsecond, as it does over PCIe.
+ */
+#ifndef _TESTS_CRTCSIM_H
+#define _TESTS_CRTCSIM_H
+
+#include "rhd_crtc.h"
+
+#define SIM_READ_COST 1000 /* ns */
+
+struct crtcSim {
+    DisplayModeRec Mode;
+    struct rhdCrtc Crtc;
+    CARD16 RegOff;
+    CARD32 Total, BlankStart, BlankEnd;
+    double Phase;	/* lines already scanned out at time 0 */
+    Bool Frozen;	/* the counter stopped outside of the blank */
+    UInt64 FirstPosition;	/* when the position was first read */
+
+    /* surface address */
+    Bool Locked;
+    Bool Pending;
+    UInt64 Released;	/* when the pending address was let go of */
+    CARD32 Address;	/* programmed */
+    CARD32 Scanout;	/* latched */
+    UInt64 LatchedAt;	/* when the blank it latched in began */
+    unsigned int Latches;
+};
+
+extern struct crtcSim Sim;
+
+void SimSetup(RHDPtr rhdPtr, int Id, int Clock, int HTotal, int VTotal,
+	      int BlankStart, int BlankEnd, double Phase);
+void SimDone(RHDPtr rhdPtr);
+void SimUpdate(void);
+double SimLines(UInt64 t);
+UInt64 SimBlankAfter(UInt64 t);
+UInt64 SimFrame(void);
+UInt64 SimLineTime(void);
+
+#endif /* _TESTS_CRTCSIM_H */
@@ -0,0 +1,334 @@
+/*
+ * Checks the page flip queue in rhd_flip.c against the simulated CRTC of
+ * crtcsim.c: flips have to latch in order, one per blank at most, Done has
+ * to hear about each of them with when it latched, and a CRTC that stops
+ * must not leave a flip pending for ever.
+ */
+#include "stubs.h"
+
+#include "rhd_fbmem.h"
+#include "rhd_regs.h"
+#include "rhd_vblank.h"
+#include "rhd_flip.h"
+#include "crtcsim.h"
+
+#define FB_INT_ADDRESS	0x40000000
+#define SCANOUT_OFFSET	0x00100000
+#define SCANOUT_SIZE	(1920 * 1080 * 4)
+
+/* the framebuffer heap: hands out buffers from the top down */
+static struct {
+    unsigned int Top;
+    int Allocs, Frees;
+    int FailAfter;	/* allocations to let through, or -1 */
+} Fb;
+
+unsigned int
+RHDAllocFbPlaced(RHDPtr rhdPtr, unsigned int size, unsigned int align,
+		 int placement, unsigned int flags, int usage, const char *name)
+{
+    CHECK(size == SCANOUT_SIZE, "back buffer of %u bytes", size);
+    CHECK(placement == RHD_FB_PLACE_HIGH, "back buffer not placed high");
+    CHECK(usage == RHD_FB_USAGE_SCANOUT, "back buffer not for scanout");
+
+    if (!Fb.FailAfter)
+	return (unsigned int) -1;
+    if (Fb.FailAfter > 0)
+	Fb.FailAfter--;
+
+    Fb.Allocs++;
+    Fb.Top -= size;
+    return Fb.Top;
+}
+
+void
+RHDFreeFb(RHDPtr rhdPtr, unsigned int offset)
+{
+    CHECK(offset != SCANOUT_OFFSET, "freed the mode set buffer");
+    Fb.Frees++;
+}
+
+/* what Done heard */
+#define DONE_MAX 256
+static struct {
+    int Count;
+    CARD32 Offset[DONE_MAX];
+    unsigned long long Stamp[DONE_MAX];
+} Done;
+
+static void
+DoneProc(void *Private, int Id, CARD32 Offset, unsigned long long Stamp)
+{
+    CHECK(Private == &Done, "wrong private pointer");
+    CHECK(Id == Sim.Crtc.Id, "done for CRTC %d", Id);
+    if (Done.Count < DONE_MAX) {
+	Done.Offset[Done.Count] = Offset;
+	Done.Stamp[Done.Count] = Stamp;
+    }
+    Done.Count++;
+}
+
+/*
+ * 1080p60 on CRTC Id, with a scanout buffer from the mode set.
+ */
+static void
+Setup(RHDPtr rhdPtr, int Id)
+{
+    SimSetup(rhdPtr, Id, 148500, 2200, 1125, 1084, 41, 300.5);
+    stubNow = 1000000000;
+
+    rhdPtr->FbIntAddress = FB_INT_ADDRESS;
+    Sim.Crtc.Offset = SCANOUT_OFFSET;
+    Sim.Crtc.FbSize = SCANOUT_SIZE;
+    Sim.Scanout = Sim.Address = FB_INT_ADDRESS + SCANOUT_OFFSET;
+
+    bzero(&Fb, sizeof(Fb));
+    Fb.Top = 0x10000000;
+    Fb.FailAfter = -1;
+    bzero(&Done, sizeof(Done));
+}
+
+static void
+Teardown(RHDPtr rhdPtr, int Id)
+{
+    RHDFlipDestroy(rhdPtr, Id);
+    SimDone(rhdPtr);
+}
+
+/*
+ * Lets time pass up to shortly after the next blank began.
+ */
+static UInt64
+PastBlank(void)
+{
+    UInt64 Blank = SimBlankAfter(stubNow);
+
+    stubNow = Blank + 5 * SIM_READ_COST;
+    return Blank;
+}
+
+static Bool
+StampOk(unsigned long long Stamp, UInt64 Blank)
+{
+    UInt64 Slack = SimLineTime() + 4 * SIM_READ_COST;
+
+    return (Stamp + Slack >= Blank) && (Stamp <= Blank + Slack);
+}
+
+static void
+TestInit(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    struct rhdCrtc Other;
+
+    Setup(rhdPtr, 0);
+    CHECK(!RHDFlipInit(rhdPtr, 0, 1, DoneProc, &Done), "flipping with one buffer");
+    CHECK(!RHDFlipInit(rhdPtr, 0, RHD_FLIP_BUFFERS_MAX + 1, DoneProc, &Done), "too many buffers");
+    CHECK(!RHDFlipInit(rhdPtr, 2, 2, DoneProc, &Done), "flipping CRTC 3");
+    CHECK(!RHDFlipInit(rhdPtr, 1, 2, DoneProc, &Done), "flipping a CRTC that is not there");
+
+    /* a mirror scans out the same buffer */
+    bzero(&Other, sizeof(Other));
+    Other.Active = TRUE;
+    Other.Offset = SCANOUT_OFFSET;
+    rhdPtr->Crtc[1] = &Other;
+    CHECK(!RHDFlipInit(rhdPtr, 0, 2, DoneProc, &Done), "flipping a mirrored buffer");
+    rhdPtr->Crtc[1] = NULL;
+
+    /* running out of memory halfway */
+    Fb.FailAfter = 1;
+    CHECK(!RHDFlipInit(rhdPtr, 0, 3, DoneProc, &Done), "flipping without memory");
+    CHECK(Fb.Frees == Fb.Allocs, "%d allocations, %d freed", Fb.Allocs, Fb.Frees);
+    CHECK(!rhdPtr->Flip[0], "flip state left behind");
+    Fb.FailAfter = -1;
+    Fb.Allocs = Fb.Frees = 0;
+
+    stubRegs[(Sim.RegOff + D1GRPH_FLIP_CONTROL) / 4] = 0x1;
+    CHECK(RHDFlipInit(rhdPtr, 0, 3, DoneProc, &Done), "no flipping");
+    CHECK(!(stubRegs[(Sim.RegOff + D1GRPH_FLIP_CONTROL) / 4] & 0x1), "flips at horizontal retrace");
+    CHECK(!RHDFlipInit(rhdPtr, 0, 3, DoneProc, &Done), "flipping twice");
+    CHECK(Fb.Allocs == 2, "%d back buffers", Fb.Allocs);
+
+    Teardown(rhdPtr, 0);
+    CHECK(Fb.Frees == 2, "%d back buffers freed", Fb.Frees);
+    CHECK(!rhdPtr->Flip[0], "flip state left behind");
+}
+
+/*
+ * One flip latches at the next blank, not before, and Done hears when.
+ */
+static void
+TestSingle(int Id)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    struct rhdFlip *Flip;
+    UInt64 Blank;
+    int Back;
+
+    Setup(rhdPtr, Id);
+    CHECK(RHDFlipInit(rhdPtr, Id, 2, DoneProc, &Done), "no flipping");
+    Flip = rhdPtr->Flip[Id];
+
+    Back = RHDFlipBackBuffer(rhdPtr, Id);
+    CHECK(Back == 1, "back buffer %d", Back);
+    CHECK(!RHDFlipQueue(rhdPtr, Id, 0), "flipped to the front buffer");
+    CHECK(!RHDFlipQueue(rhdPtr, Id, 2), "flipped to a buffer that is not there");
+    CHECK(RHDFlipQueue(rhdPtr, Id, Back), "flip refused");
+    CHECK(Sim.Address == FB_INT_ADDRESS + Flip->Offset[Back], "programmed 0x%08X",
+	  (unsigned) Sim.Address);
+    CHECK(!Sim.Locked, "update lock left on");
+    CHECK(!RHDFlipQueue(rhdPtr, Id, Back), "flipped to the pending buffer");
+    CHECK(RHDFlipBackBuffer(rhdPtr, Id) == -1, "a free back buffer out of two");
+
+    RHDFlipPoll(rhdPtr, Id);
+    CHECK(Done.Count == 0, "done before the blank");
+    CHECK(Flip->Pending == Back, "pending %d", Flip->Pending);
+
+    Blank = PastBlank();
+    RHDFlipPoll(rhdPtr, Id);
+    CHECK(Sim.Scanout == FB_INT_ADDRESS + Flip->Offset[Back], "scanning out 0x%08X",
+	  (unsigned) Sim.Scanout);
+    CHECK(Done.Count == 1, "done %d times", Done.Count);
+    CHECK(Done.Offset[0] == Flip->Offset[Back], "done with 0x%08X", (unsigned) Done.Offset[0]);
+    CHECK(StampOk(Done.Stamp[0], Blank), "stamp off by %lld ns",
+	  (long long) (Done.Stamp[0] - Blank));
+    CHECK(Flip->Front == Back && Flip->Pending == -1, "front %d pending %d",
+	  Flip->Front, Flip->Pending);
+    CHECK(RHDFlipBackBuffer(rhdPtr, Id) == 0, "mode set buffer not free again");
+
+    /* flipping back puts the mode set buffer up on destroy, without Done */
+    Teardown(rhdPtr, Id);
+    CHECK(Sim.Scanout == FB_INT_ADDRESS + SCANOUT_OFFSET, "left scanning out 0x%08X",
+	  (unsigned) Sim.Scanout);
+    CHECK(Done.Count == 1, "done on destroy");
+}
+
+/*
+ * With three buffers a flip waits behind the pending one, and goes out in
+ * the blank after.
+ */
+static void
+TestQueued(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    struct rhdFlip *Flip;
+    UInt64 Blank[2];
+
+    Setup(rhdPtr, 0);
+    CHECK(RHDFlipInit(rhdPtr, 0, 3, DoneProc, &Done), "no flipping");
+    Flip = rhdPtr->Flip[0];
+
+    CHECK(RHDFlipQueue(rhdPtr, 0, 1), "first flip refused");
+    CHECK(RHDFlipQueue(rhdPtr, 0, 2), "second flip refused");
+    CHECK(Sim.Address == FB_INT_ADDRESS + Flip->Offset[1], "queued flip programmed early");
+    CHECK(RHDFlipBackBuffer(rhdPtr, 0) == -1, "a free back buffer out of three");
+    CHECK(!RHDFlipQueue(rhdPtr, 0, 0), "third flip taken");
+
+    Blank[0] = PastBlank();
+    RHDFlipPoll(rhdPtr, 0);
+    CHECK(Done.Count == 1 && Done.Offset[0] == Flip->Offset[1], "first flip not done");
+    CHECK(Sim.Address == FB_INT_ADDRESS + Flip->Offset[2], "queued flip not programmed");
+    CHECK(Flip->Pending == 2 && Flip->Queued == -1, "pending %d queued %d",
+	  Flip->Pending, Flip->Queued);
+
+    Blank[1] = PastBlank();
+    RHDFlipPoll(rhdPtr, 0);
+    CHECK(Done.Count == 2 && Done.Offset[1] == Flip->Offset[2], "second flip not done");
+    CHECK(StampOk(Done.Stamp[0], Blank[0]) && StampOk(Done.Stamp[1], Blank[1]),
+	  "stamps off by %lld and %lld ns", (long long) (Done.Stamp[0] - Blank[0]),
+	  (long long) (Done.Stamp[1] - Blank[1]));
+    CHECK(Sim.Latches == 2, "%u latches", Sim.Latches);
+
+    Teardown(rhdPtr, 0);
+}
+
+/*
+ * Rendering as fast as the flips allow: every frame shows a new buffer,
+ * in order, and the waits sleep rather than spin.
+ */
+static void
+TestRun(int NumBuffers)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    struct rhdFlip *Flip;
+    int Order[DONE_MAX], i, Frames = 120;
+
+    Setup(rhdPtr, 1);
+    CHECK(RHDFlipInit(rhdPtr, 1, NumBuffers, DoneProc, &Done), "no flipping");
+    Flip = rhdPtr->Flip[1];
+
+    for (i = 0; i < Frames; i++) {
+	int Back;
+
+	while ((Back = RHDFlipBackBuffer(rhdPtr, 1)) < 0)
+	    CHECK(RHDFlipWait(rhdPtr, 1), "frame %d: wait failed", i);
+	/* a millisecond of drawing */
+	IODelay(1000);
+	Order[i] = Back;
+	CHECK(RHDFlipQueue(rhdPtr, 1, Back), "frame %d: flip refused", i);
+    }
+    while (Flip->Pending >= 0)
+	CHECK(RHDFlipWait(rhdPtr, 1), "last wait failed");
+
+    CHECK(Done.Count == Frames, "%d of %d flips done", Done.Count, Frames);
+    CHECK(Sim.Latches == Frames, "%u of %d flips latched", Sim.Latches, Frames);
+    for (i = 0; i < Done.Count; i++) {
+	CHECK(Done.Offset[i] == Flip->Offset[Order[i]], "flip %d out of order", i);
+	if (i)
+	    CHECK((Done.Stamp[i] > Done.Stamp[i - 1] + SimFrame() - SimLineTime() - 4 * SIM_READ_COST) &&
+		  (Done.Stamp[i] < Done.Stamp[i - 1] + SimFrame() + SimLineTime() + 4 * SIM_READ_COST),
+		  "%d buffers: flip %d %lld ns after the one before", NumBuffers, i,
+		  (long long) (Done.Stamp[i] - Done.Stamp[i - 1]));
+    }
+    CHECK(stubNow - 1000000000 < (Frames + 3) * SimFrame(), "%d buffers: %d frames took %llu ns",
+	  NumBuffers, Frames, (unsigned long long) (stubNow - 1000000000));
+    CHECK(rhdPtr->VBlank->Crtc[1].Polls < (unsigned) Frames * 1000,
+	  "%u polls", (unsigned) rhdPtr->VBlank->Crtc[1].Polls);
+
+    Teardown(rhdPtr, 1);
+}
+
+/*
+ * A CRTC that stops scanning out retires the pending flip without a stamp,
+ * instead of leaving it pending for ever.
+ */
+static void
+TestStopped(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    struct rhdFlip *Flip;
+
+    Setup(rhdPtr, 0);
+    CHECK(RHDFlipInit(rhdPtr, 0, 3, DoneProc, &Done), "no flipping");
+    Flip = rhdPtr->Flip[0];
+
+    CHECK(RHDFlipQueue(rhdPtr, 0, 1), "first flip refused");
+    CHECK(RHDFlipQueue(rhdPtr, 0, 2), "second flip refused");
+    stubRegs[(Sim.RegOff + D1CRTC_CONTROL) / 4] = 0;
+
+    CHECK(!RHDFlipWait(rhdPtr, 0), "waited on a CRTC that is off");
+    CHECK(Done.Count == 1 && Done.Stamp[0] == 0, "done %d times, stamp %llu",
+	  Done.Count, Done.Stamp[0]);
+    CHECK(Flip->Front == 1 && Flip->Pending == 2, "front %d pending %d",
+	  Flip->Front, Flip->Pending);
+    CHECK(!RHDFlipWait(rhdPtr, 0), "waited on a CRTC that is off");
+    CHECK(Done.Count == 2 && Flip->Pending == -1, "second flip left pending");
+    CHECK(RHDFlipBackBuffer(rhdPtr, 0) >= 0, "no back buffer freed up");
+
+    Teardown(rhdPtr, 0);
+    CHECK(!rhdPtr->Flip[0], "flip state left behind");
+}
+
+int
+main(void)
+{
+    TestInit();
+    TestSingle(0);
+    TestSingle(1);
+    TestQueued();
+    TestRun(2);
+    TestRun(3);
+    TestStopped();
+
+    return stubFailures ? 1 : 0;
+}
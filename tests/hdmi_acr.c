@@ -0,0 +1,191 @@
+/*
+ * Checks the HDMI audio clock regeneration solver in rhd_hdmi.c: every
+ * solution it calls exact has to be exact, in range and the one closest to
+ * the recommended N, and every solution it calls inexact has to have no
+ * exact alternative at all.
+ */
+#include "stubs.h"
+
+#include "rhd_hdmi.c"
+
+int
+RHDOutputTmdsIndex(struct rhdOutput *Output)
+{
+    return 0;
+}
+
+static const int Rates[] = { 32000, 44100, 48000, 88200, 96000, 176400, 192000 };
+#define NUM_RATES (sizeof(Rates) / sizeof(Rates[0]))
+
+/* CEA-861 and VESA DMT pixel clocks, in kHz */
+static const CARD32 Clocks[] = {
+    25175, 25200, 27000, 27027, 31500, 33750, 36000, 40000, 49500, 50000,
+    54000, 54054, 56250, 65000, 68250, 71000, 72000, 74176, 74250, 75000,
+    78750, 83500, 85500, 88750, 94500, 101000, 106500, 108000, 108108, 119000,
+    121750, 135000, 146250, 148352, 148500, 154000, 156000, 157500, 162000, 175500,
+    179500, 187000, 189000, 193250, 202500, 204750, 214750, 218250, 229500, 234000,
+    241500, 245250, 252750, 261000, 268250, 268500, 281250, 296703, 297000, 317000,
+    0
+};
+
+/* the sweep covers every integer kHz clock TMDS can carry */
+#define SWEEP_MIN 20000
+#define SWEEP_MAX 340000
+
+static int
+RecommendedN(int freq)
+{
+    if (!(freq % 32000))
+	return 4096 * (freq / 32000);
+    else if (!(freq % 44100))
+	return 6272 * (freq / 44100);
+    else
+	return 6144 * (freq / 48000);
+}
+
+/*
+ * What every answer has to satisfy.
+ */
+static Bool
+CheckSolution(CARD32 Clock, int freq, Bool Exact, int N, int CTS)
+{
+    unsigned long long Den = 128ULL * freq;
+    unsigned long long Num = (unsigned long long) Clock * 1000 * N;
+    int failures = stubFailures;
+
+    CHECK((N >= (128 * freq + 1499) / 1500) && (N <= 128 * freq / 300),
+	  "%u kHz %d Hz: N=%d out of range", (unsigned) Clock, freq, N);
+    CHECK((CTS > 0) && (CTS <= HDMI_ACR_CTS_MAX),
+	  "%u kHz %d Hz: CTS=%d out of range", (unsigned) Clock, freq, CTS);
+    if (Exact)
+	CHECK(Den * CTS == Num, "%u kHz %d Hz: N=%d CTS=%d is not exact",
+	      (unsigned) Clock, freq, N, CTS);
+    else {
+	CHECK(N == RecommendedN(freq), "%u kHz %d Hz: inexact N=%d is not the recommended one",
+	      (unsigned) Clock, freq, N);
+	CHECK((CTS == (Num + Den / 2) / Den), "%u kHz %d Hz: CTS=%d is not rounded",
+	      (unsigned) Clock, freq, CTS);
+    }
+    return failures == stubFailures;
+}
+
+/* xf86.h has an abs() that does not survive being compared */
+static int
+Distance(int a, int b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+/*
+ * Brute force: the exact N closest to the recommended one, the lower on a
+ * tie, or 0 when there is none.
+ */
+static int
+BestN(CARD32 Clock, int freq)
+{
+    unsigned long long Den = 128ULL * freq;
+    int Rec = RecommendedN(freq), Best = 0, N;
+
+    for (N = (128 * freq + 1499) / 1500; N <= 128 * freq / 300; N++) {
+	unsigned long long Num = (unsigned long long) Clock * 1000 * N;
+
+	if ((Num % Den) || (Num / Den > HDMI_ACR_CTS_MAX))
+	    continue;
+	if (!Best || (Distance(N, Rec) < Distance(Best, Rec)))
+	    Best = N;
+    }
+    return Best;
+}
+
+static void
+TestKnownClocks(void)
+{
+    unsigned int i, j;
+
+    for (i = 0; Clocks[i]; i++)
+	for (j = 0; j < NUM_RATES; j++) {
+	    int N, CTS, Best = BestN(Clocks[i], Rates[j]);
+	    Bool Exact = HdmiSolveACR(Clocks[i], Rates[j], &N, &CTS);
+
+	    if (!CheckSolution(Clocks[i], Rates[j], Exact, N, CTS))
+		continue;
+	    CHECK(Exact == (Best != 0), "%u kHz %d Hz: solver says %s, brute force found N=%d",
+		  (unsigned) Clocks[i], Rates[j], Exact ? "exact" : "inexact", Best);
+	    if (Exact)
+		CHECK(N == Best, "%u kHz %d Hz: N=%d, closest exact N is %d",
+		      (unsigned) Clocks[i], Rates[j], N, Best);
+	}
+}
+
+/*
+ * Every kHz clock: the answers have to hold up, and the claims in the
+ * comment above HdmiSolveACR have to be true.
+ */
+static void
+TestSweep(void)
+{
+    CARD32 Clock;
+    unsigned int j;
+    int Inexact = 0;
+
+    for (Clock = SWEEP_MIN; Clock <= SWEEP_MAX; Clock++)
+	for (j = 0; j < NUM_RATES; j++) {
+	    int N, CTS;
+	    Bool Exact = HdmiSolveACR(Clock, Rates[j], &N, &CTS);
+
+	    CheckSolution(Clock, Rates[j], Exact, N, CTS);
+	    if (Exact)
+		continue;
+	    Inexact++;
+	    CHECK(Rates[j] % 44100 == 0, "%u kHz %d Hz: no exact solution",
+		  (unsigned) Clock, Rates[j]);
+	    CHECK(Clock % 10, "%u kHz %d Hz: no exact solution on the 10kHz grid",
+		  (unsigned) Clock, Rates[j]);
+	}
+    printf("hdmi_acr: %d of %d swept clock/rate pairs have no exact solution\n",
+	   Inexact, (SWEEP_MAX - SWEEP_MIN + 1) * (int) NUM_RATES);
+}
+
+/*
+ * The 1/1.001 clocks come from the table, everything is cached, and the
+ * oldest cache entry goes first.
+ */
+static void
+TestLookup(void)
+{
+    struct rhdHdmi hdmi;
+    struct rhdHdmiACR *ACR, *First;
+    int i;
+
+    bzero(&hdmi, sizeof(hdmi));
+
+    ACR = HdmiACRLookup(&hdmi, 74175);
+    CHECK(ACR->N[0] == 11648 && ACR->CTS[0] == 210937, "74.25/1.001 MHz 32kHz not from the table");
+    CHECK(ACR->N[1] == 17836 && ACR->CTS[1] == 234375, "74.25/1.001 MHz 44.1kHz not from the table");
+    CHECK(ACR->N[2] == 11648 && ACR->CTS[2] == 140625, "74.25/1.001 MHz 48kHz not from the table");
+
+    First = HdmiACRLookup(&hdmi, 148500);
+    CHECK(First->N[2] == 6144 && First->CTS[2] == 148500, "148.5 MHz 48kHz: N=%d CTS=%d",
+	  First->N[2], First->CTS[2]);
+    CHECK(HdmiACRLookup(&hdmi, 148500) == First, "148.5 MHz not cached");
+
+    for (i = 0; i < RHD_HDMI_ACR_CACHE - 1; i++)
+	HdmiACRLookup(&hdmi, 25200 + i);
+    CHECK(HdmiACRLookup(&hdmi, 148500) == First, "148.5 MHz evicted too early");
+
+    HdmiACRLookup(&hdmi, 27000);
+    for (i = 0; i < RHD_HDMI_ACR_CACHE; i++)
+	CHECK(hdmi.ACRCache[i].Clock != 74175, "oldest entry not evicted");
+}
+
+int
+main(void)
+{
+    stubInit();
+
+    TestKnownClocks();
+    TestSweep();
+    TestLookup();
+
+    return stubFailures ? 1 : 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Host stand-in for the parts of IOLib the rhd code uses; the functions
+ * are implemented in tests/stubs.c.
+ */
+#ifndef _TESTS_IOLIB_H
+#define _TESTS_IOLIB_H
+
+#include <IOKit/IOTypes.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdarg.h>
+
+void *IOMalloc(size_t size);
+void IOFree(void *address, size_t size);
+#define IONew(type, number) ((type *) IOMalloc(sizeof(type) * (number)))
+#define IODelete(ptr, type, number) IOFree((ptr), sizeof(type) * (number))
+
+void IOSleep(unsigned milliseconds);
+void IODelay(unsigned microseconds);
+void IOLog(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+void clock_get_uptime(uint64_t *result);
+void absolutetime_to_nanoseconds(uint64_t abstime, uint64_t *result);
+void nanoseconds_to_absolutetime(uint64_t nanoseconds, uint64_t *result);
+
+enum {
+	kNanosecondScale = 1,
+	kMicrosecondScale = 1000,
+	kMillisecondScale = 1000000,
+	kSecondScale = 1000000000
+};
+
+int min(int a, int b);
+int max(int a, int b);
+
+#endif /* _TESTS_IOLIB_H */
@@ -0,0 +1,34 @@
+/*
+ * Host stand-in for the IOKit types the rhd code uses.
+ */
+#ifndef _TESTS_IOTYPES_H
+#define _TESTS_IOTYPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef uint8_t UInt8;
+typedef int8_t SInt8;
+typedef uint16_t UInt16;
+typedef int16_t SInt16;
+typedef uint32_t UInt32;
+typedef int32_t SInt32;
+typedef uint64_t UInt64;
+typedef int64_t SInt64;
+
+typedef int IOReturn;
+typedef uint32_t IOOptionBits;
+typedef unsigned long IOVirtualAddress;
+typedef unsigned long IOPhysicalAddress;
+typedef unsigned long IOByteCount;
+typedef struct IOLock IOLock;
+
+#define kIOReturnSuccess 0
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#endif /* _TESTS_IOTYPES_H */
@@ -0,0 +1 @@
+#define assert(x) ((void) 0)
@@ -0,0 +1,20 @@
+/*
+ * Host stand-in for the Mac OS types the rhd code uses.
+ */
+#ifndef _TESTS_IOMACOSTYPES_H
+#define _TESTS_IOMACOSTYPES_H
+
+#include <IOKit/IOTypes.h>
+
+typedef void *LogicalAddress;
+typedef void *Ptr;
+typedef short OSErr;
+typedef int32_t OSStatus;
+typedef unsigned long ByteCount;
+typedef int32_t Fixed;
+
+struct RegEntryID { void *opaque[4]; };
+typedef struct RegEntryID RegEntryID;
+typedef RegEntryID *RegEntryIDPtr;
+
+#endif /* _TESTS_IOMACOSTYPES_H */
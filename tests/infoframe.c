@@ -0,0 +1,198 @@
+/*
+ * Checks the infoframe builders and slots in rhd_infoframe.c: checksums,
+ * which dwords a flush writes, and that an invalidated slot is written out
+ * in full.
+ */
+#include "stubs.h"
+
+#include "rhd_infoframe.h"
+
+#define SLOT_REG 0x7400
+
+static unsigned int Writes;
+
+static void
+WriteReg(void *Private, CARD32 Reg, CARD32 Value)
+{
+    CHECK(Private == &Writes, "wrong private pointer");
+    Writes++;
+    myRegWrite(NULL, Reg, Value);
+}
+
+static int
+Flush(struct rhdInfoFrameSlot *Slot)
+{
+    int Count;
+
+    Writes = 0;
+    Count = RHDInfoFrameSlotFlush(Slot, WriteReg, &Writes);
+    CHECK(Count == (int) Writes, "flush says %d, wrote %u", Count, Writes);
+    return Count;
+}
+
+/*
+ * Header and payload, checksum included, have to add up to 0.
+ */
+static void
+CheckSum(const struct rhdInfoFrame *Frame, const char *Name)
+{
+    CARD8 Sum = Frame->Type + Frame->Version + Frame->Length;
+    int i;
+
+    for (i = 0; i <= Frame->Length; i++)
+	Sum += Frame->Data[i];
+    CHECK(Sum == 0, "%s frame sums up to 0x%02X", Name, Sum);
+}
+
+/*
+ * The registers have to hold the frame, little endian, checksum first.
+ */
+static void
+CheckRegs(const struct rhdInfoFrame *Frame, int NumDwords)
+{
+    int i;
+
+    for (i = 0; i < NumDwords; i++) {
+	const CARD8 *Data = &Frame->Data[4 * i];
+	CARD32 Value = Data[0] | (Data[1] << 8) | (Data[2] << 16) | ((CARD32) Data[3] << 24);
+
+	CHECK(stubRegs[SLOT_REG / 4 + i] == Value, "dword %d is 0x%08X, not 0x%08X",
+	      i, (unsigned) stubRegs[SLOT_REG / 4 + i], (unsigned) Value);
+    }
+}
+
+static void
+TestChecksums(void)
+{
+    struct rhdInfoFrameAVI AVI;
+    struct rhdInfoFrameAudio Audio;
+    struct rhdInfoFrame Frame;
+
+    /* what RHDHdmiSetMode sends */
+    bzero(&AVI, sizeof(AVI));
+    RHDInfoFrameAVI(&Frame, &AVI);
+    CHECK(Frame.Type == 0x82 && Frame.Version == 0x02 && Frame.Length == 0x0D,
+	  "AVI header %02X %02X %02X", Frame.Type, Frame.Version, Frame.Length);
+    CHECK(Frame.Data[0] == 0x6F, "empty AVI checksum is 0x%02X", Frame.Data[0]);
+    CheckSum(&Frame, "empty AVI");
+
+    AVI.ColorFormat = 2;
+    AVI.ActiveInformationPresent = TRUE;
+    AVI.ActiveFormatAspectRatio = 8;
+    AVI.PictureAspectRatio = 2;
+    AVI.Colorimetry = 2;
+    AVI.Quantization = 2;
+    AVI.ITC = TRUE;
+    AVI.VideoFormatIdentification = 16;
+    AVI.BarInfoDataValid = 3;
+    AVI.TopBar = 0x1234;
+    AVI.RightBar = 0xFFFF;
+    RHDInfoFrameAVI(&Frame, &AVI);
+    CHECK(Frame.Data[1] == 0x5C && Frame.Data[2] == 0xA8 && Frame.Data[3] == 0x88 &&
+	  Frame.Data[4] == 16, "AVI payload %02X %02X %02X %02X",
+	  Frame.Data[1], Frame.Data[2], Frame.Data[3], Frame.Data[4]);
+    CHECK(Frame.Data[6] == 0x34 && Frame.Data[7] == 0x12, "AVI top bar not little endian");
+    CheckSum(&Frame, "1080p AVI");
+
+    /* two channels */
+    bzero(&Audio, sizeof(Audio));
+    Audio.ChannelCount = 1;
+    RHDInfoFrameAudio(&Frame, &Audio);
+    CHECK(Frame.Type == 0x84 && Frame.Version == 0x01 && Frame.Length == 0x0A,
+	  "audio header %02X %02X %02X", Frame.Type, Frame.Version, Frame.Length);
+    CHECK(Frame.Data[0] == 0x70, "stereo audio checksum is 0x%02X", Frame.Data[0]);
+    CheckSum(&Frame, "stereo audio");
+
+    Audio.ChannelCount = 7;
+    Audio.ChannelAllocation = 0x13;
+    Audio.LevelShift = 15;
+    Audio.DownmixInhibit = TRUE;
+    RHDInfoFrameAudio(&Frame, &Audio);
+    CHECK(Frame.Data[5] == 0xF8, "audio level shift byte is 0x%02X", Frame.Data[5]);
+    CheckSum(&Frame, "7.1 audio");
+}
+
+static void
+TestSlot(void)
+{
+    struct rhdInfoFrameAVI AVI;
+    struct rhdInfoFrame Frame;
+    struct rhdInfoFrameSlot Slot;
+
+    stubInit();
+    RHDInfoFrameSlotInit(&Slot, SLOT_REG, 4);
+
+    bzero(&AVI, sizeof(AVI));
+    RHDInfoFrameAVI(&Frame, &AVI);
+
+    /* nothing is known about the hardware yet */
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 4, "first flush wrote %u dwords", Writes);
+    CheckRegs(&Frame, 4);
+
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 0, "unchanged frame wrote %u dwords", Writes);
+
+    /* the VIC is in the second dword, and the checksum in the first */
+    AVI.VideoFormatIdentification = 4;
+    RHDInfoFrameAVI(&Frame, &AVI);
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 2, "new VIC wrote %u dwords", Writes);
+    CheckRegs(&Frame, 4);
+
+    /* changes add up until the next flush */
+    AVI.TopBar = 1;
+    RHDInfoFrameAVI(&Frame, &AVI);
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    AVI.TopBar = 0;
+    AVI.RightBar = 1;
+    RHDInfoFrameAVI(&Frame, &AVI);
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 3, "two bar changes wrote %u dwords", Writes);
+    CheckRegs(&Frame, 4);
+
+    /* lost registers */
+    bzero(stubRegs, sizeof(stubRegs));
+    RHDInfoFrameSlotInvalidate(&Slot);
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 4, "invalidated slot wrote %u dwords", Writes);
+    CheckRegs(&Frame, 4);
+
+    CHECK(Flush(&Slot) == 0, "flush without a set wrote %u dwords", Writes);
+}
+
+/*
+ * A frame longer than its slot is cut off at the end of the slot.
+ */
+static void
+TestShortSlot(void)
+{
+    struct rhdInfoFrameAudio Audio;
+    struct rhdInfoFrame Frame;
+    struct rhdInfoFrameSlot Slot;
+
+    stubInit();
+    RHDInfoFrameSlotInit(&Slot, SLOT_REG, 2);
+
+    bzero(&Audio, sizeof(Audio));
+    Audio.ChannelCount = 1;
+    Audio.LevelShift = 1;
+    RHDInfoFrameAudio(&Frame, &Audio);
+    RHDInfoFrameSlotSet(&Slot, &Frame);
+    CHECK(Flush(&Slot) == 2, "audio frame wrote %u dwords", Writes);
+    CheckRegs(&Frame, 2);
+    CHECK(stubRegs[SLOT_REG / 4 + 2] == 0, "wrote past the end of the slot");
+
+    RHDInfoFrameSlotInit(&Slot, SLOT_REG, 100);
+    CHECK(Slot.NumDwords == RHD_INFOFRAME_DWORDS, "slot of %d dwords", Slot.NumDwords);
+}
+
+int
+main(void)
+{
+    TestChecksums();
+    TestSlot();
+    TestShortSlot();
+
+    return stubFailures ? 1 : 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Host stand-ins for the kext environment.
+ */
+#include <stdlib.h>
+
+#include "stubs.h"
+
+CARD32 stubRegs[STUB_REGS];
+unsigned int stubRegWrites;
+
+void (*stubRegReadHook)(CARD16 offset, CARD32 *value);
+void (*stubRegWriteHook)(CARD16 offset, CARD32 value);
+
+UInt64 stubNow;
+UInt64 stubSleepLate;
+
+RHDRec stubRhd;
+ScrnInfoRec stubScrn;
+
+int stubFailures;
+
+/*
+ * Fresh registers, clock and screen for each test.
+ */
+void
+stubInit(void)
+{
+    bzero(stubRegs, sizeof(stubRegs));
+    stubRegWrites = 0;
+    stubRegReadHook = NULL;
+    stubRegWriteHook = NULL;
+    stubNow = 0;
+    stubSleepLate = 0;
+
+    bzero(&stubRhd, sizeof(stubRhd));
+    bzero(&stubScrn, sizeof(stubScrn));
+    stubScrn.driverPrivate = (pointer) &stubRhd;
+    xf86Screens[0] = &stubScrn;
+}
+
+CARD32
+myRegRead(pointer MMIOBase, CARD16 offset)
+{
+    CARD32 value = stubRegs[offset / 4];
+
+    if (stubRegReadHook)
+	stubRegReadHook(offset, &value);
+    return value;
+}
+
+void
+myRegWrite(pointer MMIOBase, CARD16 offset, CARD32 value)
+{
+    stubRegWrites++;
+    stubRegs[offset / 4] = value;
+    if (stubRegWriteHook)
+	stubRegWriteHook(offset, value);
+}
+
+void *
+IOMalloc(size_t size)
+{
+    return malloc(size);
+}
+
+void
+IOFree(void *address, size_t size)
+{
+    free(address);
+}
+
+void
+IOSleep(unsigned milliseconds)
+{
+    stubNow += (UInt64) milliseconds * 1000000 + stubSleepLate;
+}
+
+void
+IODelay(unsigned microseconds)
+{
+    stubNow += (UInt64) microseconds * 1000;
+}
+
+void
+IOLog(const char *format, ...)
+{
+    va_list ap;
+
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void
+logMsg(UInt32 type, const char *format, ...)
+{
+    va_list ap;
+
+    if (!getenv("STUB_VERBOSE"))
+	return;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void
+clock_get_uptime(uint64_t *result)
+{
+    *result = stubNow;
+}
+
+void
+absolutetime_to_nanoseconds(uint64_t abstime, uint64_t *result)
+{
+    *result = abstime;
+}
+
+void
+nanoseconds_to_absolutetime(uint64_t nanoseconds, uint64_t *result)
+{
+    *result = nanoseconds;
+}
+
+int
+min(int a, int b)
+{
+    return (a < b) ? a : b;
+}
+
+int
+max(int a, int b)
+{
+    return (a > b) ? a : b;
+}
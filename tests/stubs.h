@@ -0,0 +1,42 @@
+/*
+ * Host stand-ins for the kext environment, so that single rhd source files
+ * can be built and exercised by the programs in this directory.
+ */
+#ifndef _TESTS_STUBS_H
+#define _TESTS_STUBS_H
+
+#include "xf86.h"
+#include "rhd.h"
+
+#define STUB_REGS (0x10000 / 4)
+
+/* register file behind myRegRead/myRegWrite, indexed by offset / 4 */
+extern CARD32 stubRegs[STUB_REGS];
+extern unsigned int stubRegWrites;
+
+/* when set, a read hook may change what a read returns, a write hook sees
+ * every write after it reached the register file */
+extern void (*stubRegReadHook)(CARD16 offset, CARD32 *value);
+extern void (*stubRegWriteHook)(CARD16 offset, CARD32 value);
+
+/* simulated uptime in ns, advanced only by IODelay, IOSleep and hooks;
+ * IOSleep oversleeps by stubSleepLate, as a busy scheduler would */
+extern UInt64 stubNow;
+extern UInt64 stubSleepLate;
+
+extern RHDRec stubRhd;
+extern ScrnInfoRec stubScrn;
+
+extern int stubFailures;
+
+void stubInit(void);
+
+#define CHECK(cond, fmt, args...)					\
+do {									\
+    if (!(cond)) {							\
+	stubFailures++;							\
+	fprintf(stderr, "%s:%d: %s: " fmt "\n", __FILE__, __LINE__, #cond, ## args); \
+    }									\
+} while (0)
+
+#endif /* _TESTS_STUBS_H */
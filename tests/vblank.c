@@ -0,0 +1,157 @@
+/*
+ * Checks the vertical blank waits in rhd_vblank.c against the simulated
+ * CRTC of crtcsim.c.
+ */
+#include "stubs.h"
+
+#include "rhd_regs.h"
+#include "rhd_vblank.c"
+#include "crtcsim.h"
+
+/*
+ * Waiting for the next blank has to return soon after it began, with when
+ * it began, from anywhere in the frame, without spinning for long.
+ */
+static void
+TestNext(int Clock, int HTotal, int VTotal, int BlankStart, int BlankEnd)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    int i;
+
+    for (i = 0; i < 200; i++) {
+	double Phase = VTotal * (i / 200.0) + 0.37;
+	unsigned long long Stamp;
+	UInt64 LineTime, Start;
+	struct rhdVBlankCrtc *VCrtc;
+
+	SimSetup(rhdPtr, i & 1, Clock, HTotal, VTotal, BlankStart, BlankEnd, Phase);
+	stubNow = 1000000000;
+	LineTime = SimLineTime();
+
+	CHECK(RHDVBlankWait(rhdPtr, i & 1, TRUE, &Stamp), "phase %.2f: wait failed", Phase);
+	Start = SimBlankAfter(Sim.FirstPosition);
+	VCrtc = &rhdPtr->VBlank->Crtc[i & 1];
+
+	CHECK(stubNow >= Start, "phase %.2f: returned %llu ns before the blank",
+	      Phase, (unsigned long long) (Start - stubNow));
+	CHECK(stubNow <= Start + 10 * SIM_READ_COST, "phase %.2f: returned %llu ns after the blank",
+	      Phase, (unsigned long long) (stubNow - Start));
+	CHECK((Stamp + LineTime + SIM_READ_COST >= Start) && (Stamp <= Start + LineTime + SIM_READ_COST),
+	      "phase %.2f: stamp off by %lld ns", Phase, (long long) (Stamp - Start));
+	CHECK(VCrtc->Polls * 4 * SIM_READ_COST <= VBLANK_SLEEP_MARGIN + 1000000 + 10 * SIM_READ_COST,
+	      "phase %.2f: %u polls", Phase, (unsigned) VCrtc->Polls);
+	if ((Start - Sim.FirstPosition) > VBLANK_SLEEP_MARGIN + 1100000)
+	    CHECK(VCrtc->Sleeps == 1, "phase %.2f: did not sleep %llu ns before the blank",
+		  Phase, (unsigned long long) (Start - Sim.FirstPosition));
+
+	SimDone(rhdPtr);
+    }
+}
+
+/*
+ * Without Next, a blank that is going on will do, and comes with when it
+ * began.
+ */
+static void
+TestInBlank(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    unsigned long long Stamp, Last, Next;
+    UInt64 Began, Now;
+
+    /* 1080p60, 30 lines into the blank */
+    SimSetup(rhdPtr, 0, 148500, 2200, 1125, 1084, 41, 1084 + 30.5);
+    Began = SimBlankAfter(0) - SimFrame();
+
+    CHECK(RHDVBlankWait(rhdPtr, 0, FALSE, &Stamp), "wait failed");
+    CHECK(rhdPtr->VBlank->Crtc[0].Immediate == 1, "waited for a blank going on");
+    CHECK(rhdPtr->VBlank->Crtc[0].Sleeps == 0, "slept for a blank going on");
+    CHECK((Stamp + 20000 >= Began) && (Stamp <= Began + 20000),
+	  "stamp off by %lld ns", (long long) (Stamp - Began));
+
+    /* the one going on is the last, the next is a frame later */
+    Now = stubNow;
+    CHECK(RHDVBlankLast(rhdPtr, 0, &Last), "no last blank");
+    CHECK(RHDVBlankNext(rhdPtr, 0, &Next), "no next blank");
+    CHECK((Last + 20000 >= Began) && (Last <= Began + 20000),
+	  "last off by %lld ns", (long long) (Last - Began));
+    CHECK((Next + 20000 >= SimBlankAfter(Now)) && (Next <= SimBlankAfter(Now) + 20000),
+	  "next off by %lld ns", (long long) (Next - SimBlankAfter(Now)));
+
+    SimDone(rhdPtr);
+}
+
+/*
+ * A scheduler that is late by less than the margin costs nothing, one that
+ * is late past the end of the blank costs a frame, but no timeout.
+ */
+static void
+TestLateSleep(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    unsigned long long Stamp;
+    UInt64 Start;
+
+    SimSetup(rhdPtr, 0, 148500, 2200, 1125, 1084, 41, 100.5);
+    stubSleepLate = 1000000;
+    CHECK(RHDVBlankWait(rhdPtr, 0, TRUE, &Stamp), "wait failed");
+    Start = SimBlankAfter(Sim.FirstPosition);
+    CHECK(stubNow <= Start + 10 * SIM_READ_COST, "1 ms late scheduler: returned %llu ns late",
+	  (unsigned long long) (stubNow - Start));
+    SimDone(rhdPtr);
+
+    SimSetup(rhdPtr, 0, 148500, 2200, 1125, 1084, 41, 100.5);
+    stubSleepLate = 3000000;
+    CHECK(RHDVBlankWait(rhdPtr, 0, TRUE, &Stamp), "wait failed");
+    Start = SimBlankAfter(Sim.FirstPosition) + SimFrame();
+    CHECK((stubNow >= Start - 1000) && (stubNow <= Start + 10 * SIM_READ_COST),
+	  "3 ms late scheduler: returned %lld ns from the blank after",
+	  (long long) (stubNow - Start));
+    CHECK(rhdPtr->VBlank->Crtc[0].Timeouts == 0, "timed out");
+    SimDone(rhdPtr);
+}
+
+/*
+ * A counter that stops gives up after a few frames, a CRTC that is off
+ * right away.
+ */
+static void
+TestStuck(void)
+{
+    RHDPtr rhdPtr = &stubRhd;
+    unsigned long long Stamp;
+
+    SimSetup(rhdPtr, 1, 148500, 2200, 1125, 1084, 41, 500.5);
+    Sim.Frozen = TRUE;
+    CHECK(!RHDVBlankWait(rhdPtr, 1, TRUE, &Stamp), "stuck counter did not time out");
+    CHECK(rhdPtr->VBlank->Crtc[1].Timeouts == 1, "%u timeouts",
+	  (unsigned) rhdPtr->VBlank->Crtc[1].Timeouts);
+    CHECK(stubNow <= 4 * SimFrame(), "gave up only after %llu ns",
+	  (unsigned long long) stubNow);
+    SimDone(rhdPtr);
+
+    SimSetup(rhdPtr, 0, 148500, 2200, 1125, 1084, 41, 500.5);
+    stubRegs[(Sim.RegOff + D1CRTC_CONTROL) / 4] = 0;
+    CHECK(!RHDVBlankWait(rhdPtr, 0, TRUE, &Stamp), "waited on a CRTC that is off");
+    CHECK(!RHDVBlankWait(rhdPtr, 1, TRUE, &Stamp), "waited on a CRTC that is not there");
+    CHECK(!RHDVBlankWait(rhdPtr, 2, TRUE, &Stamp), "waited on CRTC 3");
+    CHECK(rhdPtr->VBlank->Crtc[0].Waits == 0, "counted a wait that never was");
+    SimDone(rhdPtr);
+}
+
+int
+main(void)
+{
+    /* 1080p60, 720p60, 640x480@60, 1600x1200@60 */
+    TestNext(148500, 2200, 1125, 1084, 41);
+    TestNext(74250, 1650, 750, 725, 25);
+    TestNext(25175, 800, 525, 515, 35);
+    TestNext(162000, 2160, 1250, 1249, 49);
+    /* blanked for most of the frame, so that it is often too close to sleep */
+    TestNext(25175, 800, 525, 100, 40);
+    TestInBlank();
+    TestLateSleep();
+    TestStuck();
+
+    return stubFailures ? 1 : 0;
+}